@@ -6,34 +6,53 @@
 // Feature toggles
 // =========================
 #define FEATURE_MODEM 1
+#define FEATURE_MQTT 1
+#define FEATURE_COAP 1
+#define FEATURE_AGGREGATION 1
 #define FEATURE_TLS 1
 #define FEATURE_SD_LOGGING 0
 #define FEATURE_AUDIO 0
 #define FEATURE_CAMERA 0
 #define FEATURE_DISPLAY 0
+#define FEATURE_I2C_BUS 0
 #define FEATURE_OTA 1
 #define FEATURE_DEEP_SLEEP 0
+#define FEATURE_POWER_MGMT 1
+#define FEATURE_SMS 1
+#define FEATURE_GNSS 1
+#define FEATURE_FRAME_LINK 1
 
 // =========================
 // Memory and buffering knobs
 // =========================
-#if HAS_PSRAM && (MAX_PSRAM_MB >= 8)
-#define RX_RING_BYTES 8192
-#define TX_RING_BYTES 4096
-#define HTTP_RX_MAX 16384
-#define JSON_DOC_BYTES 16384
-#else
-#define RX_RING_BYTES 4096
-#define TX_RING_BYTES 2048
-#define HTTP_RX_MAX 8192
-#define JSON_DOC_BYTES 6144
-#endif
+// Planned at boot from the real heap (src/mem_plan.c): every
+// buffer gets at least its floor, at most its _MAX, and the rest
+// of the budget is split by _WEIGHT. The plain names are the
+// floors, for code that needs a compile-time size; runtime sizes
+// come from mem_plan_value().
+#define MEM_PLAN_INTERNAL_PCT 15     // Share of free internal heap at boot handed out
+#define MEM_PLAN_PSRAM_PCT 50        // Share of free PSRAM (for PSRAM-capable items; none yet)
+#define RX_RING_BYTES 2048           // Modem UART RX ring (internal RAM)
+#define RX_RING_BYTES_MAX 16384
+#define RX_RING_WEIGHT 4
+#define TX_RING_BYTES 1024           // Modem UART TX ring (internal RAM)
+#define TX_RING_BYTES_MAX 8192
+#define TX_RING_WEIGHT 2
 
 #define MODEM_LINE_MAX 512
 #define AUDIO_FRAME_BYTES 1024
 #define AUDIO_DMA_BUF_COUNT 6
 #define AUDIO_DMA_BUF_LEN 256
+#if FEATURE_CAMERA && HAS_PSRAM && (MAX_PSRAM_MB >= 8)
+#define CAM_FRAME_BYTES 98304  // Max JPEG per frame (PSRAM frame ring)
+#elif FEATURE_CAMERA
+#define CAM_FRAME_BYTES 49152
+#else
 #define CAM_FRAME_BYTES 0  // Keep 0 unless camera is enabled.
+#endif
+#define AGG_MAX_CHANNELS 4
+#define AGG_MAX_PERCENTILES 3
+#define AGG_RAW_PRETRIGGER 8  // Raw samples kept for anomaly context
 
 // =========================
 // Timeouts and task sizing
@@ -46,6 +65,208 @@
 #define WATCHDOG_ENABLE 1
 #define WATCHDOG_TIMEOUT_S 10
 
+// =========================
+// Boot and subsystem start
+// =========================
+#define BOOT_INIT_EAGER 1         // 0: every peripheral starts at first use
+#define BOOT_INIT_TASK_PRIO 1     // Below the modem and fake modem tasks
+#define BOOT_INIT_TASK_STACK 6144
+
+// =========================
+// Modem UART flow control and errors
+// =========================
+// RTS/CTS when the board profile sets MODEM_USE_HWFC and wires
+// both lines, XON/XOFF otherwise (src/flow_ctl.c).
+#define MODEM_SWFC_XOFF_THRESH 100   // RX FIFO bytes (of 128) that send XOFF
+#define MODEM_SWFC_XON_THRESH 32     // ... and XON once drained below
+#define MODEM_FLOW_TEST_BYTES 4096   // Burst into a stalled receiver, per mode
+#define MODEM_FLOW_TEST_STALL_MS 300 // Fake modem stops reading this long
+#define MODEM_RESYNC_QUIET_MS 50     // Silence that ends a damaged answer
+#define MODEM_UART_RETRIES 1         // Resends of a query ("?") whose answer was damaged
+#define MODEM_STRESS_BAUD 2500000    // Flash stress test line rate (XTAL 40 MHz / 16, the top)
+#define MODEM_STRESS_BYTES 262144    // Streamed by the fake modem during the erases
+#define MODEM_STRESS_PARTITION "scratch"  // Data partition erased meanwhile (partitions.csv)
+#define MODEM_STRESS_ERASE_MS 50     // Longest 4 KB sector erase the stress rings are sized for
+
+// =========================
+// Build profile benchmark
+// =========================
+// Same workload in the debug and release profiles
+// (src/build_profile.c); keep it fixed between the two runs.
+#define BENCH_AT_ROUNDS 20           // "AT" round trips timed
+#define BENCH_FRAME_MSGS 256         // FRAME_PAYLOAD_MAX messages through a frame_link pair
+#define BENCH_DSP_BLOCKS 256         // AUDIO_DMA_BUF_LEN-sample blocks per filter
+
+// =========================
+// Modem registration
+// =========================
+#define MODEM_APN "iot"              // PDP context MODEM_PDP_CID
+#define MODEM_PDP_CID 1
+#define MODEM_SIM_TIMEOUT_MS 10000   // "+CPIN: READY" after the modem answers
+#define MODEM_REG_TIMEOUT_MS 60000   // Registration URC, per attempt
+#define MODEM_PDP_TIMEOUT_MS 30000   // AT+CGACT + "+CGEV: ME PDN ACT"
+#define MODEM_REG_RETRY_MS 2000      // Back-off after a failed stage
+#define MODEM_REG_POLL_MS 1000       // Longest sleep in modem_poll() (wakes early on RX)
+#define MODEM_REG_TASK_PRIO 4
+#define MODEM_REG_TEST_OUTAGE_MS 3000  // Simulated coverage loss in the recovery test
+
+// =========================
+// Modem sockets
+// =========================
+#define MODEM_SOCK_MAX 6             // Cap on sockets; the modem's link count may be lower
+#define MODEM_SOCK_TX_MAX 1024       // Bytes per AT+CIPSEND (larger TCP sends are partial)
+#define MODEM_SOCK_LOCAL_PORT_BASE 50000  // UDP socket n binds base + n
+#define MODEM_SOCK_TEST_ROUNDS 8     // Echo round trips per socket in the socket test
+
+// =========================
+// SMS (PDU mode)
+// =========================
+#define MODEM_SMS_NUMBER_MAX 24      // Sender / destination, "+" and up to 20 digits or a name
+#define MODEM_SMS_TEXT_MAX 480       // UTF-8 bytes: any 160-character message fits
+#define MODEM_SMS_SEND_TIMEOUT_MS 60000  // AT+CMGS waits for the network's acknowledgement
+#define MODEM_SMS_DELETE_READ 1      // modem_sms_poll() frees storage once messages are read
+#define MODEM_SMS_TEST_NUMBER "+15551234567"
+
+// =========================
+// GNSS (NMEA on the modem channel)
+// =========================
+#define GNSS_SATS_MAX 32             // Satellites in view kept across all systems
+#define GNSS_BENCH_MS 1000           // Parser benchmark duration in the GNSS test
+#define GNSS_TEST_WAIT_MS 3000       // GNSS test waits this long for a live fix
+
+// =========================
+// Framed link (binary transport beside AT)
+// =========================
+#define FRAME_PAYLOAD_MAX 256        // Bytes per DATA frame
+#define FRAME_WINDOW 8               // Frames in flight (and held out of order); power of two, <= 128, full SACK up to 8
+#define FRAME_CRC32 1                // 1 = CRC-32, 0 = CRC-16/CCITT (2 bytes less per frame)
+#define FRAME_RTO_MS 300             // Resend an unacknowledged frame after this long
+#define FRAME_RETRIES_MAX 10         // Timeout rounds without a word from the peer before failing
+#define FRAME_BENCH_BYTES 16384      // Echoed per bit-error rate in the framed link benchmark
+
+// =========================
+// MQTT client
+// =========================
+#define MQTT_BROKER_HOST "broker.local"
+#define MQTT_BROKER_PORT 1883
+#define MQTT_PROTOCOL_LEVEL 4       // 4 = MQTT 3.1.1, 5 = MQTT 5.0
+#define MQTT_KEEPALIVE_S 60
+#define MQTT_SESSION_EXPIRY_S 86400 // MQTT 5: keep session across deep sleep
+#define MQTT_INFLIGHT_MAX 8         // QoS1 publishes awaiting PUBACK
+#define MQTT_PACKET_MAX 256         // Largest encoded PUBLISH / received packet
+#define MQTT_TX_BATCH_BYTES 1024    // Publishes coalesced per transport write
+#define MQTT_ACK_TIMEOUT_MS 5000
+
+// =========================
+// CoAP telemetry transport
+// =========================
+#define COAP_SERVER_HOST "coap.local"
+#define COAP_USE_DTLS 0             // Needs DTLS + CID enabled in sdkconfig
+#if COAP_USE_DTLS
+#define COAP_SERVER_PORT 5684       // coaps
+#else
+#define COAP_SERVER_PORT 5683
+#endif
+#define COAP_LOCAL_PORT 5683
+#define COAP_REBIND_PORT 5783       // Local port the uplink test moves to (NAT rebinding)
+#define COAP_UDP_LINK_ID 1          // Modem socket index for CoAP
+#define COAP_MSG_MAX 320            // Largest datagram sent or received
+#define COAP_BLOCK_SZX 4            // Block-wise size 2^(SZX+4) = 256 bytes
+#define COAP_ACK_TIMEOUT_MS 2000    // RFC 7252 ACK_TIMEOUT
+#define COAP_MAX_RETRANSMIT 4
+#define COAP_DTLS_CID_LEN 4         // Our connection ID length (0 = none)
+#define COAP_DTLS_PSK_IDENTITY "device-01"
+#define COAP_DTLS_PSK "coap-dtls-psk-01" // Shared with the stand-in server
+
+// =========================
+// SD card logging
+// =========================
+#define SD_LOG_BUF_BYTES 4096        // One block = one DMA write (8 sectors)
+#define SD_LOG_BUF_COUNT 3           // 2 = double, 3 = triple buffering
+#define SD_LOG_BLOCKS_PER_INDEX 32   // Data blocks per index sector
+#define SD_LOG_START_SECTOR 2048     // Log owns the card from here (raw, no FATFS)
+#define SD_LOG_FLUSH_MS 1000         // Max age of buffered records
+#define SD_LOG_TASK_STACK_BYTES 4096
+#define SD_LOG_TASK_PRIO 4
+
+// =========================
+// Audio pipeline
+// =========================
+#define AUDIO_SAMPLE_RATE_HZ 16000   // 256-sample DMA frame = 16 ms
+#define DSP_USE_PIE 1                // ESP32-S3 SIMD kernels (scalar elsewhere)
+#define AUDIO_ENC_DECIMATE 2         // 16 kHz -> 8 kHz before ADPCM (1 = off)
+#define AUDIO_ENC_CORE 1             // Encoder task core (modem/network on 0)
+#define AUDIO_ENC_TASK_PRIO 6
+#define AUDIO_ENC_TASK_STACK_BYTES 4096
+
+// =========================
+// Camera pipeline
+// =========================
+#define CAM_FB_COUNT 3               // PSRAM frame ring (capture, queue, uplink)
+#define CAM_JPEG_QUALITY 12          // 0-63, lower = better / larger
+#define CAM_XCLK_HZ 20000000
+#define CAM_TX_CHUNK_BYTES 512       // Bytes per transport write
+#define CAM_DROP_POLICY 0            // 0 = drop oldest (live), 1 = drop newest
+#define CAM_TASK_STACK_BYTES 4096
+
+// =========================
+// SPI display
+// =========================
+#define DISPLAY_WIDTH 240
+#define DISPLAY_HEIGHT 240
+#define DISPLAY_SPI_HZ 40000000      // Panel clock (bus SPI_FREQ_HZ is for the SD card)
+#define DISPLAY_BAND_LINES 20        // Rows per band buffer (2 x 9.6 KB internal DMA RAM)
+#define DISPLAY_MAX_DIRTY 8          // Dirty rectangles tracked per frame
+
+// =========================
+// Deep sleep
+// =========================
+#define DEEP_SLEEP_INTERVAL_S 300
+#define DEEP_SLEEP_REG_TIMEOUT_MS 60000  // Full path: wait for network registration
+#define DEEP_SLEEP_PSM_TAU "00100001"    // T3412 ext: 1 h periodic TAU
+#define DEEP_SLEEP_PSM_ACTIVE "00000101" // T3324: 10 s reachable after each wake
+#define DEEP_SLEEP_EDRX "0101"           // 81.92 s eDRX cycle (LTE-M)
+#define DEEP_SLEEP_TLS_SESSION_MAX 512   // RTC bytes for a serialized TLS session
+
+// =========================
+// SPI bus arbiter
+// =========================
+#define SPI_ARB_ENABLED (FEATURE_SD_LOGGING || FEATURE_DISPLAY)
+#define SPI_ARB_MAX_DEVICES 4
+#define SPI_ARB_MAX_TRANSFER_BYTES 9728  // >= SD block + 1 sector and >= one display band
+#define SPI_ARB_TASK_PRIO 7
+#define SPI_ARB_TASK_STACK_BYTES 4096    // Jobs run sdspi / esp_lcd calls on this stack
+#define SPI_ARB_PRIO_DISPLAY 2           // Visible stutter if late
+#define SPI_ARB_PRIO_SD 1                // Buffered; only late, never lost
+#define SPI_ARB_DISPLAY_DEADLINE_MS 33   // Band deadline from flush start (~30 fps)
+#define SPI_ARB_SD_DEADLINE_MS 500       // Block deadline from seal
+
+// =========================
+// I2C bus manager
+// =========================
+#define I2C_QUEUE_DEPTH 16           // Transactions waiting for the bus (planner floor)
+#define I2C_QUEUE_DEPTH_MAX 64
+#define I2C_QUEUE_WEIGHT 1
+#define I2C_TXN_MAX_OPS 8            // Ops per transaction (across devices)
+#define I2C_OP_WRITE_MAX 8           // Register address + write payload bytes
+#define I2C_MAX_DEVICES 8            // Distinct addresses the bus task keeps handles for
+#define I2C_TASK_PRIO 5
+#define I2C_TASK_STACK_BYTES 3072
+
+// =========================
+// Power management (DFS + light sleep)
+// =========================
+#define POWER_CPU_MAX_MHZ 160        // PARSE / CRYPTO locks; same as the sdkconfig default
+#define POWER_CPU_MIN_MHZ 40         // XTAL clock while idle or only waiting on the UART
+#define POWER_LIGHT_SLEEP 1          // Tickless idle light sleep when no lock is held
+// Current model for the energy estimate (ESP32-S3 datasheet, radio off)
+#define POWER_UA_CPU_MAX 40000       // 160 MHz running
+#define POWER_UA_CPU_MIN 15000       // 40 MHz awake
+#define POWER_UA_LIGHT_SLEEP 240
+#define POWER_SUPPLY_MV 3300
+#define POWER_BENCH_TXNS 20          // AT transactions per benchmark pass
+#define POWER_BENCH_GAP_MS 200       // Idle time between transactions
+
 // =========================
 // Compile-time safety checks
 // =========================
@@ -53,8 +274,76 @@
 #error "FEATURE_CAMERA is enabled but HAS_CAMERA is false for this board."
 #endif
 
+#if FEATURE_CAMERA && !HAS_PSRAM
+#error "FEATURE_CAMERA keeps its frame ring in PSRAM."
+#endif
+
+#if FEATURE_MQTT && !FEATURE_MODEM
+#error "FEATURE_MQTT runs over the modem transport and needs FEATURE_MODEM."
+#endif
+
+#if FEATURE_COAP && !FEATURE_MODEM
+#error "FEATURE_COAP runs over modem UDP sockets and needs FEATURE_MODEM."
+#endif
+
+#if FEATURE_POWER_MGMT && (POWER_CPU_MIN_MHZ < 40 || POWER_CPU_MIN_MHZ > POWER_CPU_MAX_MHZ)
+#error "POWER_CPU_MIN_MHZ must be at least 40 (XTAL) and not above POWER_CPU_MAX_MHZ."
+#endif
+
+#if FEATURE_DEEP_SLEEP && !(FEATURE_MODEM && FEATURE_COAP)
+#error "FEATURE_DEEP_SLEEP wakes, sends a CoAP reading over the modem and sleeps; needs FEATURE_MODEM and FEATURE_COAP."
+#endif
+
+#if COAP_USE_DTLS && !FEATURE_TLS
+#error "COAP_USE_DTLS requires FEATURE_TLS."
+#endif
+
+#if SPI_ARB_ENABLED && (SPI_ARB_MAX_TRANSFER_BYTES < SD_LOG_BUF_BYTES + 512 || \
+                        SPI_ARB_MAX_TRANSFER_BYTES < DISPLAY_WIDTH * DISPLAY_BAND_LINES * 2)
+#error "SPI_ARB_MAX_TRANSFER_BYTES is smaller than an SD block or a display band."
+#endif
+
+// Bytes the line carries through one MODEM_STRESS_ERASE_MS erase
+// at the stress rate, while no task on either end can run: the
+// fake modem's TX ring must hold them to keep sending, and the
+// host's RX ring to keep them.
+#define MODEM_STRESS_BURST_BYTES (MODEM_STRESS_BAUD / 10 * MODEM_STRESS_ERASE_MS / 1000)
+#if RX_RING_BYTES_MAX < MODEM_STRESS_BURST_BYTES
+#error "RX_RING_BYTES_MAX is smaller than MODEM_STRESS_ERASE_MS of MODEM_STRESS_BAUD: the flash stress test could never run."
+#endif
+
+// 8-bit sequence numbers index slots as seq % FRAME_WINDOW, which
+// only stays aligned across the wrap if the window divides 256;
+// selective repeat also needs it to be at most half the space.
+#if (FRAME_WINDOW & (FRAME_WINDOW - 1)) || FRAME_WINDOW > 128 || FRAME_WINDOW < 1
+#error "FRAME_WINDOW must be a power of two, at most 128."
+#endif
+
+#if MODEM_SWFC_XON_THRESH >= MODEM_SWFC_XOFF_THRESH || MODEM_SWFC_XOFF_THRESH > 120
+#error "XON/XOFF thresholds: XON below XOFF, and XOFF low enough to leave FIFO room for bytes in flight."
+#endif
+
+// Pin checks need compile-time pins; with BOARD_AUTODETECT
+// board_init() runs the same checks against the detected board.
+#if !BOARD_AUTODETECT
+#if FEATURE_SD_LOGGING && (PIN_SD_CS < 0)
+#error "FEATURE_SD_LOGGING is enabled but PIN_SD_CS is not mapped in this board profile."
+#endif
+
+#if FEATURE_DISPLAY && ((PIN_LCD_CS < 0) || (PIN_LCD_DC < 0))
+#error "FEATURE_DISPLAY is enabled but PIN_LCD_CS / PIN_LCD_DC are not mapped in this board profile."
+#endif
+
+#if FEATURE_I2C_BUS && ((PIN_I2C_SDA < 0) || (PIN_I2C_SCL < 0))
+#error "FEATURE_I2C_BUS is enabled but I2C pins are not mapped in this board profile."
+#endif
+
 #if FEATURE_AUDIO
 #if (PIN_I2S_BCLK < 0) || (PIN_I2S_WS < 0)
 #error "FEATURE_AUDIO is enabled but I2S pins are not mapped in this board profile."
 #endif
+#if PIN_I2S_DIN < 0
+#error "FEATURE_AUDIO captures from a microphone and needs PIN_I2S_DIN."
+#endif
 #endif
+#endif  // !BOARD_AUTODETECT
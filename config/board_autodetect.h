@@ -0,0 +1,62 @@
+#pragma once
+
+// NOTE:
+// - One image for every board_*.h profile; see src/board.h for
+//   how the board is identified at boot.
+// - Compile-time values here are either common to all boards or
+//   the floor across them. board_table.c checks both against
+//   every profile, so a new board that breaks them fails to build.
+
+// Descriptor types + board_info().
+#include "board.h"
+
+#define BOARD_NAME (board_info()->desc->name)
+
+// Used when neither eFuse nor fingerprint identify the board.
+#define BOARD_AUTODETECT_DEFAULT BOARD_ID_FEATHER_ESP32S3
+
+// Shared by every profile: hot paths keep these as constants.
+#define BOARD_COMMON_UART_MODEM_NUM 1
+#define BOARD_COMMON_MODEM_BAUD 115200
+#define BOARD_COMMON_MODEM_USE_HWFC 1
+#define BOARD_COMMON_I2C_FREQ_HZ 400000
+#define BOARD_COMMON_SPI_FREQ_HZ 8000000
+
+#define UART_MODEM_NUM BOARD_COMMON_UART_MODEM_NUM
+#define MODEM_BAUD BOARD_COMMON_MODEM_BAUD
+#define MODEM_USE_HWFC BOARD_COMMON_MODEM_USE_HWFC
+#define I2C_FREQ_HZ BOARD_COMMON_I2C_FREQ_HZ
+#define SPI_FREQ_HZ BOARD_COMMON_SPI_FREQ_HZ
+
+// Capability floor for static sizing (smallest board wins).
+// Runtime values: board_info()->desc->has_* / psram_mb.
+#define BOARD_FLOOR_PSRAM_MB 2
+#define HAS_PSRAM 1
+#define MAX_PSRAM_MB BOARD_FLOOR_PSRAM_MB
+#define HAS_CAMERA 0
+#define HAS_SD 0
+
+// Sentinel for unavailable pins.
+#define INVALID_PIN (-1)
+
+// Pins: resolved at boot. Init code only.
+#define PIN_LED_STATUS (board_info()->desc->led_status)
+#define PIN_BTN_BOOT (board_info()->desc->btn_boot)
+#define PIN_BTN_USER (board_info()->desc->btn_user)
+#define PIN_I2C_SDA (board_info()->desc->i2c_sda)
+#define PIN_I2C_SCL (board_info()->desc->i2c_scl)
+#define PIN_SPI_SCK (board_info()->desc->spi_sck)
+#define PIN_SPI_MISO (board_info()->desc->spi_miso)
+#define PIN_SPI_MOSI (board_info()->desc->spi_mosi)
+#define PIN_SD_CS (board_info()->desc->sd_cs)
+#define PIN_LCD_CS (board_info()->desc->lcd_cs)
+#define PIN_LCD_DC (board_info()->desc->lcd_dc)
+#define PIN_LCD_RST (board_info()->desc->lcd_rst)
+#define PIN_MODEM_TX (board_info()->desc->modem_tx)
+#define PIN_MODEM_RX (board_info()->desc->modem_rx)
+#define PIN_MODEM_RTS (board_info()->desc->modem_rts)
+#define PIN_MODEM_CTS (board_info()->desc->modem_cts)
+#define PIN_I2S_BCLK (board_info()->desc->i2s_bclk)
+#define PIN_I2S_WS (board_info()->desc->i2s_ws)
+#define PIN_I2S_DOUT (board_info()->desc->i2s_dout)
+#define PIN_I2S_DIN (board_info()->desc->i2s_din)
@@ -5,10 +5,12 @@
 // - Keep this file focused on board-specific hardware facts only.
 
 #define BOARD_NAME "Adafruit Feather ESP32-S3"
+#define BOARD_ID BOARD_ID_FEATHER_ESP32S3
 
 // Capabilities
 #define HAS_PSRAM 1
 #define MAX_PSRAM_MB 2
+#define BOARD_FLASH_MB 4
 #define HAS_CAMERA 0
 #define HAS_NATIVE_USB 1
 #define HAS_BATTERY_CHARGER 1
@@ -42,6 +44,16 @@
 #define PIN_SPI_MOSI 35
 #define SPI_FREQ_HZ 8000000
 
+// SD card (SPI mode, on the bus above):
+//   - Not assigned in this template profile
+#define PIN_SD_CS INVALID_PIN
+
+// SPI display (ST7789, on the bus above):
+//   - Not assigned in this template profile
+#define PIN_LCD_CS INVALID_PIN
+#define PIN_LCD_DC INVALID_PIN
+#define PIN_LCD_RST INVALID_PIN
+
 // Modem UART mapping:
 //   - UART1 TX (ESP -> modem RX) -> GPIO17
 //   - UART1 RX (ESP <- modem TX) -> GPIO18
@@ -4,15 +4,12 @@
 //   - BOARD_XIAO_ESP32S3
 //   - BOARD_FEATHER_ESP32S3
 //   - BOARD_METRO_ESP32S3
+//   - BOARD_ANY_ESP32S3: one image for all three; the board is
+//     identified at boot (see src/board.h, board_autodetect.h)
 #define BOARD_FEATHER_ESP32S3
 
-#if defined(BOARD_XIAO_ESP32S3) && defined(BOARD_FEATHER_ESP32S3)
-#error "Select only one board profile."
-#endif
-#if defined(BOARD_XIAO_ESP32S3) && defined(BOARD_METRO_ESP32S3)
-#error "Select only one board profile."
-#endif
-#if defined(BOARD_FEATHER_ESP32S3) && defined(BOARD_METRO_ESP32S3)
+#if defined(BOARD_XIAO_ESP32S3) + defined(BOARD_FEATHER_ESP32S3) + \
+        defined(BOARD_METRO_ESP32S3) + defined(BOARD_ANY_ESP32S3) > 1
 #error "Select only one board profile."
 #endif
 
@@ -22,6 +19,16 @@
 #include "board_feather_esp32s3.h"
 #elif defined(BOARD_METRO_ESP32S3)
 #include "board_metro_esp32s3.h"
+#elif defined(BOARD_ANY_ESP32S3)
+#include "board_autodetect.h"
 #else
 #error "No board profile selected in board_profile.h"
 #endif
+
+// 1 when pins come from the boot-time descriptor (PIN_* are not
+// preprocessor constants then; #if on them is not possible).
+#if defined(BOARD_ANY_ESP32S3)
+#define BOARD_AUTODETECT 1
+#else
+#define BOARD_AUTODETECT 0
+#endif
@@ -0,0 +1,42 @@
+// No #pragma once: board_table.c includes this between profiles.
+//
+// Clears every macro a board_*.h profile defines, so the next
+// profile can be included in the same translation unit. Keep in
+// sync with the profiles.
+
+#undef BOARD_NAME
+#undef BOARD_ID
+#undef HAS_PSRAM
+#undef MAX_PSRAM_MB
+#undef BOARD_FLASH_MB
+#undef HAS_CAMERA
+#undef HAS_NATIVE_USB
+#undef HAS_BATTERY_CHARGER
+#undef HAS_RGB_LED
+#undef HAS_SD
+#undef INVALID_PIN
+#undef PIN_LED_STATUS
+#undef PIN_BTN_BOOT
+#undef PIN_BTN_USER
+#undef PIN_I2C_SDA
+#undef PIN_I2C_SCL
+#undef I2C_FREQ_HZ
+#undef PIN_SPI_SCK
+#undef PIN_SPI_MISO
+#undef PIN_SPI_MOSI
+#undef SPI_FREQ_HZ
+#undef PIN_SD_CS
+#undef PIN_LCD_CS
+#undef PIN_LCD_DC
+#undef PIN_LCD_RST
+#undef UART_MODEM_NUM
+#undef PIN_MODEM_TX
+#undef PIN_MODEM_RX
+#undef PIN_MODEM_RTS
+#undef PIN_MODEM_CTS
+#undef MODEM_BAUD
+#undef MODEM_USE_HWFC
+#undef PIN_I2S_BCLK
+#undef PIN_I2S_WS
+#undef PIN_I2S_DOUT
+#undef PIN_I2S_DIN
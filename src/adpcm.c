@@ -0,0 +1,127 @@
+// ============================================================
+// adpcm.c
+//
+// IMA-ADPCM (DVI) encoder/decoder. See adpcm.h for the block
+// format. Integer-only; the step tables are const (flash).
+// ============================================================
+
+#include "adpcm.h"
+
+static const int16_t s_step_table[89] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,
+    19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+    130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+    337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+    876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+    2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+    5894,  6484,  7132,  7845,  8630,  9493,  10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+
+static const int8_t s_index_table[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8,
+};
+
+// ============================================================
+// step()
+//
+// Applies one 4-bit code to the predictor / step index. Shared
+// by encoder and decoder so both track exactly the same state.
+// ============================================================
+static inline void step(adpcm_state_t *st, uint8_t code) {
+    int32_t s = s_step_table[st->step_index];
+    int32_t diff = s >> 3;
+    if (code & 4) {
+        diff += s;
+    }
+    if (code & 2) {
+        diff += s >> 1;
+    }
+    if (code & 1) {
+        diff += s >> 2;
+    }
+
+    int32_t pred = st->predictor + ((code & 8) ? -diff : diff);
+    if (pred > INT16_MAX) {
+        pred = INT16_MAX;
+    } else if (pred < INT16_MIN) {
+        pred = INT16_MIN;
+    }
+    st->predictor = (int16_t)pred;
+
+    int idx = st->step_index + s_index_table[code];
+    st->step_index = (uint8_t)(idx < 0 ? 0 : (idx > 88 ? 88 : idx));
+}
+
+// ============================================================
+// encode_sample()
+//
+// Quantizes the difference to the prediction into 4 bits.
+// ============================================================
+static inline uint8_t encode_sample(adpcm_state_t *st, int16_t sample) {
+    int32_t diff = (int32_t)sample - st->predictor;
+    int32_t s = s_step_table[st->step_index];
+    uint8_t code = 0;
+
+    if (diff < 0) {
+        code = 8;
+        diff = -diff;
+    }
+    if (diff >= s) {
+        code |= 4;
+        diff -= s;
+    }
+    s >>= 1;
+    if (diff >= s) {
+        code |= 2;
+        diff -= s;
+    }
+    s >>= 1;
+    if (diff >= s) {
+        code |= 1;
+    }
+
+    step(st, code);
+    return code;
+}
+
+size_t adpcm_encode_block(adpcm_state_t *st, const int16_t *pcm, size_t n,
+                          uint8_t *out) {
+    out[0] = (uint8_t)(st->predictor & 0xFF);
+    out[1] = (uint8_t)((uint16_t)st->predictor >> 8);
+    out[2] = st->step_index;
+    out[3] = 0;
+
+    uint8_t *p = out + ADPCM_HEADER_BYTES;
+    for (size_t i = 0; i + 1 < n; i += 2) {
+        uint8_t lo = encode_sample(st, pcm[i]);
+        uint8_t hi = encode_sample(st, pcm[i + 1]);
+        *p++ = (uint8_t)(lo | (hi << 4));
+    }
+    return (size_t)(p - out);
+}
+
+size_t adpcm_decode_block(const uint8_t *in, size_t len, int16_t *pcm,
+                          size_t max_samples) {
+    if (len < ADPCM_HEADER_BYTES) {
+        return 0;
+    }
+    adpcm_state_t st = {
+        .predictor = (int16_t)(in[0] | (in[1] << 8)),
+        .step_index = in[2] > 88 ? 88 : in[2],
+    };
+
+    size_t n = 0;
+    for (size_t i = ADPCM_HEADER_BYTES; i < len && n < max_samples; i++) {
+        step(&st, in[i] & 0x0F);
+        pcm[n++] = st.predictor;
+        if (n >= max_samples) {
+            break;
+        }
+        step(&st, in[i] >> 4);
+        pcm[n++] = st.predictor;
+    }
+    return n;
+}
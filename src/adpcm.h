@@ -0,0 +1,40 @@
+#pragma once
+
+// ============================================================
+// adpcm.h
+//
+// IMA-ADPCM codec (4 bits per sample, 4:1 over 16-bit PCM).
+//
+// Block format (one block per encoded frame, self-contained so
+// a lost datagram only loses its own frame):
+//   int16  predictor   — decoder state before the first sample
+//   uint8  step_index
+//   uint8  reserved (0)
+//   n/2 bytes of nibbles, first sample in the low nibble.
+//
+// State is a few bytes and lives in the caller's struct; no
+// allocation, no tables outside flash.
+// ============================================================
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ADPCM_HEADER_BYTES 4
+
+// Encoded size of a block of n samples (n even).
+#define ADPCM_BLOCK_BYTES(n) (ADPCM_HEADER_BYTES + (n) / 2)
+
+typedef struct {
+    int16_t predictor;
+    uint8_t step_index;
+} adpcm_state_t;
+
+// Encodes n (even) samples into out (ADPCM_BLOCK_BYTES(n) bytes),
+// continuing from and updating *st. Returns bytes written.
+size_t adpcm_encode_block(adpcm_state_t *st, const int16_t *pcm, size_t n,
+                          uint8_t *out);
+
+// Decodes one block. Returns the number of samples written
+// (at most max_samples).
+size_t adpcm_decode_block(const uint8_t *in, size_t len, int16_t *pcm,
+                          size_t max_samples);
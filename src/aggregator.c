@@ -0,0 +1,368 @@
+// ============================================================
+// aggregator.c
+//
+// Streaming aggregation engine. See aggregator.h.
+//
+// Per sample (agg_add):
+//   1. Close the current window if the sample is past its end.
+//   2. Update Welford mean/variance, min/max, P-square markers.
+//   3. Check anomaly triggers against the running baseline.
+//   4. Forward raw data if a trigger is active, else store the
+//      sample in the pre-trigger ring.
+//   5. Update the baseline.
+// All steps are O(1) and allocation-free.
+// ============================================================
+
+#include "aggregator.h"
+
+// math.h: sqrtf(), fabsf() for deviation checks.
+#include <math.h>
+
+// stdio.h: snprintf() for JSON formatting.
+#include <stdio.h>
+
+// string.h: memset().
+#include <string.h>
+
+// build_profile.h: HOT_FN (IRAM in the release profile).
+#include "build_profile.h"
+
+// Baseline smoothing: EWMA weight 1/64 (~64-sample memory).
+#define BASE_ALPHA (1.0f / 64.0f)
+
+// Samples needed before the sigma trigger is trusted.
+#define BASE_WARMUP 32
+
+// ============================================================
+// P-square estimator
+//
+// Five markers track min, p/2, p, (1+p)/2 and max. Their
+// heights are adjusted with a piecewise-parabolic formula as
+// samples arrive, so the middle marker converges on the p-th
+// percentile without storing samples.
+// ============================================================
+static void p2_init(agg_p2_t *e, float p) {
+    memset(e, 0, sizeof(*e));
+    e->p = p;
+}
+
+static float p2_parabolic(const agg_p2_t *e, int i, int d) {
+    float nd = (float)d;
+    float n_im1 = (float)e->n[i - 1], n_i = (float)e->n[i], n_ip1 = (float)e->n[i + 1];
+    return e->q[i] + nd / (n_ip1 - n_im1) *
+                         ((n_i - n_im1 + nd) * (e->q[i + 1] - e->q[i]) / (n_ip1 - n_i) +
+                          (n_ip1 - n_i - nd) * (e->q[i] - e->q[i - 1]) / (n_i - n_im1));
+}
+
+static float p2_linear(const agg_p2_t *e, int i, int d) {
+    return e->q[i] + (float)d * (e->q[i + d] - e->q[i]) / (float)(e->n[i + d] - e->n[i]);
+}
+
+static void HOT_FN p2_add(agg_p2_t *e, float x) {
+    // --- Warm-up: collect the first five samples, then sort ---
+    if (e->count < 5) {
+        e->q[e->count++] = x;
+        if (e->count == 5) {
+            for (int i = 1; i < 5; i++) {
+                for (int j = i; j > 0 && e->q[j - 1] > e->q[j]; j--) {
+                    float t = e->q[j];
+                    e->q[j] = e->q[j - 1];
+                    e->q[j - 1] = t;
+                }
+            }
+            for (int i = 0; i < 5; i++) {
+                e->n[i] = i;
+            }
+            e->np[0] = 0.0f;
+            e->np[1] = 2.0f * e->p;
+            e->np[2] = 4.0f * e->p;
+            e->np[3] = 2.0f + 2.0f * e->p;
+            e->np[4] = 4.0f;
+        }
+        return;
+    }
+
+    // --- Find the cell k containing x, extending extremes ---
+    int k;
+    if (x < e->q[0]) {
+        e->q[0] = x;
+        k = 0;
+    } else if (x >= e->q[4]) {
+        e->q[4] = x;
+        k = 3;
+    } else {
+        k = 0;
+        while (k < 3 && x >= e->q[k + 1]) {
+            k++;
+        }
+    }
+    for (int i = k + 1; i < 5; i++) {
+        e->n[i]++;
+    }
+    const float dn[5] = {0.0f, e->p / 2.0f, e->p, (1.0f + e->p) / 2.0f, 1.0f};
+    for (int i = 0; i < 5; i++) {
+        e->np[i] += dn[i];
+    }
+
+    // --- Adjust the three middle markers ---
+    for (int i = 1; i <= 3; i++) {
+        float d = e->np[i] - (float)e->n[i];
+        if ((d >= 1.0f && e->n[i + 1] - e->n[i] > 1) ||
+            (d <= -1.0f && e->n[i - 1] - e->n[i] < -1)) {
+            int ds = d > 0 ? 1 : -1;
+            float qp = p2_parabolic(e, i, ds);
+            if (e->q[i - 1] < qp && qp < e->q[i + 1]) {
+                e->q[i] = qp;
+            } else {
+                e->q[i] = p2_linear(e, i, ds);
+            }
+            e->n[i] += ds;
+        }
+    }
+    e->count++;
+}
+
+static float p2_result(const agg_p2_t *e) {
+    if (e->count >= 5) {
+        return e->q[2];
+    }
+    if (e->count == 0) {
+        return 0.0f;
+    }
+    // Fewer than five samples: exact percentile of what we have.
+    float tmp[5];
+    memcpy(tmp, e->q, sizeof(tmp));
+    for (uint32_t i = 1; i < e->count; i++) {
+        for (uint32_t j = i; j > 0 && tmp[j - 1] > tmp[j]; j--) {
+            float t = tmp[j];
+            tmp[j] = tmp[j - 1];
+            tmp[j - 1] = t;
+        }
+    }
+    uint32_t idx = (uint32_t)(e->p * (float)(e->count - 1) + 0.5f);
+    return tmp[idx];
+}
+
+// ============================================================
+// window_reset()
+//
+// Starts an empty window at start_ms.
+// ============================================================
+static void window_reset(agg_channel_t *c, uint32_t start_ms) {
+    c->window_open = true;
+    c->window_start_ms = start_ms;
+    c->count = 0;
+    c->min = INFINITY;
+    c->max = -INFINITY;
+    c->mean = 0.0f;
+    c->m2 = 0.0f;
+    c->anomaly = false;
+    for (int i = 0; i < c->cfg.n_pct; i++) {
+        p2_init(&c->p2[i], c->cfg.pct[i]);
+    }
+}
+
+// ============================================================
+// window_close()
+//
+// Emits the summary for the current window (if it holds any
+// samples) and marks the channel as having no open window.
+// ============================================================
+static void window_close(aggregator_t *a, uint8_t ch) {
+    agg_channel_t *c = &a->ch[ch];
+    if (!c->window_open) {
+        return;
+    }
+    c->window_open = false;
+    if (c->count == 0) {
+        return;
+    }
+
+    agg_summary_t s = {
+        .channel = ch,
+        .t_start_ms = c->window_start_ms,
+        .t_end_ms = c->window_start_ms + c->cfg.rollup_ms,
+        .count = c->count,
+        .min = c->min,
+        .max = c->max,
+        .mean = c->mean,
+        .stddev = c->count > 1 ? sqrtf(c->m2 / (float)(c->count - 1)) : 0.0f,
+        .n_pct = c->cfg.n_pct,
+        .anomaly = c->anomaly,
+    };
+    for (int i = 0; i < c->cfg.n_pct; i++) {
+        s.pct[i] = p2_result(&c->p2[i]);
+    }
+    a->stats.summaries_out++;
+    if (a->sink.on_summary != NULL) {
+        a->sink.on_summary(a->sink.user, &s);
+    }
+}
+
+// ============================================================
+// emit_raw()
+// ============================================================
+static void emit_raw(aggregator_t *a, const agg_sample_t *samples, size_t n) {
+    if (n == 0) {
+        return;
+    }
+    a->stats.raw_out += (uint32_t)n;
+    if (a->sink.on_raw != NULL) {
+        a->sink.on_raw(a->sink.user, samples, n);
+    }
+}
+
+// ============================================================
+// is_anomaly()
+//
+// Absolute bounds first, then deviation from the baseline.
+// ============================================================
+static bool is_anomaly(const agg_channel_t *c, float v) {
+    if (c->cfg.low <= c->cfg.high && (v < c->cfg.low || v > c->cfg.high)) {
+        return true;
+    }
+    if (c->cfg.sigma_k > 0.0f && c->base_samples >= BASE_WARMUP &&
+        c->base_var > 0.0f) {
+        float z = fabsf(v - c->base_mean) / sqrtf(c->base_var);
+        return z > c->cfg.sigma_k;
+    }
+    return false;
+}
+
+// ============================================================
+// Public API
+// ============================================================
+void agg_init(aggregator_t *a, const agg_sink_t *sink) {
+    memset(a, 0, sizeof(*a));
+    a->sink = *sink;
+}
+
+bool agg_channel_setup(aggregator_t *a, uint8_t ch,
+                       const agg_channel_config_t *cfg) {
+    if (ch >= AGG_MAX_CHANNELS || cfg->rollup_ms == 0 ||
+        cfg->n_pct > AGG_MAX_PERCENTILES) {
+        return false;
+    }
+    for (int i = 0; i < cfg->n_pct; i++) {
+        if (cfg->pct[i] <= 0.0f || cfg->pct[i] >= 1.0f) {
+            return false;
+        }
+    }
+    agg_channel_t *c = &a->ch[ch];
+    memset(c, 0, sizeof(*c));
+    c->cfg = *cfg;
+    c->active = true;
+    return true;
+}
+
+void HOT_FN agg_add(aggregator_t *a, uint8_t ch, uint32_t t_ms, float value) {
+    if (ch >= AGG_MAX_CHANNELS || !a->ch[ch].active) {
+        return;
+    }
+    agg_channel_t *c = &a->ch[ch];
+    a->stats.samples_in++;
+
+    // --- Step 1: window boundaries aligned to rollup_ms ---
+    if (c->window_open && t_ms - c->window_start_ms >= c->cfg.rollup_ms) {
+        window_close(a, ch);
+    }
+    if (!c->window_open) {
+        window_reset(c, t_ms - (t_ms % c->cfg.rollup_ms));
+    }
+
+    // --- Step 2: window statistics ---
+    c->count++;
+    float delta = value - c->mean;
+    c->mean += delta / (float)c->count;
+    c->m2 += delta * (value - c->mean);
+    if (value < c->min) {
+        c->min = value;
+    }
+    if (value > c->max) {
+        c->max = value;
+    }
+    for (int i = 0; i < c->cfg.n_pct; i++) {
+        p2_add(&c->p2[i], value);
+    }
+
+    // --- Steps 3-4: triggers and raw forwarding ---
+    agg_sample_t sample = {.channel = ch, .t_ms = t_ms, .value = value};
+    if (is_anomaly(c, value)) {
+        a->stats.triggers++;
+        c->anomaly = true;
+        if (c->post_left == 0) {
+            // New event: flush pre-trigger context oldest first.
+            agg_sample_t ctx[AGG_RAW_PRETRIGGER];
+            size_t n = 0;
+            uint8_t start = (uint8_t)((c->ring_head + AGG_RAW_PRETRIGGER -
+                                       c->ring_count) % AGG_RAW_PRETRIGGER);
+            for (uint8_t i = 0; i < c->ring_count; i++) {
+                ctx[n++] = c->ring[(start + i) % AGG_RAW_PRETRIGGER];
+            }
+            c->ring_count = 0;
+            emit_raw(a, ctx, n);
+        }
+        emit_raw(a, &sample, 1);
+        c->post_left = c->cfg.post_trigger;
+    } else if (c->post_left > 0) {
+        c->post_left--;
+        emit_raw(a, &sample, 1);
+    } else {
+        c->ring[c->ring_head] = sample;
+        c->ring_head = (uint8_t)((c->ring_head + 1) % AGG_RAW_PRETRIGGER);
+        if (c->ring_count < AGG_RAW_PRETRIGGER) {
+            c->ring_count++;
+        }
+    }
+
+    // --- Step 5: baseline (EWMA mean / variance) ---
+    if (c->base_samples == 0) {
+        c->base_mean = value;
+        c->base_var = 0.0f;
+    } else {
+        float d = value - c->base_mean;
+        c->base_mean += BASE_ALPHA * d;
+        c->base_var = (1.0f - BASE_ALPHA) * (c->base_var + BASE_ALPHA * d * d);
+    }
+    c->base_samples++;
+}
+
+void agg_tick(aggregator_t *a, uint32_t now_ms) {
+    for (uint8_t ch = 0; ch < AGG_MAX_CHANNELS; ch++) {
+        agg_channel_t *c = &a->ch[ch];
+        if (c->active && c->window_open &&
+            now_ms - c->window_start_ms >= c->cfg.rollup_ms) {
+            window_close(a, ch);
+        }
+    }
+}
+
+void agg_flush(aggregator_t *a) {
+    for (uint8_t ch = 0; ch < AGG_MAX_CHANNELS; ch++) {
+        if (a->ch[ch].active) {
+            window_close(a, ch);
+        }
+    }
+}
+
+size_t agg_format_summary(const aggregator_t *a, const agg_summary_t *s,
+                          char *buf, size_t len) {
+    const agg_channel_config_t *cfg = &a->ch[s->channel].cfg;
+    int n = snprintf(buf, len,
+                     "{\"ch\":\"%s\",\"t\":%lu,\"n\":%lu,\"min\":%.2f,"
+                     "\"max\":%.2f,\"avg\":%.2f,\"sd\":%.2f",
+                     cfg->name ? cfg->name : "?", (unsigned long)s->t_start_ms,
+                     (unsigned long)s->count, (double)s->min, (double)s->max,
+                     (double)s->mean, (double)s->stddev);
+    for (int i = 0; i < s->n_pct && n > 0 && (size_t)n < len; i++) {
+        n += snprintf(buf + n, len - (size_t)n, ",\"p%d\":%.2f",
+                      (int)(cfg->pct[i] * 100.0f + 0.5f), (double)s->pct[i]);
+    }
+    if (n > 0 && (size_t)n < len) {
+        n += snprintf(buf + n, len - (size_t)n, "%s}", s->anomaly ? ",\"anom\":1" : "");
+    }
+    if (n < 0) {
+        return 0;
+    }
+    return (size_t)n < len ? (size_t)n : len - 1;
+}
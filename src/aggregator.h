@@ -0,0 +1,153 @@
+#pragma once
+
+// ============================================================
+// aggregator.h
+//
+// Streaming time-series aggregation before uplink.
+//
+// Instead of sending every raw sample, each channel keeps one
+// rolling window per rollup interval and emits a single summary
+// when the window closes:
+//   count, min, max, mean, standard deviation, and up to
+//   AGG_MAX_PERCENTILES percentiles.
+//
+// Fixed memory:
+//   - min/max/mean/variance use Welford's running update.
+//   - Percentiles use the P-square estimator (Jain & Chlamtac,
+//     1985): 5 markers per percentile, no sample storage.
+//   - A small pre-trigger ring holds the last AGG_RAW_PRETRIGGER
+//     raw samples per channel.
+//
+// Anomaly triggers:
+//   A sample outside [low, high], or more than sigma_k standard
+//   deviations from the channel's running baseline, forwards the
+//   pre-trigger ring plus the next post_trigger samples raw, so
+//   the interesting part of the signal is not averaged away.
+//   The window's summary is flagged as anomalous.
+// ============================================================
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "app_config.h"
+
+// --- Emitted records ----------------------------------------
+typedef struct {
+    uint8_t channel;
+    uint32_t t_start_ms;   // Window start (aligned to rollup_ms).
+    uint32_t t_end_ms;     // Window end (exclusive).
+    uint32_t count;
+    float min;
+    float max;
+    float mean;
+    float stddev;
+    uint8_t n_pct;
+    float pct[AGG_MAX_PERCENTILES];  // Estimates for cfg.pct[i].
+    bool anomaly;          // A trigger fired inside this window.
+} agg_summary_t;
+
+typedef struct {
+    uint8_t channel;
+    uint32_t t_ms;
+    float value;
+} agg_sample_t;
+
+// --- Output sink --------------------------------------------
+// on_summary: one call per closed window with count > 0.
+// on_raw:     a batch of raw samples around an anomaly (the
+//             pre-trigger ring first, then post-trigger samples
+//             one at a time).
+typedef struct {
+    void (*on_summary)(void *user, const agg_summary_t *s);
+    void (*on_raw)(void *user, const agg_sample_t *samples, size_t n);
+    void *user;
+} agg_sink_t;
+
+// --- Channel configuration ----------------------------------
+typedef struct {
+    const char *name;
+    uint32_t rollup_ms;     // Window length.
+    uint8_t n_pct;          // Number of percentiles (<= AGG_MAX_PERCENTILES).
+    float pct[AGG_MAX_PERCENTILES];  // e.g. 0.5f, 0.95f.
+    float low;              // Absolute trigger bounds; set low > high
+    float high;             // to disable.
+    float sigma_k;          // Deviation trigger; 0 = disabled.
+    uint16_t post_trigger;  // Raw samples forwarded after a trigger.
+} agg_channel_config_t;
+
+// --- P-square percentile estimator --------------------------
+typedef struct {
+    float p;
+    uint32_t count;
+    float q[5];   // Marker heights.
+    int32_t n[5]; // Actual marker positions.
+    float np[5];  // Desired marker positions.
+} agg_p2_t;
+
+// --- Per-channel state --------------------------------------
+typedef struct {
+    agg_channel_config_t cfg;
+    bool active;
+
+    // Current window.
+    bool window_open;
+    uint32_t window_start_ms;
+    uint32_t count;
+    float min;
+    float max;
+    float mean;
+    float m2;               // Welford sum of squared deviations.
+    agg_p2_t p2[AGG_MAX_PERCENTILES];
+    bool anomaly;
+
+    // Long-running baseline for the sigma trigger (EWMA).
+    float base_mean;
+    float base_var;
+    uint32_t base_samples;
+
+    // Raw sample ring for pre-trigger context.
+    agg_sample_t ring[AGG_RAW_PRETRIGGER];
+    uint8_t ring_head;
+    uint8_t ring_count;
+    uint16_t post_left;
+} agg_channel_t;
+
+// --- Counters -----------------------------------------------
+typedef struct {
+    uint32_t samples_in;
+    uint32_t summaries_out;
+    uint32_t raw_out;
+    uint32_t triggers;
+} agg_stats_t;
+
+typedef struct {
+    agg_channel_t ch[AGG_MAX_CHANNELS];
+    agg_sink_t sink;
+    agg_stats_t stats;
+} aggregator_t;
+
+// --- Public functions ---------------------------------------
+
+void agg_init(aggregator_t *a, const agg_sink_t *sink);
+
+// Configures channel index ch (0 .. AGG_MAX_CHANNELS-1).
+// Returns false on a bad index or configuration.
+bool agg_channel_setup(aggregator_t *a, uint8_t ch,
+                       const agg_channel_config_t *cfg);
+
+// Adds one sample. Closes (and emits) the current window first if
+// t_ms falls past its end. Timestamps must be non-decreasing.
+void agg_add(aggregator_t *a, uint8_t ch, uint32_t t_ms, float value);
+
+// Closes windows whose end has passed even if no new sample arrived.
+// Call periodically from the uplink task.
+void agg_tick(aggregator_t *a, uint32_t now_ms);
+
+// Closes every open window now (e.g. before deep sleep).
+void agg_flush(aggregator_t *a);
+
+// Formats a summary as compact JSON. Returns the length written
+// (excluding the terminator), truncated to len - 1.
+size_t agg_format_summary(const aggregator_t *a, const agg_summary_t *s,
+                          char *buf, size_t len);
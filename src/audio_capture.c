@@ -0,0 +1,270 @@
+// ============================================================
+// audio_capture.c
+//
+// I2S RX with zero-copy DMA frame handoff.
+// See audio_capture.h for the ownership rules.
+//
+// The application never calls i2s_channel_read() (which would
+// copy every frame out of the DMA buffers). Instead the
+// on_recv ISR callback publishes the just-filled DMA buffer
+// itself to the consumer queues.
+// ============================================================
+
+#include "audio_capture.h"
+
+#if FEATURE_AUDIO
+
+// stdio.h: printf() for console logging to UART0.
+#include <stdio.h>
+
+// string.h: memset() for stats.
+#include <string.h>
+
+// FreeRTOS: consumer queues and the pool spinlock.
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+// ESP-IDF I2S standard-mode driver.
+#include "driver/i2s_std.h"
+
+// esp_attr.h: IRAM_ATTR for the DMA callback.
+#include "esp_attr.h"
+
+// esp_timer.h: capture timestamps and latency.
+#include "esp_timer.h"
+
+static const char *TAG = "audio";
+
+#define AUDIO_MAX_CONSUMERS 3
+
+// Marks a slot whose buffer DMA is currently overwriting.
+#define SEQ_WRITING 0xFFFFFFFFu
+
+_Static_assert(AUDIO_DMA_BUF_LEN * sizeof(int32_t) == AUDIO_FRAME_BYTES,
+               "AUDIO_FRAME_BYTES must equal one DMA buffer of 32-bit mono samples");
+_Static_assert(AUDIO_DMA_BUF_COUNT >= 3,
+               "AUDIO_DMA_BUF_COUNT < 3 leaves consumers no time to release");
+
+// --- Pool slot: one per DMA buffer --------------------------
+typedef struct {
+    const int32_t *buf;   // DMA buffer address (learned on first lap).
+    uint32_t seq;         // Frame currently in the buffer.
+    uint8_t refs;         // Consumers still holding it.
+} audio_slot_t;
+
+typedef struct {
+    QueueHandle_t q;
+    audio_consumer_stats_t stats;
+} audio_consumer_t;
+
+static i2s_chan_handle_t s_rx;
+static audio_slot_t s_slot[AUDIO_DMA_BUF_COUNT];
+static uint8_t s_slots_known;
+static audio_consumer_t s_consumer[AUDIO_MAX_CONSUMERS];
+static uint8_t s_consumers;
+static uint32_t s_seq;
+static int64_t s_last_isr_us;
+static bool s_running;
+static audio_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// ============================================================
+// find_slot()
+//
+// Maps a DMA buffer address to its pool slot. The driver's
+// buffers never move, so the first lap fills the table in ring
+// order. Runs in the ISR.
+// ============================================================
+static int IRAM_ATTR find_slot(const void *dma_buf) {
+    for (int i = 0; i < s_slots_known; i++) {
+        if (s_slot[i].buf == dma_buf) {
+            return i;
+        }
+    }
+    if (s_slots_known < AUDIO_DMA_BUF_COUNT) {
+        s_slot[s_slots_known].buf = dma_buf;
+        return s_slots_known++;
+    }
+    return -1;
+}
+
+// ============================================================
+// on_recv()
+//
+// I2S RX DMA callback: one buffer has just been filled.
+//
+// Steps:
+//   1. Detect gaps between callbacks (stalled DMA / ISR latency).
+//   2. A buffer that is still referenced was overwritten while a
+//      consumer held it: count an overrun.
+//   3. Stamp the slot with a new sequence number and queue a
+//      descriptor to every consumer (a full queue is a drop).
+//   4. DMA now writes the next buffer in the ring, so stale
+//      descriptors for it stop being intact.
+// ============================================================
+static bool IRAM_ATTR on_recv(i2s_chan_handle_t handle, i2s_event_data_t *event,
+                              void *user_ctx) {
+    int64_t now = esp_timer_get_time();
+    BaseType_t woken = pdFALSE;
+
+    // --- Step 1: Gap detection ---
+    if (s_last_isr_us && now - s_last_isr_us > AUDIO_FRAME_US * 3 / 2) {
+        s_stats.gaps++;
+    }
+    s_last_isr_us = now;
+
+    portENTER_CRITICAL_ISR(&s_lock);
+    int i = find_slot(event->dma_buf);
+    if (i < 0) {
+        portEXIT_CRITICAL_ISR(&s_lock);
+        return false;
+    }
+    audio_slot_t *slot = &s_slot[i];
+
+    // --- Step 2: Overrun ---
+    if (slot->refs > 0) {
+        s_stats.overruns++;
+    }
+
+    // --- Step 3: Publish ---
+    audio_frame_t f = {
+        .samples = slot->buf,
+        .n_samples = AUDIO_FRAME_SAMPLES,
+        .seq = s_seq++,
+        .t_first_us = now - AUDIO_FRAME_US,
+        .slot = (uint8_t)i,
+    };
+    slot->seq = f.seq;
+    slot->refs = 0;
+    for (int c = 0; c < s_consumers; c++) {
+        if (xQueueSendFromISR(s_consumer[c].q, &f, &woken) == pdTRUE) {
+            slot->refs++;
+        } else {
+            s_consumer[c].stats.drops++;
+        }
+    }
+    s_stats.frames++;
+
+    // --- Step 4: Invalidate the buffer DMA is writing next ---
+    if (s_slots_known == AUDIO_DMA_BUF_COUNT) {
+        s_slot[(i + 1) % AUDIO_DMA_BUF_COUNT].seq = SEQ_WRITING;
+    }
+    portEXIT_CRITICAL_ISR(&s_lock);
+
+    return woken == pdTRUE;
+}
+
+// ============================================================
+// Public API
+// ============================================================
+esp_err_t audio_capture_init(void) {
+    i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_0, I2S_ROLE_MASTER);
+    chan_cfg.dma_desc_num = AUDIO_DMA_BUF_COUNT;
+    chan_cfg.dma_frame_num = AUDIO_DMA_BUF_LEN;
+    esp_err_t err = i2s_new_channel(&chan_cfg, NULL, &s_rx);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // 32-bit mono slot: I2S MEMS microphones send 18..24-bit
+    // samples left-justified in a 32-bit slot.
+    i2s_std_config_t std_cfg = {
+        .clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(AUDIO_SAMPLE_RATE_HZ),
+        .slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_32BIT,
+                                                        I2S_SLOT_MODE_MONO),
+        .gpio_cfg = {
+            .mclk = I2S_GPIO_UNUSED,
+            .bclk = PIN_I2S_BCLK,
+            .ws = PIN_I2S_WS,
+            .dout = I2S_GPIO_UNUSED,
+            .din = PIN_I2S_DIN,
+        },
+    };
+    std_cfg.slot_cfg.slot_mask = I2S_STD_SLOT_LEFT;
+    err = i2s_channel_init_std_mode(s_rx, &std_cfg);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    i2s_event_callbacks_t cbs = {
+        .on_recv = on_recv,
+    };
+    err = i2s_channel_register_event_callback(s_rx, &cbs, NULL);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    printf("[%s] I2S RX %d Hz, %d x %d-byte DMA frames (%lld us each)\n", TAG,
+           AUDIO_SAMPLE_RATE_HZ, AUDIO_DMA_BUF_COUNT, AUDIO_FRAME_BYTES,
+           (long long)AUDIO_FRAME_US);
+    return ESP_OK;
+}
+
+int audio_subscribe(const char *name, uint8_t depth) {
+    if (s_running || s_consumers >= AUDIO_MAX_CONSUMERS || depth == 0) {
+        return -1;
+    }
+    audio_consumer_t *c = &s_consumer[s_consumers];
+    c->q = xQueueCreate(depth, sizeof(audio_frame_t));
+    if (!c->q) {
+        return -1;
+    }
+    memset(&c->stats, 0, sizeof(c->stats));
+    c->stats.name = name;
+    return s_consumers++;
+}
+
+esp_err_t audio_capture_start(void) {
+    s_last_isr_us = 0;
+    s_running = true;
+    return i2s_channel_enable(s_rx);
+}
+
+esp_err_t audio_capture_stop(void) {
+    esp_err_t err = i2s_channel_disable(s_rx);
+    s_running = false;
+    return err;
+}
+
+bool audio_frame_acquire(int consumer, audio_frame_t *f, uint32_t timeout_ms) {
+    audio_consumer_t *c = &s_consumer[consumer];
+    if (xQueueReceive(c->q, f, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+        if (s_running) {
+            c->stats.underruns++;
+        }
+        return false;
+    }
+    c->stats.received++;
+    return true;
+}
+
+void audio_frame_release(int consumer, const audio_frame_t *f) {
+    audio_consumer_stats_t *st = &s_consumer[consumer].stats;
+    uint32_t latency = (uint32_t)(esp_timer_get_time() - f->t_first_us);
+    st->total_latency_us += latency;
+    if (latency > st->max_latency_us) {
+        st->max_latency_us = latency;
+    }
+
+    // A stale descriptor (buffer already reused) holds no reference.
+    portENTER_CRITICAL(&s_lock);
+    audio_slot_t *slot = &s_slot[f->slot];
+    if (slot->seq == f->seq && slot->refs > 0) {
+        slot->refs--;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+bool audio_frame_intact(const audio_frame_t *f) {
+    return s_slot[f->slot].seq == f->seq;
+}
+
+const audio_stats_t *audio_capture_stats(void) {
+    return &s_stats;
+}
+
+const audio_consumer_stats_t *audio_consumer_stats(int consumer) {
+    return &s_consumer[consumer].stats;
+}
+
+#endif  // FEATURE_AUDIO
@@ -0,0 +1,101 @@
+#pragma once
+
+// ============================================================
+// audio_capture.h
+//
+// I2S microphone capture with zero-copy frame handoff
+// (FEATURE_AUDIO).
+//
+// Frames are the I2S driver's own DMA buffers:
+//   AUDIO_DMA_BUF_COUNT buffers of AUDIO_DMA_BUF_LEN samples
+//   (32-bit mono slots, AUDIO_FRAME_BYTES each). When DMA
+//   finishes one, the ISR hands a small descriptor (pointer,
+//   sequence number, timestamp) to every subscribed consumer's
+//   queue. Nothing is copied: consumers read the samples in
+//   place and release the frame when done.
+//
+// Ownership:
+//   Each delivered frame carries a reference per consumer it
+//   was queued to. audio_frame_release() drops one reference;
+//   at zero the buffer is back in the pool. DMA does not wait
+//   for the pool: a consumer has (AUDIO_DMA_BUF_COUNT - 1)
+//   frame periods to release before the hardware writes the
+//   buffer again. If it is still referenced then, the frame is
+//   counted as an overrun and audio_frame_intact() turns false
+//   for the stale descriptor.
+//
+// Counters:
+//   overruns  — DMA reused a buffer that was still referenced.
+//   drops     — a consumer queue was full, frame not delivered.
+//   underruns — a consumer waited a full timeout for a frame
+//               (capture stalled or starved).
+//   gaps      — DMA callbacks more than 1.5 frame periods apart.
+//   latency   — first-sample time to release, per consumer.
+// ============================================================
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "app_config.h"
+
+// Samples per frame (one DMA buffer, 32-bit mono slots).
+#define AUDIO_FRAME_SAMPLES (AUDIO_FRAME_BYTES / sizeof(int32_t))
+
+// Duration of one frame in microseconds.
+#define AUDIO_FRAME_US ((int64_t)AUDIO_FRAME_SAMPLES * 1000000 / AUDIO_SAMPLE_RATE_HZ)
+
+// --- Frame descriptor ---------------------------------------
+// Points into a DMA buffer. Valid until released (and only while
+// audio_frame_intact() is true).
+typedef struct {
+    const int32_t *samples;   // Left-justified 32-bit samples.
+    size_t n_samples;
+    uint32_t seq;             // Capture sequence number.
+    int64_t t_first_us;       // Time of the first sample.
+    uint8_t slot;             // Pool index (internal).
+} audio_frame_t;
+
+// --- Counters -----------------------------------------------
+typedef struct {
+    uint32_t frames;
+    uint32_t overruns;
+    uint32_t gaps;
+} audio_stats_t;
+
+typedef struct {
+    const char *name;
+    uint32_t received;
+    uint32_t drops;
+    uint32_t underruns;
+    uint32_t max_latency_us;
+    uint64_t total_latency_us;
+} audio_consumer_stats_t;
+
+// --- Public functions ---------------------------------------
+
+// Creates the I2S RX channel on PIN_I2S_BCLK / WS / DIN at
+// AUDIO_SAMPLE_RATE_HZ. Capture does not run yet.
+esp_err_t audio_capture_init(void);
+
+// Registers a consumer with a queue of depth frame descriptors
+// (at most AUDIO_DMA_BUF_COUNT - 1 is useful). Must be called
+// before audio_capture_start(). Returns the consumer id or -1.
+int audio_subscribe(const char *name, uint8_t depth);
+
+esp_err_t audio_capture_start(void);
+esp_err_t audio_capture_stop(void);
+
+// Waits up to timeout_ms for the next frame for this consumer.
+bool audio_frame_acquire(int consumer, audio_frame_t *f, uint32_t timeout_ms);
+
+// Returns the frame's buffer reference and records latency.
+void audio_frame_release(int consumer, const audio_frame_t *f);
+
+// False if DMA has already reused the frame's buffer.
+bool audio_frame_intact(const audio_frame_t *f);
+
+const audio_stats_t *audio_capture_stats(void);
+const audio_consumer_stats_t *audio_consumer_stats(int consumer);
@@ -0,0 +1,232 @@
+// ============================================================
+// audio_encoder.c
+//
+// Capture -> int16 -> low-pass/decimate -> IMA-ADPCM stage.
+// See audio_encoder.h.
+// ============================================================
+
+#include "audio_encoder.h"
+
+#if FEATURE_AUDIO
+
+// stdio.h: printf() for console logging to UART0.
+#include <stdio.h>
+
+// string.h: memset() for state reset.
+#include <string.h>
+
+// math.h: windowed-sinc filter design at init, SNR in the bench.
+#include <math.h>
+
+// FreeRTOS: the encoder task.
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// esp_timer.h: encode time per frame.
+#include "esp_timer.h"
+
+static const char *TAG = "audio_enc";
+
+// Anti-alias filter length (Q15 windowed sinc).
+#define ENC_FIR_TAPS 24
+
+_Static_assert(AUDIO_FRAME_SAMPLES % AUDIO_ENC_DECIMATE == 0,
+               "AUDIO_ENC_DECIMATE must divide the frame length");
+_Static_assert(ENC_FIR_TAPS <= DSP_FIR_MAX_TAPS, "ENC_FIR_TAPS too long");
+
+static audio_encoder_t s_enc;
+static audio_enc_stats_t s_stats;
+static audio_enc_sink_fn s_sink;
+static void *s_sink_user;
+static int s_consumer = -1;
+static volatile bool s_run;
+
+// ============================================================
+// design_lowpass()
+//
+// Hamming-windowed sinc with the cutoff at 90% of the new
+// Nyquist frequency, DC gain normalized to 1.0 in Q15.
+// Runs once at init.
+// ============================================================
+static void design_lowpass(int16_t *taps, int n, int decimate) {
+    const float pi = 3.14159265f;
+    float fc = 0.9f * 0.5f / (float)decimate;   // cycles/sample
+    float h[ENC_FIR_TAPS];
+    float sum = 0.0f;
+    for (int i = 0; i < n; i++) {
+        float m = (float)i - (float)(n - 1) / 2.0f;
+        float sinc = (m == 0.0f) ? 2.0f * fc : sinf(2.0f * pi * fc * m) / (pi * m);
+        float window = 0.54f - 0.46f * cosf(2.0f * pi * (float)i / (float)(n - 1));
+        h[i] = sinc * window;
+        sum += h[i];
+    }
+    for (int i = 0; i < n; i++) {
+        taps[i] = (int16_t)lrintf(h[i] / sum * 32767.0f);
+    }
+}
+
+// ============================================================
+// Frame encode
+// ============================================================
+void audio_encoder_init(audio_encoder_t *e) {
+    memset(e, 0, sizeof(*e));
+    int16_t taps[ENC_FIR_TAPS];
+    design_lowpass(taps, ENC_FIR_TAPS, AUDIO_ENC_DECIMATE);
+    dsp_fir_s16_init(&e->lowpass, taps, ENC_FIR_TAPS);
+}
+
+size_t audio_encode_frame(audio_encoder_t *e, const int16_t *pcm) {
+#if AUDIO_ENC_DECIMATE > 1
+    dsp_fir_s16(&e->lowpass, pcm, e->filtered, AUDIO_FRAME_SAMPLES);
+    for (size_t i = 0; i < AUDIO_ENC_SAMPLES; i++) {
+        e->decimated[i] = e->filtered[i * AUDIO_ENC_DECIMATE];
+    }
+#else
+    memcpy(e->decimated, pcm, sizeof(e->decimated));
+#endif
+    return adpcm_encode_block(&e->adpcm, e->decimated, AUDIO_ENC_SAMPLES, e->out);
+}
+
+// ============================================================
+// audio_encoder_task()
+//
+// Steps (per captured frame):
+//   1. Convert the DMA frame to int16 and release it at once,
+//      so the DMA pool is never held for the encode time.
+//   2. Encode, time it, and hand the block to the sink.
+// ============================================================
+static void audio_encoder_task(void *arg) {
+    audio_frame_t f;
+    while (s_run) {
+        if (!audio_frame_acquire(s_consumer, &f, 100)) {
+            continue;
+        }
+        int64_t start = esp_timer_get_time();
+
+        // --- Step 1: Convert + release ---
+        dsp_s32_to_s16(f.samples, s_enc.pcm, f.n_samples);
+        if (!audio_frame_intact(&f)) {
+            s_stats.torn++;
+        }
+        audio_frame_release(s_consumer, &f);
+
+        // --- Step 2: Encode + deliver ---
+        size_t len = audio_encode_frame(&s_enc, s_enc.pcm);
+        uint32_t us = (uint32_t)(esp_timer_get_time() - start);
+        s_stats.frames++;
+        s_stats.bytes_out += (uint32_t)len;
+        s_stats.total_encode_us += us;
+        if (us > s_stats.max_encode_us) {
+            s_stats.max_encode_us = us;
+        }
+        if (s_sink) {
+            s_sink(s_sink_user, s_enc.out, len, f.seq);
+        }
+    }
+    vTaskDelete(NULL);
+}
+
+// ============================================================
+// Public API
+// ============================================================
+esp_err_t audio_encoder_start(audio_enc_sink_fn sink, void *user) {
+    if (s_consumer < 0) {
+        s_consumer = audio_subscribe("encoder", AUDIO_DMA_BUF_COUNT - 1);
+        if (s_consumer < 0) {
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+    audio_encoder_init(&s_enc);
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_sink = sink;
+    s_sink_user = user;
+    s_run = true;
+
+    if (xTaskCreatePinnedToCore(audio_encoder_task, "audio_enc",
+                                AUDIO_ENC_TASK_STACK_BYTES, NULL,
+                                AUDIO_ENC_TASK_PRIO, NULL,
+                                AUDIO_ENC_CORE) != pdPASS) {
+        s_run = false;
+        return ESP_ERR_NO_MEM;
+    }
+    printf("[%s] IMA-ADPCM, %d Hz, %d bytes per %lld us frame (%lld bit/s), core %d\n",
+           TAG, AUDIO_SAMPLE_RATE_HZ / AUDIO_ENC_DECIMATE, (int)AUDIO_ENC_FRAME_BYTES,
+           (long long)AUDIO_FRAME_US,
+           (long long)(AUDIO_ENC_FRAME_BYTES * 8 * 1000000LL / AUDIO_FRAME_US),
+           AUDIO_ENC_CORE);
+    return ESP_OK;
+}
+
+void audio_encoder_stop(void) {
+    s_run = false;
+}
+
+int audio_encoder_consumer(void) {
+    return s_consumer;
+}
+
+const audio_enc_stats_t *audio_encoder_stats(void) {
+    return &s_stats;
+}
+
+// ============================================================
+// audio_encoder_bench()
+//
+// Steps:
+//   1. Encode BENCH_FRAMES frames of a 440 Hz + 1.7 kHz tone mix
+//      on the calling core and time each one.
+//   2. Decode every block and compare with the encoder input
+//      (decimated PCM) for the SNR.
+//   3. Print time per frame and the real-time factor
+//      (frame duration / encode time).
+// ============================================================
+#define BENCH_FRAMES 100
+
+void audio_encoder_bench(void) {
+    static audio_encoder_t enc;
+    static DSP_ALIGNED int16_t pcm[AUDIO_FRAME_SAMPLES];
+    static int16_t decoded[AUDIO_ENC_SAMPLES];
+    audio_encoder_init(&enc);
+
+    uint64_t total_us = 0;
+    uint32_t max_us = 0;
+    double sig = 0.0;
+    double err = 0.0;
+    uint32_t t = 0;
+
+    for (int frame = 0; frame < BENCH_FRAMES; frame++) {
+        for (size_t i = 0; i < AUDIO_FRAME_SAMPLES; i++, t++) {
+            float ph = 2.0f * 3.14159265f * (float)(t % AUDIO_SAMPLE_RATE_HZ) /
+                       (float)AUDIO_SAMPLE_RATE_HZ;
+            pcm[i] = (int16_t)(9000.0f * sinf(440.0f * ph) + 5000.0f * sinf(1700.0f * ph));
+        }
+
+        // --- Step 1: Encode ---
+        int64_t start = esp_timer_get_time();
+        size_t len = audio_encode_frame(&enc, pcm);
+        uint32_t us = (uint32_t)(esp_timer_get_time() - start);
+        total_us += us;
+        if (us > max_us) {
+            max_us = us;
+        }
+
+        // --- Step 2: Decode and compare ---
+        size_t n = adpcm_decode_block(enc.out, len, decoded, AUDIO_ENC_SAMPLES);
+        for (size_t i = 0; i < n; i++) {
+            double d = (double)decoded[i] - enc.decimated[i];
+            sig += (double)enc.decimated[i] * enc.decimated[i];
+            err += d * d;
+        }
+    }
+
+    // --- Step 3: Report ---
+    double avg_us = (double)total_us / BENCH_FRAMES;
+    printf("[%s] bench: %d frames, encode avg %.1f us, max %lu us per %lld us frame\n",
+           TAG, BENCH_FRAMES, avg_us, (unsigned long)max_us, (long long)AUDIO_FRAME_US);
+    printf("[%s] bench: real-time factor %.0fx, %d -> %d bytes/frame, SNR %.1f dB\n",
+           TAG, avg_us > 0 ? (double)AUDIO_FRAME_US / avg_us : 0.0,
+           (int)(AUDIO_FRAME_SAMPLES * sizeof(int16_t)), (int)AUDIO_ENC_FRAME_BYTES,
+           err > 0 ? 10.0 * log10(sig / err) : 99.0);
+}
+
+#endif  // FEATURE_AUDIO
@@ -0,0 +1,86 @@
+#pragma once
+
+// ============================================================
+// audio_encoder.h
+//
+// Streaming low-bitrate encoder stage for the capture pipeline
+// (FEATURE_AUDIO).
+//
+// Raw 16 kHz / 16-bit PCM is 256 kbit/s — more than twice what
+// a 115200-baud modem link carries. Per captured frame this
+// stage:
+//   1. converts the 32-bit I2S slots to int16 (dsp.h) and
+//      releases the DMA buffer right away,
+//   2. low-pass filters and decimates by AUDIO_ENC_DECIMATE,
+//   3. IMA-ADPCM encodes the result (4 bits per sample).
+// With the defaults that is 68 bytes per 16 ms frame
+// (34 kbit/s, 4 kHz audio bandwidth). Opus would roughly halve that
+// again but needs libopus, which is not part of this tree; the
+// sink interface does not depend on the codec.
+//
+// All state (filter history, codec state, scratch and output
+// buffers) is one static struct; nothing is allocated per frame.
+// The task is pinned to AUDIO_ENC_CORE so encoding does not
+// compete with the modem / network tasks on the other core.
+// ============================================================
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "app_config.h"
+#include "adpcm.h"
+#include "audio_capture.h"
+#include "dsp.h"
+
+#define AUDIO_ENC_SAMPLES (AUDIO_FRAME_SAMPLES / AUDIO_ENC_DECIMATE)
+#define AUDIO_ENC_FRAME_BYTES ADPCM_BLOCK_BYTES(AUDIO_ENC_SAMPLES)
+
+// Receives each encoded frame (e.g. queues it for modem TX).
+// data is only valid during the call.
+typedef void (*audio_enc_sink_fn)(void *user, const uint8_t *data, size_t len,
+                                  uint32_t seq);
+
+// --- Encoder state (fixed, pre-allocated) -------------------
+typedef struct {
+    dsp_fir_s16_t lowpass;                         // Anti-alias filter.
+    adpcm_state_t adpcm;
+    DSP_ALIGNED int16_t pcm[AUDIO_FRAME_SAMPLES];
+    DSP_ALIGNED int16_t filtered[AUDIO_FRAME_SAMPLES];
+    int16_t decimated[AUDIO_ENC_SAMPLES];
+    uint8_t out[AUDIO_ENC_FRAME_BYTES];
+} audio_encoder_t;
+
+// --- Counters -----------------------------------------------
+typedef struct {
+    uint32_t frames;
+    uint32_t bytes_out;
+    uint32_t torn;             // Frames whose DMA buffer was reused early.
+    uint32_t max_encode_us;
+    uint64_t total_encode_us;
+} audio_enc_stats_t;
+
+// --- Public functions ---------------------------------------
+
+// Resets filter and codec state.
+void audio_encoder_init(audio_encoder_t *e);
+
+// Encodes one frame of int16 samples (AUDIO_FRAME_SAMPLES) into
+// e->out. Returns the encoded length.
+size_t audio_encode_frame(audio_encoder_t *e, const int16_t *pcm);
+
+// Subscribes to the capture pipeline and starts the encoder task
+// on AUDIO_ENC_CORE. Call before audio_capture_start().
+esp_err_t audio_encoder_start(audio_enc_sink_fn sink, void *user);
+void audio_encoder_stop(void);
+
+// Capture consumer id of the encoder (for audio_consumer_stats()).
+int audio_encoder_consumer(void);
+
+const audio_enc_stats_t *audio_encoder_stats(void);
+
+// Encodes synthetic frames offline and prints encode time per
+// frame, real-time factor, bitrate and decoded SNR.
+void audio_encoder_bench(void);
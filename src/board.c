@@ -0,0 +1,191 @@
+// ============================================================
+// board.c
+//
+// Boot-time board identification and resolution.
+// See board.h.
+// ============================================================
+
+#include "board.h"
+
+// stdio.h: printf() for console logging to UART0.
+#include <stdio.h>
+
+// Feature toggles (pin checks), BOARD_AUTODETECT.
+#include "app_config.h"
+
+#if BOARD_AUTODETECT
+// eFuse: board id in user data, in-package PSRAM size.
+#include "esp_efuse.h"
+#include "esp_efuse_table.h"
+
+// esp_flash.h: physical flash size from the JEDEC id.
+#include "esp_flash.h"
+#endif
+
+static const char *TAG = "board";
+
+static board_info_t s_info;
+
+static const char *const s_source_names[] = {
+    [BOARD_SRC_FIXED] = "fixed profile",
+    [BOARD_SRC_EFUSE] = "eFuse id",
+    [BOARD_SRC_FINGERPRINT] = "PSRAM/flash fingerprint",
+    [BOARD_SRC_DEFAULT] = "default (not identified)",
+};
+
+static const board_desc_t *find_by_id(board_id_t id) {
+    for (int i = 0; i < board_table_count; i++) {
+        if (board_table[i]->id == id) {
+            return board_table[i];
+        }
+    }
+    return NULL;
+}
+
+#if BOARD_AUTODETECT
+// ============================================================
+// Detection sources
+// ============================================================
+
+// Board id burned into eFuse user data byte 0 (0 = not set).
+static board_id_t efuse_board_id(void) {
+    uint8_t id = 0;
+    if (esp_efuse_read_field_blob(ESP_EFUSE_USER_DATA, &id, 8) != ESP_OK) {
+        return BOARD_ID_UNKNOWN;
+    }
+    return (board_id_t)id;
+}
+
+// In-package PSRAM in MB (ESP32-S3 PSRAM_CAP: 0 none, 1 8 MB,
+// 2 2 MB). Read from eFuse so it works without CONFIG_SPIRAM.
+static uint8_t efuse_psram_mb(void) {
+    uint8_t cap = 0;
+    esp_efuse_read_field_blob(ESP_EFUSE_PSRAM_CAP, &cap,
+                              esp_efuse_get_field_size(ESP_EFUSE_PSRAM_CAP));
+    return cap == 1 ? 8 : cap == 2 ? 2 : 0;
+}
+
+static uint8_t flash_mb(void) {
+    uint32_t bytes = 0;
+    if (esp_flash_get_physical_size(esp_flash_default_chip, &bytes) != ESP_OK) {
+        return 0;
+    }
+    return (uint8_t)(bytes >> 20);
+}
+
+// ============================================================
+// detect()
+//
+// Steps:
+//   1. eFuse id, if programmed and in the table.
+//   2. Exact (PSRAM, flash) fingerprint match.
+//   3. PSRAM-only match, if exactly one board has that size
+//      (flash chip swapped for a bigger one).
+//   4. BOARD_AUTODETECT_DEFAULT.
+// ============================================================
+static const board_desc_t *detect(board_source_t *source) {
+    // --- Step 1: eFuse id ---
+    const board_desc_t *d = find_by_id(efuse_board_id());
+    if (d) {
+        *source = BOARD_SRC_EFUSE;
+        return d;
+    }
+
+    // --- Step 2: Exact fingerprint ---
+    uint8_t psram = efuse_psram_mb();
+    uint8_t flash = flash_mb();
+    printf("[%s] fingerprint: %u MB PSRAM, %u MB flash\n", TAG, psram, flash);
+    for (int i = 0; i < board_table_count; i++) {
+        if (board_table[i]->psram_mb == psram && board_table[i]->flash_mb == flash) {
+            *source = BOARD_SRC_FINGERPRINT;
+            return board_table[i];
+        }
+    }
+
+    // --- Step 3: PSRAM only, if unambiguous ---
+    const board_desc_t *only = NULL;
+    int matches = 0;
+    for (int i = 0; i < board_table_count; i++) {
+        if (board_table[i]->psram_mb == psram) {
+            only = board_table[i];
+            matches++;
+        }
+    }
+    if (matches == 1) {
+        *source = BOARD_SRC_FINGERPRINT;
+        return only;
+    }
+
+    // --- Step 4: Default ---
+    *source = BOARD_SRC_DEFAULT;
+    return find_by_id(BOARD_AUTODETECT_DEFAULT);
+}
+#endif  // BOARD_AUTODETECT
+
+// ============================================================
+// check_feature_pins()
+//
+// Runtime form of the pin checks in app_config.h (which only
+// run for fixed profiles). Returns the number of enabled
+// features this board cannot serve.
+// ============================================================
+static int check_feature_pins(const board_desc_t *d) {
+    int missing = 0;
+#if FEATURE_SD_LOGGING
+    if (d->sd_cs < 0) {
+        printf("[%s] FEATURE_SD_LOGGING: no SD chip select on %s\n", TAG, d->name);
+        missing++;
+    }
+#endif
+#if FEATURE_DISPLAY
+    if (d->lcd_cs < 0 || d->lcd_dc < 0) {
+        printf("[%s] FEATURE_DISPLAY: no LCD CS / DC on %s\n", TAG, d->name);
+        missing++;
+    }
+#endif
+#if FEATURE_I2C_BUS
+    if (d->i2c_sda < 0 || d->i2c_scl < 0) {
+        printf("[%s] FEATURE_I2C_BUS: no I2C pins on %s\n", TAG, d->name);
+        missing++;
+    }
+#endif
+#if FEATURE_AUDIO
+    if (d->i2s_bclk < 0 || d->i2s_ws < 0 || d->i2s_din < 0) {
+        printf("[%s] FEATURE_AUDIO: no I2S input pins on %s\n", TAG, d->name);
+        missing++;
+    }
+#endif
+    (void)d;
+    return missing;
+}
+
+// ============================================================
+// board_init()
+//
+// Steps:
+//   1. Pick the descriptor (fixed profile, or detect()).
+//   2. Check enabled features against its pins.
+// ============================================================
+esp_err_t board_init(void) {
+    // --- Step 1: Descriptor ---
+    board_source_t source = BOARD_SRC_FIXED;
+#if BOARD_AUTODETECT
+    const board_desc_t *d = detect(&source);
+#else
+    const board_desc_t *d = board_table[0];
+#endif
+
+    s_info = (board_info_t){.desc = d, .source = source};
+    printf("[%s] %s (%s), %u MB PSRAM\n", TAG, d->name, s_source_names[source],
+           d->psram_mb);
+
+    // --- Step 2: Feature pins ---
+    return check_feature_pins(d) ? ESP_ERR_NOT_SUPPORTED : ESP_OK;
+}
+
+const board_info_t *board_info(void) {
+    if (!s_info.desc) {
+        board_init();  // First use before app_main() called board_init().
+    }
+    return &s_info;
+}
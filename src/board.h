@@ -0,0 +1,95 @@
+#pragma once
+
+// ============================================================
+// board.h
+//
+// Board descriptors and boot-time board resolution.
+//
+// Every board profile (config/board_*.h) is also compiled into a
+// constant descriptor (board_table.c, flash / rodata). With
+// BOARD_AUTODETECT selected in board_profile.h one image carries
+// all of them and board_init() picks one at boot:
+//
+//   1. eFuse user data byte 0 = board_id_t, if programmed at
+//      manufacturing (espefuse.py burn_block_data BLOCK_USR_DATA).
+//   2. Fingerprint: in-package PSRAM size (eFuse PSRAM_CAP) and
+//      the flash chip's physical size (JEDEC id) against the
+//      descriptors' MAX_PSRAM_MB / BOARD_FLASH_MB.
+//   3. BOARD_AUTODETECT_DEFAULT, with a warning.
+//
+// With a fixed profile the table has that one board and
+// detection is skipped.
+//
+// Hot paths never read the descriptor. Facts they depend on
+// (UART_MODEM_NUM, MODEM_BAUD, bus clocks) are identical on
+// every board and stay compile-time constants; PIN_* are only
+// read by init code. Buffer sizes are planned from the heap by
+// mem_plan.c. board_info() is resolved once and is read-only
+// afterwards.
+// ============================================================
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+// Stable ids: also the value programmed into eFuse.
+typedef enum {
+    BOARD_ID_UNKNOWN = 0,
+    BOARD_ID_XIAO_ESP32S3 = 1,
+    BOARD_ID_FEATHER_ESP32S3 = 2,
+    BOARD_ID_METRO_ESP32S3 = 3,
+} board_id_t;
+
+typedef enum {
+    BOARD_SRC_FIXED,          // Compile-time profile.
+    BOARD_SRC_EFUSE,
+    BOARD_SRC_FINGERPRINT,
+    BOARD_SRC_DEFAULT,        // Nothing matched.
+} board_source_t;
+
+// --- Descriptor (one per board profile) ---------------------
+typedef struct {
+    board_id_t id;
+    const char *name;
+
+    // Capabilities + detection fingerprint.
+    uint8_t psram_mb;
+    uint8_t flash_mb;
+    bool has_psram;
+    bool has_camera;
+    bool has_native_usb;
+    bool has_battery_charger;
+    bool has_rgb_led;
+    bool has_sd;
+
+    // Pins (INVALID_PIN = not mapped).
+    int8_t led_status, btn_boot, btn_user;
+    int8_t i2c_sda, i2c_scl;
+    int8_t spi_sck, spi_miso, spi_mosi;
+    int8_t sd_cs;
+    int8_t lcd_cs, lcd_dc, lcd_rst;
+    int8_t modem_tx, modem_rx, modem_rts, modem_cts;
+    int8_t i2s_bclk, i2s_ws, i2s_dout, i2s_din;
+} board_desc_t;
+
+// --- Resolved board (filled once by board_init()) -----------
+typedef struct {
+    const board_desc_t *desc;
+    board_source_t source;
+} board_info_t;
+
+// Descriptor table (board_table.c).
+extern const board_desc_t *const board_table[];
+extern const int board_table_count;
+
+// --- Public functions ---------------------------------------
+
+// Identifies the board, resolves board_info() and checks the
+// enabled FEATURE_* against its pins. ESP_ERR_NOT_SUPPORTED if a
+// feature lacks pins on this board (its own init will then fail;
+// the rest runs). Call first in app_main(), before any driver.
+esp_err_t board_init(void);
+
+// The resolved board. Valid after board_init(); read-only.
+const board_info_t *board_info(void);
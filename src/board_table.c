@@ -0,0 +1,92 @@
+// ============================================================
+// board_table.c
+//
+// Board descriptors built from the config/board_*.h profiles.
+// See board.h.
+//
+// The profiles stay plain macro files. Under BOARD_AUTODETECT
+// each one is included in turn and captured into a descriptor;
+// board_undef.h clears the macros between them. Nothing else in
+// this file may use board macros.
+// ============================================================
+
+#include "board.h"
+
+// Selects the fixed profile or BOARD_AUTODETECT.
+#include "board_profile.h"
+
+#define BOARD_DESC_FROM_PROFILE()                                           \
+    {                                                                       \
+        .id = BOARD_ID,                                                     \
+        .name = BOARD_NAME,                                                 \
+        .psram_mb = MAX_PSRAM_MB,                                           \
+        .flash_mb = BOARD_FLASH_MB,                                         \
+        .has_psram = HAS_PSRAM,                                             \
+        .has_camera = HAS_CAMERA,                                           \
+        .has_native_usb = HAS_NATIVE_USB,                                   \
+        .has_battery_charger = HAS_BATTERY_CHARGER,                         \
+        .has_rgb_led = HAS_RGB_LED,                                         \
+        .has_sd = HAS_SD,                                                   \
+        .led_status = PIN_LED_STATUS,                                       \
+        .btn_boot = PIN_BTN_BOOT,                                           \
+        .btn_user = PIN_BTN_USER,                                           \
+        .i2c_sda = PIN_I2C_SDA,                                             \
+        .i2c_scl = PIN_I2C_SCL,                                             \
+        .spi_sck = PIN_SPI_SCK,                                             \
+        .spi_miso = PIN_SPI_MISO,                                           \
+        .spi_mosi = PIN_SPI_MOSI,                                           \
+        .sd_cs = PIN_SD_CS,                                                 \
+        .lcd_cs = PIN_LCD_CS,                                               \
+        .lcd_dc = PIN_LCD_DC,                                               \
+        .lcd_rst = PIN_LCD_RST,                                             \
+        .modem_tx = PIN_MODEM_TX,                                           \
+        .modem_rx = PIN_MODEM_RX,                                           \
+        .modem_rts = PIN_MODEM_RTS,                                         \
+        .modem_cts = PIN_MODEM_CTS,                                         \
+        .i2s_bclk = PIN_I2S_BCLK,                                           \
+        .i2s_ws = PIN_I2S_WS,                                               \
+        .i2s_dout = PIN_I2S_DOUT,                                           \
+        .i2s_din = PIN_I2S_DIN,                                             \
+    }
+
+#if BOARD_AUTODETECT
+
+// Facts the hot paths use as constants must agree across boards.
+#define BOARD_CHECK_COMMON(board)                                           \
+    _Static_assert(UART_MODEM_NUM == BOARD_COMMON_UART_MODEM_NUM &&         \
+                   MODEM_BAUD == BOARD_COMMON_MODEM_BAUD &&                 \
+                   MODEM_USE_HWFC == BOARD_COMMON_MODEM_USE_HWFC &&         \
+                   I2C_FREQ_HZ == BOARD_COMMON_I2C_FREQ_HZ &&               \
+                   SPI_FREQ_HZ == BOARD_COMMON_SPI_FREQ_HZ,                 \
+                   board " differs from the BOARD_COMMON_* constants");     \
+    _Static_assert(MAX_PSRAM_MB >= BOARD_FLOOR_PSRAM_MB,                     \
+                   board " has less PSRAM than BOARD_FLOOR_PSRAM_MB")
+
+#include "board_undef.h"
+#include "board_xiao_esp32s3.h"
+BOARD_CHECK_COMMON("XIAO ESP32S3");
+static const board_desc_t s_xiao = BOARD_DESC_FROM_PROFILE();
+
+#include "board_undef.h"
+#include "board_feather_esp32s3.h"
+BOARD_CHECK_COMMON("Feather ESP32-S3");
+static const board_desc_t s_feather = BOARD_DESC_FROM_PROFILE();
+
+#include "board_undef.h"
+#include "board_metro_esp32s3.h"
+BOARD_CHECK_COMMON("Metro ESP32-S3");
+static const board_desc_t s_metro = BOARD_DESC_FROM_PROFILE();
+
+#include "board_undef.h"
+
+const board_desc_t *const board_table[] = {&s_xiao, &s_feather, &s_metro};
+
+#else
+
+static const board_desc_t s_fixed = BOARD_DESC_FROM_PROFILE();
+
+const board_desc_t *const board_table[] = {&s_fixed};
+
+#endif  // BOARD_AUTODETECT
+
+const int board_table_count = sizeof(board_table) / sizeof(board_table[0]);
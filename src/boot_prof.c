@@ -0,0 +1,137 @@
+// ============================================================
+// boot_prof.c
+//
+// Boot timeline marks and spans. See boot_prof.h.
+// ============================================================
+
+#include "boot_prof.h"
+
+// stdio.h: printf() for console logging to UART0.
+#include <stdio.h>
+
+// FreeRTOS: the spans / first AT stamp come from other tasks.
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// esp_timer.h: the timeline's clock.
+#include "esp_timer.h"
+
+// esp_system.h: esp_reset_reason(); power-on is when the RTC
+// timer starts from zero.
+#include "esp_system.h"
+
+// esp_rtc_time.h: RTC timer, for the time before esp_timer starts.
+#include "esp_rtc_time.h"
+
+static const char *TAG = "boot_prof";
+
+typedef struct {
+    const char *name;
+    int64_t end_us;
+} mark_t;
+
+typedef struct {
+    const char *name;
+    const char *where;
+    int64_t start_us;
+    int64_t end_us;
+    esp_err_t result;
+} span_t;
+
+static int64_t s_reset_us = -1;     // esp_timer zero since reset; -1 not known.
+static int64_t s_main_us;
+static int64_t s_first_at_us;
+static mark_t s_marks[BOOT_PROF_MAX_MARKS];
+static int s_mark_count;
+static span_t s_spans[BOOT_PROF_MAX_SPANS];
+static int s_span_count;
+static SemaphoreHandle_t s_lock;
+
+void boot_prof_start(void) {
+    s_main_us = esp_timer_get_time();
+    if (esp_reset_reason() == ESP_RST_POWERON) {
+        int64_t rtc_us = (int64_t)esp_rtc_get_time_us();
+        int64_t now_us = esp_timer_get_time();
+        s_reset_us = rtc_us > now_us ? rtc_us - now_us : 0;
+    }
+    s_lock = xSemaphoreCreateMutex();
+}
+
+void boot_prof_mark(const char *name) {
+    if (s_mark_count < BOOT_PROF_MAX_MARKS) {
+        s_marks[s_mark_count].name = name;
+        s_marks[s_mark_count].end_us = esp_timer_get_time();
+        s_mark_count++;
+    }
+}
+
+void boot_prof_span(const char *name, const char *where, int64_t start_us, int64_t end_us,
+                    esp_err_t result) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_span_count < BOOT_PROF_MAX_SPANS) {
+        s_spans[s_span_count++] = (span_t){name, where, start_us, end_us, result};
+    }
+    xSemaphoreGive(s_lock);
+}
+
+void boot_prof_first_at(void) {
+    if (s_first_at_us != 0 || s_lock == NULL) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_first_at_us == 0) {
+        s_first_at_us = now;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+// esp_timer stamp to ms on the printed timeline.
+static double ms(int64_t us) {
+    return (us + (s_reset_us > 0 ? s_reset_us : 0)) / 1000.0;
+}
+
+static void phase(const char *name, int64_t start_us, int64_t end_us) {
+    printf("[%s]   %8.1f .. %8.1f  %7.1f ms  %s\n", TAG, ms(start_us), ms(end_us),
+           (end_us - start_us) / 1000.0, name);
+}
+
+// ============================================================
+// boot_prof_print()
+//
+// Main timeline first (phases back to back), then the spans
+// that overlapped it, then the first AT command.
+// ============================================================
+void boot_prof_print(void) {
+    if (s_reset_us >= 0) {
+        printf("[%s] boot timeline (ms since reset, power-on):\n", TAG);
+        printf("[%s]   %8.1f .. %8.1f  %7.1f ms  rom+bootloader (RTC timer)\n", TAG, 0.0,
+               ms(0), s_reset_us / 1000.0);
+    } else {
+        printf("[%s] boot timeline (ms since esp_timer start, reset reason %d; "
+               "rom+bootloader not measured):\n",
+               TAG, (int)esp_reset_reason());
+    }
+    phase("app init", 0, s_main_us);
+    int64_t prev = s_main_us;
+    for (int i = 0; i < s_mark_count; i++) {
+        phase(s_marks[i].name, prev, s_marks[i].end_us);
+        prev = s_marks[i].end_us;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < s_span_count; i++) {
+        const span_t *s = &s_spans[i];
+        printf("[%s]   %8.1f .. %8.1f  %7.1f ms  %s (%s, %s)\n", TAG, ms(s->start_us),
+               ms(s->end_us), (s->end_us - s->start_us) / 1000.0, s->name, s->where,
+               s->result == ESP_OK ? "ok" : esp_err_to_name(s->result));
+    }
+    int64_t first_at = s_first_at_us;
+    xSemaphoreGive(s_lock);
+
+    if (first_at != 0) {
+        printf("[%s]   first AT command at %.1f ms\n", TAG, ms(first_at));
+    } else {
+        printf("[%s]   no AT command yet\n", TAG);
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+// ============================================================
+// boot_prof.h
+//
+// Boot timeline: where the time goes between reset and the first
+// AT command.
+//
+// Stamps are esp_timer_get_time(), which starts with the app's
+// startup code, not at reset: ROM and bootloader time is not in
+// it. On a power-on reset the RTC timer starts at zero with the
+// chip, so boot_prof_start() reads both clocks and the
+// difference is where esp_timer's zero lies after reset (good to
+// a few ms: the RTC runs from the calibrated slow clock). Every
+// time is printed as ms since reset with that added. After other
+// resets (deep-sleep wake, software, watchdog) the RTC timer has
+// kept running, the phase is not measured and times are since
+// esp_timer start; deep_sleep.c reports a timer wake's own
+// reset-to-esp_timer figure.
+//
+// Phases on the main timeline, each ending at a mark:
+//   rom+bootloader  reset up to esp_timer's zero (ROM,
+//                   second-stage bootloader, image load, the
+//                   start of the IDF startup). Power-on only;
+//                   neither ROM nor bootloader is ours to
+//                   instrument, their log lines split this phase.
+//   app init        the rest of the IDF startup, up to app_main().
+//   <mark>          one per boot_prof_mark() in app_main(), for
+//                   each subsystem brought up there.
+//
+// Spans: subsystems started off the main timeline (init task,
+// first use; see lazy_init.h), with where they ran and their
+// result. The first AT command (any task) is stamped by modem.c.
+// ============================================================
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#define BOOT_PROF_MAX_MARKS 16
+#define BOOT_PROF_MAX_SPANS 8
+
+// --- Public functions ---------------------------------------
+
+// Opens the timeline; first thing in app_main().
+void boot_prof_start(void);
+
+// Closes the phase since the previous mark (or app_main()).
+// Main task only.
+void boot_prof_mark(const char *name);
+
+// Records a subsystem start that ran elsewhere. Any task.
+void boot_prof_span(const char *name, const char *where, int64_t start_us, int64_t end_us,
+                    esp_err_t result);
+
+// Stamps the first AT command; later calls do nothing. Any task.
+void boot_prof_first_at(void);
+
+// Prints the timeline (phases, spans, first AT command).
+void boot_prof_print(void);
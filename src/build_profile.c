@@ -0,0 +1,224 @@
+// ============================================================
+// build_profile.c
+//
+// Debug / release comparison benchmark. See build_profile.h.
+// ============================================================
+
+#include "build_profile.h"
+
+// stdio.h: printf() for console logging to UART0.
+#include <stdio.h>
+
+// string.h: memset() for the result record.
+#include <string.h>
+
+// esp_timer.h: microsecond timing of each workload.
+#include "esp_timer.h"
+
+// nvs_flash.h / nvs.h: one result record per profile.
+#include "nvs_flash.h"
+#include "nvs.h"
+
+// esp_ota_ops.h / esp_image_format.h: running app image size.
+#include "esp_ota_ops.h"
+#include "esp_image_format.h"
+
+// BENCH_* workload sizes, FRAME_PAYLOAD_MAX.
+#include "app_config.h"
+
+// AT round trip over the loopback.
+#include "modem.h"
+
+// frame_link pair in memory.
+#include "frame_link.h"
+
+// FIR / biquad kernels.
+#include "dsp.h"
+
+static const char *TAG = "build_profile";
+
+#define NVS_NAMESPACE "bench"
+
+// ============================================================
+// Workloads
+// ============================================================
+
+static uint32_t s_frame_delivered;
+
+// Each end writes straight into the other's receive path.
+static void pair_write(const uint8_t *data, size_t len, void *user) {
+    frame_link_rx(user, data, len, esp_timer_get_time());
+}
+
+static bool pair_deliver(const uint8_t *data, size_t len, void *user) {
+    (void)data;
+    (void)user;
+    s_frame_delivered += (uint32_t)len;
+    return true;
+}
+
+static void bench_at(build_profile_result_t *r) {
+    char resp[32];
+    int64_t total = 0;
+    for (int i = 0; i < BENCH_AT_ROUNDS; i++) {
+        int64_t t0 = esp_timer_get_time();
+        modem_send_at("AT\r\n", resp, sizeof(resp), MODEM_CMD_TIMEOUT_MS);
+        uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+        total += us;
+        r->at_rtt_max_us = us > r->at_rtt_max_us ? us : r->at_rtt_max_us;
+    }
+    r->at_rtt_us = (uint32_t)(total / BENCH_AT_ROUNDS);
+}
+
+// Every send runs the whole path on both ends: COBS encode, CRC,
+// delimiter scan, decode, CRC check, delivery and the ACK back.
+static void bench_frame(build_profile_result_t *r) {
+    static frame_link_t a;
+    static frame_link_t b;
+    uint8_t payload[FRAME_PAYLOAD_MAX];
+    for (size_t i = 0; i < sizeof(payload); i++) {
+        payload[i] = (uint8_t)(i * 7);  // Zeros included, for COBS.
+    }
+    frame_link_init(&a, pair_write, pair_deliver, &b);
+    frame_link_init(&b, pair_write, pair_deliver, &a);
+    s_frame_delivered = 0;
+
+    int64_t t0 = esp_timer_get_time();
+    for (int i = 0; i < BENCH_FRAME_MSGS; i++) {
+        frame_link_send(&a, payload, sizeof(payload), esp_timer_get_time());
+    }
+    int64_t us = esp_timer_get_time() - t0;
+    r->frame_kbps = us > 0 ? (uint32_t)((int64_t)s_frame_delivered * 1000000 / 1024 / us) : 0;
+}
+
+static void bench_dsp(build_profile_result_t *r) {
+    static DSP_ALIGNED int16_t x[AUDIO_DMA_BUF_LEN];
+    static DSP_ALIGNED int16_t y[AUDIO_DMA_BUF_LEN];
+    static dsp_fir_s16_t fir;
+    static const int16_t taps[16] = {
+        -120, -310, -420, 0, 1350, 3600, 5900, 7200,
+        7200, 5900, 3600, 1350, 0, -420, -310, -120,
+    };
+    static const int16_t lowpass_q14[5] = {1024, 2048, 1024, -22000, 8000};
+    dsp_biquad_s16_t biquad;
+    uint32_t lcg = 1;
+    for (size_t i = 0; i < AUDIO_DMA_BUF_LEN; i++) {
+        lcg = lcg * 1664525u + 1013904223u;
+        x[i] = (int16_t)(lcg >> 16);
+    }
+    const int64_t samples = (int64_t)BENCH_DSP_BLOCKS * AUDIO_DMA_BUF_LEN;
+
+    dsp_fir_s16_init(&fir, taps, sizeof(taps) / sizeof(taps[0]));
+    int64_t t0 = esp_timer_get_time();
+    for (int i = 0; i < BENCH_DSP_BLOCKS; i++) {
+        dsp_fir_s16(&fir, x, y, AUDIO_DMA_BUF_LEN);
+    }
+    int64_t us = esp_timer_get_time() - t0;
+    r->fir_ksps = us > 0 ? (uint32_t)(samples * 1000 / us) : 0;
+
+    dsp_biquad_s16_init(&biquad, lowpass_q14);
+    t0 = esp_timer_get_time();
+    for (int i = 0; i < BENCH_DSP_BLOCKS; i++) {
+        dsp_biquad_s16(&biquad, x, y, AUDIO_DMA_BUF_LEN);
+    }
+    us = esp_timer_get_time() - t0;
+    r->biquad_ksps = us > 0 ? (uint32_t)(samples * 1000 / us) : 0;
+}
+
+static uint32_t image_size(void) {
+    const esp_partition_t *app = esp_ota_get_running_partition();
+    if (app == NULL) {
+        return 0;
+    }
+    const esp_partition_pos_t pos = {.offset = app->address, .size = app->size};
+    esp_image_metadata_t meta;
+    if (esp_image_get_metadata(&pos, &meta) != ESP_OK) {
+        return 0;
+    }
+    return meta.image_len;
+}
+
+// ============================================================
+// Report
+// ============================================================
+
+// Change of now against then, in percent.
+static int pct(uint32_t now, uint32_t then) {
+    return then ? (int)(((int64_t)now - then) * 100 / (int64_t)then) : 0;
+}
+
+static void row(const char *name, const char *unit, uint32_t now, const uint32_t *then) {
+    printf("[%s]   %-14s %8lu %-5s", TAG, name, (unsigned long)now, unit);
+    if (then != NULL) {
+        printf("  %s %8lu (%+d%%)", BUILD_PROFILE_OTHER, (unsigned long)*then, pct(now, *then));
+    }
+    printf("\n");
+}
+
+static void print_result(const build_profile_result_t *r, const build_profile_result_t *other) {
+    if (other != NULL) {
+        printf("[%s] %s profile against the last %s run:\n", TAG, BUILD_PROFILE_NAME,
+               BUILD_PROFILE_OTHER);
+    } else {
+        printf("[%s] %s profile (no %s run stored yet; flash and run it for the delta):\n",
+               TAG, BUILD_PROFILE_NAME, BUILD_PROFILE_OTHER);
+    }
+    row("AT round trip", "us", r->at_rtt_us, other ? &other->at_rtt_us : NULL);
+    row("  worst", "us", r->at_rtt_max_us, other ? &other->at_rtt_max_us : NULL);
+    row("frame link", "KB/s", r->frame_kbps, other ? &other->frame_kbps : NULL);
+    row("FIR 16 taps", "kS/s", r->fir_ksps, other ? &other->fir_ksps : NULL);
+    row("biquad", "kS/s", r->biquad_ksps, other ? &other->biquad_ksps : NULL);
+    row("image", "B", r->image_bytes, other ? &other->image_bytes : NULL);
+    if (other != NULL) {
+        printf("[%s]   flash cost %+ld B\n", TAG,
+               (long)r->image_bytes - (long)other->image_bytes);
+    }
+}
+
+// ============================================================
+// build_profile_bench()
+//
+// Steps:
+//   1. NVS up (erased and retried when its layout is stale).
+//   2. Run the workloads.
+//   3. Print against the other profile's record, if any.
+//   4. Store this profile's record.
+// ============================================================
+void build_profile_bench(void) {
+    // --- Step 1: NVS ---
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        nvs_flash_erase();
+        err = nvs_flash_init();
+    }
+    nvs_handle_t nvs = 0;
+    if (err == ESP_OK) {
+        err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    }
+    if (err != ESP_OK) {
+        printf("[%s] NVS unavailable (%s), no comparison\n", TAG, esp_err_to_name(err));
+    }
+
+    // --- Step 2: Workloads ---
+    build_profile_result_t r;
+    memset(&r, 0, sizeof(r));
+    bench_at(&r);
+    bench_frame(&r);
+    bench_dsp(&r);
+    r.image_bytes = image_size();
+
+    // --- Step 3: Report ---
+    build_profile_result_t other;
+    size_t len = sizeof(other);
+    bool have = err == ESP_OK &&
+                nvs_get_blob(nvs, BUILD_PROFILE_OTHER, &other, &len) == ESP_OK &&
+                len == sizeof(other);
+    print_result(&r, have ? &other : NULL);
+
+    // --- Step 4: Store ---
+    if (err == ESP_OK) {
+        nvs_set_blob(nvs, BUILD_PROFILE_NAME, &r, sizeof(r));
+        nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+}
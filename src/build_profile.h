@@ -0,0 +1,61 @@
+#pragma once
+
+// ============================================================
+// build_profile.h
+//
+// Which of the two build profiles this image is, and the
+// benchmark that compares them.
+//
+// Profiles (platformio.ini):
+//   debug    env adafruit_feather_esp32s3, the default:
+//            -Og, assertions with file / line / expression
+//            (level 2).
+//   release  env adafruit_feather_esp32s3_release: -O2, silent
+//            assertions (level 1: a failed assert still aborts,
+//            without the message strings), the SPI master
+//            driver in IRAM, and every function marked HOT_FN
+//            in IRAM.
+//
+// build_profile_bench() times a fixed workload, keeps the result
+// in NVS under the profile's name and prints it next to the
+// other profile's stored run: flash and run one profile, then the
+// other, on the same board. Uploading an app leaves the NVS
+// partition alone.
+// ============================================================
+
+#include <stdint.h>
+
+// CONFIG_COMPILER_OPTIMIZATION_*, from the profile's sdkconfig.
+#include "sdkconfig.h"
+
+// IRAM_ATTR.
+#include "esp_attr.h"
+
+#if CONFIG_COMPILER_OPTIMIZATION_PERF
+#define BUILD_PROFILE_NAME "release"
+#define BUILD_PROFILE_OTHER "debug"
+// Per-sample / per-byte kernels run from IRAM: no flash cache
+// misses, whatever else the cache is busy with. The debug
+// profile leaves them in flash and the IRAM to the drivers.
+#define HOT_FN IRAM_ATTR
+#else
+#define BUILD_PROFILE_NAME "debug"
+#define BUILD_PROFILE_OTHER "release"
+#define HOT_FN
+#endif
+
+typedef struct {
+    uint32_t at_rtt_us;       // "AT" -> "OK" round trip, mean.
+    uint32_t at_rtt_max_us;
+    uint32_t frame_kbps;      // frame_link payload, encode + decode + ack, KB/s.
+    uint32_t fir_ksps;        // dsp_fir_s16(), k samples/s.
+    uint32_t biquad_ksps;     // dsp_biquad_s16(), k samples/s.
+    uint32_t image_bytes;     // App image in flash.
+} build_profile_result_t;
+
+// --- Public functions ---------------------------------------
+
+// Runs the workload (the modem UART must be up), prints the
+// result and its delta to the other profile's last run, and
+// stores it.
+void build_profile_bench(void);
@@ -0,0 +1,275 @@
+// ============================================================
+// camera_pipeline.c
+//
+// PSRAM frame ring + chunked JPEG uplink. See camera_pipeline.h.
+// ============================================================
+
+#include "camera_pipeline.h"
+
+#if FEATURE_CAMERA
+
+#if !__has_include("esp_camera.h")
+#error "FEATURE_CAMERA needs the esp32-camera component (espressif/esp32-camera)."
+#endif
+#ifndef PIN_CAM_XCLK
+#error "Board profiles with HAS_CAMERA 1 must define the PIN_CAM_* pins."
+#endif
+
+// stdio.h: printf() for console logging to UART0.
+#include <stdio.h>
+
+// string.h: memset() for stats.
+#include <string.h>
+
+// FreeRTOS: capture / uplink tasks and the frame queue.
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+// esp32-camera driver (sensor, DMA, frame buffers).
+#include "esp_camera.h"
+
+// esp_heap_caps.h: PSRAM / internal RAM accounting.
+#include "esp_heap_caps.h"
+
+// esp_timer.h: capture timestamps and latency.
+#include "esp_timer.h"
+
+static const char *TAG = "camera";
+
+// The driver needs one free buffer to capture into and the
+// uplink holds one while sending; the rest can queue.
+#define CAM_QUEUE_DEPTH (CAM_FB_COUNT - 2)
+
+_Static_assert(CAM_FB_COUNT >= 3,
+               "CAM_FB_COUNT must be >= 3 (capture, queue, uplink)");
+
+// --- Queued frame -------------------------------------------
+typedef struct {
+    camera_fb_t *fb;
+    uint32_t seq;
+    int64_t t_capture_us;
+} cam_item_t;
+
+static QueueHandle_t s_q;
+static cam_write_fn s_write;
+static void *s_write_ctx;
+static volatile bool s_run;
+static volatile bool s_capture_done;
+static cam_stats_t s_stats;
+
+// ============================================================
+// write_all()
+//
+// Pushes len bytes through the transport, retrying short writes.
+// Returns false on a transport error.
+// ============================================================
+static bool write_all(const uint8_t *data, size_t len) {
+    while (len > 0) {
+        int n = s_write(s_write_ctx, data, len);
+        if (n < 0) {
+            return false;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+// ============================================================
+// cam_capture_task()
+//
+// Steps (per frame):
+//   1. Get the next JPEG frame buffer from the driver.
+//   2. Drop it if it exceeds the CAM_FRAME_BYTES budget.
+//   3. Queue it for the uplink; if the queue is full apply
+//      CAM_DROP_POLICY.
+// ============================================================
+static void cam_capture_task(void *arg) {
+    uint32_t seq = 0;
+    while (s_run) {
+        // --- Step 1: Capture ---
+        camera_fb_t *fb = esp_camera_fb_get();
+        if (!fb) {
+            continue;
+        }
+        cam_item_t item = {
+            .fb = fb,
+            .seq = seq++,
+            .t_capture_us = esp_timer_get_time(),
+        };
+        s_stats.captured++;
+        if (fb->len > s_stats.max_jpeg_bytes) {
+            s_stats.max_jpeg_bytes = (uint32_t)fb->len;
+        }
+
+        // --- Step 2: Size budget ---
+        if (fb->len > CAM_FRAME_BYTES) {
+            s_stats.oversize++;
+            esp_camera_fb_return(fb);
+            continue;
+        }
+
+        // --- Step 3: Queue / drop policy ---
+        if (xQueueSend(s_q, &item, 0) == pdTRUE) {
+            continue;
+        }
+#if CAM_DROP_POLICY == CAM_DROP_OLDEST
+        cam_item_t old;
+        if (xQueueReceive(s_q, &old, 0) == pdTRUE) {
+            esp_camera_fb_return(old.fb);
+            s_stats.dropped++;
+        }
+        if (xQueueSend(s_q, &item, 0) != pdTRUE) {
+            esp_camera_fb_return(fb);
+            s_stats.dropped++;
+        }
+#else
+        esp_camera_fb_return(fb);
+        s_stats.dropped++;
+#endif
+    }
+    s_capture_done = true;
+    vTaskDelete(NULL);
+}
+
+// ============================================================
+// cam_uplink_task()
+//
+// Streams queued frames out of PSRAM in CAM_TX_CHUNK_BYTES
+// pieces, then hands each buffer back to the driver.
+// Keeps going after stop until the capture task has exited and
+// the queue is empty, so every buffer is returned.
+// ============================================================
+static void cam_uplink_task(void *arg) {
+    cam_item_t item;
+    while (!s_capture_done || uxQueueMessagesWaiting(s_q) > 0) {
+        if (xQueueReceive(s_q, &item, pdMS_TO_TICKS(100)) != pdTRUE) {
+            continue;
+        }
+        camera_fb_t *fb = item.fb;
+        if (!s_run) {
+            // Stopping: return queued buffers unsent.
+            esp_camera_fb_return(fb);
+            continue;
+        }
+
+        cam_frame_hdr_t hdr = {
+            .magic = CAM_FRAME_MAGIC,
+            .seq = item.seq,
+            .len = (uint32_t)fb->len,
+            .t_capture_ms = (uint32_t)(item.t_capture_us / 1000),
+        };
+        bool ok = write_all((const uint8_t *)&hdr, sizeof(hdr));
+        for (size_t off = 0; ok && off < fb->len; off += CAM_TX_CHUNK_BYTES) {
+            size_t chunk = fb->len - off;
+            if (chunk > CAM_TX_CHUNK_BYTES) {
+                chunk = CAM_TX_CHUNK_BYTES;
+            }
+            ok = write_all(fb->buf + off, chunk);
+        }
+        esp_camera_fb_return(fb);
+
+        if (!ok) {
+            s_stats.tx_errors++;
+            continue;
+        }
+        uint32_t latency_ms = (uint32_t)((esp_timer_get_time() - item.t_capture_us) / 1000);
+        s_stats.sent++;
+        s_stats.bytes_sent += sizeof(hdr) + hdr.len;
+        s_stats.total_latency_ms += latency_ms;
+        if (latency_ms > s_stats.max_latency_ms) {
+            s_stats.max_latency_ms = latency_ms;
+        }
+    }
+    vTaskDelete(NULL);
+}
+
+// ============================================================
+// Public API
+// ============================================================
+esp_err_t cam_pipeline_init(void) {
+    camera_config_t cfg = {
+        .pin_pwdn = PIN_CAM_PWDN,
+        .pin_reset = PIN_CAM_RESET,
+        .pin_xclk = PIN_CAM_XCLK,
+        .pin_sccb_sda = PIN_CAM_SIOD,
+        .pin_sccb_scl = PIN_CAM_SIOC,
+        .pin_d7 = PIN_CAM_D7,
+        .pin_d6 = PIN_CAM_D6,
+        .pin_d5 = PIN_CAM_D5,
+        .pin_d4 = PIN_CAM_D4,
+        .pin_d3 = PIN_CAM_D3,
+        .pin_d2 = PIN_CAM_D2,
+        .pin_d1 = PIN_CAM_D1,
+        .pin_d0 = PIN_CAM_D0,
+        .pin_vsync = PIN_CAM_VSYNC,
+        .pin_href = PIN_CAM_HREF,
+        .pin_pclk = PIN_CAM_PCLK,
+        .xclk_freq_hz = CAM_XCLK_HZ,
+        .ledc_timer = LEDC_TIMER_0,
+        .ledc_channel = LEDC_CHANNEL_0,
+        .pixel_format = PIXFORMAT_JPEG,
+        // Larger JPEG budget (8MB PSRAM tier) -> larger frames.
+        .frame_size = CAM_FRAME_BYTES >= 96 * 1024 ? FRAMESIZE_SVGA : FRAMESIZE_VGA,
+        .jpeg_quality = CAM_JPEG_QUALITY,
+        .fb_count = CAM_FB_COUNT,
+        .fb_location = CAMERA_FB_IN_PSRAM,
+#if CAM_DROP_POLICY == CAM_DROP_OLDEST
+        .grab_mode = CAMERA_GRAB_LATEST,
+#else
+        .grab_mode = CAMERA_GRAB_WHEN_EMPTY,
+#endif
+    };
+
+    size_t psram_before = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    size_t internal_before = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+
+    esp_err_t err = esp_camera_init(&cfg);
+    if (err != ESP_OK) {
+        printf("[%s] esp_camera_init failed: %s\n", TAG, esp_err_to_name(err));
+        return err;
+    }
+
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_stats.psram_used = (uint32_t)(psram_before - heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+    s_stats.internal_used =
+        (uint32_t)(internal_before - heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+
+    s_q = xQueueCreate(CAM_QUEUE_DEPTH, sizeof(cam_item_t));
+    if (!s_q) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    printf("[%s] %s: %d frame buffers, PSRAM %lu bytes, internal %lu bytes\n",
+           TAG, BOARD_NAME, CAM_FB_COUNT, (unsigned long)s_stats.psram_used,
+           (unsigned long)s_stats.internal_used);
+    return ESP_OK;
+}
+
+esp_err_t cam_pipeline_start(cam_write_fn write, void *ctx) {
+    s_write = write;
+    s_write_ctx = ctx;
+    s_run = true;
+    s_capture_done = false;
+
+    // Capture next to the camera/DMA ISRs, uplink next to the modem.
+    if (xTaskCreatePinnedToCore(cam_capture_task, "cam_capture", CAM_TASK_STACK_BYTES,
+                                NULL, 6, NULL, 1) != pdPASS ||
+        xTaskCreatePinnedToCore(cam_uplink_task, "cam_uplink", CAM_TASK_STACK_BYTES,
+                                NULL, 5, NULL, 0) != pdPASS) {
+        s_run = false;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void cam_pipeline_stop(void) {
+    s_run = false;
+}
+
+const cam_stats_t *cam_pipeline_stats(void) {
+    return &s_stats;
+}
+
+#endif  // FEATURE_CAMERA
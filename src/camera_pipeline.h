@@ -0,0 +1,89 @@
+#pragma once
+
+// ============================================================
+// camera_pipeline.h
+//
+// Camera -> modem uplink pipeline (FEATURE_CAMERA).
+//
+// Frames:
+//   The sensor produces JPEG in hardware. The esp32-camera
+//   driver DMAs each frame into one of CAM_FB_COUNT frame
+//   buffers in PSRAM (the frame ring); internal SRAM only holds
+//   the DMA line buffers.
+//
+// Flow:
+//   capture task ──(queue of fb pointers)──> uplink task
+//   The uplink task streams each JPEG straight out of its PSRAM
+//   buffer in CAM_TX_CHUNK_BYTES pieces through the transport
+//   write function, then returns the buffer to the driver. No
+//   full-frame copy is ever assembled.
+//
+// Drop policy (uplink slower than capture):
+//   CAM_DROP_OLDEST — keep the freshest frame: when the queue is
+//                     full the oldest queued frame is returned
+//                     unsent (live view).
+//   CAM_DROP_NEWEST — keep what is queued and drop the new frame
+//                     (no gaps inside a burst).
+//   Frames larger than CAM_FRAME_BYTES are dropped as oversize.
+//
+// Wire format per frame:
+//   cam_frame_hdr_t (magic, seq, length, capture time) followed
+//   by the JPEG bytes.
+//
+// Needs the esp32-camera component (espressif/esp32-camera) and
+// a board profile with HAS_CAMERA 1 and the PIN_CAM_* pins.
+// ============================================================
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "app_config.h"
+
+#define CAM_DROP_OLDEST 0
+#define CAM_DROP_NEWEST 1
+
+#define CAM_FRAME_MAGIC 0x4A504547u  // "JPEG"
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t len;          // JPEG bytes that follow.
+    uint32_t t_capture_ms;
+} cam_frame_hdr_t;
+
+// Uplink byte stream (same shape as the MQTT transport write).
+// Returns bytes written or -1.
+typedef int (*cam_write_fn)(void *ctx, const uint8_t *data, size_t len);
+
+// --- Counters -----------------------------------------------
+typedef struct {
+    uint32_t captured;
+    uint32_t sent;
+    uint32_t dropped;        // Drop policy (uplink behind).
+    uint32_t oversize;       // Larger than CAM_FRAME_BYTES.
+    uint32_t tx_errors;
+    uint64_t bytes_sent;
+    uint32_t max_latency_ms; // Capture to last byte written.
+    uint64_t total_latency_ms;
+    uint32_t max_jpeg_bytes;
+
+    // Memory use, measured around camera init.
+    uint32_t psram_used;
+    uint32_t internal_used;
+} cam_stats_t;
+
+// --- Public functions ---------------------------------------
+
+// Initializes the sensor (hardware JPEG, frame buffers in PSRAM)
+// and records how much PSRAM / internal RAM that took.
+esp_err_t cam_pipeline_init(void);
+
+// Starts the capture and uplink tasks. write is called from the
+// uplink task with chunks of at most CAM_TX_CHUNK_BYTES.
+esp_err_t cam_pipeline_start(cam_write_fn write, void *ctx);
+void cam_pipeline_stop(void);
+
+const cam_stats_t *cam_pipeline_stats(void);
@@ -0,0 +1,567 @@
+// ============================================================
+// coap_client.c
+//
+// CoAP client. See coap_client.h for the feature list.
+//
+// Message layout (RFC 7252, section 3):
+//   | Ver T TKL | Code | Message ID (2) | Token (TKL) |
+//   | Options (delta-encoded) ... | 0xFF | Payload ... |
+//
+// Exchange model:
+//   build_request() -> exchange() -> coap_msg_t response
+// exchange() owns retransmission and matching; coap_post() and
+// coap_get() only decide which blocks to ask for next.
+// ============================================================
+
+#include "coap_client.h"
+
+// stdio.h: printf() for debug logging to UART0 console.
+#include <stdio.h>
+
+// string.h: memcpy(), strchr() for encoding and path splitting.
+#include <string.h>
+
+// esp_timer.h: microsecond deadlines for retransmission.
+#include "esp_timer.h"
+
+// power_lock(): full CPU clock while parsing received messages.
+#include "power_mgmt.h"
+
+static const char *TAG = "coap";
+
+// --- Message types ------------------------------------------
+#define COAP_TYPE_CON 0
+#define COAP_TYPE_NON 1
+#define COAP_TYPE_ACK 2
+#define COAP_TYPE_RST 3
+
+// --- Option numbers -----------------------------------------
+#define COAP_OPT_URI_PATH       11
+#define COAP_OPT_CONTENT_FORMAT 12
+#define COAP_OPT_BLOCK2         23
+#define COAP_OPT_BLOCK1         27
+#define COAP_OPT_SIZE1          60
+
+// Token length used for every request.
+#define COAP_TOKEN_LEN 4
+
+// Marker before the payload.
+#define COAP_PAYLOAD_MARKER 0xFF
+
+// Block option value helpers: NUM (20 bits) | M (1) | SZX (3).
+#define BLOCK_VALUE(num, more, szx) (((uint32_t)(num) << 4) | ((more) ? 8u : 0u) | (szx))
+#define BLOCK_NUM(v)  ((v) >> 4)
+#define BLOCK_MORE(v) (((v) & 0x08) != 0)
+#define BLOCK_SZX(v)  ((v) & 0x07)
+#define BLOCK_SIZE(szx) (1u << ((szx) + 4))
+
+// --- Decoded message ----------------------------------------
+typedef struct {
+    uint8_t type;
+    uint8_t code;
+    uint16_t mid;
+    uint8_t tkl;
+    uint8_t token[8];
+    bool has_block1;
+    bool has_block2;
+    uint32_t block1;
+    uint32_t block2;
+    const uint8_t *payload;
+    size_t payload_len;
+} coap_msg_t;
+
+// --- Request encoder ----------------------------------------
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t pos;
+    uint16_t last_opt;
+    bool overflow;
+} coap_writer_t;
+
+// ============================================================
+// Encoding helpers
+// ============================================================
+static void w_bytes(coap_writer_t *w, const void *data, size_t len) {
+    if (w->pos + len > w->cap) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->pos, data, len);
+    w->pos += len;
+}
+
+static void w_u8(coap_writer_t *w, uint8_t v) {
+    w_bytes(w, &v, 1);
+}
+
+// Option delta / length nibble plus extended bytes.
+static uint8_t ext_nibble(uint16_t v, uint8_t *ext, size_t *ext_len) {
+    if (v < 13) {
+        *ext_len = 0;
+        return (uint8_t)v;
+    }
+    if (v < 269) {
+        ext[0] = (uint8_t)(v - 13);
+        *ext_len = 1;
+        return 13;
+    }
+    ext[0] = (uint8_t)((v - 269) >> 8);
+    ext[1] = (uint8_t)((v - 269) & 0xFF);
+    *ext_len = 2;
+    return 14;
+}
+
+// Options must be added in ascending number order.
+static void w_option(coap_writer_t *w, uint16_t num, const void *val,
+                     size_t len) {
+    uint8_t d_ext[2], l_ext[2];
+    size_t d_len, l_len;
+    uint8_t d = ext_nibble((uint16_t)(num - w->last_opt), d_ext, &d_len);
+    uint8_t l = ext_nibble((uint16_t)len, l_ext, &l_len);
+
+    w_u8(w, (uint8_t)((d << 4) | l));
+    w_bytes(w, d_ext, d_len);
+    w_bytes(w, l_ext, l_len);
+    w_bytes(w, val, len);
+    w->last_opt = num;
+}
+
+// uint options use the minimal number of bytes (0 -> empty).
+static void w_uint_option(coap_writer_t *w, uint16_t num, uint32_t v) {
+    uint8_t be[4];
+    size_t len = 0;
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        uint8_t b = (uint8_t)(v >> shift);
+        if (len > 0 || b != 0) {
+            be[len++] = b;
+        }
+    }
+    w_option(w, num, be, len);
+}
+
+// ============================================================
+// coap_parse()
+//
+// Decodes header, token, the options this client cares about,
+// and locates the payload.
+//
+// Returns:
+//   false if the datagram is not a well-formed CoAP message.
+// ============================================================
+static bool coap_parse(const uint8_t *buf, size_t len, coap_msg_t *m) {
+    memset(m, 0, sizeof(*m));
+    if (len < 4 || (buf[0] >> 6) != 1) {
+        return false;
+    }
+    m->type = (buf[0] >> 4) & 0x03;
+    m->tkl = buf[0] & 0x0F;
+    m->code = buf[1];
+    m->mid = (uint16_t)((buf[2] << 8) | buf[3]);
+    if (m->tkl > 8 || 4u + m->tkl > len) {
+        return false;
+    }
+    memcpy(m->token, buf + 4, m->tkl);
+
+    size_t pos = 4 + m->tkl;
+    uint32_t opt = 0;
+    while (pos < len && buf[pos] != COAP_PAYLOAD_MARKER) {
+        uint32_t delta = buf[pos] >> 4;
+        uint32_t olen = buf[pos] & 0x0F;
+        pos++;
+        // Extended delta, then extended length.
+        uint32_t *fields[2] = {&delta, &olen};
+        for (int i = 0; i < 2; i++) {
+            uint32_t v = *fields[i];
+            if (v == 13) {
+                if (pos + 1 > len) {
+                    return false;
+                }
+                v = 13u + buf[pos];
+                pos += 1;
+            } else if (v == 14) {
+                if (pos + 2 > len) {
+                    return false;
+                }
+                v = 269u + (uint32_t)((buf[pos] << 8) | buf[pos + 1]);
+                pos += 2;
+            } else if (v == 15) {
+                return false;
+            }
+            *fields[i] = v;
+        }
+        if (pos + olen > len) {
+            return false;
+        }
+        opt += delta;
+
+        if (opt == COAP_OPT_BLOCK1 || opt == COAP_OPT_BLOCK2) {
+            uint32_t v = 0;
+            for (uint32_t i = 0; i < olen && i < 3; i++) {
+                v = (v << 8) | buf[pos + i];
+            }
+            if (opt == COAP_OPT_BLOCK1) {
+                m->has_block1 = true;
+                m->block1 = v;
+            } else {
+                m->has_block2 = true;
+                m->block2 = v;
+            }
+        }
+        pos += olen;
+    }
+    if (pos < len) {
+        // Skip the 0xFF marker.
+        m->payload = buf + pos + 1;
+        m->payload_len = len - pos - 1;
+    }
+    return true;
+}
+
+// ============================================================
+// rand_next()
+//
+// xorshift32 for message ids and retransmit jitter. CoAP only
+// needs unpredictability against accidental collisions.
+// ============================================================
+static uint32_t rand_next(coap_client_t *c) {
+    uint32_t x = c->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    c->rng = x;
+    return x;
+}
+
+// ============================================================
+// build_request()
+//
+// Encodes a request into c->tx.
+//
+// Inputs:
+//   type, code, mid, token  — header fields.
+//   path                    — "a/b/c", one Uri-Path option per segment.
+//   content_format          — < 0 to omit.
+//   block_opt, block_value  — Block1/Block2 option (block_opt 0 = none).
+//   size1                   — total upload size (0 = omit).
+//   payload, len            — request body (may be empty).
+//
+// Returns:
+//   Encoded length, or 0 if it does not fit COAP_MSG_MAX.
+// ============================================================
+static size_t build_request(coap_client_t *c, uint8_t type, uint8_t code,
+                            uint16_t mid, uint32_t token, const char *path,
+                            int content_format, uint16_t block_opt,
+                            uint32_t block_value, uint32_t size1,
+                            const uint8_t *payload, size_t len) {
+    coap_writer_t w = {.buf = c->tx, .cap = sizeof(c->tx)};
+
+    w_u8(&w, (uint8_t)((1 << 6) | (type << 4) | COAP_TOKEN_LEN));
+    w_u8(&w, code);
+    w_u8(&w, (uint8_t)(mid >> 8));
+    w_u8(&w, (uint8_t)(mid & 0xFF));
+    uint8_t tok[COAP_TOKEN_LEN] = {(uint8_t)(token >> 24), (uint8_t)(token >> 16),
+                                   (uint8_t)(token >> 8), (uint8_t)token};
+    w_bytes(&w, tok, sizeof(tok));
+
+    // Uri-Path (11): one option per non-empty segment.
+    const char *seg = path;
+    while (*seg != '\0') {
+        const char *end = strchr(seg, '/');
+        size_t seg_len = end ? (size_t)(end - seg) : strlen(seg);
+        if (seg_len > 0) {
+            w_option(&w, COAP_OPT_URI_PATH, seg, seg_len);
+        }
+        seg += seg_len;
+        if (*seg == '/') {
+            seg++;
+        }
+    }
+    if (content_format >= 0) {
+        w_uint_option(&w, COAP_OPT_CONTENT_FORMAT, (uint32_t)content_format);
+    }
+    if (block_opt != 0) {
+        w_uint_option(&w, block_opt, block_value);
+    }
+    if (size1 > 0) {
+        w_uint_option(&w, COAP_OPT_SIZE1, size1);
+    }
+    if (len > 0) {
+        w_u8(&w, COAP_PAYLOAD_MARKER);
+        w_bytes(&w, payload, len);
+    }
+    return w.overflow ? 0 : w.pos;
+}
+
+// ============================================================
+// send_datagram() / send_empty()
+// ============================================================
+static bool send_datagram(coap_client_t *c, const uint8_t *data, size_t len) {
+    if (c->tp.send(c->tp.ctx, data, len) != (int)len) {
+        return false;
+    }
+    c->stats.tx_datagrams++;
+    c->stats.tx_bytes += (uint32_t)len;
+    return true;
+}
+
+// Empty ACK or RST for a message id (acknowledging a separate response).
+static void send_empty(coap_client_t *c, uint8_t type, uint16_t mid) {
+    uint8_t msg[4] = {(uint8_t)((1 << 6) | (type << 4)), 0, (uint8_t)(mid >> 8),
+                      (uint8_t)(mid & 0xFF)};
+    send_datagram(c, msg, sizeof(msg));
+}
+
+// ============================================================
+// recv_msg()
+//
+// Receives and parses one datagram into m (payload points into
+// c->rx). Returns false on timeout or malformed input.
+// ============================================================
+static bool recv_msg(coap_client_t *c, coap_msg_t *m, int64_t deadline_us) {
+    int64_t now = esp_timer_get_time();
+    if (now >= deadline_us) {
+        return false;
+    }
+    uint32_t wait_ms = (uint32_t)((deadline_us - now + 999) / 1000);
+    int n = c->tp.recv(c->tp.ctx, c->rx, sizeof(c->rx), wait_ms);
+    if (n <= 0) {
+        return false;
+    }
+    c->stats.rx_datagrams++;
+    c->stats.rx_bytes += (uint32_t)n;
+    power_lock(POWER_PARSE);
+    bool ok = coap_parse(c->rx, (size_t)n, m);
+    power_unlock(POWER_PARSE);
+    return ok;
+}
+
+static bool token_matches(const coap_msg_t *m, uint32_t token) {
+    return m->tkl == COAP_TOKEN_LEN &&
+           m->token[0] == (uint8_t)(token >> 24) &&
+           m->token[1] == (uint8_t)(token >> 16) &&
+           m->token[2] == (uint8_t)(token >> 8) &&
+           m->token[3] == (uint8_t)token;
+}
+
+// ============================================================
+// exchange()
+//
+// Sends the confirmable request in c->tx and waits for its
+// response, retransmitting per RFC 7252 section 4.2:
+//   timeout starts at ACK_TIMEOUT * [1, 1.5), doubles per retry,
+//   at most COAP_MAX_RETRANSMIT retransmissions.
+//
+// Handles:
+//   - piggybacked response (ACK with code != 0 and our token;
+//     another token is not our answer and is ignored)
+//   - empty ACK (code 0) followed by a separate CON/NON response
+//   - RST (peer rejected the message)
+//
+// Returns:
+//   ESP_OK with *resp filled, ESP_ERR_TIMEOUT, or ESP_FAIL.
+// ============================================================
+static esp_err_t exchange(coap_client_t *c, size_t len, uint16_t mid,
+                          uint32_t token, coap_msg_t *resp) {
+    uint32_t timeout_ms = COAP_ACK_TIMEOUT_MS +
+                          rand_next(c) % (COAP_ACK_TIMEOUT_MS / 2);
+    bool acked = false;
+
+    for (int attempt = 0; attempt <= COAP_MAX_RETRANSMIT && !acked; attempt++) {
+        if (attempt > 0) {
+            c->stats.retransmits++;
+        }
+        if (!send_datagram(c, c->tx, len)) {
+            return ESP_FAIL;
+        }
+
+        int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+        while (recv_msg(c, resp, deadline)) {
+            if (resp->type == COAP_TYPE_RST && resp->mid == mid) {
+                printf("[%s] reset by peer (mid %u)\n", TAG, mid);
+                return ESP_FAIL;
+            }
+            if (resp->type == COAP_TYPE_ACK && resp->mid == mid) {
+                if (resp->code == 0) {
+                    acked = true;   // Empty ACK: response comes separately.
+                    break;
+                }
+                if (token_matches(resp, token)) {
+                    return ESP_OK;  // Piggybacked response.
+                }
+                // Our message id but another request's token: not
+                // our answer. An ACK cannot be reset; drop it.
+                printf("[%s] ACK for mid %u with a foreign token, ignored\n", TAG, mid);
+                continue;
+            }
+            if ((resp->type == COAP_TYPE_CON || resp->type == COAP_TYPE_NON) &&
+                token_matches(resp, token)) {
+                // Separate response overtook (or replaced) the ACK.
+                if (resp->type == COAP_TYPE_CON) {
+                    send_empty(c, COAP_TYPE_ACK, resp->mid);
+                }
+                return ESP_OK;
+            }
+            // Anything else is stale or unrelated; keep waiting.
+        }
+        timeout_ms *= 2;
+    }
+
+    if (acked) {
+        // Server promised a separate response; give it the whole
+        // retransmission window (MAX_TRANSMIT_WAIT-ish) to arrive.
+        int64_t deadline = esp_timer_get_time() +
+                           (int64_t)COAP_ACK_TIMEOUT_MS * 1000 *
+                               ((1 << (COAP_MAX_RETRANSMIT + 1)) - 1);
+        while (recv_msg(c, resp, deadline)) {
+            if ((resp->type == COAP_TYPE_CON || resp->type == COAP_TYPE_NON) &&
+                token_matches(resp, token)) {
+                if (resp->type == COAP_TYPE_CON) {
+                    send_empty(c, COAP_TYPE_ACK, resp->mid);
+                }
+                return ESP_OK;
+            }
+        }
+    }
+
+    c->stats.timeouts++;
+    printf("[%s] no response (mid %u)\n", TAG, mid);
+    return ESP_ERR_TIMEOUT;
+}
+
+// ============================================================
+// Public API
+// ============================================================
+void coap_client_init(coap_client_t *c, const coap_transport_t *tp,
+                      uint32_t seed) {
+    memset(c, 0, sizeof(*c));
+    c->tp = *tp;
+    c->rng = seed ? seed : 0x2545F491u;
+    c->next_mid = (uint16_t)rand_next(c);
+    c->next_token = rand_next(c);
+}
+
+esp_err_t coap_post(coap_client_t *c, const char *path,
+                    uint16_t content_format, const uint8_t *payload,
+                    size_t len, bool confirmable, uint8_t *code_out) {
+    coap_msg_t resp;
+    uint32_t token = c->next_token++;
+    uint8_t szx = COAP_BLOCK_SZX;
+    c->stats.requests++;
+
+    if (code_out != NULL) {
+        *code_out = 0;
+    }
+
+    // --- Single message ---
+    if (len <= BLOCK_SIZE(szx)) {
+        uint16_t mid = c->next_mid++;
+        uint8_t type = confirmable ? COAP_TYPE_CON : COAP_TYPE_NON;
+        size_t n = build_request(c, type, COAP_POST, mid, token, path,
+                                 content_format, 0, 0, 0, payload, len);
+        if (n == 0) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if (!confirmable) {
+            return send_datagram(c, c->tx, n) ? ESP_OK : ESP_FAIL;
+        }
+        esp_err_t err = exchange(c, n, mid, token, &resp);
+        if (err == ESP_OK && code_out != NULL) {
+            *code_out = resp.code;
+        }
+        return err;
+    }
+
+    // --- Block1 upload (always confirmable) ---
+    size_t offset = 0;
+    while (offset < len) {
+        size_t bs = BLOCK_SIZE(szx);
+        uint32_t num = (uint32_t)(offset / bs);
+        size_t chunk = (len - offset < bs) ? len - offset : bs;
+        bool more = offset + chunk < len;
+        uint16_t mid = c->next_mid++;
+
+        size_t n = build_request(c, COAP_TYPE_CON, COAP_POST, mid, token, path,
+                                 content_format, COAP_OPT_BLOCK1,
+                                 BLOCK_VALUE(num, more, szx),
+                                 num == 0 ? (uint32_t)len : 0,
+                                 payload + offset, chunk);
+        if (n == 0) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        esp_err_t err = exchange(c, n, mid, token, &resp);
+        if (err != ESP_OK) {
+            return err;
+        }
+        c->stats.blocks++;
+        if (code_out != NULL) {
+            *code_out = resp.code;
+        }
+
+        if (more) {
+            if (resp.code != COAP_CONTINUE) {
+                printf("[%s] block %u rejected (%u.%02u)\n", TAG, (unsigned)num,
+                       resp.code >> 5, resp.code & 0x1F);
+                return ESP_FAIL;
+            }
+            // Server may ask for smaller blocks; the byte offset stays valid.
+            if (resp.has_block1 && BLOCK_SZX(resp.block1) < szx) {
+                szx = BLOCK_SZX(resp.block1);
+            }
+        }
+        offset += chunk;
+    }
+    return ESP_OK;
+}
+
+esp_err_t coap_get(coap_client_t *c, const char *path, uint8_t *buf,
+                   size_t buf_len, size_t *out_len, uint8_t *code_out) {
+    coap_msg_t resp;
+    uint32_t token = c->next_token++;
+    uint8_t szx = COAP_BLOCK_SZX;
+    size_t total = 0;
+    c->stats.requests++;
+
+    for (;;) {
+        uint32_t num = (uint32_t)(total / BLOCK_SIZE(szx));
+        uint16_t mid = c->next_mid++;
+        // Ask for our block size from the first request on (early negotiation).
+        size_t n = build_request(c, COAP_TYPE_CON, COAP_GET, mid, token, path,
+                                 -1, COAP_OPT_BLOCK2,
+                                 BLOCK_VALUE(num, false, szx), 0, NULL, 0);
+        if (n == 0) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        esp_err_t err = exchange(c, n, mid, token, &resp);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (code_out != NULL) {
+            *code_out = resp.code;
+        }
+
+        if (total < buf_len) {
+            size_t copy = resp.payload_len;
+            if (copy > buf_len - total) {
+                copy = buf_len - total;
+            }
+            if (copy > 0) {
+                memcpy(buf + total, resp.payload, copy);
+            }
+        }
+        total += resp.payload_len;
+
+        if (!resp.has_block2) {
+            break;
+        }
+        c->stats.blocks++;
+        if (!BLOCK_MORE(resp.block2)) {
+            break;
+        }
+        szx = BLOCK_SZX(resp.block2);
+    }
+    if (out_len != NULL) {
+        *out_len = total;
+    }
+    return ESP_OK;
+}
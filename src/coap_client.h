@@ -0,0 +1,114 @@
+#pragma once
+
+// ============================================================
+// coap_client.h
+//
+// Small CoAP (RFC 7252) client for periodic telemetry over UDP.
+//
+// Why CoAP for small readings:
+//   - One datagram out, one back (piggybacked ACK): no TCP
+//     handshake, no TLS handshake per connection.
+//   - 4-byte header + compact options instead of HTTP text.
+//
+// Features:
+//   - Confirmable (CON) requests with RFC 7252 retransmission
+//     (randomized ACK_TIMEOUT, exponential backoff) and
+//     non-confirmable (NON) fire-and-forget requests.
+//   - Piggybacked and separate responses.
+//   - Block-wise transfer (RFC 7959): Block1 for uploads larger
+//     than one block, Block2 for large responses.
+//   - Transport-agnostic datagram interface, so the same client
+//     runs over plain modem UDP or a DTLS session (coap_dtls.h).
+//
+// No dynamic allocation: buffers live in coap_client_t.
+// ============================================================
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "app_config.h"
+
+// --- Codes (class << 5 | detail) ----------------------------
+#define COAP_CODE(c, d)          ((uint8_t)(((c) << 5) | (d)))
+#define COAP_GET                 COAP_CODE(0, 1)
+#define COAP_POST                COAP_CODE(0, 2)
+#define COAP_PUT                 COAP_CODE(0, 3)
+#define COAP_CREATED             COAP_CODE(2, 1)
+#define COAP_CHANGED             COAP_CODE(2, 4)
+#define COAP_CONTENT             COAP_CODE(2, 5)
+#define COAP_CONTINUE            COAP_CODE(2, 31)
+#define COAP_REQUEST_INCOMPLETE  COAP_CODE(4, 8)
+#define COAP_NOT_FOUND           COAP_CODE(4, 4)
+
+// --- Content formats ----------------------------------------
+#define COAP_FORMAT_TEXT   0
+#define COAP_FORMAT_OCTETS 42
+#define COAP_FORMAT_JSON   50
+#define COAP_FORMAT_CBOR   60
+
+// --- Datagram transport -------------------------------------
+//   send — transmit one datagram; returns len or -1.
+//   recv — wait up to timeout_ms for one datagram; returns its
+//          length, 0 on timeout, -1 on error.
+typedef struct {
+    int (*send)(void *ctx, const uint8_t *data, size_t len);
+    int (*recv)(void *ctx, uint8_t *buf, size_t len, uint32_t timeout_ms);
+    void *ctx;
+} coap_transport_t;
+
+// --- Counters -----------------------------------------------
+// Byte counts are CoAP message bytes (no UDP/IP headers).
+typedef struct {
+    uint32_t requests;       // Application-level requests issued.
+    uint32_t tx_datagrams;
+    uint32_t rx_datagrams;
+    uint32_t tx_bytes;
+    uint32_t rx_bytes;
+    uint32_t retransmits;
+    uint32_t timeouts;       // CON exchanges that gave up.
+    uint32_t blocks;         // Block1/Block2 exchanges.
+} coap_stats_t;
+
+// --- Client state -------------------------------------------
+typedef struct {
+    coap_transport_t tp;
+    uint16_t next_mid;       // Message id counter.
+    uint32_t next_token;     // Token counter (4-byte tokens).
+    uint32_t rng;            // xorshift state for retransmit jitter.
+    uint8_t tx[COAP_MSG_MAX];
+    uint8_t rx[COAP_MSG_MAX];
+    coap_stats_t stats;
+} coap_client_t;
+
+// --- Public functions ---------------------------------------
+
+// Prepares a client. seed randomizes the initial message id and
+// token (pass esp_random() on target).
+void coap_client_init(coap_client_t *c, const coap_transport_t *tp,
+                      uint32_t seed);
+
+// coap_post()
+//
+// POSTs payload to path (e.g. "t/temp"). Payloads larger than one
+// block are sent with Block1 and are always confirmable.
+//
+// Inputs:
+//   confirmable — true: CON, wait for the response (code_out set).
+//                 false: NON, return right after sending.
+//   code_out    — response code (may be NULL).
+//
+// Returns ESP_OK, ESP_ERR_TIMEOUT, ESP_ERR_INVALID_SIZE, or
+// ESP_FAIL (reset by peer / error response to a block).
+esp_err_t coap_post(coap_client_t *c, const char *path,
+                    uint16_t content_format, const uint8_t *payload,
+                    size_t len, bool confirmable, uint8_t *code_out);
+
+// coap_get()
+//
+// GETs path, following Block2 until the whole representation is
+// in buf. Data beyond buf_len is dropped (out_len still counts it).
+esp_err_t coap_get(coap_client_t *c, const char *path, uint8_t *buf,
+                   size_t buf_len, size_t *out_len, uint8_t *code_out);
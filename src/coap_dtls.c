@@ -0,0 +1,277 @@
+// ============================================================
+// coap_dtls.c
+//
+// DTLS 1.2 + Connection ID session for the CoAP client.
+// See coap_dtls.h. Compiled only when COAP_USE_DTLS is set.
+// ============================================================
+
+#include "coap_dtls.h"
+
+#if COAP_USE_DTLS
+
+// stdio.h: printf() for debug logging to UART0 console.
+#include <stdio.h>
+
+// string.h: strlen() for the PSK identity.
+#include <string.h>
+
+// sdkconfig.h: verify the mbedTLS features this file needs.
+#include "sdkconfig.h"
+
+// esp_timer.h: DTLS retransmission timer.
+#include "esp_timer.h"
+
+// esp_random.h: esp_fill_random() for the RNG callback and CID.
+#include "esp_random.h"
+
+// mbedTLS network error codes for the BIO callbacks.
+#include "mbedtls/net_sockets.h"
+
+// power_lock(): full CPU clock for record / handshake crypto.
+#include "power_mgmt.h"
+
+#if !defined(CONFIG_MBEDTLS_SSL_PROTO_DTLS)
+#error "COAP_USE_DTLS needs CONFIG_MBEDTLS_SSL_PROTO_DTLS in sdkconfig."
+#endif
+#if (COAP_DTLS_CID_LEN > 0) && !defined(CONFIG_MBEDTLS_SSL_DTLS_CONNECTION_ID)
+#error "COAP_DTLS_CID_LEN > 0 needs CONFIG_MBEDTLS_SSL_DTLS_CONNECTION_ID in sdkconfig."
+#endif
+#if !defined(CONFIG_MBEDTLS_PSK_MODES) || !defined(CONFIG_MBEDTLS_KEY_EXCHANGE_PSK)
+#error "COAP_USE_DTLS needs CONFIG_MBEDTLS_PSK_MODES and CONFIG_MBEDTLS_KEY_EXCHANGE_PSK in sdkconfig."
+#endif
+// s_ciphersuites below is AES-128-CCM-8 only.
+#if !defined(CONFIG_MBEDTLS_CCM_C)
+#error "COAP_USE_DTLS needs CONFIG_MBEDTLS_CCM_C in sdkconfig."
+#endif
+// The uplink test runs its handshake on the main task.
+#if CONFIG_ESP_MAIN_TASK_STACK_SIZE < 8192
+#error "COAP_USE_DTLS needs CONFIG_ESP_MAIN_TASK_STACK_SIZE >= 8192 in sdkconfig."
+#endif
+
+static const char *TAG = "coap_dtls";
+
+// CoAP PSK mandatory-to-implement cipher suite (RFC 7252, 9.1.3.1).
+static const int s_ciphersuites[] = {
+    MBEDTLS_TLS_PSK_WITH_AES_128_CCM_8,
+    0,
+};
+
+// ============================================================
+// mbedTLS callbacks
+//
+// BIO:   datagrams go through the plain modem UDP transport.
+//        Receive drops POWER_CRYPTO while it waits, so a
+//        handshake waiting on the network runs at the idle clock.
+// Timer: DTLS handshake retransmission (intermediate / final).
+// RNG:   hardware RNG.
+// ============================================================
+static int bio_send(void *ctx, const unsigned char *buf, size_t len) {
+    coap_dtls_t *d = (coap_dtls_t *)ctx;
+    int n = d->udp.send(d->udp.ctx, buf, len);
+    return n < 0 ? MBEDTLS_ERR_NET_SEND_FAILED : n;
+}
+
+static int bio_recv_timeout(void *ctx, unsigned char *buf, size_t len,
+                            uint32_t timeout_ms) {
+    coap_dtls_t *d = (coap_dtls_t *)ctx;
+    power_unlock(POWER_CRYPTO);
+    int n = d->udp.recv(d->udp.ctx, buf, len,
+                        timeout_ms ? timeout_ms : COAP_ACK_TIMEOUT_MS);
+    power_lock(POWER_CRYPTO);
+    if (n == 0) {
+        return MBEDTLS_ERR_SSL_TIMEOUT;
+    }
+    if (n > 0 && d->in_handshake) {
+        d->handshake_rx++;
+    }
+    return n < 0 ? MBEDTLS_ERR_NET_RECV_FAILED : n;
+}
+
+static void timer_set(void *ctx, uint32_t int_ms, uint32_t fin_ms) {
+    coap_dtls_t *d = (coap_dtls_t *)ctx;
+    d->timer_start_us = esp_timer_get_time();
+    d->timer_int_ms = int_ms;
+    d->timer_fin_ms = fin_ms;
+}
+
+// Returns -1 cancelled, 0 running, 1 intermediate passed, 2 final passed.
+static int timer_get(void *ctx) {
+    coap_dtls_t *d = (coap_dtls_t *)ctx;
+    if (d->timer_fin_ms == 0) {
+        return -1;
+    }
+    int64_t elapsed_ms = (esp_timer_get_time() - d->timer_start_us) / 1000;
+    if (elapsed_ms >= d->timer_fin_ms) {
+        return 2;
+    }
+    if (elapsed_ms >= d->timer_int_ms) {
+        return 1;
+    }
+    return 0;
+}
+
+static int rng(void *ctx, unsigned char *out, size_t len) {
+    (void)ctx;
+    esp_fill_random(out, len);
+    return 0;
+}
+
+// ============================================================
+// dtls_send() / dtls_recv()
+//
+// coap_transport_t adapter on top of the DTLS session.
+// ============================================================
+static int dtls_send(void *ctx, const uint8_t *data, size_t len) {
+    coap_dtls_t *d = (coap_dtls_t *)ctx;
+    int ret;
+    power_lock(POWER_CRYPTO);
+    do {
+        ret = mbedtls_ssl_write(&d->ssl, data, len);
+    } while (ret == MBEDTLS_ERR_SSL_WANT_WRITE);
+    power_unlock(POWER_CRYPTO);
+    return ret < 0 ? -1 : ret;
+}
+
+static int dtls_recv(void *ctx, uint8_t *buf, size_t len, uint32_t timeout_ms) {
+    coap_dtls_t *d = (coap_dtls_t *)ctx;
+    mbedtls_ssl_conf_read_timeout(&d->conf, timeout_ms);
+    power_lock(POWER_CRYPTO);
+    int ret = mbedtls_ssl_read(&d->ssl, buf, len);
+    power_unlock(POWER_CRYPTO);
+    if (ret == MBEDTLS_ERR_SSL_TIMEOUT || ret == MBEDTLS_ERR_SSL_WANT_READ) {
+        return 0;
+    }
+    return ret < 0 ? -1 : ret;
+}
+
+// ============================================================
+// Public API
+// ============================================================
+esp_err_t coap_dtls_init(coap_dtls_t *d, const coap_transport_t *udp,
+                         const uint8_t *psk, size_t psk_len,
+                         const char *identity) {
+    memset(d, 0, sizeof(*d));
+    d->udp = *udp;
+    mbedtls_ssl_init(&d->ssl);
+    mbedtls_ssl_config_init(&d->conf);
+
+    if (mbedtls_ssl_config_defaults(&d->conf, MBEDTLS_SSL_IS_CLIENT,
+                                    MBEDTLS_SSL_TRANSPORT_DATAGRAM,
+                                    MBEDTLS_SSL_PRESET_DEFAULT) != 0) {
+        return ESP_FAIL;
+    }
+    mbedtls_ssl_conf_rng(&d->conf, rng, NULL);
+    mbedtls_ssl_conf_ciphersuites(&d->conf, s_ciphersuites);
+    if (mbedtls_ssl_conf_psk(&d->conf, psk, psk_len,
+                             (const unsigned char *)identity,
+                             strlen(identity)) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Handshake retransmission follows the CoAP ACK timeout.
+    mbedtls_ssl_conf_handshake_timeout(&d->conf, COAP_ACK_TIMEOUT_MS,
+                                       COAP_ACK_TIMEOUT_MS * 16);
+#if COAP_DTLS_CID_LEN > 0
+    mbedtls_ssl_conf_cid(&d->conf, COAP_DTLS_CID_LEN,
+                         MBEDTLS_SSL_UNEXPECTED_CID_IGNORE);
+#endif
+
+    if (mbedtls_ssl_setup(&d->ssl, &d->conf) != 0) {
+        return ESP_ERR_NO_MEM;
+    }
+#if COAP_DTLS_CID_LEN > 0
+    esp_fill_random(d->own_cid, sizeof(d->own_cid));
+    mbedtls_ssl_set_cid(&d->ssl, MBEDTLS_SSL_CID_ENABLED, d->own_cid,
+                        sizeof(d->own_cid));
+#endif
+    mbedtls_ssl_set_bio(&d->ssl, d, bio_send, NULL, bio_recv_timeout);
+    mbedtls_ssl_set_timer_cb(&d->ssl, d, timer_set, timer_get);
+    return ESP_OK;
+}
+
+esp_err_t coap_dtls_handshake(coap_dtls_t *d, uint32_t timeout_ms) {
+    int64_t start = esp_timer_get_time();
+    int64_t deadline = start + (int64_t)timeout_ms * 1000;
+    int ret;
+
+    d->handshake_rx = 0;
+    d->in_handshake = true;
+    power_lock(POWER_CRYPTO);
+    do {
+        ret = mbedtls_ssl_handshake(&d->ssl);
+    } while ((ret == MBEDTLS_ERR_SSL_WANT_READ ||
+              ret == MBEDTLS_ERR_SSL_WANT_WRITE ||
+              ret == MBEDTLS_ERR_SSL_TIMEOUT) &&
+             esp_timer_get_time() < deadline);
+    power_unlock(POWER_CRYPTO);
+    d->in_handshake = false;
+
+    if (ret != 0) {
+        printf("[%s] handshake failed: -0x%04x\n", TAG, (unsigned)-ret);
+        return ret == MBEDTLS_ERR_SSL_TIMEOUT ? ESP_ERR_TIMEOUT : ESP_FAIL;
+    }
+    d->handshakes++;
+    // Abbreviated: ServerHello .. Finished in one flight. A lost
+    // flight adds a datagram and reads as full, never the reverse.
+    d->resumed = d->offered && d->handshake_rx == 1;
+
+#if COAP_DTLS_CID_LEN > 0
+    int enabled = MBEDTLS_SSL_CID_DISABLED;
+    unsigned char peer_cid[MBEDTLS_SSL_CID_OUT_LEN_MAX];
+    size_t peer_cid_len = 0;
+    mbedtls_ssl_get_peer_cid(&d->ssl, &enabled, peer_cid, &peer_cid_len);
+    d->cid_active = (enabled == MBEDTLS_SSL_CID_ENABLED);
+#endif
+
+    printf("[%s] %s handshake done in %lld ms, suite %s, CID %s\n", TAG,
+           d->resumed ? "resumed" : "full",
+           (long long)((esp_timer_get_time() - start) / 1000),
+           mbedtls_ssl_get_ciphersuite(&d->ssl),
+           d->cid_active ? "active" : "not negotiated");
+    return ESP_OK;
+}
+
+void coap_dtls_transport(coap_dtls_t *d, coap_transport_t *out) {
+    out->send = dtls_send;
+    out->recv = dtls_recv;
+    out->ctx = d;
+}
+
+bool coap_dtls_cid_active(const coap_dtls_t *d) {
+    return d->cid_active;
+}
+
+bool coap_dtls_resumed(const coap_dtls_t *d) {
+    return d->resumed;
+}
+
+size_t coap_dtls_save_session(coap_dtls_t *d, uint8_t *buf, size_t cap) {
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    size_t len = 0;
+    if (mbedtls_ssl_get_session(&d->ssl, &session) != 0 ||
+        mbedtls_ssl_session_save(&session, buf, cap, &len) != 0) {
+        len = 0;
+    }
+    mbedtls_ssl_session_free(&session);
+    return len;
+}
+
+esp_err_t coap_dtls_resume_session(coap_dtls_t *d, const uint8_t *buf, size_t len) {
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    int ret = mbedtls_ssl_session_load(&session, buf, len);
+    if (ret == 0) {
+        ret = mbedtls_ssl_set_session(&d->ssl, &session);
+    }
+    mbedtls_ssl_session_free(&session);
+    d->offered = ret == 0;
+    return ret == 0 ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+void coap_dtls_free(coap_dtls_t *d) {
+    mbedtls_ssl_close_notify(&d->ssl);
+    mbedtls_ssl_free(&d->ssl);
+    mbedtls_ssl_config_free(&d->conf);
+}
+
+#endif  // COAP_USE_DTLS
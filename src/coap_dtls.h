@@ -0,0 +1,95 @@
+#pragma once
+
+// ============================================================
+// coap_dtls.h
+//
+// Optional DTLS 1.2 layer for the CoAP client (COAP_USE_DTLS).
+//
+// Wraps a plain datagram transport (modem UDP) in an mbedTLS
+// DTLS session and exposes the result as another
+// coap_transport_t, so coap_client.c does not change.
+//
+// Connection ID (RFC 9146):
+//   Cellular NATs rebind idle UDP flows to new ports. Without a
+//   CID the server keys the session on the old address/port and
+//   the device has to redo the handshake (several round trips,
+//   hundreds of bytes). With COAP_DTLS_CID_LEN > 0 the client
+//   asks the server to tag records with a CID instead, so after
+//   a rebinding (or after reopening the modem socket) records on
+//   the new port still map to the same session.
+//
+// Credentials: pre-shared key, TLS_PSK_WITH_AES_128_CCM_8 (the
+// CoAP mandatory-to-implement suite for PSK mode).
+//
+// sdkconfig requirements: CONFIG_MBEDTLS_SSL_PROTO_DTLS,
+// CONFIG_MBEDTLS_SSL_DTLS_CONNECTION_ID, CONFIG_MBEDTLS_PSK_MODES,
+// CONFIG_MBEDTLS_KEY_EXCHANGE_PSK, CONFIG_MBEDTLS_CCM_C.
+// CONFIG_ESP_MAIN_TASK_STACK_SIZE >= 8192 (handshakes on the main
+// task).
+// ============================================================
+
+#include "coap_client.h"
+
+#if COAP_USE_DTLS
+
+#include "mbedtls/ssl.h"
+
+// --- Session state ------------------------------------------
+typedef struct {
+    coap_transport_t udp;            // Underlying datagram transport.
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_config conf;
+
+    // DTLS retransmission timer (mbedtls_ssl_set_timer_cb).
+    int64_t timer_start_us;
+    uint32_t timer_int_ms;
+    uint32_t timer_fin_ms;
+
+    uint8_t own_cid[COAP_DTLS_CID_LEN > 0 ? COAP_DTLS_CID_LEN : 1];
+    bool cid_active;                 // Server accepted the CID extension.
+    uint32_t handshakes;             // Handshakes performed (full or resumed).
+
+    // Resumption (coap_dtls_resume_session()).
+    bool offered;                    // A saved session went into the ClientHello.
+    bool in_handshake;
+    uint8_t handshake_rx;            // Datagrams received by the last handshake.
+    bool resumed;                    // Last handshake was abbreviated.
+} coap_dtls_t;
+
+// --- Public functions ---------------------------------------
+
+// Sets up the mbedTLS context. psk / identity must stay valid
+// for the lifetime of the session.
+esp_err_t coap_dtls_init(coap_dtls_t *d, const coap_transport_t *udp,
+                         const uint8_t *psk, size_t psk_len,
+                         const char *identity);
+
+// Runs the handshake. Returns ESP_OK, ESP_ERR_TIMEOUT or ESP_FAIL.
+esp_err_t coap_dtls_handshake(coap_dtls_t *d, uint32_t timeout_ms);
+
+// Fills out with a transport that encrypts through the session.
+void coap_dtls_transport(coap_dtls_t *d, coap_transport_t *out);
+
+// True if records carry a connection ID, i.e. the session
+// survives NAT rebinding without a new handshake.
+bool coap_dtls_cid_active(const coap_dtls_t *d);
+
+// True if the last handshake resumed the offered session: the
+// server answered the ClientHello with its Finished in one
+// datagram, instead of the two round trips of a full handshake.
+bool coap_dtls_resumed(const coap_dtls_t *d);
+
+// Serializes the negotiated session (session ID / ticket and
+// master secret) into buf, e.g. for RTC memory across deep sleep.
+// Returns bytes written, 0 if it does not fit or failed.
+size_t coap_dtls_save_session(coap_dtls_t *d, uint8_t *buf, size_t cap);
+
+// Offers a saved session in the next handshake (call after
+// coap_dtls_init()). If the server still has it the handshake is
+// abbreviated: one round trip, no key exchange.
+esp_err_t coap_dtls_resume_session(coap_dtls_t *d, const uint8_t *buf, size_t len);
+
+// Sends close_notify and frees the mbedTLS context.
+void coap_dtls_free(coap_dtls_t *d);
+
+#endif  // COAP_USE_DTLS
@@ -0,0 +1,407 @@
+// ============================================================
+// deep_sleep.c
+//
+// RTC-retained modem / session state and the fast wake path.
+// See deep_sleep.h.
+// ============================================================
+
+#include "deep_sleep.h"
+
+#if FEATURE_DEEP_SLEEP
+
+// stdio.h: printf() for console logging to UART0.
+#include <stdio.h>
+
+// string.h: strstr() for AT responses, memcpy()/memset().
+#include <string.h>
+
+// stddef.h: offsetof() for the CRC span.
+#include <stddef.h>
+
+// FreeRTOS: delays between bring-up polls.
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// esp_attr.h: RTC_NOINIT_ATTR (RTC slow memory, kept in deep sleep
+// and across software / watchdog / panic resets).
+#include "esp_attr.h"
+
+// esp_sleep.h: wake cause, timer wake-up, deep sleep entry.
+#include "esp_sleep.h"
+
+// esp_rom_crc.h: esp_rom_crc32_le() for the retained block.
+#include "esp_rom_crc.h"
+
+// esp_timer.h: bring-up and wake-to-first-byte timing.
+#include "esp_timer.h"
+
+// esp_rtc_time.h: RTC timer, for the time before esp_timer starts.
+#include "esp_rtc_time.h"
+
+// esp_system.h: esp_reset_reason() (power-on starts the RTC at 0).
+#include "esp_system.h"
+
+// UART1 modem driver — modem_send_at().
+#include "modem.h"
+
+static const char *TAG = "deep_sleep";
+
+#define DS_MAGIC 0x44534C50u  // "DSLP"
+
+// Steps the modem itself keeps while in PSM; skipped on wake.
+#define DS_STEPS_KEPT (DS_STEP_CONFIGURED | DS_STEP_PSM)
+
+// Short per-command timeout on the wake path: a modem leaving
+// PSM answers within a few hundred ms or not at all.
+#define DS_WAKE_AT_TIMEOUT_MS 500
+#define DS_WAKE_AT_TRIES 4
+
+// --- RTC-retained block -------------------------------------
+typedef struct {
+    uint32_t magic;
+    uint32_t boots;
+    uint32_t wakes;
+    uint32_t steps;                     // ds_step_t bits.
+    uint32_t cursor[DS_CURSOR_COUNT];
+    uint32_t last_fast_us;              // Wake-to-first-byte, fast path.
+    uint32_t last_full_us;              // Boot-to-first-byte, full path.
+    uint32_t last_resumed_us;           // Wake-to-first-byte, DTLS session resumed.
+    uint32_t last_handshake_us;         // Wake-to-first-byte, full DTLS handshake.
+    uint64_t wake_rtc_us;               // RTC time the wake timer fires at.
+    uint16_t tls_len;
+    uint8_t tls[DEEP_SLEEP_TLS_SESSION_MAX];
+    uint32_t crc;
+} ds_rtc_t;
+
+// Not RTC_DATA_ATTR: the bootloader reloads that from the image on
+// every reset but a deep-sleep wake, which would send the cursors
+// back to zero after a watchdog or panic reset.
+RTC_NOINIT_ATTR static ds_rtc_t s_rtc;
+
+static bool s_wake;                     // This boot took the fast path.
+static bool s_fell_back;                // Fast path failed verification.
+static int64_t s_first_byte_us = -1;    // From reset if s_from_reset.
+static uint32_t s_modem_up_us;
+static int64_t s_reset_offset_us;       // Reset to esp_timer start.
+static bool s_from_reset;               // s_reset_offset_us is known.
+static int s_session = -1;              // -1 none, 0 full handshake, 1 resumed.
+
+static uint32_t rtc_crc(void) {
+    return esp_rom_crc32_le(0, (const uint8_t *)&s_rtc, offsetof(ds_rtc_t, crc));
+}
+
+// Called after every change, so the block is valid whenever a
+// reset (not only deep sleep) cuts the boot short.
+static void rtc_seal(void) {
+    s_rtc.crc = rtc_crc();
+}
+
+// ============================================================
+// deep_sleep_boot()
+//
+// Steps:
+//   1. Check the wake cause: only a timer wake may use the
+//      retained block (power-on / reset left the modem in an
+//      unknown state).
+//   2. Validate magic + CRC; otherwise start from a zeroed block.
+//   3. Find where reset was on the RTC timer (see deep_sleep.h).
+// ============================================================
+void deep_sleep_boot(void) {
+    // --- Step 1: Wake cause ---
+    bool timer_wake = esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER;
+    bool valid = s_rtc.magic == DS_MAGIC && s_rtc.crc == rtc_crc();
+
+    // --- Step 2: Retained block ---
+    if (!valid) {
+        memset(&s_rtc, 0, sizeof(s_rtc));
+        s_rtc.magic = DS_MAGIC;
+    }
+    if (!timer_wake) {
+        // Cursors stay valid (they only have to move forward), but
+        // nothing about the modem can be trusted.
+        s_rtc.steps = 0;
+        s_rtc.tls_len = 0;
+    }
+    s_rtc.boots++;
+    s_wake = timer_wake && valid && (s_rtc.steps & DS_STEP_REGISTERED);
+    if (s_wake) {
+        s_rtc.wakes++;
+    }
+
+    // --- Step 3: Reset on the RTC timer ---
+    int64_t rtc_now = (int64_t)esp_rtc_get_time_us();
+    int64_t app_now = esp_timer_get_time();
+    if (timer_wake && valid && s_rtc.wake_rtc_us != 0) {
+        s_reset_offset_us = rtc_now - (int64_t)s_rtc.wake_rtc_us - app_now;
+        s_from_reset = true;
+    } else if (esp_reset_reason() == ESP_RST_POWERON) {
+        s_reset_offset_us = rtc_now - app_now;
+        s_from_reset = true;
+    }
+    if (s_reset_offset_us < 0) {
+        s_reset_offset_us = 0;          // Slow-clock error on a fast boot.
+    }
+    s_rtc.wake_rtc_us = 0;
+    rtc_seal();
+
+    printf("[%s] boot %lu: %s\n", TAG, (unsigned long)s_rtc.boots,
+           s_wake ? "timer wake, retained state valid" : "cold start");
+}
+
+bool deep_sleep_is_wake(void) {
+    return s_wake;
+}
+
+// ============================================================
+// Bring-up steps
+// ============================================================
+static bool at_ok(const char *cmd, uint32_t timeout_ms) {
+    char resp[64];
+    return modem_send_at(cmd, resp, sizeof(resp), timeout_ms) >= 0 &&
+           strstr(resp, "OK") != NULL;
+}
+
+static bool wait_at_ready(uint32_t budget_ms, uint32_t per_try_ms) {
+    int64_t deadline = esp_timer_get_time() + (int64_t)budget_ms * 1000;
+    do {
+        if (at_ok("AT\r\n", per_try_ms)) {
+            return true;
+        }
+    } while (esp_timer_get_time() < deadline);
+    return false;
+}
+
+// One +CEREG? query: true for "registered, home" or "roaming".
+static bool query_registered(void) {
+    char resp[64];
+    if (modem_send_at("AT+CEREG?\r\n", resp, sizeof(resp), MODEM_CMD_TIMEOUT_MS) < 0) {
+        return false;
+    }
+    const char *p = strstr(resp, "+CEREG:");
+    p = p ? strchr(p, ',') : NULL;
+    return p && (p[1] == '1' || p[1] == '5');
+}
+
+static bool configure(void) {
+    return at_ok("ATE0\r\n", MODEM_CMD_TIMEOUT_MS) &&
+           at_ok("AT+CMEE=2\r\n", MODEM_CMD_TIMEOUT_MS);
+}
+
+static bool wait_registered(uint32_t budget_ms) {
+    int64_t deadline = esp_timer_get_time() + (int64_t)budget_ms * 1000;
+    do {
+        if (query_registered()) {
+            return true;
+        }
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    } while (esp_timer_get_time() < deadline);
+    return false;
+}
+
+static bool request_psm(void) {
+    char cmd[64];
+    snprintf(cmd, sizeof(cmd), "AT+CPSMS=1,,,\"%s\",\"%s\"\r\n",
+             DEEP_SLEEP_PSM_TAU, DEEP_SLEEP_PSM_ACTIVE);
+    if (!at_ok(cmd, MODEM_CMD_TIMEOUT_MS)) {
+        return false;
+    }
+    snprintf(cmd, sizeof(cmd), "AT+CEDRXS=1,4,\"%s\"\r\n", DEEP_SLEEP_EDRX);
+    return at_ok(cmd, MODEM_CMD_TIMEOUT_MS);
+}
+
+// ============================================================
+// full_bringup()
+//
+// Cold path. Each completed step sets its bit so a later wake
+// knows what it can skip.
+// ============================================================
+static esp_err_t full_bringup(void) {
+    s_rtc.steps = 0;
+    if (!wait_at_ready(MODEM_BOOT_GRACE_MS, 1000)) {
+        printf("[%s] modem not answering after %d ms\n", TAG, MODEM_BOOT_GRACE_MS);
+        return ESP_ERR_TIMEOUT;
+    }
+    s_rtc.steps |= DS_STEP_AT_READY;
+
+    if (!configure()) {
+        return ESP_FAIL;
+    }
+    s_rtc.steps |= DS_STEP_CONFIGURED;
+
+    if (!wait_registered(DEEP_SLEEP_REG_TIMEOUT_MS)) {
+        printf("[%s] not registered after %d ms\n", TAG, DEEP_SLEEP_REG_TIMEOUT_MS);
+        return ESP_ERR_TIMEOUT;
+    }
+    s_rtc.steps |= DS_STEP_REGISTERED;
+
+    // PSM is a request; the network may refuse it. The device
+    // still works, the modem just stays in idle between wakes.
+    if (request_psm()) {
+        s_rtc.steps |= DS_STEP_PSM;
+    } else {
+        printf("[%s] PSM/eDRX request rejected\n", TAG);
+    }
+    return ESP_OK;
+}
+
+// ============================================================
+// fast_resume()
+//
+// Wake path: the modem is registered and parked in PSM.
+//
+// Steps:
+//   1. UART traffic brings it out of PSM; retry AT a few times
+//      with short timeouts.
+//   2. One +CEREG? to confirm it is still registered (the
+//      network may have dropped us if a TAU was missed).
+//   3. Skip configuration and PSM setup (kept by the modem).
+// ============================================================
+static bool fast_resume(void) {
+    // --- Step 1: Wake ---
+    bool ready = false;
+    for (int i = 0; i < DS_WAKE_AT_TRIES && !ready; i++) {
+        ready = at_ok("AT\r\n", DS_WAKE_AT_TIMEOUT_MS);
+    }
+    if (!ready) {
+        return false;
+    }
+
+    // --- Step 2: Verify registration ---
+    if (!query_registered()) {
+        return false;
+    }
+
+    // --- Step 3: Retained steps ---
+    s_rtc.steps &= DS_STEPS_KEPT;
+    s_rtc.steps |= DS_STEP_AT_READY | DS_STEP_REGISTERED;
+    return true;
+}
+
+esp_err_t deep_sleep_modem_up(void) {
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = ESP_OK;
+
+    if (s_wake && !fast_resume()) {
+        printf("[%s] fast resume failed verification, full bring-up\n", TAG);
+        s_wake = false;
+        s_fell_back = true;
+        s_rtc.tls_len = 0;
+    }
+    if (!s_wake) {
+        err = full_bringup();
+    }
+    rtc_seal();
+
+    s_modem_up_us = (uint32_t)(esp_timer_get_time() - start);
+    printf("[%s] modem up via %s path in %lu ms (steps 0x%lx)\n", TAG,
+           s_wake ? "fast" : "full", (unsigned long)(s_modem_up_us / 1000),
+           (unsigned long)s_rtc.steps);
+    return err;
+}
+
+// ============================================================
+// Cursors and TLS session
+// ============================================================
+uint32_t deep_sleep_cursor(ds_cursor_t id) {
+    return s_rtc.cursor[id];
+}
+
+void deep_sleep_set_cursor(ds_cursor_t id, uint32_t value) {
+    s_rtc.cursor[id] = value;
+    rtc_seal();
+}
+
+const uint8_t *deep_sleep_tls_session(size_t *len) {
+    *len = s_rtc.tls_len;
+    return s_rtc.tls_len ? s_rtc.tls : NULL;
+}
+
+void deep_sleep_save_tls_session(const uint8_t *data, size_t len) {
+    if (len == 0 || len > sizeof(s_rtc.tls)) {
+        // None, or does not fit: the next wake pays the full handshake.
+        s_rtc.tls_len = 0;
+    } else {
+        memcpy(s_rtc.tls, data, len);
+        s_rtc.tls_len = (uint16_t)len;
+    }
+    rtc_seal();
+}
+
+// ============================================================
+// Timing + report
+// ============================================================
+void deep_sleep_note_session(bool resumed) {
+    s_session = resumed ? 1 : 0;
+}
+
+void deep_sleep_mark_first_byte(void) {
+    if (s_first_byte_us >= 0) {
+        return;
+    }
+    s_first_byte_us = esp_timer_get_time() + s_reset_offset_us;
+    if (s_wake) {
+        s_rtc.last_fast_us = (uint32_t)s_first_byte_us;
+    } else {
+        s_rtc.last_full_us = (uint32_t)s_first_byte_us;
+    }
+    if (s_session == 1) {
+        s_rtc.last_resumed_us = (uint32_t)s_first_byte_us;
+    } else if (s_session == 0) {
+        s_rtc.last_handshake_us = (uint32_t)s_first_byte_us;
+    }
+    rtc_seal();
+}
+
+void deep_sleep_report(void) {
+    const char *since = s_from_reset ? "reset" : "app start, ROM + bootloader not included";
+    printf("[%s] boot %lu (wake %lu): %s path%s, modem up %lu ms, first byte at %lld ms "
+           "(since %s)\n",
+           TAG, (unsigned long)s_rtc.boots, (unsigned long)s_rtc.wakes,
+           s_wake ? "fast" : "full", s_fell_back ? " (fallback)" : "",
+           (unsigned long)(s_modem_up_us / 1000),
+           (long long)(s_first_byte_us >= 0 ? s_first_byte_us / 1000 : -1), since);
+    if (s_from_reset) {
+        printf("[%s] reset to esp_timer start (ROM, bootloader, early app init): %lld ms\n",
+               TAG, (long long)(s_reset_offset_us / 1000));
+    }
+    printf("[%s] wake-to-first-byte: fast %lu ms, full %lu ms (last of each)\n", TAG,
+           (unsigned long)(s_rtc.last_fast_us / 1000),
+           (unsigned long)(s_rtc.last_full_us / 1000));
+    if (s_session >= 0) {
+        printf("[%s] dtls: %s this boot; wake-to-first-byte: resumed %lu ms, "
+               "full handshake %lu ms (last of each)\n",
+               TAG, s_session ? "session resumed" : "full handshake",
+               (unsigned long)(s_rtc.last_resumed_us / 1000),
+               (unsigned long)(s_rtc.last_handshake_us / 1000));
+    }
+}
+
+// ============================================================
+// deep_sleep_enter()
+//
+// Steps:
+//   1. Without a PSM grant the modem would sit in idle draining
+//      power, and a wake could not trust its state either:
+//      drop the registered bit so the next boot runs full.
+//   2. Seal the RTC block (CRC) with the RTC time the timer will
+//      fire at, and arm the timer.
+//   3. Enter deep sleep.
+// ============================================================
+void deep_sleep_enter(uint32_t seconds) {
+    // --- Step 1: Only PSM keeps a trustworthy modem state ---
+    if (!(s_rtc.steps & DS_STEP_PSM)) {
+        s_rtc.steps = 0;
+    }
+
+    // --- Step 2: Seal + arm ---
+    printf("[%s] deep sleep for %lu s\n", TAG, (unsigned long)seconds);
+    uint64_t interval_us = (uint64_t)seconds * 1000000ULL;
+    s_rtc.wake_rtc_us = esp_rtc_get_time_us() + interval_us;
+    rtc_seal();
+    esp_sleep_enable_timer_wakeup(interval_us);
+
+    // --- Step 3: Sleep ---
+    esp_deep_sleep_start();
+}
+
+#endif  // FEATURE_DEEP_SLEEP
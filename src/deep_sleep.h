@@ -0,0 +1,107 @@
+#pragma once
+
+// ============================================================
+// deep_sleep.h
+//
+// Deep-sleep duty cycle with fast resume (FEATURE_DEEP_SLEEP).
+//
+// A cold start runs the full modem bring-up:
+//   boot grace (poll AT) -> ATE0 / CMEE -> wait for registration
+//   -> PSM + eDRX request.
+// Before deep sleep the modem is left registered in PSM/eDRX
+// instead of being powered off, and what has been verified is
+// kept in RTC slow memory (RTC_NOINIT_ATTR, survives deep sleep
+// and software / watchdog / panic resets, lost on power-on /
+// brown-out):
+//   - which bring-up steps completed (ds_step_t bits),
+//   - queue / protocol cursors (uplink sequence, CoAP message id
+//     and token, so a woken device never reuses them),
+//   - a serialized TLS/DTLS session for abbreviated handshakes.
+// The block is CRC-checked and resealed after every change; a
+// bad CRC means cold start.
+//
+// Wake path:
+//   Steps whose result the modem keeps across PSM (echo / error
+//   format settings, PSM request) are skipped. AT readiness and
+//   registration are verified with a single query each, no
+//   polling loops. Any failed check clears the retained state
+//   and falls back to the full bring-up.
+//
+// DTLS (COAP_USE_DTLS): the session is saved to RTC memory after
+// each handshake and offered again on the next timer wake, so a
+// wake normally pays one round trip instead of the full
+// handshake. The report keeps wake-to-first-byte separately for
+// resumed and full handshakes.
+//
+// Timing:
+//   esp_timer starts with the app, after ROM and bootloader, so
+//   deep_sleep_boot() works out how long the chip ran before it
+//   from the RTC timer, which keeps counting through deep sleep:
+//     - timer wake: RTC now minus the RTC time the wake timer was
+//       set to fire at (stored at deep_sleep_enter()),
+//     - power-on: RTC now (it starts at zero with the chip).
+//   Times are reported from reset with that added. The RTC timer
+//   runs from the calibrated slow clock, so this is good to a
+//   few ms. Other resets (software, watchdog, brown-out) have no
+//   reference point; their times are from app start and the
+//   report says so.
+// ============================================================
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "app_config.h"
+
+// --- Bring-up steps (bit mask) ------------------------------
+typedef enum {
+    DS_STEP_AT_READY   = 1u << 0,   // Modem answers AT.
+    DS_STEP_CONFIGURED = 1u << 1,   // ATE0, AT+CMEE=2.
+    DS_STEP_REGISTERED = 1u << 2,   // +CEREG stat 1 or 5.
+    DS_STEP_PSM        = 1u << 3,   // AT+CPSMS / AT+CEDRXS accepted.
+} ds_step_t;
+
+// --- Retained cursors ---------------------------------------
+typedef enum {
+    DS_CURSOR_UPLINK_SEQ,
+    DS_CURSOR_COAP_MID,
+    DS_CURSOR_COAP_TOKEN,
+    DS_CURSOR_COUNT
+} ds_cursor_t;
+
+// --- Public functions ---------------------------------------
+
+// Call first thing in app_main(). Validates the RTC block and
+// decides between the wake and cold paths.
+void deep_sleep_boot(void);
+
+// True if this boot is a timer wake with valid retained state.
+bool deep_sleep_is_wake(void);
+
+// Runs the modem bring-up, skipping steps retained across sleep.
+// Returns ESP_OK once the modem is registered.
+esp_err_t deep_sleep_modem_up(void);
+
+uint32_t deep_sleep_cursor(ds_cursor_t id);
+void deep_sleep_set_cursor(ds_cursor_t id, uint32_t value);
+
+// Retained TLS/DTLS session (NULL / 0 if none).
+const uint8_t *deep_sleep_tls_session(size_t *len);
+void deep_sleep_save_tls_session(const uint8_t *data, size_t len);
+
+// Records how this boot's DTLS session came up: resumed from the
+// retained session or a full handshake.
+void deep_sleep_note_session(bool resumed);
+
+// Records the first uplink byte of this boot (later calls ignored).
+void deep_sleep_mark_first_byte(void);
+
+// Prints path taken, wake-to-first-byte and the last fast / full
+// (and resumed / full handshake) figures kept in RTC memory.
+void deep_sleep_report(void);
+
+// Seals the RTC block and enters deep sleep for seconds.
+// Does not return.
+void deep_sleep_enter(uint32_t seconds);
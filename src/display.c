@@ -0,0 +1,315 @@
+// ============================================================
+// display.c
+//
+// Dirty-rectangle tracking + double band buffers over esp_lcd.
+// See display.h.
+// ============================================================
+
+#include "display.h"
+
+#if FEATURE_DISPLAY
+
+// stdio.h: printf() for console logging to UART0.
+#include <stdio.h>
+
+// string.h: memset() for stats.
+#include <string.h>
+
+// FreeRTOS: counting semaphore of free band buffers.
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// ESP-IDF SPI bus + LCD panel drivers.
+#include "driver/spi_common.h"
+#include "esp_lcd_panel_io.h"
+#include "esp_lcd_panel_ops.h"
+#include "esp_lcd_panel_st7789.h"
+
+// Shared SPI bus: band transfers are queued as arbiter jobs.
+#include "spi_arbiter.h"
+
+// esp_heap_caps.h: DMA-capable band buffers.
+#include "esp_heap_caps.h"
+
+// esp_timer.h: render / wait / flush timing.
+#include "esp_timer.h"
+
+static const char *TAG = "display";
+
+// Same SPI peripheral as the SD card; the bus belongs to the
+// SPI arbiter.
+#define DISPLAY_SPI_HOST SPI2_HOST
+
+#define BAND_PIXELS (DISPLAY_WIDTH * DISPLAY_BAND_LINES)
+
+static esp_lcd_panel_io_handle_t s_io;
+static esp_lcd_panel_handle_t s_panel;
+static uint16_t *s_band[2];
+static uint8_t s_next_band;
+static SemaphoreHandle_t s_free;     // Band buffers not owned by DMA.
+static int s_spi_dev = -1;           // Arbiter device id.
+
+static display_rect_t s_dirty[DISPLAY_MAX_DIRTY];
+static uint8_t s_dirty_count;
+static display_stats_t s_stats;
+
+// ============================================================
+// on_trans_done()
+//
+// esp_lcd color transfer complete (ISR context). Transfers
+// finish in the order they were queued, so each completion
+// frees the older of the two band buffers.
+// ============================================================
+static bool on_trans_done(esp_lcd_panel_io_handle_t io,
+                          esp_lcd_panel_io_event_data_t *edata, void *user_ctx) {
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(s_free, &woken);
+    return woken == pdTRUE;
+}
+
+// ============================================================
+// Dirty rectangle helpers
+// ============================================================
+static int32_t area(const display_rect_t *r) {
+    return (int32_t)r->w * r->h;
+}
+
+static display_rect_t rect_union(const display_rect_t *a, const display_rect_t *b) {
+    int x0 = a->x < b->x ? a->x : b->x;
+    int y0 = a->y < b->y ? a->y : b->y;
+    int x1 = (a->x + a->w) > (b->x + b->w) ? (a->x + a->w) : (b->x + b->w);
+    int y1 = (a->y + a->h) > (b->y + b->h) ? (a->y + a->h) : (b->y + b->h);
+    display_rect_t u = {(int16_t)x0, (int16_t)y0, (int16_t)(x1 - x0), (int16_t)(y1 - y0)};
+    return u;
+}
+
+static bool rect_touch(const display_rect_t *a, const display_rect_t *b) {
+    return a->x <= b->x + b->w && b->x <= a->x + a->w &&
+           a->y <= b->y + b->h && b->y <= a->y + a->h;
+}
+
+void display_invalidate(int x, int y, int w, int h) {
+    // --- Clip to the screen ---
+    if (x < 0) {
+        w += x;
+        x = 0;
+    }
+    if (y < 0) {
+        h += y;
+        y = 0;
+    }
+    if (x + w > DISPLAY_WIDTH) {
+        w = DISPLAY_WIDTH - x;
+    }
+    if (y + h > DISPLAY_HEIGHT) {
+        h = DISPLAY_HEIGHT - y;
+    }
+    if (w <= 0 || h <= 0) {
+        return;
+    }
+    display_rect_t r = {(int16_t)x, (int16_t)y, (int16_t)w, (int16_t)h};
+
+    // --- Merge with an overlapping / adjacent rectangle ---
+    // Repeat: the grown rectangle may now touch others.
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (int i = 0; i < s_dirty_count; i++) {
+            if (rect_touch(&r, &s_dirty[i])) {
+                r = rect_union(&r, &s_dirty[i]);
+                s_dirty[i] = s_dirty[--s_dirty_count];
+                merged = true;
+                break;
+            }
+        }
+    }
+
+    if (s_dirty_count < DISPLAY_MAX_DIRTY) {
+        s_dirty[s_dirty_count++] = r;
+        return;
+    }
+
+    // --- List full: merge where the union grows the least ---
+    int best = 0;
+    int32_t best_growth = INT32_MAX;
+    for (int i = 0; i < s_dirty_count; i++) {
+        display_rect_t u = rect_union(&r, &s_dirty[i]);
+        int32_t growth = area(&u) - area(&s_dirty[i]) - area(&r);
+        if (growth < best_growth) {
+            best_growth = growth;
+            best = i;
+        }
+    }
+    s_dirty[best] = rect_union(&r, &s_dirty[best]);
+}
+
+void display_invalidate_all(void) {
+    s_dirty_count = 0;
+    display_invalidate(0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT);
+}
+
+// ============================================================
+// draw_band_job()
+//
+// Arbiter job: queues one band's color DMA on the panel. The
+// transfer completes in the background (on_trans_done).
+// ============================================================
+typedef struct {
+    display_rect_t band;
+    const uint16_t *buf;
+} band_job_t;
+
+static esp_err_t draw_band_job(void *ctx) {
+    const band_job_t *j = (const band_job_t *)ctx;
+    return esp_lcd_panel_draw_bitmap(s_panel, j->band.x, j->band.y, j->band.x + j->band.w,
+                                     j->band.y + j->band.h, j->buf);
+}
+
+// ============================================================
+// display_flush()
+//
+// Steps (per band of each dirty rectangle):
+//   1. Take a free band buffer (blocks only while both are
+//      still being sent).
+//   2. Render the band into it.
+//   3. Hand it to the SPI arbiter, which queues it with
+//      esp_lcd_panel_draw_bitmap(); the transfer runs on DMA
+//      while the loop renders the next band. All bands of a
+//      flush share one deadline.
+// ============================================================
+esp_err_t display_flush(display_render_fn render, void *user) {
+    if (s_dirty_count == 0) {
+        return ESP_OK;
+    }
+    int64_t flush_start = esp_timer_get_time();
+    int64_t deadline_us = flush_start + (int64_t)SPI_ARB_DISPLAY_DEADLINE_MS * 1000;
+
+    for (int i = 0; i < s_dirty_count; i++) {
+        const display_rect_t *r = &s_dirty[i];
+        // Bands hold DISPLAY_BAND_LINES full-width rows, so
+        // narrower rectangles get proportionally taller bands.
+        int lines = BAND_PIXELS / r->w;
+        for (int y = r->y; y < r->y + r->h; y += lines) {
+            display_rect_t band = {r->x, (int16_t)y, r->w, (int16_t)lines};
+            if (band.y + band.h > r->y + r->h) {
+                band.h = (int16_t)(r->y + r->h - band.y);
+            }
+
+            // --- Step 1: Free buffer ---
+            int64_t t0 = esp_timer_get_time();
+            xSemaphoreTake(s_free, portMAX_DELAY);
+            int64_t t1 = esp_timer_get_time();
+            uint16_t *buf = s_band[s_next_band];
+            s_next_band ^= 1;
+
+            // --- Step 2: Render ---
+            render(user, &band, buf);
+            int64_t t2 = esp_timer_get_time();
+
+            // --- Step 3: Queue DMA via the arbiter ---
+            band_job_t job = {band, buf};
+            spi_arb_req_t req;
+            spi_arb_req_job(&req, s_spi_dev, draw_band_job, &job, deadline_us);
+            esp_err_t err = spi_arb_run(&req);
+            if (err != ESP_OK) {
+                xSemaphoreGive(s_free);
+                s_dirty_count = 0;
+                return err;
+            }
+
+            s_stats.wait_us += (uint64_t)(t1 - t0);
+            s_stats.render_us += (uint64_t)(t2 - t1);
+            s_stats.bands++;
+            s_stats.pixels += (uint64_t)band.w * band.h;
+        }
+    }
+
+    s_dirty_count = 0;
+    s_stats.frames++;
+    s_stats.flush_us += (uint64_t)(esp_timer_get_time() - flush_start);
+    return ESP_OK;
+}
+
+void display_wait_idle(void) {
+    // Both buffers free == nothing left on the bus.
+    xSemaphoreTake(s_free, portMAX_DELAY);
+    xSemaphoreTake(s_free, portMAX_DELAY);
+    xSemaphoreGive(s_free);
+    xSemaphoreGive(s_free);
+}
+
+// ============================================================
+// display_init()
+// ============================================================
+esp_err_t display_init(void) {
+    spi_arb_device_config_t arb = {
+        .name = "display",
+        .cs = -1,                      // esp_lcd drives its own CS / DC.
+        .clock_hz = DISPLAY_SPI_HZ,
+        .priority = SPI_ARB_PRIO_DISPLAY,
+    };
+    s_spi_dev = spi_arb_add_device(&arb);
+    if (s_spi_dev < 0) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = spi_arb_init();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    s_free = xSemaphoreCreateCounting(2, 2);
+    for (int i = 0; i < 2; i++) {
+        s_band[i] = heap_caps_malloc(BAND_PIXELS * sizeof(uint16_t), MALLOC_CAP_DMA);
+        if (!s_band[i]) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    if (!s_free) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_lcd_panel_io_spi_config_t io_cfg = {
+        .cs_gpio_num = PIN_LCD_CS,
+        .dc_gpio_num = PIN_LCD_DC,
+        .spi_mode = 0,
+        .pclk_hz = DISPLAY_SPI_HZ,
+        .trans_queue_depth = 4,
+        .on_color_trans_done = on_trans_done,
+        .lcd_cmd_bits = 8,
+        .lcd_param_bits = 8,
+    };
+    err = esp_lcd_new_panel_io_spi((esp_lcd_spi_bus_handle_t)DISPLAY_SPI_HOST, &io_cfg, &s_io);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    esp_lcd_panel_dev_config_t panel_cfg = {
+        .reset_gpio_num = PIN_LCD_RST,
+        .rgb_ele_order = LCD_RGB_ELEMENT_ORDER_RGB,
+        .bits_per_pixel = 16,
+    };
+    err = esp_lcd_new_panel_st7789(s_io, &panel_cfg, &s_panel);
+    if (err != ESP_OK) {
+        return err;
+    }
+    esp_lcd_panel_reset(s_panel);
+    esp_lcd_panel_init(s_panel);
+    esp_lcd_panel_invert_color(s_panel, true);
+    esp_lcd_panel_disp_on_off(s_panel, true);
+
+    printf("[%s] %dx%d ST7789 @ %d Hz, 2 x %d-byte band buffers\n", TAG,
+           DISPLAY_WIDTH, DISPLAY_HEIGHT, DISPLAY_SPI_HZ,
+           (int)(BAND_PIXELS * sizeof(uint16_t)));
+    display_invalidate_all();
+    return ESP_OK;
+}
+
+const display_stats_t *display_stats(void) {
+    return &s_stats;
+}
+
+void display_reset_stats(void) {
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+
+#endif  // FEATURE_DISPLAY
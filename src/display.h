@@ -0,0 +1,78 @@
+#pragma once
+
+// ============================================================
+// display.h
+//
+// SPI TFT display engine with partial, band-buffered rendering
+// (FEATURE_DISPLAY).
+//
+// A full 240x240 RGB565 framebuffer is 115 KB — too much
+// internal SRAM for something DMA only reads once per frame.
+// Instead:
+//   - Callers mark what changed with display_invalidate(). Up to
+//     DISPLAY_MAX_DIRTY rectangles are kept; overlapping ones are
+//     merged, and when the list is full the new rectangle is
+//     merged into the one it grows the least.
+//   - display_flush() walks each dirty rectangle in bands of
+//     DISPLAY_BAND_LINES rows. The caller's render callback
+//     draws one band into a small DMA-capable buffer.
+//   - Two band buffers alternate: while SPI DMA sends band N,
+//     the CPU renders band N+1 into the other buffer. A buffer
+//     is only reused after its transfer-done callback.
+//
+// Panel: ST7789 over esp_lcd, RGB565 big-endian on the wire
+// (use DISPLAY_RGB565() to build pixel values).
+// ============================================================
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "app_config.h"
+
+// RGB565, byte-swapped for the panel's big-endian SPI order.
+#define DISPLAY_RGB565(r, g, b)                                                 \
+    ((uint16_t)((((r) & 0xF8) | ((g) >> 5)) |                                   \
+                (((((g) & 0x1C) << 3) | ((b) >> 3)) << 8)))
+
+typedef struct {
+    int16_t x;
+    int16_t y;
+    int16_t w;
+    int16_t h;
+} display_rect_t;
+
+// Draws the area (x, y, w, h) into pixels (w * h, row-major).
+typedef void (*display_render_fn)(void *user, const display_rect_t *area,
+                                  uint16_t *pixels);
+
+// --- Counters -----------------------------------------------
+typedef struct {
+    uint32_t frames;          // display_flush() calls with work.
+    uint32_t bands;
+    uint64_t pixels;
+    uint64_t render_us;       // CPU time in render callbacks.
+    uint64_t wait_us;         // Time blocked waiting for a free buffer.
+    uint64_t flush_us;        // Wall time inside display_flush().
+} display_stats_t;
+
+// --- Public functions ---------------------------------------
+
+// Registers with the SPI arbiter (shared PIN_SPI_* bus), brings
+// up the panel on PIN_LCD_* and allocates the two band buffers.
+esp_err_t display_init(void);
+
+// Marks an area as changed (clipped to the screen).
+void display_invalidate(int x, int y, int w, int h);
+void display_invalidate_all(void);
+
+// Renders and sends every dirty area, then clears the list.
+// Returns once the last band is queued; the final DMA transfer
+// may still be running (display_wait_idle() waits for it).
+esp_err_t display_flush(display_render_fn render, void *user);
+void display_wait_idle(void);
+
+const display_stats_t *display_stats(void);
+void display_reset_stats(void);
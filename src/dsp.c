@@ -0,0 +1,502 @@
+// ============================================================
+// dsp.c
+//
+// Scalar reference kernels plus ESP32-S3 PIE (SIMD) versions.
+// See dsp.h for the arithmetic each kernel implements.
+//
+// PIE notes:
+//   - q0..q7 are 128-bit vector registers (8 x int16).
+//   - EE.VLD.128.IP / EE.VST.128.IP load/store 16 aligned bytes
+//     and post-increment the pointer.
+//   - EE.VMUL.S16 multiplies lane-wise and shifts right by SAR.
+//   - EE.VMULAS.S16.ACCX multiply-accumulates all 8 lanes into
+//     the 40-bit ACCX register (read back with RUR.ACCX_0/1).
+//   - EE.VZIP.16 / EE.VUNZIP.16 interleave / de-interleave
+//     16-bit lanes, used for the 32 <-> 16 bit conversions.
+//   Loops are plain branch loops so the compiler's zero-overhead
+//   loop registers are left alone.
+// ============================================================
+
+#include "dsp.h"
+
+// stdio.h: printf() for the self-test report.
+#include <stdio.h>
+
+// string.h: memcpy(), memmove(), memset() for FIR state.
+#include <string.h>
+
+// build_profile.h: HOT_FN (IRAM in the release profile).
+#include "build_profile.h"
+
+#if defined(__XTENSA__)
+#include "sdkconfig.h"
+#endif
+
+#if DSP_USE_PIE && defined(__XTENSA__) && defined(CONFIG_IDF_TARGET_ESP32S3)
+#define DSP_HAVE_PIE 1
+#else
+#define DSP_HAVE_PIE 0
+#endif
+
+// esp_cpu.h: esp_cpu_get_cycle_count() for the self-test.
+#include "esp_cpu.h"
+
+static const char *TAG = "dsp";
+
+// ============================================================
+// sat16()
+//
+// Clamps a 32/64-bit intermediate to the int16 range.
+// ============================================================
+static inline int16_t sat16(int64_t v) {
+    if (v > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (v < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return (int16_t)v;
+}
+
+#if DSP_HAVE_PIE
+// ============================================================
+// simd_ok()
+//
+// True if every pointer is 16-byte aligned and n is a
+// non-zero multiple of 8 samples.
+// ============================================================
+static inline bool simd_ok(const void *a, const void *b, const void *c, size_t n) {
+    uintptr_t bits = (uintptr_t)a | (uintptr_t)b | (uintptr_t)c;
+    return n >= 8 && (n & 7) == 0 && (bits & 15) == 0;
+}
+
+static void gain_pie(const int16_t *x, int16_t *y, size_t n, int16_t gain, uint8_t shift) {
+    int16_t g = gain;
+    uint32_t sar = shift;
+    size_t blocks = n / 8;
+    __asm__ volatile(
+        "wsr.sar %[sh]\n"
+        "ee.vldbc.16 q1, %[g]\n"
+        "1:\n"
+        "ee.vld.128.ip q0, %[x], 16\n"
+        "ee.vmul.s16 q2, q0, q1\n"
+        "ee.vst.128.ip q2, %[y], 16\n"
+        "addi %[b], %[b], -1\n"
+        "bnez %[b], 1b\n"
+        : [x] "+r"(x), [y] "+r"(y), [b] "+r"(blocks)
+        : [g] "r"(&g), [sh] "r"(sar)
+        : "memory");
+}
+
+static void mix_pie(const int16_t *a, const int16_t *b, int16_t *y, size_t n,
+                    int16_t ga, int16_t gb) {
+    int16_t g[2] = {ga, gb};
+    uint32_t sar = 15;
+    size_t blocks = n / 8;
+    __asm__ volatile(
+        "wsr.sar %[sh]\n"
+        "ee.vldbc.16 q4, %[ga]\n"
+        "ee.vldbc.16 q5, %[gb]\n"
+        "1:\n"
+        "ee.vld.128.ip q0, %[a], 16\n"
+        "ee.vld.128.ip q1, %[b], 16\n"
+        "ee.vmul.s16 q2, q0, q4\n"
+        "ee.vmul.s16 q3, q1, q5\n"
+        "ee.vadds.s16 q2, q2, q3\n"
+        "ee.vst.128.ip q2, %[y], 16\n"
+        "addi %[n], %[n], -1\n"
+        "bnez %[n], 1b\n"
+        : [a] "+r"(a), [b] "+r"(b), [y] "+r"(y), [n] "+r"(blocks)
+        : [ga] "r"(&g[0]), [gb] "r"(&g[1]), [sh] "r"(sar)
+        : "memory");
+}
+
+// ============================================================
+// dot_pie()
+//
+// Signed dot product of blocks x 8 int16 pairs in ACCX.
+// 40-bit ACCX holds 256 full-scale products without overflow;
+// callers keep blocks <= 32.
+// ============================================================
+static int64_t HOT_FN dot_pie(const int16_t *a, const int16_t *b, size_t blocks) {
+    uint32_t lo, hi;
+    __asm__ volatile(
+        "ee.zero.accx\n"
+        "1:\n"
+        "ee.vld.128.ip q0, %[a], 16\n"
+        "ee.vld.128.ip q1, %[b], 16\n"
+        "ee.vmulas.s16.accx q0, q1\n"
+        "addi %[n], %[n], -1\n"
+        "bnez %[n], 1b\n"
+        "rur.accx_0 %[lo]\n"
+        "rur.accx_1 %[hi]\n"
+        : [a] "+r"(a), [b] "+r"(b), [n] "+r"(blocks), [lo] "=&r"(lo), [hi] "=&r"(hi)
+        :
+        : "memory");
+    return (int64_t)(((uint64_t)(int64_t)(int8_t)hi << 32) | lo);
+}
+
+static void s32_to_s16_pie(const int32_t *x, int16_t *y, size_t n) {
+    size_t blocks = n / 8;
+    __asm__ volatile(
+        "1:\n"
+        "ee.vld.128.ip q0, %[x], 16\n"
+        "ee.vld.128.ip q1, %[x], 16\n"
+        "ee.vunzip.16 q0, q1\n"       // q1 = upper halves, in order
+        "ee.vst.128.ip q1, %[y], 16\n"
+        "addi %[b], %[b], -1\n"
+        "bnez %[b], 1b\n"
+        : [x] "+r"(x), [y] "+r"(y), [b] "+r"(blocks)
+        :
+        : "memory");
+}
+
+static void s16_to_s32_pie(const int16_t *x, int32_t *y, size_t n) {
+    size_t blocks = n / 8;
+    __asm__ volatile(
+        "1:\n"
+        "ee.vld.128.ip q1, %[x], 16\n"
+        "ee.zero.q q0\n"
+        "ee.vzip.16 q0, q1\n"         // (0, x) pairs = x << 16
+        "ee.vst.128.ip q0, %[y], 16\n"
+        "ee.vst.128.ip q1, %[y], 16\n"
+        "addi %[b], %[b], -1\n"
+        "bnez %[b], 1b\n"
+        : [x] "+r"(x), [y] "+r"(y), [b] "+r"(blocks)
+        :
+        : "memory");
+}
+#endif  // DSP_HAVE_PIE
+
+// ============================================================
+// Gain / mix
+// ============================================================
+void dsp_gain_s16_ref(const int16_t *x, int16_t *y, size_t n, int16_t gain, uint8_t shift) {
+    for (size_t i = 0; i < n; i++) {
+        y[i] = sat16(((int32_t)x[i] * gain) >> shift);
+    }
+}
+
+void dsp_gain_s16(const int16_t *x, int16_t *y, size_t n, int16_t gain, uint8_t shift) {
+#if DSP_HAVE_PIE
+    if (simd_ok(x, y, y, n)) {
+        gain_pie(x, y, n, gain, shift);
+        return;
+    }
+#endif
+    dsp_gain_s16_ref(x, y, n, gain, shift);
+}
+
+void dsp_mix_s16_ref(const int16_t *a, const int16_t *b, int16_t *y, size_t n,
+                     int16_t ga, int16_t gb) {
+    for (size_t i = 0; i < n; i++) {
+        int32_t va = sat16(((int32_t)a[i] * ga) >> 15);
+        int32_t vb = sat16(((int32_t)b[i] * gb) >> 15);
+        y[i] = sat16(va + vb);
+    }
+}
+
+void dsp_mix_s16(const int16_t *a, const int16_t *b, int16_t *y, size_t n,
+                 int16_t ga, int16_t gb) {
+#if DSP_HAVE_PIE
+    if (simd_ok(a, b, y, n)) {
+        mix_pie(a, b, y, n, ga, gb);
+        return;
+    }
+#endif
+    dsp_mix_s16_ref(a, b, y, n, ga, gb);
+}
+
+// ============================================================
+// Level
+// ============================================================
+uint64_t dsp_sumsq_s16_ref(const int16_t *x, size_t n) {
+    uint64_t acc = 0;
+    for (size_t i = 0; i < n; i++) {
+        acc += (uint64_t)((int32_t)x[i] * x[i]);
+    }
+    return acc;
+}
+
+uint64_t dsp_sumsq_s16(const int16_t *x, size_t n) {
+#if DSP_HAVE_PIE
+    if (simd_ok(x, x, x, n)) {
+        uint64_t acc = 0;
+        while (n > 0) {
+            size_t chunk = n > 256 ? 256 : n;
+            acc += (uint64_t)dot_pie(x, x, chunk / 8);
+            x += chunk;
+            n -= chunk;
+        }
+        return acc;
+    }
+#endif
+    return dsp_sumsq_s16_ref(x, n);
+}
+
+uint16_t dsp_rms_s16(const int16_t *x, size_t n) {
+    if (n == 0) {
+        return 0;
+    }
+    uint32_t mean = (uint32_t)(dsp_sumsq_s16(x, n) / n);
+
+    // Bitwise integer square root.
+    uint32_t root = 0;
+    uint32_t bit = 1u << 30;
+    while (bit > mean) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (mean >= root + bit) {
+            mean -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint16_t)root;
+}
+
+// ============================================================
+// Format conversion
+// ============================================================
+void dsp_s32_to_s16_ref(const int32_t *x, int16_t *y, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        y[i] = (int16_t)(x[i] >> 16);
+    }
+}
+
+void dsp_s32_to_s16(const int32_t *x, int16_t *y, size_t n) {
+#if DSP_HAVE_PIE
+    if (simd_ok(x, y, y, n)) {
+        s32_to_s16_pie(x, y, n);
+        return;
+    }
+#endif
+    dsp_s32_to_s16_ref(x, y, n);
+}
+
+void dsp_s16_to_s32_ref(const int16_t *x, int32_t *y, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        y[i] = (int32_t)((uint32_t)(uint16_t)x[i] << 16);
+    }
+}
+
+void dsp_s16_to_s32(const int16_t *x, int32_t *y, size_t n) {
+#if DSP_HAVE_PIE
+    if (simd_ok(x, y, y, n)) {
+        s16_to_s32_pie(x, y, n);
+        return;
+    }
+#endif
+    dsp_s16_to_s32_ref(x, y, n);
+}
+
+// ============================================================
+// FIR
+// ============================================================
+bool dsp_fir_s16_init(dsp_fir_s16_t *f, const int16_t *coeffs, uint8_t taps) {
+    if (taps == 0 || taps > DSP_FIR_MAX_TAPS) {
+        return false;
+    }
+    memset(f, 0, sizeof(*f));
+    f->taps = taps;
+    memcpy(f->coeffs, coeffs, taps * sizeof(int16_t));
+
+    // bank[o][j] multiplies buf[A + j] where the window starts at
+    // A + o, i.e. tap h[K-1-(j-o)] for o <= j < o + K.
+    for (int o = 0; o < 8; o++) {
+        for (int j = 0; j < taps; j++) {
+            f->bank[o][o + j] = coeffs[taps - 1 - j];
+        }
+    }
+    return true;
+}
+
+void dsp_fir_s16_ref(dsp_fir_s16_t *f, const int16_t *x, int16_t *y, size_t n) {
+    int16_t *cur = f->buf + DSP_FIR_HIST;
+    memcpy(cur, x, n * sizeof(int16_t));
+    for (size_t i = 0; i < n; i++) {
+        int64_t acc = 0;
+        for (int k = 0; k < f->taps; k++) {
+            acc += (int32_t)f->coeffs[k] * cur[(int)i - k];
+        }
+        y[i] = sat16(acc >> 15);
+    }
+    memmove(f->buf, f->buf + n, DSP_FIR_HIST * sizeof(int16_t));
+}
+
+void HOT_FN dsp_fir_s16(dsp_fir_s16_t *f, const int16_t *x, int16_t *y, size_t n) {
+#if DSP_HAVE_PIE
+    int16_t *cur = f->buf + DSP_FIR_HIST;
+    memcpy(cur, x, n * sizeof(int16_t));
+    for (size_t i = 0; i < n; i++) {
+        size_t start = DSP_FIR_HIST + i - f->taps + 1;
+        size_t base = start & ~(size_t)7;
+        int64_t acc = dot_pie(f->buf + base, f->bank[start - base], DSP_FIR_BANK_LEN / 8);
+        y[i] = sat16(acc >> 15);
+    }
+    memmove(f->buf, f->buf + n, DSP_FIR_HIST * sizeof(int16_t));
+#else
+    dsp_fir_s16_ref(f, x, y, n);
+#endif
+}
+
+// ============================================================
+// Biquad
+// ============================================================
+void dsp_biquad_s16_init(dsp_biquad_s16_t *q, const int16_t coeffs_q14[5]) {
+    memset(q, 0, sizeof(*q));
+    q->b0 = coeffs_q14[0];
+    q->b1 = coeffs_q14[1];
+    q->b2 = coeffs_q14[2];
+    q->a1 = coeffs_q14[3];
+    q->a2 = coeffs_q14[4];
+}
+
+void HOT_FN dsp_biquad_s16(dsp_biquad_s16_t *q, const int16_t *x, int16_t *y, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        int64_t acc = (int64_t)q->b0 * x[i] + (int64_t)q->b1 * q->x1 +
+                      (int64_t)q->b2 * q->x2 - (int64_t)q->a1 * q->y1 -
+                      (int64_t)q->a2 * q->y2;
+        int16_t out = sat16(acc >> 14);
+        q->x2 = q->x1;
+        q->x1 = x[i];
+        q->y2 = q->y1;
+        q->y1 = out;
+        y[i] = out;
+    }
+}
+
+// ============================================================
+// Self-test / benchmark
+//
+// Steps:
+//   1. Fill aligned frames with pseudo-random full-scale data.
+//   2. For each kernel, time the dispatching version and the
+//      reference on the same input (cycle counter).
+//   3. Compare outputs and print cycles/sample + max |diff|.
+// ============================================================
+#define ST_N AUDIO_DMA_BUF_LEN
+
+static DSP_ALIGNED int16_t s_a[ST_N];
+static DSP_ALIGNED int16_t s_b[ST_N];
+static DSP_ALIGNED int16_t s_y1[ST_N];
+static DSP_ALIGNED int16_t s_y2[ST_N];
+static DSP_ALIGNED int32_t s_w[ST_N];
+static DSP_ALIGNED int32_t s_w2[ST_N];
+static dsp_fir_s16_t s_fir1;
+static dsp_fir_s16_t s_fir2;
+
+static int max_diff16(const int16_t *a, const int16_t *b, size_t n) {
+    int worst = 0;
+    for (size_t i = 0; i < n; i++) {
+        int d = a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+        if (d > worst) {
+            worst = d;
+        }
+    }
+    return worst;
+}
+
+static bool report(const char *name, uint32_t fast, uint32_t ref, int64_t diff) {
+    printf("[%s] %-10s %6.2f cyc/sample (ref %6.2f, x%.1f), max diff %lld\n", TAG,
+           name, (double)fast / ST_N, (double)ref / ST_N,
+           fast ? (double)ref / fast : 0.0, (long long)diff);
+    return diff <= 1;
+}
+
+bool dsp_selftest(void) {
+    bool ok = true;
+    uint32_t lcg = 1;
+    for (int i = 0; i < ST_N; i++) {
+        lcg = lcg * 1664525u + 1013904223u;
+        s_a[i] = (int16_t)(lcg >> 16);
+        lcg = lcg * 1664525u + 1013904223u;
+        s_b[i] = (int16_t)(lcg >> 16);
+        s_w[i] = (int32_t)lcg;
+    }
+    uint32_t t0, fast, ref;
+
+    printf("[%s] %d-sample frames, PIE %s\n", TAG, ST_N,
+           DSP_HAVE_PIE ? "enabled" : "not available (scalar only)");
+
+    // --- Gain (Q15, -6 dB) ---
+    t0 = esp_cpu_get_cycle_count();
+    dsp_gain_s16(s_a, s_y1, ST_N, 16384, 15);
+    fast = esp_cpu_get_cycle_count() - t0;
+    t0 = esp_cpu_get_cycle_count();
+    dsp_gain_s16_ref(s_a, s_y2, ST_N, 16384, 15);
+    ref = esp_cpu_get_cycle_count() - t0;
+    ok &= report("gain", fast, ref, max_diff16(s_y1, s_y2, ST_N));
+
+    // --- Mix (0.7 / 0.5, saturating) ---
+    t0 = esp_cpu_get_cycle_count();
+    dsp_mix_s16(s_a, s_b, s_y1, ST_N, 22938, 16384);
+    fast = esp_cpu_get_cycle_count() - t0;
+    t0 = esp_cpu_get_cycle_count();
+    dsp_mix_s16_ref(s_a, s_b, s_y2, ST_N, 22938, 16384);
+    ref = esp_cpu_get_cycle_count() - t0;
+    ok &= report("mix", fast, ref, max_diff16(s_y1, s_y2, ST_N));
+
+    // --- Sum of squares (RMS) ---
+    t0 = esp_cpu_get_cycle_count();
+    uint64_t sq1 = dsp_sumsq_s16(s_a, ST_N);
+    fast = esp_cpu_get_cycle_count() - t0;
+    t0 = esp_cpu_get_cycle_count();
+    uint64_t sq2 = dsp_sumsq_s16_ref(s_a, ST_N);
+    ref = esp_cpu_get_cycle_count() - t0;
+    ok &= report("rms", fast, ref, sq1 > sq2 ? (int64_t)(sq1 - sq2) : (int64_t)(sq2 - sq1));
+
+    // --- 32 -> 16 bit ---
+    t0 = esp_cpu_get_cycle_count();
+    dsp_s32_to_s16(s_w, s_y1, ST_N);
+    fast = esp_cpu_get_cycle_count() - t0;
+    t0 = esp_cpu_get_cycle_count();
+    dsp_s32_to_s16_ref(s_w, s_y2, ST_N);
+    ref = esp_cpu_get_cycle_count() - t0;
+    ok &= report("s32->s16", fast, ref, max_diff16(s_y1, s_y2, ST_N));
+
+    // --- 16 -> 32 bit ---
+    t0 = esp_cpu_get_cycle_count();
+    dsp_s16_to_s32(s_a, s_w, ST_N);
+    fast = esp_cpu_get_cycle_count() - t0;
+    t0 = esp_cpu_get_cycle_count();
+    dsp_s16_to_s32_ref(s_a, s_w2, ST_N);
+    ref = esp_cpu_get_cycle_count() - t0;
+    ok &= report("s16->s32", fast, ref, memcmp(s_w, s_w2, sizeof(s_w)) ? 2 : 0);
+
+    // --- FIR (24-tap low-pass-ish triangle) ---
+    int16_t taps[24];
+    for (int k = 0; k < 24; k++) {
+        taps[k] = (int16_t)((k < 12 ? k + 1 : 24 - k) * 200);
+    }
+    dsp_fir_s16_init(&s_fir1, taps, 24);
+    dsp_fir_s16_init(&s_fir2, taps, 24);
+    int worst = 0;
+    fast = ref = 0;
+    for (int pass = 0; pass < 2; pass++) {  // 2nd pass exercises history
+        t0 = esp_cpu_get_cycle_count();
+        dsp_fir_s16(&s_fir1, pass ? s_b : s_a, s_y1, ST_N);
+        fast += esp_cpu_get_cycle_count() - t0;
+        t0 = esp_cpu_get_cycle_count();
+        dsp_fir_s16_ref(&s_fir2, pass ? s_b : s_a, s_y2, ST_N);
+        ref += esp_cpu_get_cycle_count() - t0;
+        int d = max_diff16(s_y1, s_y2, ST_N);
+        worst = d > worst ? d : worst;
+    }
+    ok &= report("fir24", fast / 2, ref / 2, worst);
+
+    // --- Biquad (scalar on every target) ---
+    static const int16_t lp[5] = {491, 982, 491, -23826, 9405};  // 1 kHz Butterworth LP @ 16 kHz
+    dsp_biquad_s16_t bq;
+    dsp_biquad_s16_init(&bq, lp);
+    t0 = esp_cpu_get_cycle_count();
+    dsp_biquad_s16(&bq, s_a, s_y1, ST_N);
+    fast = esp_cpu_get_cycle_count() - t0;
+    report("biquad", fast, fast, 0);
+
+    printf("[%s] equivalence %s\n", TAG, ok ? "PASS" : "FAIL");
+    return ok;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+// ============================================================
+// dsp.h
+//
+// Fixed-point audio DSP kernels for the capture pipeline.
+//
+// Every kernel has a portable scalar reference (*_ref) that
+// defines the exact arithmetic. On the ESP32-S3 the public
+// function uses the PIE 128-bit SIMD unit (8 x int16 per
+// instruction) when DSP_USE_PIE is set and the buffers allow it:
+//   - pointers 16-byte aligned (use DSP_ALIGNED on buffers),
+//   - n a multiple of 8.
+// Anything else, and every non-S3 / host build, falls back to
+// the reference, so results never depend on the call site.
+//
+// PIE and reference results may differ by 1 LSB where the
+// hardware rounds differently (dsp_selftest reports the max
+// difference per kernel).
+//
+// The biquad is recursive (each output needs the previous one),
+// so it has no SIMD path for a single channel.
+//
+// PIE registers are per-task context: call from tasks, not ISRs.
+// ============================================================
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "app_config.h"
+
+#define DSP_ALIGNED __attribute__((aligned(16)))
+
+// --- Gain / mix ---------------------------------------------
+
+// y[i] = sat16((x[i] * gain) >> shift). shift 15 = Q15 gain.
+void dsp_gain_s16(const int16_t *x, int16_t *y, size_t n, int16_t gain, uint8_t shift);
+void dsp_gain_s16_ref(const int16_t *x, int16_t *y, size_t n, int16_t gain, uint8_t shift);
+
+// y[i] = sat16(sat16((a[i] * ga) >> 15) + sat16((b[i] * gb) >> 15)).
+void dsp_mix_s16(const int16_t *a, const int16_t *b, int16_t *y, size_t n,
+                 int16_t ga, int16_t gb);
+void dsp_mix_s16_ref(const int16_t *a, const int16_t *b, int16_t *y, size_t n,
+                     int16_t ga, int16_t gb);
+
+// --- Level --------------------------------------------------
+
+// Sum of x[i]^2 (exact, 64-bit).
+uint64_t dsp_sumsq_s16(const int16_t *x, size_t n);
+uint64_t dsp_sumsq_s16_ref(const int16_t *x, size_t n);
+
+// Integer RMS: floor(sqrt(sumsq / n)).
+uint16_t dsp_rms_s16(const int16_t *x, size_t n);
+
+// --- Format conversion --------------------------------------
+
+// I2S 32-bit slot -> int16 (upper half, truncating).
+void dsp_s32_to_s16(const int32_t *x, int16_t *y, size_t n);
+void dsp_s32_to_s16_ref(const int32_t *x, int16_t *y, size_t n);
+
+// int16 -> 32-bit slot (value << 16).
+void dsp_s16_to_s32(const int16_t *x, int32_t *y, size_t n);
+void dsp_s16_to_s32_ref(const int16_t *x, int32_t *y, size_t n);
+
+// --- FIR ----------------------------------------------------
+// Q15 taps, block processing with history kept between calls.
+//
+// SIMD trick: the window x[n-K+1 .. n] starts at any alignment,
+// so the taps are stored 8 times, pre-shifted by 0..7 samples
+// and zero padded to DSP_FIR_BANK_LEN. Every output is then one
+// aligned dot product of DSP_FIR_BANK_LEN samples.
+#define DSP_FIR_MAX_TAPS 32
+#define DSP_FIR_BANK_LEN (((DSP_FIR_MAX_TAPS + 7) + 7) & ~7)
+#define DSP_FIR_HIST ((DSP_FIR_MAX_TAPS + 7) & ~7)
+#define DSP_FIR_MAX_BLOCK AUDIO_DMA_BUF_LEN
+
+typedef struct {
+    uint8_t taps;
+    int16_t coeffs[DSP_FIR_MAX_TAPS];                   // Reference order.
+    DSP_ALIGNED int16_t bank[8][DSP_FIR_BANK_LEN];       // Shifted, reversed.
+    // History (DSP_FIR_HIST), current block, then zero slack
+    // read (and multiplied by zero taps) by the last dot product.
+    DSP_ALIGNED int16_t buf[DSP_FIR_HIST + DSP_FIR_MAX_BLOCK + DSP_FIR_BANK_LEN];
+} dsp_fir_s16_t;
+
+// Returns false if taps > DSP_FIR_MAX_TAPS.
+bool dsp_fir_s16_init(dsp_fir_s16_t *f, const int16_t *coeffs, uint8_t taps);
+
+// y[i] = sat16(sum_k h[k] * x[i-k] >> 15). n <= DSP_FIR_MAX_BLOCK.
+void dsp_fir_s16(dsp_fir_s16_t *f, const int16_t *x, int16_t *y, size_t n);
+void dsp_fir_s16_ref(dsp_fir_s16_t *f, const int16_t *x, int16_t *y, size_t n);
+
+// --- Biquad -------------------------------------------------
+// Direct form I, Q14 coefficients {b0, b1, b2, a1, a2} (a0 = 1):
+// y = (b0 x + b1 x1 + b2 x2 - a1 y1 - a2 y2) >> 14.
+typedef struct {
+    int16_t b0, b1, b2, a1, a2;
+    int16_t x1, x2, y1, y2;
+} dsp_biquad_s16_t;
+
+void dsp_biquad_s16_init(dsp_biquad_s16_t *q, const int16_t coeffs_q14[5]);
+void dsp_biquad_s16(dsp_biquad_s16_t *q, const int16_t *x, int16_t *y, size_t n);
+
+// --- Self-test ----------------------------------------------
+
+// Runs every kernel's SIMD and reference path on the same
+// pseudo-random frame, prints cycles per sample for both and
+// the max difference. Returns false on a mismatch > 1 LSB.
+bool dsp_selftest(void);
@@ -0,0 +1,401 @@
+// ============================================================
+// fake_broker.c
+//
+// Stand-in MQTT broker behind the fake modem's transparent
+// TCP link. See fake_broker.h.
+//
+// Behavior:
+//   - Reassembles MQTT packets byte by byte (fixed header,
+//     remaining length, body).
+//   - Keeps one persistent session: client id + up to
+//     FAKE_BROKER_MAX_SUBS topic filters.
+//   - Routes PUBLISH packets back to the client when they match
+//     one of its filters, so the driver can exercise its receive
+//     path against itself.
+// ============================================================
+
+#include "fake_broker.h"
+
+// stdio.h: printf() for debug logging to UART0 console.
+#include <stdio.h>
+
+// string.h: memcpy(), memcmp(), strlen() for session bookkeeping.
+#include <string.h>
+
+static const char *TAG = "fake_broker";
+
+// --- Limits -------------------------------------------------
+// Largest packet body the broker accepts (larger ones are dropped).
+#define FAKE_BROKER_PKT_MAX   512
+// Topic filters remembered per session.
+#define FAKE_BROKER_MAX_SUBS  4
+// Longest client id / topic filter stored.
+#define FAKE_BROKER_STR_MAX   64
+
+// --- Stored session (survives DISCONNECT) -------------------
+static struct {
+    bool valid;
+    char client_id[FAKE_BROKER_STR_MAX];
+    int sub_count;
+    char subs[FAKE_BROKER_MAX_SUBS][FAKE_BROKER_STR_MAX];
+    uint8_t sub_qos[FAKE_BROKER_MAX_SUBS];
+} s_session;
+
+// --- Current connection -------------------------------------
+static fake_broker_tx_fn s_tx;
+static uint8_t s_level;        // 4 or 5, from CONNECT.
+static bool s_clean;           // clean_session flag of this connection.
+static uint16_t s_next_id = 1; // Packet ids for broker -> client PUBLISH.
+
+// Packet reassembly.
+static int s_rx_state;         // 0 = header, 1 = length, 2 = body.
+static uint8_t s_rx_header;
+static uint32_t s_rx_remaining;
+static int s_rx_shift;
+static uint32_t s_rx_pos;
+static uint8_t s_rx_buf[FAKE_BROKER_PKT_MAX];
+
+// ============================================================
+// topic_matches()
+//
+// MQTT topic filter matching with '+' (one level) and '#'
+// (rest of the topic) wildcards.
+//
+// Inputs:
+//   filter — null-terminated subscription filter.
+//   topic  — topic bytes (not null-terminated), topic_len long.
+// ============================================================
+static bool topic_matches(const char *filter, const char *topic,
+                          size_t topic_len) {
+    size_t t = 0;
+    while (*filter != '\0') {
+        if (*filter == '#') {
+            return true;
+        }
+        if (*filter == '+') {
+            // Skip one level in the topic.
+            while (t < topic_len && topic[t] != '/') {
+                t++;
+            }
+            filter++;
+            continue;
+        }
+        if (t >= topic_len || *filter != topic[t]) {
+            // "a/#" also matches the parent "a".
+            return t == topic_len && filter[0] == '/' && filter[1] == '#';
+        }
+        filter++;
+        t++;
+    }
+    return t == topic_len;
+}
+
+// ============================================================
+// skip_props()
+//
+// Steps over an MQTT 5 property block (variable-length count,
+// then that many bytes) starting at *pos.
+//
+// Returns:
+//   false when the count is malformed or runs past len; the
+//   caller drops the packet.
+// ============================================================
+static bool skip_props(const uint8_t *p, size_t len, size_t *pos) {
+    uint32_t prop_len = 0;
+    int shift = 0;
+    for (;;) {
+        if (*pos >= len || shift > 21) {
+            return false;
+        }
+        uint8_t b = p[(*pos)++];
+        prop_len |= (uint32_t)(b & 0x7F) << shift;
+        shift += 7;
+        if ((b & 0x80) == 0) {
+            break;
+        }
+    }
+    if (prop_len > len - *pos) {
+        return false;
+    }
+    *pos += prop_len;
+    return true;
+}
+
+// ============================================================
+// send_packet()
+//
+// Builds fixed header + remaining length around body and sends it.
+// ============================================================
+static void send_packet(uint8_t header, const uint8_t *body, size_t len) {
+    uint8_t pkt[FAKE_BROKER_PKT_MAX + 5];
+    size_t pos = 0;
+    uint32_t rem = (uint32_t)len;
+
+    pkt[pos++] = header;
+    do {
+        uint8_t b = rem & 0x7F;
+        rem >>= 7;
+        pkt[pos++] = (uint8_t)(b | (rem ? 0x80 : 0));
+    } while (rem > 0);
+    memcpy(pkt + pos, body, len);
+    s_tx(pkt, pos + len);
+}
+
+// ============================================================
+// handle_connect()
+//
+// Parses CONNECT, restores or creates the session, and replies
+// with CONNACK.
+// ============================================================
+static void handle_connect(const uint8_t *p, size_t len) {
+    // Protocol name "MQTT" (2 + 4), level, flags, keepalive.
+    if (len < 10) {
+        return;
+    }
+    s_level = p[6];
+    s_clean = (p[7] & 0x02) != 0;
+    size_t pos = 10;
+    if (s_level >= 5 && !skip_props(p, len, &pos)) {
+        printf("[%s] dropped CONNECT (bad property length)\n", TAG);
+        return;
+    }
+    if (pos + 2 > len) {
+        return;
+    }
+    size_t id_len = (size_t)((p[pos] << 8) | p[pos + 1]);
+    pos += 2;
+    if (id_len >= FAKE_BROKER_STR_MAX || pos + id_len > len) {
+        id_len = 0;
+    }
+
+    bool same_client = s_session.valid &&
+                       strlen(s_session.client_id) == id_len &&
+                       memcmp(s_session.client_id, p + pos, id_len) == 0;
+    bool present = same_client && !s_clean;
+
+    if (!present) {
+        // New or clean session: forget old subscriptions.
+        memset(&s_session, 0, sizeof(s_session));
+        memcpy(s_session.client_id, p + pos, id_len);
+        s_session.valid = true;
+    }
+
+    printf("[%s] CONNECT \"%s\" v%u clean=%d -> session %s\n", TAG,
+           s_session.client_id, s_level, s_clean, present ? "present" : "new");
+
+    // CONNACK: ack flags, return/reason code, [v5 property length].
+    uint8_t ack[3] = {present ? 1 : 0, 0, 0};
+    send_packet(0x20, ack, s_level >= 5 ? 3 : 2);
+}
+
+// ============================================================
+// handle_subscribe()
+//
+// Stores each topic filter in the session and replies SUBACK.
+// ============================================================
+static void handle_subscribe(const uint8_t *p, size_t len) {
+    if (len < 2) {
+        return;
+    }
+    uint8_t ack[2 + 1 + FAKE_BROKER_MAX_SUBS];
+    size_t ack_len = 0;
+    ack[ack_len++] = p[0];
+    ack[ack_len++] = p[1];
+
+    size_t pos = 2;
+    if (s_level >= 5) {
+        if (!skip_props(p, len, &pos)) {
+            printf("[%s] dropped SUBSCRIBE (bad property length)\n", TAG);
+            return;
+        }
+        ack[ack_len++] = 0;  // SUBACK property length.
+    }
+
+    while (pos + 2 < len && ack_len < sizeof(ack)) {
+        size_t t_len = (size_t)((p[pos] << 8) | p[pos + 1]);
+        pos += 2;
+        if (pos + t_len + 1 > len) {
+            break;
+        }
+        uint8_t qos = p[pos + t_len] & 0x03;
+        if (qos > 1) {
+            qos = 1;  // Broker grants at most QoS 1.
+        }
+
+        if (t_len < FAKE_BROKER_STR_MAX &&
+            s_session.sub_count < FAKE_BROKER_MAX_SUBS) {
+            char *dst = s_session.subs[s_session.sub_count];
+            memcpy(dst, p + pos, t_len);
+            dst[t_len] = '\0';
+            s_session.sub_qos[s_session.sub_count] = qos;
+            s_session.sub_count++;
+            printf("[%s] SUBSCRIBE \"%s\" qos %u\n", TAG, dst, qos);
+            ack[ack_len++] = qos;
+        } else {
+            ack[ack_len++] = 0x80;  // Failure.
+        }
+        pos += t_len + 1;
+    }
+    send_packet(0x90, ack, ack_len);
+}
+
+// ============================================================
+// handle_publish()
+//
+// Acknowledges QoS1 publishes and routes matching ones back to
+// the client.
+// ============================================================
+static void handle_publish(uint8_t header, const uint8_t *p, size_t len) {
+    uint8_t qos = (header >> 1) & 0x03;
+    if (len < 2) {
+        return;
+    }
+    size_t t_len = (size_t)((p[0] << 8) | p[1]);
+    size_t pos = 2 + t_len;
+    if (pos > len) {
+        return;
+    }
+    const char *topic = (const char *)p + 2;
+
+    size_t id_pos = pos;
+    if (qos > 0) {
+        if (pos + 2 > len) {
+            return;
+        }
+        pos += 2;
+    }
+    if (s_level >= 5 && !skip_props(p, len, &pos)) {
+        printf("[%s] dropped PUBLISH (bad property length)\n", TAG);
+        return;
+    }
+    if (qos > 0) {
+        send_packet(0x40, p + id_pos, 2);
+    }
+
+    for (int i = 0; i < s_session.sub_count; i++) {
+        if (!topic_matches(s_session.subs[i], topic, t_len)) {
+            continue;
+        }
+        // Forward at min(publish qos, granted qos).
+        uint8_t out_qos = qos < s_session.sub_qos[i] ? qos : s_session.sub_qos[i];
+        uint8_t out[FAKE_BROKER_PKT_MAX];
+        size_t o = 0;
+        size_t payload_len = len - pos;
+        if (2 + t_len + 2 + 1 + payload_len > sizeof(out)) {
+            return;
+        }
+        out[o++] = p[0];
+        out[o++] = p[1];
+        memcpy(out + o, topic, t_len);
+        o += t_len;
+        if (out_qos > 0) {
+            out[o++] = (uint8_t)(s_next_id >> 8);
+            out[o++] = (uint8_t)(s_next_id & 0xFF);
+            if (++s_next_id == 0) {
+                s_next_id = 1;
+            }
+        }
+        if (s_level >= 5) {
+            out[o++] = 0;
+        }
+        memcpy(out + o, p + pos, payload_len);
+        o += payload_len;
+        send_packet((uint8_t)(0x30 | (out_qos << 1)), out, o);
+        return;  // Deliver once even if several filters overlap.
+    }
+}
+
+// ============================================================
+// handle_packet()
+//
+// Dispatches one reassembled packet.
+//
+// Returns:
+//   false when the client disconnected.
+// ============================================================
+static bool handle_packet(uint8_t header, const uint8_t *p, size_t len) {
+    switch (header & 0xF0) {
+    case 0x10:
+        handle_connect(p, len);
+        break;
+    case 0x30:
+        handle_publish(header, p, len);
+        break;
+    case 0x40:
+        // PUBACK for a message we forwarded; nothing to track.
+        break;
+    case 0x80:
+        handle_subscribe(p, len);
+        break;
+    case 0xC0: {
+        uint8_t none = 0;
+        send_packet(0xD0, &none, 0);
+        break;
+    }
+    case 0xE0:
+        printf("[%s] DISCONNECT (session %s)\n", TAG,
+               s_clean ? "dropped" : "kept");
+        if (s_clean) {
+            s_session.valid = false;
+        }
+        return false;
+    default:
+        printf("[%s] unsupported packet 0x%02x\n", TAG, header);
+        break;
+    }
+    return true;
+}
+
+// ============================================================
+// Public API
+// ============================================================
+void fake_broker_open(fake_broker_tx_fn tx) {
+    s_tx = tx;
+    s_level = 4;
+    s_clean = true;
+    s_rx_state = 0;
+}
+
+bool fake_broker_feed(uint8_t byte) {
+    switch (s_rx_state) {
+    case 0:
+        s_rx_header = byte;
+        s_rx_remaining = 0;
+        s_rx_shift = 0;
+        s_rx_state = 1;
+        break;
+
+    case 1:
+        s_rx_remaining |= (uint32_t)(byte & 0x7F) << s_rx_shift;
+        s_rx_shift += 7;
+        if ((byte & 0x80) == 0) {
+            s_rx_pos = 0;
+            if (s_rx_remaining == 0) {
+                s_rx_state = 0;
+                return handle_packet(s_rx_header, s_rx_buf, 0);
+            }
+            s_rx_state = 2;
+        } else if (s_rx_shift > 21) {
+            // More than 4 length bytes: drop it and resync on the
+            // next byte, like the client.
+            printf("[%s] dropped packet (malformed remaining length)\n", TAG);
+            s_rx_state = 0;
+        }
+        break;
+
+    case 2:
+        if (s_rx_pos < sizeof(s_rx_buf)) {
+            s_rx_buf[s_rx_pos] = byte;
+        }
+        s_rx_pos++;
+        if (s_rx_pos == s_rx_remaining) {
+            s_rx_state = 0;
+            if (s_rx_remaining <= sizeof(s_rx_buf)) {
+                return handle_packet(s_rx_header, s_rx_buf, s_rx_remaining);
+            }
+            printf("[%s] dropped oversize packet\n", TAG);
+        }
+        break;
+    }
+    return true;
+}
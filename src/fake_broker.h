@@ -0,0 +1,45 @@
+#pragma once
+
+// ============================================================
+// fake_broker.h
+//
+// Stand-in MQTT broker used by the fake modem.
+//
+// When the driver opens a transparent TCP connection
+// (AT+CIPOPEN ... -> CONNECT), the fake modem stops parsing AT
+// lines and feeds every received byte to fake_broker_feed().
+// The broker answers like a real one:
+//   CONNECT    -> CONNACK (session present if this client id
+//                 connected before with clean_session = 0)
+//   PUBLISH    -> PUBACK for QoS1, and delivery back to the
+//                 client if the topic matches its subscription
+//   SUBSCRIBE  -> SUBACK, subscription stored in the session
+//   PINGREQ    -> PINGRESP
+//   DISCONNECT -> connection closed, session kept
+//
+// Supports MQTT 3.1.1 and 5.0 framing (protocol level taken
+// from the CONNECT packet). One client at a time.
+// ============================================================
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Function the broker uses to send bytes back to the client.
+typedef void (*fake_broker_tx_fn)(const uint8_t *data, size_t len);
+
+// fake_broker_open()
+//
+// Starts a new TCP connection. Stored sessions survive across
+// connections, exactly like a real broker.
+void fake_broker_open(fake_broker_tx_fn tx);
+
+// fake_broker_feed()
+//
+// Feeds one byte received from the client.
+//
+// Returns:
+//   true while the connection stays open, false once the client
+//   sent DISCONNECT (the fake modem then reports CLOSED and
+//   returns to AT command mode).
+bool fake_broker_feed(uint8_t byte);
@@ -0,0 +1,217 @@
+// ============================================================
+// fake_coap_server.c
+//
+// Stand-in CoAP server for the fake modem's UDP socket.
+// See fake_coap_server.h for the resources it serves.
+//
+// Only the pieces the driver exercises are decoded: header,
+// token, Uri-Path, Block1/Block2. Responses always use a
+// piggybacked ACK.
+// ============================================================
+
+#include "fake_coap_server.h"
+
+// stdbool.h: bool flags for parsed options.
+#include <stdbool.h>
+
+// stdio.h: printf() for debug logging, snprintf() for the config body.
+#include <stdio.h>
+
+// string.h: memcpy(), memcmp() for parsing and building replies.
+#include <string.h>
+
+static const char *TAG = "fake_coap";
+
+// --- Limits -------------------------------------------------
+// Reassembly buffer for Block1 uploads.
+#define UPLOAD_MAX 2048
+// Size of the GET config document.
+#define CONFIG_DOC_BYTES 600
+
+// --- Block1 reassembly state --------------------------------
+static uint8_t s_upload[UPLOAD_MAX];
+static size_t s_upload_len;
+
+// --- Config document served with Block2 ---------------------
+static char s_config[CONFIG_DOC_BYTES + 1];
+static size_t s_config_len;
+
+// ============================================================
+// put_uint_option()
+//
+// Appends a uint option with up to 3 value bytes. Deltas up to
+// 268 are enough for the Block1/Block2 options used in replies.
+// ============================================================
+static size_t put_uint_option(uint8_t *out, uint16_t delta, uint32_t v) {
+    uint8_t be[3];
+    size_t len = 0;
+    for (int shift = 16; shift >= 0; shift -= 8) {
+        uint8_t b = (uint8_t)(v >> shift);
+        if (len > 0 || b != 0) {
+            be[len++] = b;
+        }
+    }
+    size_t pos = 0;
+    if (delta < 13) {
+        out[pos++] = (uint8_t)((delta << 4) | len);
+    } else {
+        out[pos++] = (uint8_t)((13 << 4) | len);
+        out[pos++] = (uint8_t)(delta - 13);
+    }
+    memcpy(out + pos, be, len);
+    return pos + len;
+}
+
+// ============================================================
+// fake_coap_server_handle()
+// ============================================================
+size_t fake_coap_server_handle(const uint8_t *req, size_t req_len,
+                               uint8_t *resp, size_t cap) {
+    if (req_len < 4 || (req[0] >> 6) != 1 || cap < 32) {
+        return 0;
+    }
+    uint8_t type = (req[0] >> 4) & 0x03;
+    uint8_t tkl = req[0] & 0x0F;
+    uint8_t code = req[1];
+    if (tkl > 8 || 4u + tkl > req_len) {
+        return 0;
+    }
+
+    // --- Options: Uri-Path (joined with '/'), Block1, Block2 ---
+    char path[64] = {0};
+    size_t path_len = 0;
+    bool has_b1 = false, has_b2 = false;
+    uint32_t b1 = 0, b2 = 0;
+    const uint8_t *payload = NULL;
+    size_t payload_len = 0;
+
+    size_t pos = 4 + tkl;
+    uint32_t opt = 0;
+    while (pos < req_len) {
+        if (req[pos] == 0xFF) {
+            payload = req + pos + 1;
+            payload_len = req_len - pos - 1;
+            break;
+        }
+        uint32_t delta = req[pos] >> 4;
+        uint32_t olen = req[pos] & 0x0F;
+        pos++;
+        if (delta == 13) {
+            delta = 13u + req[pos++];
+        } else if (delta == 14) {
+            delta = 269u + (uint32_t)((req[pos] << 8) | req[pos + 1]);
+            pos += 2;
+        }
+        if (olen == 13) {
+            olen = 13u + req[pos++];
+        }
+        if (pos + olen > req_len) {
+            return 0;
+        }
+        opt += delta;
+
+        if (opt == 11 && path_len + olen + 1 < sizeof(path)) {
+            if (path_len > 0) {
+                path[path_len++] = '/';
+            }
+            memcpy(path + path_len, req + pos, olen);
+            path_len += olen;
+        } else if (opt == 23 || opt == 27) {
+            uint32_t v = 0;
+            for (uint32_t i = 0; i < olen; i++) {
+                v = (v << 8) | req[pos + i];
+            }
+            if (opt == 23) {
+                has_b2 = true;
+                b2 = v;
+            } else {
+                has_b1 = true;
+                b1 = v;
+            }
+        }
+        pos += olen;
+    }
+
+    // NON telemetry: accept silently.
+    if (type == 1) {
+        printf("[%s] NON %s (%u bytes)\n", TAG, path, (unsigned)payload_len);
+        return 0;
+    }
+    if (type != 0) {
+        return 0;  // ACK/RST sent to a server: nothing to do.
+    }
+
+    // --- Reply header: ACK, same mid and token ---
+    size_t out = 0;
+    resp[out++] = (uint8_t)((1 << 6) | (2 << 4) | tkl);
+    size_t code_pos = out++;
+    resp[out++] = req[2];
+    resp[out++] = req[3];
+    memcpy(resp + out, req + 4, tkl);
+    out += tkl;
+
+    uint8_t reply = (4 << 5) | 4;  // 4.04 Not Found.
+
+    if (code == 2) {
+        // --- POST ---
+        if (!has_b1) {
+            printf("[%s] POST %s (%u bytes)\n", TAG, path, (unsigned)payload_len);
+            reply = (2 << 5) | 4;
+        } else {
+            uint32_t num = b1 >> 4;
+            bool more = (b1 & 0x08) != 0;
+            size_t bs = 1u << ((b1 & 0x07) + 4);
+            size_t offset = num * bs;
+            if (num == 0) {
+                s_upload_len = 0;
+            }
+            if (offset != s_upload_len || offset + payload_len > UPLOAD_MAX) {
+                // Out-of-order or oversize block.
+                reply = (4 << 5) | 8;
+            } else {
+                memcpy(s_upload + offset, payload, payload_len);
+                s_upload_len = offset + payload_len;
+                reply = more ? ((2 << 5) | 31) : ((2 << 5) | 4);
+                if (!more) {
+                    printf("[%s] POST %s reassembled %u bytes\n", TAG, path,
+                           (unsigned)s_upload_len);
+                }
+            }
+            // Echo Block1 (delta 27 from option 0).
+            out += put_uint_option(resp + out, 27, b1);
+        }
+    } else if (code == 1 && strcmp(path, "config") == 0) {
+        // --- GET config (Block2) ---
+        if (s_config_len == 0) {
+            for (int i = 0; s_config_len < CONFIG_DOC_BYTES - 32; i++) {
+                s_config_len += (size_t)snprintf(s_config + s_config_len,
+                                                 sizeof(s_config) - s_config_len,
+                                                 "param%02d=%d\n", i, i * 7);
+            }
+        }
+        uint32_t szx = has_b2 ? (b2 & 0x07) : 6;
+        uint32_t num = has_b2 ? (b2 >> 4) : 0;
+        size_t bs = 1u << (szx + 4);
+        size_t offset = num * bs;
+        size_t chunk = 0;
+        bool more = false;
+        if (offset < s_config_len) {
+            chunk = s_config_len - offset < bs ? s_config_len - offset : bs;
+            more = offset + chunk < s_config_len;
+        }
+        if (out + 8 + chunk > cap) {
+            return 0;
+        }
+        reply = (2 << 5) | 5;
+        // Content-Format text/plain (12, value 0 -> empty), then Block2 (23).
+        resp[out++] = (uint8_t)(12 << 4);
+        out += put_uint_option(resp + out, 23 - 12,
+                               (num << 4) | (more ? 8u : 0u) | szx);
+        resp[out++] = 0xFF;
+        memcpy(resp + out, s_config + offset, chunk);
+        out += chunk;
+    }
+
+    resp[code_pos] = reply;
+    return out;
+}
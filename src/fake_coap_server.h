@@ -0,0 +1,34 @@
+#pragma once
+
+// ============================================================
+// fake_coap_server.h
+//
+// Stand-in CoAP server behind the fake modem's UDP socket.
+//
+// Each datagram the driver sends with AT+CIPSEND is handed to
+// fake_coap_server_handle(); the returned response (if any) is
+// delivered back as a "+IPD" datagram.
+//
+// Resources:
+//   POST <any path>  -> 2.04 Changed (Block1 uploads reassembled,
+//                       2.31 Continue for intermediate blocks)
+//   GET  config      -> 2.05 Content, ~600-byte text document
+//                       served with Block2 at the client's size
+//   anything else    -> 4.04 Not Found
+//
+// CON requests get a piggybacked ACK; NON requests get no reply.
+// ============================================================
+
+#include <stddef.h>
+#include <stdint.h>
+
+// fake_coap_server_handle()
+//
+// Inputs:
+//   req, req_len — one received datagram.
+//   resp, cap    — output buffer for the reply.
+//
+// Returns:
+//   Reply length, or 0 when nothing should be sent back.
+size_t fake_coap_server_handle(const uint8_t *req, size_t req_len,
+                               uint8_t *resp, size_t cap);
@@ -0,0 +1,267 @@
+// ============================================================
+// fake_dtls_server.c
+//
+// Stand-in DTLS 1.2 + Connection ID server for the fake modem's
+// UDP socket. See fake_dtls_server.h.
+// ============================================================
+
+#include "fake_dtls_server.h"
+
+#if COAP_USE_DTLS
+
+// stdbool.h: association flags.
+#include <stdbool.h>
+
+// stdio.h: printf() for debug logging to UART0 console.
+#include <stdio.h>
+
+// string.h: memcpy(), memcmp(), strlen().
+#include <string.h>
+
+// esp_random.h: esp_fill_random() for the RNG callback and CID.
+#include "esp_random.h"
+
+// mbedTLS: the server end of the session, ticket keys.
+#include "mbedtls/ssl.h"
+#include "mbedtls/ssl_ticket.h"
+
+// The CoAP resources behind the session.
+#include "fake_coap_server.h"
+
+static const char *TAG = "fake_dtls";
+
+// --- Record layout (RFC 6347, RFC 9146) ---------------------
+#define REC_HANDSHAKE      22
+#define REC_CID            25
+#define REC_HDR_LEN        13    // type, version, epoch, sequence, length.
+#define REC_CID_OFFSET     11    // CID records: CID after the sequence.
+#define HS_CLIENT_HELLO    1
+
+// Tickets stay good for a day: longer than any sleep interval.
+#define TICKET_LIFETIME_S  86400
+
+static const int s_ciphersuites[] = {
+    MBEDTLS_TLS_PSK_WITH_AES_128_CCM_8,
+    0,
+};
+
+// Fixed ticket key: see fake_dtls_server.h.
+static const unsigned char s_ticket_name[4] = {'F', 'D', 'T', 'K'};
+static const unsigned char s_ticket_key[32] = "stand-in dtls ticket key, fixed";
+
+static struct {
+    bool ready;                       // mbedTLS set up.
+    bool established;                 // Handshake done.
+    uint16_t port;                    // Peer port of the association, 0 = none.
+    uint8_t flights;                  // Datagrams sent during the handshake.
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_config conf;
+    mbedtls_ssl_ticket_context ticket;
+    uint8_t own_cid[COAP_DTLS_CID_LEN > 0 ? COAP_DTLS_CID_LEN : 1];
+
+    // Datagram being processed and where replies go.
+    const uint8_t *in;
+    size_t in_len;
+    fake_dtls_emit_fn emit;
+    uint32_t timer_fin_ms;
+} s_srv;
+
+// Decrypted request / CoAP reply.
+static uint8_t s_plain[COAP_MSG_MAX];
+static uint8_t s_reply[COAP_MSG_MAX];
+
+// ============================================================
+// mbedTLS callbacks
+//
+// BIO:   one datagram in (the one being handled), each write
+//        out as one datagram.
+// Timer: never expires; see fake_dtls_server.h.
+// ============================================================
+static int bio_send(void *ctx, const unsigned char *buf, size_t len) {
+    (void)ctx;
+    if (!s_srv.established) {
+        s_srv.flights++;
+    }
+    s_srv.emit(buf, len);
+    return (int)len;
+}
+
+static int bio_recv(void *ctx, unsigned char *buf, size_t len) {
+    (void)ctx;
+    if (s_srv.in_len == 0) {
+        return MBEDTLS_ERR_SSL_WANT_READ;
+    }
+    size_t n = s_srv.in_len < len ? s_srv.in_len : len;
+    memcpy(buf, s_srv.in, n);
+    s_srv.in_len = 0;
+    return (int)n;
+}
+
+static void timer_set(void *ctx, uint32_t int_ms, uint32_t fin_ms) {
+    (void)ctx;
+    (void)int_ms;
+    s_srv.timer_fin_ms = fin_ms;
+}
+
+static int timer_get(void *ctx) {
+    (void)ctx;
+    return s_srv.timer_fin_ms == 0 ? -1 : 0;
+}
+
+static int rng(void *ctx, unsigned char *out, size_t len) {
+    (void)ctx;
+    esp_fill_random(out, len);
+    return 0;
+}
+
+// ============================================================
+// setup()
+//
+// One-time mbedTLS configuration, on the first datagram.
+// ============================================================
+static bool setup(void) {
+    mbedtls_ssl_init(&s_srv.ssl);
+    mbedtls_ssl_config_init(&s_srv.conf);
+    mbedtls_ssl_ticket_init(&s_srv.ticket);
+
+    const char *id = COAP_DTLS_PSK_IDENTITY;
+    const char *psk = COAP_DTLS_PSK;
+    if (mbedtls_ssl_config_defaults(&s_srv.conf, MBEDTLS_SSL_IS_SERVER,
+                                    MBEDTLS_SSL_TRANSPORT_DATAGRAM,
+                                    MBEDTLS_SSL_PRESET_DEFAULT) != 0 ||
+        mbedtls_ssl_conf_psk(&s_srv.conf, (const unsigned char *)psk, strlen(psk),
+                             (const unsigned char *)id, strlen(id)) != 0) {
+        return false;
+    }
+    mbedtls_ssl_conf_rng(&s_srv.conf, rng, NULL);
+    mbedtls_ssl_conf_ciphersuites(&s_srv.conf, s_ciphersuites);
+#if defined(MBEDTLS_SSL_DTLS_HELLO_VERIFY)
+    // No HelloVerifyRequest: the only client is on the loopback.
+    mbedtls_ssl_conf_dtls_cookies(&s_srv.conf, NULL, NULL, NULL);
+#endif
+#if COAP_DTLS_CID_LEN > 0
+    mbedtls_ssl_conf_cid(&s_srv.conf, COAP_DTLS_CID_LEN,
+                         MBEDTLS_SSL_UNEXPECTED_CID_IGNORE);
+#endif
+
+    if (mbedtls_ssl_ticket_setup(&s_srv.ticket, rng, NULL, MBEDTLS_CIPHER_AES_256_GCM,
+                                 TICKET_LIFETIME_S) != 0 ||
+        mbedtls_ssl_ticket_rotate(&s_srv.ticket, s_ticket_name, sizeof(s_ticket_name),
+                                  s_ticket_key, sizeof(s_ticket_key),
+                                  TICKET_LIFETIME_S) != 0) {
+        return false;
+    }
+    mbedtls_ssl_conf_session_tickets_cb(&s_srv.conf, mbedtls_ssl_ticket_write,
+                                        mbedtls_ssl_ticket_parse, &s_srv.ticket);
+
+    if (mbedtls_ssl_setup(&s_srv.ssl, &s_srv.conf) != 0) {
+        return false;
+    }
+    mbedtls_ssl_set_bio(&s_srv.ssl, NULL, bio_send, bio_recv, NULL);
+    mbedtls_ssl_set_timer_cb(&s_srv.ssl, NULL, timer_set, timer_get);
+    return true;
+}
+
+// Drops the current association and waits for a ClientHello on
+// port.
+static void new_association(uint16_t port) {
+    mbedtls_ssl_session_reset(&s_srv.ssl);
+#if COAP_DTLS_CID_LEN > 0
+    esp_fill_random(s_srv.own_cid, sizeof(s_srv.own_cid));
+    mbedtls_ssl_set_cid(&s_srv.ssl, MBEDTLS_SSL_CID_ENABLED, s_srv.own_cid,
+                        sizeof(s_srv.own_cid));
+#endif
+    s_srv.established = false;
+    s_srv.flights = 0;
+    s_srv.port = port;
+}
+
+// A record from a port the association was not made on is ours
+// only if it carries our CID.
+static bool has_our_cid(const uint8_t *dgram, size_t len) {
+#if COAP_DTLS_CID_LEN > 0
+    return dgram[0] == REC_CID && len >= REC_CID_OFFSET + COAP_DTLS_CID_LEN &&
+           memcmp(dgram + REC_CID_OFFSET, s_srv.own_cid, COAP_DTLS_CID_LEN) == 0;
+#else
+    (void)dgram;
+    (void)len;
+    return false;
+#endif
+}
+
+// ============================================================
+// fake_dtls_server_handle()
+//
+// Steps:
+//   1. Sort the datagram: new ClientHello, record from the
+//      association's port, CID record from a new port, or drop.
+//   2. Handshake in progress: let mbedTLS take it further.
+//   3. Established: decrypt every record in it, answer each
+//      request through the CoAP stand-in, encrypted.
+// ============================================================
+void fake_dtls_server_handle(uint16_t port, const uint8_t *dgram, size_t len,
+                             fake_dtls_emit_fn emit) {
+    if (!s_srv.ready) {
+        s_srv.ready = setup();
+        if (!s_srv.ready) {
+            printf("[%s] mbedTLS setup failed\n", TAG);
+            return;
+        }
+    }
+    if (len <= REC_HDR_LEN) {
+        return;  // Not even one record with a body.
+    }
+
+    // --- Step 1: Sort ---
+    bool hello = dgram[0] == REC_HANDSHAKE && dgram[3] == 0 && dgram[4] == 0 &&
+                 dgram[REC_HDR_LEN] == HS_CLIENT_HELLO;
+    bool moved = port != s_srv.port;
+    if (hello && (moved || s_srv.established)) {
+        new_association(port);
+    } else if (moved && !(s_srv.established && has_our_cid(dgram, len))) {
+        printf("[%s] dropped %u-byte record from port %u (no association)\n", TAG,
+               (unsigned)len, (unsigned)port);
+        return;
+    }
+    s_srv.in = dgram;
+    s_srv.in_len = len;
+    s_srv.emit = emit;
+
+    // --- Step 2: Handshake ---
+    if (!s_srv.established) {
+        int ret = mbedtls_ssl_handshake(&s_srv.ssl);
+        if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+            return;
+        }
+        if (ret != 0) {
+            printf("[%s] handshake failed: -0x%04x\n", TAG, (unsigned)-ret);
+            new_association(0);
+            return;
+        }
+        s_srv.established = true;
+        printf("[%s] handshake done with port %u: %s\n", TAG, (unsigned)port,
+               s_srv.flights == 1 ? "resumed from ticket" : "full");
+    }
+
+    // --- Step 3: Records ---
+    int n;
+    while ((n = mbedtls_ssl_read(&s_srv.ssl, s_plain, sizeof(s_plain))) > 0) {
+        if (moved) {
+            printf("[%s] CID record authenticated from port %u: association moved from %u\n",
+                   TAG, (unsigned)port, (unsigned)s_srv.port);
+            s_srv.port = port;
+            moved = false;
+        }
+        size_t r = fake_coap_server_handle(s_plain, (size_t)n, s_reply, sizeof(s_reply));
+        if (r > 0) {
+            mbedtls_ssl_write(&s_srv.ssl, s_reply, r);
+        }
+    }
+    if (n == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) {
+        printf("[%s] close_notify from port %u\n", TAG, (unsigned)port);
+        new_association(0);
+    }
+    s_srv.in_len = 0;
+}
+
+#endif  // COAP_USE_DTLS
@@ -0,0 +1,53 @@
+#pragma once
+
+// ============================================================
+// fake_dtls_server.h
+//
+// Stand-in DTLS 1.2 server in front of the stand-in CoAP server
+// (COAP_USE_DTLS). Terminates the session coap_dtls.c opens and
+// hands each decrypted request to fake_coap_server_handle().
+//
+// Same credentials and suite as the client: PSK
+// (COAP_DTLS_PSK_IDENTITY / COAP_DTLS_PSK),
+// TLS_PSK_WITH_AES_128_CCM_8, connection ID of
+// COAP_DTLS_CID_LEN bytes. One association at a time.
+//
+// Peer addresses (the link's local port stands in for the
+// device's NAT-mapped address):
+//   - A ClientHello from any port starts a new association.
+//   - Other records are accepted from the port the association
+//     was made on, or from a new port if they carry our CID;
+//     once one authenticates, the association moves to that
+//     port (RFC 9146, section 6).
+//   - Anything else is dropped, as a server keyed on addresses
+//     would after a NAT rebinding.
+//
+// Session tickets (RFC 5077) with a fixed ticket key, so a
+// ticket the device saved before deep sleep still resumes after
+// the chip (and with it this stand-in) restarts: the stand-in
+// plays a server whose uptime spans the device's sleep.
+//
+// No retransmission timer of its own: the client retransmits,
+// and a repeated flight makes mbedTLS resend the reply.
+// ============================================================
+
+#include "app_config.h"
+
+#if COAP_USE_DTLS
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Sends one datagram back to the device.
+typedef void (*fake_dtls_emit_fn)(const uint8_t *data, size_t len);
+
+// fake_dtls_server_handle()
+//
+// Inputs:
+//   port        — local port of the link the datagram came from.
+//   dgram, len  — one datagram from the device.
+//   emit        — called once per reply datagram.
+void fake_dtls_server_handle(uint16_t port, const uint8_t *dgram, size_t len,
+                             fake_dtls_emit_fn emit);
+
+#endif  // COAP_USE_DTLS
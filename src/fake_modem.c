@@ -12,19 +12,112 @@
 //   - Sends back a canned response on UART2 TX.
 //
 // Supported commands (case-sensitive):
-//   "AT"       -> responds "\r\nOK\r\n"
-//   "AT+CSQ"   -> responds "\r\n+CSQ: 20,99\r\nOK\r\n"
-//   anything   -> responds "\r\nERROR\r\n"
+//   "AT"           -> responds "\r\nOK\r\n"
+//   "AT+CSQ"       -> responds "\r\n+CSQ: 20,99\r\nOK\r\n"
+//   "AT+CIPMODE=n" -> responds "\r\nOK\r\n" (1 = transparent mode)
+//   "AT+NETOPEN"   -> responds "\r\nOK\r\n"
+//   "AT+CIPOPEN?"  -> one "+CIPOPEN: <link>" line per link, OK
+//   "AT+CIPOPEN*"  -> TCP, CIPMODE=1: responds "\r\nCONNECT 115200\r\n"
+//                     and switches to data mode: bytes go to the
+//                     stand-in MQTT broker (fake_broker.c) until it
+//                     disconnects, then "\r\nCLOSED\r\n" and back to
+//                     AT mode.
+//                     TCP, CIPMODE=0: OK, "+CIPOPEN: <link>,0" a
+//                     moment later (loopback echo peer).
+//                     UDP: responds "+CIPOPEN: <link>,0" and OK.
+//   "AT+CIPSEND*"  -> responds "\r\n>", reads <len> raw bytes, replies
+//                     OK and "+CIPSEND: <link>,<len>,<len>". In manual
+//                     receive mode the link's peer echoes them
+//                     ("+CIPRXGET: 1,<link>" when the link's buffer
+//                     was empty); otherwise they go to the stand-in
+//                     CoAP server (fake_coap_server.c), whose answer
+//                     is sent as "\r\n+IPD<n>\r\n<bytes>". With
+//                     COAP_USE_DTLS a stand-in DTLS server
+//                     (fake_dtls_server.c) sits in front of it.
+//   "AT+CIPRXGET=m" -> OK; 1 = manual receive, 0 = push ("+IPD")
+//   "AT+CIPRXGET=2,l,n"
+//                  -> "+CIPRXGET: 2,<l>,<read>,<rest>", the bytes, OK
+//                     (UDP: one datagram)
+//   "AT+CIPCLOSE*" -> responds OK and "+CIPCLOSE: <link>,0"
+//   "AT+CMGF=0"    -> OK (PDU mode; text mode is not simulated)
+//   "AT+CNMI=m,1*" -> OK; "+CMTI: "SM",<index>" for new messages
+//   "AT+CMGS=n"    -> responds "\r\n>", reads hex PDU text up to
+//                     Ctrl-Z, replies "+CMGS: <mr>" and OK. The
+//                     stand-in SMSC sends the message back as an
+//                     SMS-DELIVER into the store a moment later.
+//   "AT+CMGL=s"    -> every stored message with stat s (4 = all) as
+//                     "+CMGL: <index>,<stat>,,<len>" + PDU lines, OK;
+//                     unread ones become read
+//   "AT+CMGD=i[,f]"-> OK; deletes index i, or by flag (1 = all read)
+//   "AT+FRAME=1"   -> responds "\r\nCONNECT\r\n" and speaks frame_link
+//                     (framed, CRC-checked, windowed) until the host
+//                     sends DISC; the peer echoes every message.
+//   "AT+CGNSSPWR=n"-> OK; 1 powers the GNSS receiver ("+CGNSSPWR: READY!")
+//   "AT+CGNSSTST=n"-> OK; 1 sends the receiver's NMEA on this channel
+//   "AT+FCTEST=n,t"-> responds "\r\n>", stops reading for t ms, then
+//                     takes up to n bytes of FLOW_TEST_BYTE pattern
+//                     and replies "+FCTEST: <got>,<bad>" and OK
+//                     (flow-control overflow benchmark)
+//   "AT+STREAM=n"  -> responds "\r\nCONNECT\r\n", then n bytes of
+//                     FLOW_TEST_BYTE pattern and back to commands
+//                     (flash stress test)
+//   "AT+UARTERR=k[,n]"
+//                  -> OK; damages the answer to the next command:
+//                     k = 1 line noise in its first line (bytes at
+//                     a third of the baud rate), k = 2 n bytes of
+//                     "+FILL" lines ahead of it (overruns a
+//                     receiver that is not reading)
+//   "ATE0", "AT+CMEE=*", "AT+CPSMS=*", "AT+CEDRXS=*", "AT+CGDCONT=*"
+//                  -> responds "\r\nOK\r\n"
+//   "AT+CPIN?"     -> responds "\r\n+CPIN: READY\r\nOK\r\n"
+//   "AT+CEREG=n"   -> OK; n > 0 enables "+CEREG: <stat>" URCs
+//                     (n = 2 adds TAC / cell id)
+//   "AT+CEREG?"    -> responds "\r\n+CEREG: <n>,<stat>\r\nOK\r\n"
+//                     (registered, home, unless coverage was dropped)
+//   "AT+CGEREP=m*" -> OK; m > 0 enables "+CGEV: ..." URCs
+//   "AT+CGACT=s,1" -> OK, PDP context up a moment later
+//                     ("+CGEV: ME PDN ACT 1"); "+CME ERROR: 30"
+//                     when not registered. s = 0 deactivates.
+//   "AT+CGACT?"    -> responds "\r\n+CGACT: 1,<state>\r\nOK\r\n"
+//   anything       -> responds "\r\nERROR\r\n"
+//
+// Unsolicited:
+//   On start, "RDY" and "+CPIN: READY", like a real module boot.
+//   fake_modem_drop_coverage() makes the network drop the device
+//   ("+CEREG: 2", "+CGEV: NW PDN DEACT 1") and take it back
+//   ("+CEREG: 1") after the outage.
+//   fake_modem_close_peer() makes a loopback peer hang up
+//   ("+IPCLOSE: <link>,1").
+//   Echoed SMS arrive as "+CMTI: "SM",<index>"; three unread
+//   messages are already in the store at start.
+//   With GNSS powered and AT+CGNSSTST=1, one epoch per second:
+//   $GPGGA, $GPRMC and $GPGSV / $GLGSV for a moving fix.
+//
+// Flow control follows the host's (flow_default()): RTS/CTS, or
+// XON/XOFF with escaped binary data when the board has no
+// RTS/CTS wiring. fake_modem_set_flow_control() changes it.
 // ============================================================
 
 #include "fake_modem.h"
 
+// Stand-in MQTT broker for the transparent data mode.
+#include "fake_broker.h"
+
+// Stand-in CoAP server for UDP datagrams.
+#include "fake_coap_server.h"
+
+// Stand-in DTLS server in front of it (COAP_USE_DTLS).
+#include "fake_dtls_server.h"
+
 // stdio.h: printf() for debug logging to UART0 console.
 #include <stdio.h>
 
 // string.h: strcmp() to match AT commands, memset() to clear buffers.
 #include <string.h>
 
+// stdlib.h: strtoul() / atoi() for parsing command arguments.
+#include <stdlib.h>
+
 // FreeRTOS headers for creating the background task.
 // FreeRTOS.h must come before task.h.
 #include "freertos/FreeRTOS.h"
@@ -35,15 +128,217 @@
 // uart_driver_install(), uart_read_bytes(), uart_write_bytes().
 #include "driver/uart.h"
 
+// esp_intr_alloc.h: ESP_INTR_FLAG_IRAM for the UART interrupt.
+#include "esp_intr_alloc.h"
+
+// esp_timer.h: due times of scheduled network events.
+#include "esp_timer.h"
+
+// esp_heap_caps.h: framed link state while AT+FRAME=1 is on.
+#include "esp_heap_caps.h"
+
+// Framed link engine, shared with the host (modem_frame.c).
+#include "frame_link.h"
+
+// Flow-control modes and XON/XOFF escaping, shared with the host.
+#include "flow_ctl.h"
+
 // ESP-IDF logging tag — used in printf statements so you can
 // tell which module is printing.
 static const char *TAG = "fake_modem";
 
+// --- Task stack ---------------------------------------------
+// Line handling and UART calls fit in 4 KB; the stand-in DTLS
+// server's handshakes (COAP_USE_DTLS) run on this task too.
+#if COAP_USE_DTLS
+#define FAKE_MODEM_TASK_STACK 8192
+#else
+#define FAKE_MODEM_TASK_STACK 4096
+#endif
+
 // --- Line buffer --------------------------------------------
 // Holds the incoming AT command as bytes arrive one at a time.
 // 128 bytes is enough for any realistic AT command string.
 #define LINE_BUF_SIZE 128
 
+// --- Data mode ----------------------------------------------
+// true between CONNECT and CLOSED: bytes bypass the AT parser.
+static bool s_data_mode = false;
+
+// --- CIPSEND payload capture --------------------------------
+// After the '>' prompt, exactly s_send_need raw bytes follow.
+#define SEND_BUF_SIZE 1024
+static uint8_t s_send_buf[SEND_BUF_SIZE];
+static size_t s_send_need = 0;
+static size_t s_send_pos = 0;
+
+// --- Network state ------------------------------------------
+// Registered (stat 1) from the start, so the deep-sleep fast
+// path finds the modem attached. URC reporting is off until the
+// host enables it.
+static int s_cereg_n = 0;
+static int s_reg_stat = 1;
+static bool s_cgerep = false;
+static int s_pdp = 0;
+
+// PDP activation takes this long after AT+CGACT's OK.
+#define FAKE_MODEM_PDP_DELAY_MS 300
+
+// --- Scheduled network events -------------------------------
+// Changes the "network" makes on its own. Queued from any task,
+// applied (and reported as URCs) by the fake modem task when due.
+typedef enum {
+    EV_REG_STAT,              // arg: new +CEREG stat
+    EV_PDP,                   // arg: 1 = ME activation, 0 = NW deactivation
+    EV_LINK_UP,               // arg: link whose TCP connect completes
+    EV_PEER_CLOSE,            // arg: link the remote peer closes
+    EV_SMS_NEW                // arg: SMS store index of a new message
+} net_event_kind_t;
+
+typedef struct {
+    int64_t due_us;
+    uint8_t kind;             // net_event_kind_t
+    int8_t arg;
+} net_event_t;
+
+#define NET_EVENT_MAX 12
+static net_event_t s_events[NET_EVENT_MAX];
+static int s_event_count = 0;
+static portMUX_TYPE s_event_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// --- Multi-socket links -------------------------------------
+// Non-transparent links (AT+CIPMODE=0). Each remote peer is an
+// in-memory echo: what the host sends on a link comes back on the
+// same link. In manual receive mode (AT+CIPRXGET=1) the echo is
+// held here and announced with "+CIPRXGET: 1,<link>"; otherwise
+// UDP goes to the stand-in CoAP server as before.
+#define FAKE_MODEM_LINKS 4
+#define FAKE_LINK_RX 1024
+#define FAKE_LINK_DGRAMS 4
+#define FAKE_MODEM_CONNECT_DELAY_MS 150
+
+typedef struct {
+    bool open;
+    bool udp;
+    uint16_t port;                         // UDP: local port from CIPOPEN.
+    uint8_t rx[FAKE_LINK_RX];
+    size_t rx_len;
+    uint16_t dgram_len[FAKE_LINK_DGRAMS];  // UDP: datagram boundaries in rx.
+    int dgram_count;
+} fake_link_t;
+
+static fake_link_t s_links[FAKE_MODEM_LINKS];
+static int s_cipmode = 0;
+static bool s_rxget_manual = false;
+static int s_send_link = 0;
+
+// --- SMS store ("SM") ---------------------------------------
+// Stored as the hex PDUs a real modem lists. Three messages wait
+// from before the host started listening; every message the host
+// sends comes back from the stand-in SMSC as a new SMS-DELIVER
+// ("+CMTI" when due, if AT+CNMI enabled it).
+#define FAKE_SMS_SLOTS 10
+#define FAKE_SMS_PDU_HEX 400
+#define FAKE_SMS_DELAY_MS 200
+
+// SMSC address that prefixes every delivered PDU (+15551234567).
+#define FAKE_SMS_SCA "07915155214365F7"
+
+typedef struct {
+    bool used;
+    uint8_t stat;             // 0 REC UNREAD, 1 REC READ, 2 STO UNSENT, 3 STO SENT
+    char pdu[FAKE_SMS_PDU_HEX];
+} fake_sms_t;
+
+static fake_sms_t s_sms[FAKE_SMS_SLOTS];
+static bool s_cnmi = false;
+static uint8_t s_sms_mr = 0;
+
+// After the AT+CMGS prompt: hex PDU text up to Ctrl-Z, in
+// s_send_buf.
+static bool s_sms_capture = false;
+
+static const char *const s_sms_seed[] = {
+    // +4917012345678, GSM 7-bit with extension characters:
+    // "Hello {world}, 10€ for Ä!"
+    FAKE_SMS_SCA "040D91947110325476F80000620171800300801CC8329BFD066D50F7B79C4DDEA4"
+                 "58A0186C530699DF72D03604",
+    // Alphanumeric sender "Operator":
+    // "Your data plan renews on 01/11."
+    FAKE_SMS_SCA "040ED04F78591EA6BFE50000620171800300801FD9775D0E2287E961109C1D7683"
+                 "E46577F93E07BDDD2058EC158BB900",
+    // +8613800138000, UCS2: "温度 23°C"
+    FAKE_SMS_SCA "040D91683108108300F00008620171800300800E6E295EA600200032003300B00043",
+};
+
+// --- GNSS receiver ------------------------------------------
+// Once powered (AT+CGNSSPWR=1) and routed to the AT channel
+// (AT+CGNSSTST=1), the receiver reports once a second: GGA, RMC
+// and a GSV series, for a fix heading north at 18 knots.
+#define FAKE_GNSS_PERIOD_US 1000000
+
+static bool s_gnss_pwr = false;
+static bool s_gnss_out = false;
+static int64_t s_gnss_next_us = 0;
+static uint32_t s_gnss_epoch = 0;
+
+// Start of the track, in 1e-4 arc minutes: 48 07.0380 N,
+// 011 31.0000 E. Latitude grows 50 units (~9.3 m) per epoch.
+#define FAKE_GNSS_LAT0 (48 * 600000 + 70380)
+#define FAKE_GNSS_LON0 (11 * 600000 + 310000)
+#define FAKE_GNSS_LAT_STEP 50
+
+// Satellites in view: PRN, elevation, azimuth, SNR. The first
+// five are GPS (two GSV messages), the rest GLONASS (one).
+static const uint16_t s_gnss_sats[][4] = {
+    {3, 45, 120, 42}, {7, 62, 45, 45}, {11, 20, 300, 33}, {19, 38, 210, 38},
+    {28, 12, 80, 0},  {65, 55, 160, 40}, {72, 30, 20, 36},
+};
+#define FAKE_GNSS_GPS_SATS 5
+
+// --- Framed link --------------------------------------------
+// After AT+FRAME=1 the UART carries frame_link frames instead of
+// lines until the host sends DISC. The peer on the other end
+// echoes every message back. Bit errors for the benchmark are
+// set from another task and picked up by the fake modem task.
+#define FAKE_FRAME_POLL_MS 5
+
+static frame_link_t *s_frame = NULL;
+static volatile uint32_t s_frame_ber = 0;
+
+// --- Flow control -------------------------------------------
+// Under XON/XOFF, binary input (CIPSEND payloads, data and
+// framed mode) arrives escaped; s_rx_esc holds a FLOW_ESC until
+// its byte follows. The overflow test waits FAKE_FCTEST_IDLE_MS
+// of silence before it counts what got through.
+#define FAKE_FCTEST_IDLE_MS 200
+
+static flow_mode_t s_flow = FLOW_HW;
+static bool s_rx_esc = false;
+
+// --- Stream -------------------------------------------------
+// AT+STREAM leaves the host this long after CONNECT to finish
+// reading the answer (its reads wait up to 20 ms), so no
+// pattern byte lands in the AT response buffer.
+#define FAKE_STREAM_GAP_MS 50
+
+// Current line rate (fake_modem_set_baud_rate()).
+static uint32_t s_baud = FAKE_MODEM_BAUD;
+
+_Static_assert(FAKE_MODEM_TX_BUF >= MODEM_STRESS_BURST_BYTES,
+               "the TX ring must keep the line busy through the longest flash erase");
+
+// --- Line damage --------------------------------------------
+// Armed by AT+UARTERR for the next answer, for the host's UART
+// error recovery test.
+enum {
+    DAMAGE_NONE,
+    DAMAGE_NOISE,
+    DAMAGE_FLOOD
+};
+static int s_damage = DAMAGE_NONE;
+static size_t s_damage_bytes = 0;
+
 // ============================================================
 // send_response()
 //
@@ -53,16 +348,502 @@ static const char *TAG = "fake_modem";
 //   response — null-terminated C string to send (e.g. "\r\nOK\r\n")
 //
 // Outputs:
-//   Bytes are queued into the UART2 TX FIFO. The UART hardware
-//   shifts them out at FAKE_MODEM_BAUD. If hardware flow control
-//   is active, transmission pauses when CTS is deasserted.
+//   Bytes are queued into the UART2 TX ring; the driver ISR
+//   feeds them to the FIFO and the UART hardware shifts them out
+//   at the current baud rate. If hardware flow control is
+//   active, transmission pauses when CTS is deasserted.
 // ============================================================
 static void send_response(const char *response) {
     // strlen(response) gives the number of bytes to write.
-    // uart_write_bytes() blocks until all bytes are in the TX FIFO.
+    // uart_write_bytes() blocks until all bytes are in the TX ring.
     uart_write_bytes(FAKE_MODEM_UART_NUM, response, strlen(response));
 }
 
+// ============================================================
+// send_data()
+//
+// Binary counterpart of send_response(), used by the stand-in
+// broker while the link is in data mode. Escaped under XON/XOFF.
+// ============================================================
+static void send_data(const uint8_t *data, size_t len) {
+    flow_write(FAKE_MODEM_UART_NUM, data, len, s_flow);
+}
+
+// ============================================================
+// Network events
+// ============================================================
+static void schedule_event(uint32_t delay_ms, net_event_kind_t kind, int arg) {
+    portENTER_CRITICAL(&s_event_mux);
+    if (s_event_count < NET_EVENT_MAX) {
+        s_events[s_event_count++] = (net_event_t){
+            .due_us = esp_timer_get_time() + (int64_t)delay_ms * 1000,
+            .kind = (uint8_t)kind,
+            .arg = (int8_t)arg,
+        };
+    }
+    portEXIT_CRITICAL(&s_event_mux);
+}
+
+// "+CEREG: <stat>" URC, or the +CEREG? reply when query is true.
+static void format_cereg(char *out, size_t len, bool query) {
+    char prefix[8] = "";
+    if (query) {
+        snprintf(prefix, sizeof(prefix), "%d,", s_cereg_n);
+    }
+    bool registered = s_reg_stat == 1 || s_reg_stat == 5;
+    if (s_cereg_n == 2 && registered) {
+        snprintf(out, len, "\r\n+CEREG: %s%d,\"1A2B\",\"01A2B3C4\",7\r\n", prefix,
+                 s_reg_stat);
+    } else {
+        snprintf(out, len, "\r\n+CEREG: %s%d\r\n", prefix, s_reg_stat);
+    }
+}
+
+// Applies due events. Only called between AT commands.
+static void run_due_events(void) {
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < s_event_count;) {
+        portENTER_CRITICAL(&s_event_mux);
+        net_event_t ev = s_events[i];
+        bool due = ev.due_us <= now;
+        if (due) {
+            s_events[i] = s_events[--s_event_count];
+        }
+        portEXIT_CRITICAL(&s_event_mux);
+        if (!due) {
+            i++;
+            continue;
+        }
+
+        char urc[64];
+        switch (ev.kind) {
+            case EV_REG_STAT:
+                if (ev.arg != s_reg_stat) {
+                    s_reg_stat = ev.arg;
+                    if (s_cereg_n > 0) {
+                        format_cereg(urc, sizeof(urc), false);
+                        send_response(urc);
+                    }
+                }
+                break;
+            case EV_PDP:
+                if (ev.arg != s_pdp) {
+                    s_pdp = ev.arg;
+                    if (s_cgerep) {
+                        send_response(s_pdp ? "\r\n+CGEV: ME PDN ACT 1\r\n"
+                                            : "\r\n+CGEV: NW PDN DEACT 1\r\n");
+                    }
+                }
+                break;
+            case EV_LINK_UP:
+                snprintf(urc, sizeof(urc), "\r\n+CIPOPEN: %d,0\r\n", ev.arg);
+                send_response(urc);
+                break;
+            case EV_PEER_CLOSE:
+                if (ev.arg >= 0 && ev.arg < FAKE_MODEM_LINKS && s_links[ev.arg].open) {
+                    s_links[ev.arg].open = false;  // Unread data stays readable.
+                    snprintf(urc, sizeof(urc), "\r\n+IPCLOSE: %d,1\r\n", ev.arg);
+                    send_response(urc);
+                }
+                break;
+            case EV_SMS_NEW:
+                if (s_cnmi) {
+                    snprintf(urc, sizeof(urc), "\r\n+CMTI: \"SM\",%d\r\n", ev.arg);
+                    send_response(urc);
+                }
+                break;
+        }
+    }
+}
+
+// ============================================================
+// Link loopback
+// ============================================================
+
+// Queues echoed bytes on a link and announces them when the link
+// goes from empty to non-empty, like a real modem.
+static void link_push(int link, const uint8_t *data, size_t len) {
+    fake_link_t *k = &s_links[link];
+    bool was_empty = k->rx_len == 0;
+    if (k->udp) {
+        if (k->dgram_count == FAKE_LINK_DGRAMS || k->rx_len + len > FAKE_LINK_RX) {
+            return;  // Datagram dropped, as on a real modem.
+        }
+        k->dgram_len[k->dgram_count++] = (uint16_t)len;
+    } else if (len > FAKE_LINK_RX - k->rx_len) {
+        len = FAKE_LINK_RX - k->rx_len;
+    }
+    memcpy(k->rx + k->rx_len, data, len);
+    k->rx_len += len;
+
+    if (was_empty && k->rx_len > 0) {
+        char urc[32];
+        snprintf(urc, sizeof(urc), "\r\n+CIPRXGET: 1,%d\r\n", link);
+        send_response(urc);
+    }
+}
+
+// AT+CIPRXGET=2,<link>,<len>: header, bytes, OK. UDP returns one
+// datagram per read.
+static void link_read(int link, size_t max) {
+    fake_link_t *k = &s_links[link];
+    size_t consumed = k->rx_len < max ? k->rx_len : max;
+    size_t n = consumed;
+    if (k->udp) {
+        consumed = k->dgram_count ? k->dgram_len[0] : 0;
+        n = consumed < max ? consumed : max;
+    }
+
+    char hdr[48];
+    snprintf(hdr, sizeof(hdr), "\r\n+CIPRXGET: 2,%d,%u,%u\r\n", link, (unsigned)n,
+             (unsigned)(k->rx_len - consumed));
+    send_response(hdr);
+    send_data(k->rx, n);
+    send_response("\r\nOK\r\n");
+
+    memmove(k->rx, k->rx + consumed, k->rx_len - consumed);
+    k->rx_len -= consumed;
+    if (k->udp && k->dgram_count > 0) {
+        memmove(k->dgram_len, k->dgram_len + 1, (size_t)(--k->dgram_count) * sizeof(uint16_t));
+    }
+}
+
+// Pushes one datagram to the host as "+IPD".
+static void push_datagram(const uint8_t *data, size_t len) {
+    char hdr[24];
+    snprintf(hdr, sizeof(hdr), "\r\n+IPD%u\r\n", (unsigned)len);
+    send_response(hdr);
+    send_data(data, len);
+}
+
+// ============================================================
+// deliver_datagram()
+//
+// Reports the send result for one captured CIPSEND payload.
+// In manual receive mode the link's loopback peer echoes it;
+// otherwise it goes through the CoAP stand-in (behind the DTLS
+// stand-in with COAP_USE_DTLS, which is told the link's local
+// port as the peer address) and any reply datagram is pushed as
+// "+IPD".
+// ============================================================
+static void deliver_datagram(void) {
+    char hdr[48];
+
+    snprintf(hdr, sizeof(hdr), "\r\nOK\r\n\r\n+CIPSEND: %d,%u,%u\r\n",
+             s_send_link, (unsigned)s_send_pos, (unsigned)s_send_pos);
+    send_response(hdr);
+
+    if (s_rxget_manual) {
+        if (s_send_link >= 0 && s_send_link < FAKE_MODEM_LINKS &&
+            s_links[s_send_link].open) {
+            link_push(s_send_link, s_send_buf, s_send_pos);
+        }
+        return;
+    }
+
+#if COAP_USE_DTLS
+    uint16_t port = (s_send_link >= 0 && s_send_link < FAKE_MODEM_LINKS)
+                        ? s_links[s_send_link].port
+                        : 0;
+    fake_dtls_server_handle(port, s_send_buf, s_send_pos, push_datagram);
+#else
+    uint8_t reply[SEND_BUF_SIZE];
+    size_t n = fake_coap_server_handle(s_send_buf, s_send_pos, reply,
+                                       sizeof(reply));
+    if (n > 0) {
+        push_datagram(reply, n);
+    }
+#endif
+}
+
+// ============================================================
+// SMS store
+// ============================================================
+static int sms_store(uint8_t stat, const char *pdu) {
+    for (int i = 0; i < FAKE_SMS_SLOTS; i++) {
+        if (!s_sms[i].used) {
+            s_sms[i].used = true;
+            s_sms[i].stat = stat;
+            snprintf(s_sms[i].pdu, sizeof(s_sms[i].pdu), "%s", pdu);
+            return i;
+        }
+    }
+    return -1;  // Store full: the message is lost.
+}
+
+// Octet n of a hex PDU.
+static int hex_at(const char *pdu, size_t n) {
+    char tmp[3] = {pdu[2 * n], pdu[2 * n + 1], '\0'};
+    return (int)strtol(tmp, NULL, 16);
+}
+
+// ============================================================
+// sms_echo()
+//
+// Turns a captured SMS-SUBMIT into the SMS-DELIVER the stand-in
+// SMSC sends back: destination becomes originator; PID, DCS, UDH
+// flag and user data are kept; the SMSC time stamp is added.
+// Returns the store index, or -1.
+// ============================================================
+static int sms_echo(const char *submit) {
+    size_t len = strlen(submit);
+    size_t fo_at = 1 + (size_t)hex_at(submit, 0);       // After the SMSC.
+    if (2 * (fo_at + 4) > len) {
+        return -1;
+    }
+    int fo = hex_at(submit, fo_at);
+    if ((fo & 0x03) != 0x01) {
+        return -1;
+    }
+    size_t da_at = fo_at + 2;                           // After TP-MR.
+    size_t da_octets = 2 + ((size_t)hex_at(submit, da_at) + 1) / 2;
+    size_t pid_at = da_at + da_octets;
+    int vpf = (fo >> 3) & 0x03;
+    size_t udl_at = pid_at + 2 + (vpf == 2 ? 1 : vpf ? 7 : 0);
+    if (2 * udl_at >= len) {
+        return -1;
+    }
+
+    // Time stamp: 2026-10-17 from 08:00, following uptime, UTC+2.
+    int64_t t = esp_timer_get_time() / 1000000;
+    int hh = 8 + (int)(t / 3600 % 16);
+    int mm = (int)(t / 60 % 60);
+    int ss = (int)(t % 60);
+
+    char deliver[FAKE_SMS_PDU_HEX];
+    int n = snprintf(deliver, sizeof(deliver), "%s%02X%.*s%.*s620171%d%d%d%d%d%d80%s",
+                     FAKE_SMS_SCA, 0x04 | (fo & 0x40),
+                     (int)(2 * da_octets), submit + 2 * da_at,
+                     4, submit + 2 * pid_at,
+                     hh % 10, hh / 10, mm % 10, mm / 10, ss % 10, ss / 10,
+                     submit + 2 * udl_at);
+    if (n < 0 || (size_t)n >= sizeof(deliver)) {
+        return -1;
+    }
+    return sms_store(0, deliver);
+}
+
+// AT+CMGS payload complete (Ctrl-Z): accept it and queue the
+// echo.
+static void deliver_sms(void) {
+    s_send_buf[s_send_pos] = '\0';
+    if (s_send_pos < 2 || s_send_pos % 2 != 0) {
+        send_response("\r\n+CMS ERROR: 304\r\n");  // Invalid PDU parameter.
+        return;
+    }
+    char resp[40];
+    snprintf(resp, sizeof(resp), "\r\n+CMGS: %u\r\n\r\nOK\r\n", (unsigned)s_sms_mr++);
+    send_response(resp);
+
+    int index = sms_echo((const char *)s_send_buf);
+    if (index >= 0) {
+        schedule_event(FAKE_SMS_DELAY_MS, EV_SMS_NEW, index);
+    }
+}
+
+// ============================================================
+// GNSS output
+// ============================================================
+
+// Sends "$<body>*<checksum>\r\n".
+static void send_nmea(const char *body) {
+    uint8_t sum = 0;
+    for (const char *c = body; *c; c++) {
+        sum ^= (uint8_t)*c;
+    }
+    char line[100];
+    snprintf(line, sizeof(line), "$%s*%02X\r\n", body, sum);
+    send_response(line);
+}
+
+// ddmm.mmmm / dddmm.mmmm from 1e-4 arc minutes.
+static void format_coord(char *out, size_t len, int deg_digits, uint32_t min_e4) {
+    unsigned deg = min_e4 / 600000;
+    unsigned rest = min_e4 % 600000;
+    snprintf(out, len, "%0*u%02u.%04u", deg_digits, deg, rest / 10000, rest % 10000);
+}
+
+// One system's GSV series, four satellites per message. An SNR
+// of 0 is sent empty (in view, not tracked).
+static void send_gsv(char system, const uint16_t (*sats)[4], int count) {
+    int msgs = (count + 3) / 4;
+    for (int m = 0; m < msgs; m++) {
+        char body[96];
+        int pos = snprintf(body, sizeof(body), "G%cGSV,%d,%d,%02d", system, msgs, m + 1, count);
+        for (int i = m * 4; i < count && i < m * 4 + 4; i++) {
+            pos += snprintf(body + pos, sizeof(body) - (size_t)pos, ",%02u,%02u,%03u,",
+                            sats[i][0], sats[i][1], sats[i][2]);
+            if (sats[i][3] > 0) {
+                pos += snprintf(body + pos, sizeof(body) - (size_t)pos, "%02u", sats[i][3]);
+            }
+        }
+        send_nmea(body);
+    }
+}
+
+// One epoch of sentences when the next one is due.
+static void run_gnss(void) {
+    int64_t now = esp_timer_get_time();
+    if (!s_gnss_pwr || !s_gnss_out || now < s_gnss_next_us) {
+        return;
+    }
+    s_gnss_next_us = now + FAKE_GNSS_PERIOD_US;
+
+    uint32_t t = 12 * 3600 + s_gnss_epoch;  // UTC seconds of day.
+    char lat[16];
+    char lon[16];
+    format_coord(lat, sizeof(lat), 2, FAKE_GNSS_LAT0 + s_gnss_epoch * FAKE_GNSS_LAT_STEP);
+    format_coord(lon, sizeof(lon), 3, FAKE_GNSS_LON0);
+    s_gnss_epoch++;
+
+    char body[96];
+    snprintf(body, sizeof(body), "GPGGA,%02u%02u%02u.00,%s,N,%s,E,1,06,0.9,545.4,M,46.9,M,,",
+             (unsigned)(t / 3600 % 24), (unsigned)(t / 60 % 60), (unsigned)(t % 60), lat, lon);
+    send_nmea(body);
+    snprintf(body, sizeof(body), "GPRMC,%02u%02u%02u.00,A,%s,N,%s,E,018.0,000.0,171026,,,A",
+             (unsigned)(t / 3600 % 24), (unsigned)(t / 60 % 60), (unsigned)(t % 60), lat, lon);
+    send_nmea(body);
+
+    send_gsv('P', s_gnss_sats, FAKE_GNSS_GPS_SATS);
+    send_gsv('L', s_gnss_sats + FAKE_GNSS_GPS_SATS,
+             (int)(sizeof(s_gnss_sats) / sizeof(s_gnss_sats[0])) - FAKE_GNSS_GPS_SATS);
+}
+
+// ============================================================
+// Framed link
+// ============================================================
+static void frame_write(const uint8_t *data, size_t len, void *user) {
+    (void)user;
+    send_data(data, len);
+}
+
+// Echo peer. A message that cannot go back yet (window full)
+// stays undelivered, which holds back the host's sender.
+static bool frame_echo(const uint8_t *data, size_t len, void *user) {
+    (void)user;
+    if (!frame_link_can_send(s_frame)) {
+        return false;
+    }
+    frame_link_send(s_frame, data, len, esp_timer_get_time());
+    return true;
+}
+
+// One pass of the framed mode: read, run the link, leave framed
+// mode once the host disconnected.
+static void frame_poll(void) {
+    uint8_t buf[128];
+    int n = uart_read_bytes(FAKE_MODEM_UART_NUM, buf, sizeof(buf),
+                            pdMS_TO_TICKS(FAKE_FRAME_POLL_MS));
+    int64_t now = esp_timer_get_time();
+    if (s_frame->ber_ppm != s_frame_ber) {
+        frame_link_set_bit_errors(s_frame, s_frame_ber, 0xFA4E);
+    }
+    if (n > 0 && s_flow == FLOW_SW) {
+        n = (int)flow_unescape(buf, (size_t)n, &s_rx_esc);
+    }
+    if (n > 0) {
+        frame_link_rx(s_frame, buf, (size_t)n, now);
+    }
+    frame_link_tick(s_frame, now);
+    if (s_frame->peer_closed) {
+        printf("[%s] framed link closed: %lu frames in, %lu CRC errors, %lu resent\n", TAG,
+               (unsigned long)s_frame->stats.frames_rx, (unsigned long)s_frame->stats.crc_errors,
+               (unsigned long)(s_frame->stats.sack_resends + s_frame->stats.timeout_resends));
+        heap_caps_free(s_frame);
+        s_frame = NULL;
+    }
+}
+
+// ============================================================
+// flow_test()
+//
+// AT+FCTEST=<n>,<stall_ms>: after the prompt the host sends n
+// pattern bytes while this side does not read for stall_ms, as
+// a busy modem would. With flow control the host is held back;
+// without it everything past the RX ring and FIFO is lost, and
+// the bytes after a gap no longer match their position.
+// ============================================================
+static void flow_test(size_t n, uint32_t stall_ms) {
+    send_response("\r\n>");
+    vTaskDelay(pdMS_TO_TICKS(stall_ms));
+
+    uint8_t buf[128];
+    size_t got = 0;
+    size_t bad = 0;
+    bool esc = false;
+    while (got < n) {
+        int r = uart_read_bytes(FAKE_MODEM_UART_NUM, buf, sizeof(buf),
+                                pdMS_TO_TICKS(FAKE_FCTEST_IDLE_MS));
+        if (r <= 0) {
+            break;
+        }
+        size_t k = s_flow == FLOW_SW ? flow_unescape(buf, (size_t)r, &esc) : (size_t)r;
+        for (size_t i = 0; i < k; i++) {
+            bad += buf[i] != FLOW_TEST_BYTE(got + i);
+        }
+        got += k;
+    }
+
+    char resp[64];
+    snprintf(resp, sizeof(resp), "\r\n+FCTEST: %u,%u\r\n\r\nOK\r\n", (unsigned)got,
+             (unsigned)bad);
+    send_response(resp);
+}
+
+// ============================================================
+// stream_test()
+//
+// AT+STREAM=<n>: n pattern bytes back to back, as fast as the
+// line goes. They pass through the TX ring, which the driver's
+// IRAM ISR keeps draining while a flash operation holds this
+// task. The task keeps the ring full between erases, and the
+// ring holds a whole erase's worth at line rate
+// (MODEM_STRESS_BURST_BYTES): like an external modem, the sender
+// does not pause for the host's flash.
+// ============================================================
+static void stream_test(size_t n) {
+    send_response("\r\nCONNECT\r\n");
+    vTaskDelay(pdMS_TO_TICKS(FAKE_STREAM_GAP_MS));
+
+    uint8_t buf[256];
+    for (size_t sent = 0; sent < n;) {
+        size_t k = n - sent < sizeof(buf) ? n - sent : sizeof(buf);
+        for (size_t i = 0; i < k; i++) {
+            buf[i] = FLOW_TEST_BYTE(sent + i);
+        }
+        flow_write(FAKE_MODEM_UART_NUM, buf, k, s_flow);
+        sent += k;
+    }
+}
+
+// ============================================================
+// send_damage()
+//
+// Goes out ahead of the armed answer. Noise: the start of a
+// line, then zeros at a third of the baud rate, which the host
+// receives as framing errors / a break; the answer itself
+// follows intact. Flood: filler lines.
+// ============================================================
+static void send_damage(void) {
+    if (s_damage == DAMAGE_NOISE) {
+        static const uint8_t zeros[2] = {0, 0};
+        send_response("\r\n+CEREG: 0,");
+        uart_wait_tx_done(FAKE_MODEM_UART_NUM, pdMS_TO_TICKS(100));
+        uart_set_baudrate(FAKE_MODEM_UART_NUM, s_baud / 3);
+        uart_write_bytes(FAKE_MODEM_UART_NUM, zeros, sizeof(zeros));
+        uart_wait_tx_done(FAKE_MODEM_UART_NUM, pdMS_TO_TICKS(100));
+        uart_set_baudrate(FAKE_MODEM_UART_NUM, s_baud);
+    } else if (s_damage == DAMAGE_FLOOD) {
+        char fill[64];
+        for (size_t sent = 0; sent < s_damage_bytes; sent += strlen(fill)) {
+            snprintf(fill, sizeof(fill), "\r\n+FILL: %06u 0123456789ABCDEFGHIJKLMNOPQRSTUV\r\n",
+                     (unsigned)sent);
+            send_response(fill);
+        }
+    }
+    s_damage = DAMAGE_NONE;
+}
+
 // ============================================================
 // process_line()
 //
@@ -80,6 +861,11 @@ static void process_line(const char *line) {
     // Log what the fake modem received (shows up in serial monitor / Wokwi console).
     printf("[%s] received: \"%s\"\n", TAG, line);
 
+    // Armed line damage hits this answer.
+    if (s_damage != DAMAGE_NONE && strncmp(line, "AT+UARTERR=", 11) != 0) {
+        send_damage();
+    }
+
     // Match known AT commands and send canned responses.
     if (strcmp(line, "AT") == 0) {
         // "AT" is the basic attention command.
@@ -93,6 +879,245 @@ static void process_line(const char *line) {
         //   ber=99 means "not known or not detectable".
         send_response("\r\n+CSQ: 20,99\r\nOK\r\n");
 
+    } else if (strcmp(line, "ATE0") == 0 ||
+               strncmp(line, "AT+CMEE=", 8) == 0 ||
+               strncmp(line, "AT+CPSMS=", 9) == 0 ||
+               strncmp(line, "AT+CEDRXS=", 10) == 0 ||
+               strncmp(line, "AT+CGDCONT=", 11) == 0) {
+        // Echo / error format / power saving / APN: accepted.
+        send_response("\r\nOK\r\n");
+
+    } else if (strcmp(line, "AT+CPIN?") == 0) {
+        // SIM present, no PIN.
+        send_response("\r\n+CPIN: READY\r\nOK\r\n");
+
+    } else if (strncmp(line, "AT+CEREG=", 9) == 0) {
+        // URC reporting level: 0 off, 1 stat, 2 stat + location.
+        s_cereg_n = atoi(line + 9);
+        send_response("\r\nOK\r\n");
+
+    } else if (strcmp(line, "AT+CEREG?") == 0) {
+        // EPS registration: n, stat (1 = registered, home network).
+        char resp[64];
+        format_cereg(resp, sizeof(resp) - 8, true);
+        strcat(resp, "OK\r\n");
+        send_response(resp);
+
+    } else if (strncmp(line, "AT+CGEREP=", 10) == 0) {
+        // Packet domain event reporting (+CGEV).
+        s_cgerep = line[10] != '0';
+        send_response("\r\nOK\r\n");
+
+    } else if (strcmp(line, "AT+CGACT?") == 0) {
+        char resp[48];
+        snprintf(resp, sizeof(resp), "\r\n+CGACT: 1,%d\r\nOK\r\n", s_pdp);
+        send_response(resp);
+
+    } else if (strncmp(line, "AT+CGACT=", 9) == 0) {
+        // AT+CGACT=<state>,<cid>. Activation completes after the
+        // OK, like on a real network.
+        if (line[9] == '0') {
+            s_pdp = 0;
+            send_response(s_cgerep ? "\r\nOK\r\n\r\n+CGEV: ME PDN DEACT 1\r\n"
+                                   : "\r\nOK\r\n");
+        } else if (s_reg_stat != 1 && s_reg_stat != 5) {
+            send_response("\r\n+CME ERROR: 30\r\n");  // No network service.
+        } else {
+            send_response("\r\nOK\r\n");
+            schedule_event(FAKE_MODEM_PDP_DELAY_MS, EV_PDP, 1);
+        }
+
+    } else if (strcmp(line, "AT+FRAME=1") == 0) {
+        // Framed binary link until DISC.
+        s_frame = heap_caps_malloc(sizeof(*s_frame), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (s_frame == NULL) {
+            send_response("\r\nERROR\r\n");
+        } else {
+            frame_link_init(s_frame, frame_write, frame_echo, NULL);
+            s_rx_esc = false;
+            send_response("\r\nCONNECT\r\n");
+        }
+
+    } else if (strncmp(line, "AT+UARTERR=", 11) == 0) {
+        // Damage for the next answer.
+        const char *comma = strchr(line + 11, ',');
+        s_damage = atoi(line + 11);
+        s_damage_bytes = comma ? strtoul(comma + 1, NULL, 10) : 0;
+        send_response("\r\nOK\r\n");
+
+    } else if (strncmp(line, "AT+FCTEST=", 10) == 0) {
+        // Overflow benchmark: n bytes into a receiver that stalls.
+        const char *comma = strchr(line + 10, ',');
+        flow_test(strtoul(line + 10, NULL, 10), comma ? strtoul(comma + 1, NULL, 10) : 0);
+
+    } else if (strncmp(line, "AT+STREAM=", 10) == 0) {
+        // Receive throughput under flash operations.
+        stream_test(strtoul(line + 10, NULL, 10));
+
+    } else if (strncmp(line, "AT+CGNSSPWR=", 12) == 0) {
+        // Receiver power. Ready at once on the fake side.
+        s_gnss_pwr = line[12] == '1';
+        send_response(s_gnss_pwr ? "\r\nOK\r\n\r\n+CGNSSPWR: READY!\r\n" : "\r\nOK\r\n");
+
+    } else if (strncmp(line, "AT+CGNSSTST=", 12) == 0) {
+        // NMEA output on the AT channel; first epoch right away.
+        s_gnss_out = line[12] == '1';
+        s_gnss_next_us = 0;
+        send_response("\r\nOK\r\n");
+
+    } else if (strncmp(line, "AT+CMGF=", 8) == 0) {
+        // Only PDU mode is simulated.
+        send_response(line[8] == '0' ? "\r\nOK\r\n" : "\r\n+CMS ERROR: 303\r\n");
+
+    } else if (strncmp(line, "AT+CNMI=", 8) == 0) {
+        // AT+CNMI=<mode>,<mt>: mt 1 = store and send "+CMTI".
+        int mode = 0;
+        int mt = 0;
+        sscanf(line + 8, "%d,%d", &mode, &mt);
+        s_cnmi = mode > 0 && mt == 1;
+        send_response("\r\nOK\r\n");
+
+    } else if (strncmp(line, "AT+CMGS=", 8) == 0) {
+        // The PDU follows the prompt as hex text, ended by Ctrl-Z.
+        s_sms_capture = true;
+        s_send_pos = 0;
+        send_response("\r\n>");
+
+    } else if (strncmp(line, "AT+CMGL=", 8) == 0) {
+        // Every stored message with <stat> (4 = all) in one
+        // response. Listed unread messages become read.
+        int stat = atoi(line + 8);
+        char hdr[40];
+        send_response("\r\n");
+        for (int i = 0; i < FAKE_SMS_SLOTS; i++) {
+            fake_sms_t *m = &s_sms[i];
+            if (!m->used || (stat != 4 && m->stat != stat)) {
+                continue;
+            }
+            size_t tpdu = strlen(m->pdu) / 2 - 1 - (size_t)hex_at(m->pdu, 0);
+            snprintf(hdr, sizeof(hdr), "+CMGL: %d,%d,,%u\r\n", i, m->stat, (unsigned)tpdu);
+            send_response(hdr);
+            send_response(m->pdu);
+            send_response("\r\n");
+            if (m->stat == 0) {
+                m->stat = 1;
+            }
+        }
+        send_response("\r\nOK\r\n");
+
+    } else if (strncmp(line, "AT+CMGD=", 8) == 0) {
+        // AT+CMGD=<index>[,<delflag>]: 0 that index, 1 all read,
+        // 2 read + sent, 3 read + sent + unsent, 4 all.
+        int index = atoi(line + 8);
+        const char *comma = strchr(line + 8, ',');
+        int flag = comma ? atoi(comma + 1) : 0;
+        for (int i = 0; i < FAKE_SMS_SLOTS; i++) {
+            int st = s_sms[i].stat;
+            if (flag == 0 ? i == index
+                          : flag == 4 || st == 1 || (flag >= 2 && st == 3) ||
+                                (flag >= 3 && st == 2)) {
+                s_sms[i].used = false;
+            }
+        }
+        send_response("\r\nOK\r\n");
+
+    } else if (strncmp(line, "AT+CIPCLOSE=", 12) == 0) {
+        int link = atoi(line + 12);
+        if (link >= 0 && link < FAKE_MODEM_LINKS) {
+            s_links[link].open = false;
+            s_links[link].rx_len = 0;
+            s_links[link].dgram_count = 0;
+        }
+        char resp[48];
+        snprintf(resp, sizeof(resp), "\r\nOK\r\n\r\n+CIPCLOSE: %d,0\r\n", link);
+        send_response(resp);
+
+    } else if (strncmp(line, "AT+CIPMODE=", 11) == 0) {
+        // 1 = transparent (TCP becomes a CONNECT data session),
+        // 0 = link-based AT sockets.
+        s_cipmode = atoi(line + 11);
+        send_response("\r\nOK\r\n");
+
+    } else if (strcmp(line, "AT+NETOPEN") == 0) {
+        // PDP/network open. Nothing to set up on the fake side.
+        send_response("\r\nOK\r\n");
+
+    } else if (strcmp(line, "AT+CIPOPEN?") == 0) {
+        // One line per link the modem supports.
+        char resp[FAKE_MODEM_LINKS * 16 + 8];
+        size_t pos = 0;
+        for (int i = 0; i < FAKE_MODEM_LINKS; i++) {
+            pos += snprintf(resp + pos, sizeof(resp) - pos, "\r\n+CIPOPEN: %d", i);
+        }
+        snprintf(resp + pos, sizeof(resp) - pos, "\r\nOK\r\n");
+        send_response(resp);
+
+    } else if (strncmp(line, "AT+CIPRXGET=", 12) == 0) {
+        // 1 = hold received data (manual), 0 = push ("+IPD"),
+        // 2,<link>,<len> = read held data.
+        if (line[12] == '2') {
+            int link = -1;
+            unsigned max = 0;
+            if (sscanf(line + 12, "2,%d,%u", &link, &max) != 2 ||
+                link < 0 || link >= FAKE_MODEM_LINKS) {
+                send_response("\r\nERROR\r\n");
+            } else {
+                link_read(link, max);
+            }
+        } else {
+            s_rxget_manual = line[12] == '1';
+            send_response("\r\nOK\r\n");
+        }
+
+    } else if (strncmp(line, "AT+CIPOPEN=", 11) == 0 &&
+               (s_cipmode == 0 || strstr(line, "\"UDP\"") != NULL)) {
+        // Link-based socket. UDP is usable at once; TCP reports
+        // the connect result later, like a real handshake.
+        int link = atoi(line + 11);
+        bool udp = strstr(line, "\"UDP\"") != NULL;
+        char resp[48];
+        if (link < 0 || link >= FAKE_MODEM_LINKS || s_links[link].open) {
+            snprintf(resp, sizeof(resp), "\r\nOK\r\n\r\n+CIPOPEN: %d,4\r\n", link);
+            send_response(resp);
+        } else {
+            // UDP: AT+CIPOPEN=<link>,"UDP",,,<local port>
+            const char *lp = strrchr(line, ',');
+            s_links[link] = (fake_link_t){
+                .open = true,
+                .udp = udp,
+                .port = (udp && lp) ? (uint16_t)atoi(lp + 1) : 0,
+            };
+            if (udp) {
+                snprintf(resp, sizeof(resp), "\r\n+CIPOPEN: %d,0\r\n\r\nOK\r\n", link);
+                send_response(resp);
+            } else {
+                send_response("\r\nOK\r\n");
+                schedule_event(FAKE_MODEM_CONNECT_DELAY_MS, EV_LINK_UP, link);
+            }
+        }
+
+    } else if (strncmp(line, "AT+CIPSEND=", 11) == 0) {
+        // AT+CIPSEND=<link>,<len>[,"<host>",<port>]
+        const char *comma = strchr(line + 11, ',');
+        size_t len = comma ? strtoul(comma + 1, NULL, 10) : 0;
+        if (len == 0 || len > SEND_BUF_SIZE) {
+            send_response("\r\nERROR\r\n");
+        } else {
+            s_send_link = atoi(line + 11);
+            s_send_need = len;
+            s_send_pos = 0;
+            s_rx_esc = false;
+            send_response("\r\n>");
+        }
+
+    } else if (strncmp(line, "AT+CIPOPEN=", 11) == 0) {
+        // TCP open in transparent mode: every following byte is
+        // payload for the remote peer (our stand-in broker).
+        send_response("\r\nCONNECT 115200\r\n");
+        fake_broker_open(send_data);
+        s_data_mode = true;
+        s_rx_esc = false;
+
     } else {
         // Any unrecognized command gets a generic ERROR.
         send_response("\r\nERROR\r\n");
@@ -130,17 +1155,82 @@ static void fake_modem_task(void *arg) {
     uint8_t byte;
 
     while (1) {
+        // Framed mode reads in blocks and has timers to run.
+        if (s_frame != NULL) {
+            frame_poll();
+            continue;
+        }
+
         // Try to read exactly 1 byte from UART2 RX.
         // Timeout is 100ms (expressed in FreeRTOS ticks).
         // Returns the number of bytes actually read (0 or 1).
         int n = uart_read_bytes(FAKE_MODEM_UART_NUM, &byte, 1,
                                 pdMS_TO_TICKS(100));
 
+        // Network events and NMEA go out between commands, never
+        // inside a datagram capture or the TCP stream.
+        if (s_send_need == 0 && !s_sms_capture && !s_data_mode && line_pos == 0) {
+            run_due_events();
+            run_gnss();
+        }
+
         // If no byte was received within 100ms, loop back.
         if (n <= 0) {
             continue;
         }
 
+        // Binary payload arrives escaped under XON/XOFF.
+        if ((s_send_need > 0 || s_data_mode) && s_flow == FLOW_SW &&
+            !flow_unescape_byte(&byte, &s_rx_esc)) {
+            continue;
+        }
+
+        // After a CIPSEND prompt the byte is datagram payload.
+        if (s_send_need > 0) {
+            // The '\n' of the command's "\r\n" can trail the prompt.
+            if (s_send_pos == 0 && byte == '\n') {
+                continue;
+            }
+            s_send_buf[s_send_pos++] = byte;
+            if (s_send_pos == s_send_need) {
+                s_send_need = 0;
+                deliver_datagram();
+            }
+            continue;
+        }
+
+        // After an AT+CMGS prompt: hex PDU up to Ctrl-Z (send) or
+        // ESC (cancel).
+        if (s_sms_capture) {
+            if (byte == 0x1A) {
+                s_sms_capture = false;
+                deliver_sms();
+            } else if (byte == 0x1B) {
+                s_sms_capture = false;
+                send_response("\r\nOK\r\n");
+            } else if (byte != '\r' && byte != '\n' && s_send_pos < SEND_BUF_SIZE - 1) {
+                s_send_buf[s_send_pos++] = byte;
+            }
+            continue;
+        }
+
+        // In data mode the byte belongs to the TCP stream, not to
+        // an AT command line.
+        if (s_data_mode) {
+            if (!fake_broker_feed(byte)) {
+                s_data_mode = false;
+                send_response("\r\nCLOSED\r\n");
+            }
+            continue;
+        }
+
+        // A frame delimiter left over from the framed link: the
+        // next command starts clean.
+        if (byte == 0x00) {
+            line_pos = 0;
+            continue;
+        }
+
         // Check if this byte is a line terminator (\r or \n).
         if (byte == '\r' || byte == '\n') {
             // Only process if we have accumulated at least one character.
@@ -177,12 +1267,13 @@ static void fake_modem_task(void *arg) {
 //
 // Steps:
 //   1. Fill a uart_config_t struct with baud rate, word format,
-//      and hardware flow control mode.
+//      and hardware flow control mode (if the board has it).
 //   2. Apply that config to UART2 via uart_param_config().
 //   3. Assign physical GPIO pins to UART2's TX, RX, RTS, CTS
 //      signals via uart_set_pin().
 //   4. Install the UART2 driver with an RX ring buffer so
-//      incoming bytes are queued even if the task is busy.
+//      incoming bytes are queued even if the task is busy,
+//      then switch to XON/XOFF if the host did.
 //   5. Create the FreeRTOS background task that reads and
 //      responds to AT commands.
 //
@@ -190,6 +1281,9 @@ static void fake_modem_task(void *arg) {
 // Outputs: none (task runs in background after this returns)
 // ============================================================
 void fake_modem_start(void) {
+    // Same mode as the host: both ends of the same wires.
+    s_flow = flow_default();
+
     // --- Step 1: UART2 configuration struct ---
     // This struct tells the UART peripheral how to operate.
     uart_config_t uart_cfg = {
@@ -205,19 +1299,20 @@ void fake_modem_start(void) {
         // 1 stop bit per frame.
         .stop_bits = UART_STOP_BITS_1,
 
-        // Enable hardware (CTS/RTS) flow control.
-        // The UART peripheral will:
+        // Hardware (CTS/RTS) flow control, unless the board has
+        // no RTS/CTS wiring. The UART peripheral will:
         //   - Assert RTS when the RX FIFO has room (telling sender "go ahead").
         //   - Check CTS before transmitting (pausing if receiver says "wait").
-        .flow_ctrl = UART_HW_FLOWCTRL_CTS_RTS,
+        .flow_ctrl = s_flow == FLOW_HW ? UART_HW_FLOWCTRL_CTS_RTS : UART_HW_FLOWCTRL_DISABLE,
 
         // RX FIFO threshold for RTS assertion.
         // When the FIFO has more than this many bytes, RTS is deasserted
         // (tells the sender to stop). 122 of 128 is the ESP-IDF default.
         .rx_flow_ctrl_thresh = 122,
 
-        // Use the default reference clock.
-        .source_clk = UART_SCLK_DEFAULT,
+        // XTAL clock, like UART1: the baud rate must not move when
+        // power management scales the CPU / APB frequency.
+        .source_clk = UART_SCLK_XTAL,
     };
 
     // --- Step 2: Apply config to UART2 hardware ---
@@ -235,27 +1330,85 @@ void fake_modem_start(void) {
                  FAKE_MODEM_CTS_PIN); // UART2 CTS -> GPIO11
 
     // --- Step 4: Install UART2 driver ---
-    // Allocates an RX ring buffer of FAKE_MODEM_RX_BUF bytes.
-    // TX buffer size = 0 means uart_write_bytes() blocks until
-    // all bytes are pushed into the hardware FIFO.
-    // No event queue (NULL), no interrupt alloc flags (0).
+    // Allocates an RX ring buffer of FAKE_MODEM_RX_BUF bytes and
+    // a TX ring of FAKE_MODEM_TX_BUF: uart_write_bytes() returns
+    // once the bytes are in the ring, and the ISR feeds the FIFO
+    // from it. The ISR runs from IRAM, like the host's, so UART2
+    // keeps sending through flash operations.
+    // No event queue (NULL).
     uart_driver_install(FAKE_MODEM_UART_NUM,
-                        FAKE_MODEM_RX_BUF,  // RX ring buffer size
-                        0,                   // TX buffer size (0 = no SW buffer)
+                        FAKE_MODEM_RX_BUF,   // RX ring buffer size
+                        FAKE_MODEM_TX_BUF,   // TX ring buffer size
                         0,                   // Event queue size (0 = disabled)
                         NULL,                // Event queue handle (not used)
-                        0);                  // Interrupt alloc flags
+                        ESP_INTR_FLAG_IRAM); // Interrupt alloc flags
+
+    // XON/XOFF from the FIFO thresholds when there is no RTS/CTS.
+    flow_apply(FAKE_MODEM_UART_NUM, s_flow);
+
+    // Messages that arrived while the host was not listening.
+    for (size_t i = 0; i < sizeof(s_sms_seed) / sizeof(s_sms_seed[0]); i++) {
+        sms_store(0, s_sms_seed[i]);
+    }
+
+    // Boot URCs. UART1 is already listening, so they wait in its
+    // RX ring for the first reader.
+    send_response("\r\nRDY\r\n\r\n+CPIN: READY\r\n");
 
     // --- Step 5: Launch the background task ---
     // Creates a FreeRTOS task that loops forever reading UART2.
-    // Stack size: 4096 bytes (enough for the line buffer + UART calls).
+    // Stack size: FAKE_MODEM_TASK_STACK (line buffer + UART calls,
+    // and the DTLS stand-in's handshakes with COAP_USE_DTLS).
     // Priority: 5 (moderate; higher than idle, lower than critical tasks).
     // Task handle: NULL (we don't need to reference it later).
     printf("[%s] starting fake modem task on UART%d\n", TAG, FAKE_MODEM_UART_NUM);
     xTaskCreate(fake_modem_task,   // Task function pointer
                 "fake_modem",      // Task name (for debug/monitoring)
-                4096,              // Stack size in bytes
+                FAKE_MODEM_TASK_STACK, // Stack size in bytes
                 NULL,              // Argument passed to task (unused)
                 5,                 // Task priority
                 NULL);             // Task handle output (not needed)
 }
+
+// ============================================================
+// fake_modem_drop_coverage()
+// ============================================================
+void fake_modem_drop_coverage(uint32_t outage_ms) {
+    printf("[%s] dropping coverage for %lu ms\n", TAG, (unsigned long)outage_ms);
+    schedule_event(0, EV_REG_STAT, 2);
+    schedule_event(0, EV_PDP, 0);
+    schedule_event(outage_ms, EV_REG_STAT, 1);
+}
+
+// ============================================================
+// fake_modem_close_peer()
+// ============================================================
+void fake_modem_close_peer(int link, uint32_t delay_ms) {
+    schedule_event(delay_ms, EV_PEER_CLOSE, link);
+}
+
+// ============================================================
+// fake_modem_set_bit_errors()
+// ============================================================
+void fake_modem_set_bit_errors(uint32_t per_million) {
+    s_frame_ber = per_million;
+}
+
+// ============================================================
+// fake_modem_set_flow_control()
+// ============================================================
+void fake_modem_set_flow_control(flow_mode_t mode) {
+    uart_wait_tx_done(FAKE_MODEM_UART_NUM, pdMS_TO_TICKS(1000));
+    flow_apply(FAKE_MODEM_UART_NUM, mode);
+    s_flow = mode;
+    s_rx_esc = false;
+}
+
+// ============================================================
+// fake_modem_set_baud_rate()
+// ============================================================
+void fake_modem_set_baud_rate(uint32_t baud) {
+    uart_wait_tx_done(FAKE_MODEM_UART_NUM, pdMS_TO_TICKS(1000));
+    uart_set_baudrate(FAKE_MODEM_UART_NUM, baud);
+    s_baud = baud;
+}
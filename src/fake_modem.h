@@ -37,7 +37,20 @@
 // 256 is plenty for short AT commands like "AT\r\n":
 #define FAKE_MODEM_RX_BUF    256
 
-// --- Public function ----------------------------------------
+// --- TX buffer size -----------------------------------------
+// Written by the task, drained by the driver ISR, so sending goes
+// on while the task is held (flash operations). At least
+// MODEM_STRESS_BURST_BYTES (checked in fake_modem.c): the line
+// stays busy through the longest erase the stress test is sized
+// for, as an external modem's would.
+#define FAKE_MODEM_TX_BUF    16384
+
+#include <stdint.h>
+
+// flow_mode_t.
+#include "flow_ctl.h"
+
+// --- Public functions ---------------------------------------
 
 // fake_modem_start()
 //
@@ -45,8 +58,10 @@
 //
 // What it does:
 //   1. Configures UART2 with the pins and baud rate above.
-//   2. Enables hardware flow control (RTS/CTS) on UART2.
-//   3. Installs the UART2 driver with an RX ring buffer.
+//   2. Enables flow control on UART2: RTS/CTS, or XON/XOFF on
+//      boards without RTS/CTS wiring (flow_default()).
+//   3. Installs the UART2 driver with RX and TX ring buffers
+//      and its interrupt in IRAM.
 //   4. Creates a FreeRTOS task that loops forever, reading
 //      bytes from UART2 RX, looking for complete lines,
 //      and writing back AT responses on UART2 TX.
@@ -54,3 +69,41 @@
 // Inputs:  none
 // Outputs: none (the task runs in the background)
 void fake_modem_start(void);
+
+// fake_modem_drop_coverage()
+//
+// Simulates coverage loss: the network deregisters the device
+// ("+CEREG: 2") and tears down its PDP context
+// ("+CGEV: NW PDN DEACT 1"), then registers it again
+// ("+CEREG: 1") after outage_ms. The context stays down until the
+// host reactivates it. URCs only go out if the host enabled them
+// (AT+CEREG=1/2, AT+CGEREP=1/2).
+void fake_modem_drop_coverage(uint32_t outage_ms);
+
+// fake_modem_close_peer()
+//
+// Makes the loopback peer on a TCP link hang up after delay_ms:
+// the modem reports "+IPCLOSE: <link>,1"; data the host has not
+// read yet stays readable.
+void fake_modem_close_peer(int link, uint32_t delay_ms);
+
+// fake_modem_set_bit_errors()
+//
+// Flips bits in what the modem sends on the framed link
+// (AT+FRAME=1), per_million / 1e6 per bit, for the goodput
+// benchmark. Takes effect within a few milliseconds; 0 stops it.
+void fake_modem_set_bit_errors(uint32_t per_million);
+
+// fake_modem_set_flow_control()
+//
+// Switches UART2 to another flow-control mode, to match the host
+// (modem_set_flow_control()) for the overflow benchmark. Call
+// while no exchange is in progress.
+void fake_modem_set_flow_control(flow_mode_t mode);
+
+// fake_modem_set_baud_rate()
+//
+// Changes UART2's baud rate, to match the host
+// (modem_set_baud_rate()) for the flash stress test. Call while
+// no exchange is in progress.
+void fake_modem_set_baud_rate(uint32_t baud);
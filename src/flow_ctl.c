@@ -0,0 +1,108 @@
+// ============================================================
+// flow_ctl.c
+//
+// UART flow-control modes and XON/XOFF escaping. See flow_ctl.h.
+// ============================================================
+
+#include "flow_ctl.h"
+
+// esp_attr.h: IRAM_ATTR for the receive-side unescaping.
+#include "esp_attr.h"
+
+// RTS/CTS: deassert RTS above 122 of the 128 FIFO bytes (the
+// ESP-IDF default, as before).
+#define FLOW_HW_THRESH 122
+
+static bool needs_escape(uint8_t b) {
+    return b == FLOW_XON || b == FLOW_XOFF || b == FLOW_ESC;
+}
+
+flow_mode_t flow_default(void) {
+    if (MODEM_USE_HWFC && PIN_MODEM_RTS != INVALID_PIN && PIN_MODEM_CTS != INVALID_PIN) {
+        return FLOW_HW;
+    }
+    return FLOW_SW;
+}
+
+// ============================================================
+// flow_apply()
+//
+// The old mode goes off before the new one comes on, so the two
+// never run together on the same port.
+// ============================================================
+void flow_apply(uart_port_t port, flow_mode_t mode) {
+    uart_set_sw_flow_ctrl(port, false, 0, 0);
+    uart_set_hw_flow_ctrl(port, UART_HW_FLOWCTRL_DISABLE, 0);
+    if (mode == FLOW_HW) {
+        uart_set_hw_flow_ctrl(port, UART_HW_FLOWCTRL_CTS_RTS, FLOW_HW_THRESH);
+    } else if (mode == FLOW_SW) {
+        uart_set_sw_flow_ctrl(port, true, MODEM_SWFC_XON_THRESH, MODEM_SWFC_XOFF_THRESH);
+    }
+}
+
+// ============================================================
+// flow_write()
+//
+// Escapes through a small stack buffer: one uart_write_bytes()
+// per chunk rather than per byte.
+// ============================================================
+int flow_write(uart_port_t port, const uint8_t *data, size_t len, flow_mode_t mode) {
+    if (mode != FLOW_SW) {
+        return uart_write_bytes(port, data, len);
+    }
+    uint8_t out[64];
+    size_t o = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (needs_escape(data[i])) {
+            out[o++] = FLOW_ESC;
+            out[o++] = data[i] ^ 0x20;
+        } else {
+            out[o++] = data[i];
+        }
+        if (o >= sizeof(out) - 1 || i + 1 == len) {
+            if (uart_write_bytes(port, out, o) < 0) {
+                return -1;
+            }
+            o = 0;
+        }
+    }
+    return (int)len;
+}
+
+// Receive side in IRAM: it runs on every byte read, and right
+// after a flash operation the backlog the UART ISR kept storing
+// meanwhile has to go through it without cache misses.
+bool IRAM_ATTR flow_unescape_byte(uint8_t *b, bool *esc) {
+    if (*esc) {
+        *b ^= 0x20;
+        *esc = false;
+        return true;
+    }
+    if (*b == FLOW_ESC) {
+        *esc = true;
+        return false;
+    }
+    return true;
+}
+
+size_t IRAM_ATTR flow_unescape(uint8_t *buf, size_t n, bool *esc) {
+    size_t o = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint8_t b = buf[i];
+        if (flow_unescape_byte(&b, esc)) {
+            buf[o++] = b;
+        }
+    }
+    return o;
+}
+
+const char *flow_name(flow_mode_t mode) {
+    switch (mode) {
+        case FLOW_HW:
+            return "RTS/CTS";
+        case FLOW_SW:
+            return "XON/XOFF";
+        default:
+            return "none";
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+// ============================================================
+// flow_ctl.h
+//
+// Flow control on a modem UART, shared by both ends of the link
+// (modem.c on UART1, fake_modem.c on UART2).
+//
+// Modes:
+//   FLOW_HW    RTS/CTS. Needs both lines wired.
+//   FLOW_SW    XON/XOFF, for boards without RTS/CTS. The UART
+//              peripheral sends XOFF when its RX FIFO passes
+//              MODEM_SWFC_XOFF_THRESH bytes and XON once it is
+//              back under MODEM_SWFC_XON_THRESH; on receiving them
+//              it pauses / resumes its own transmitter. The IDF
+//              driver stops draining the FIFO while its RX ring
+//              is full, so the FIFO thresholds are reached exactly
+//              when the ring is: they act as the ring's high / low
+//              watermarks without any code on the receive path.
+//   FLOW_NONE  Neither (overflow benchmark only).
+//
+// With FLOW_SW the receiving UART strips XON / XOFF out of the
+// byte stream, so binary data (transparent and framed modes,
+// CIPSEND / +IPD payloads) is escaped on the wire: XON, XOFF and
+// FLOW_ESC go out as FLOW_ESC, byte ^ 0x20. AT text is never
+// escaped. Both ends must use the same mode.
+// ============================================================
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "driver/uart.h"
+
+#include "app_config.h"
+
+#define FLOW_XON 0x11
+#define FLOW_XOFF 0x13
+#define FLOW_ESC 0x7D
+
+// Overflow benchmark pattern (AT+FCTEST): every byte value in
+// turn, XON / XOFF / FLOW_ESC included, shifted each 256 bytes.
+#define FLOW_TEST_BYTE(i) ((uint8_t)((i) + ((i) >> 8)))
+
+typedef enum {
+    FLOW_NONE,
+    FLOW_HW,
+    FLOW_SW
+} flow_mode_t;
+
+// --- Public functions ---------------------------------------
+
+// Mode from the board profile: FLOW_HW when it sets
+// MODEM_USE_HWFC and wires both RTS and CTS, FLOW_SW otherwise.
+flow_mode_t flow_default(void);
+
+// Switches an installed UART driver to mode. Call with the port
+// idle: bytes in flight while the mode changes may be lost.
+void flow_apply(uart_port_t port, flow_mode_t mode);
+
+// Writes binary data, escaped when mode is FLOW_SW (blocking,
+// like uart_write_bytes()). Returns len, or -1 on a UART error.
+int flow_write(uart_port_t port, const uint8_t *data, size_t len, flow_mode_t mode);
+
+// Undoes the escaping on one received byte. *esc carries a
+// FLOW_ESC across calls. Returns false when the byte was the
+// escape itself (nothing to store).
+bool flow_unescape_byte(uint8_t *b, bool *esc);
+
+// Same over a received block, in place. Returns the new length.
+size_t flow_unescape(uint8_t *buf, size_t n, bool *esc);
+
+const char *flow_name(flow_mode_t mode);
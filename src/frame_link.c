@@ -0,0 +1,372 @@
+// ============================================================
+// frame_link.c
+//
+// COBS framing, CRC and selective-repeat ARQ. See frame_link.h.
+// ============================================================
+
+#include "frame_link.h"
+
+// string.h: memcpy() / memset() for slots and frames.
+#include <string.h>
+
+// esp_rom_crc.h: esp_rom_crc32_le() / esp_rom_crc16_le().
+#include "esp_rom_crc.h"
+
+// esp_attr.h: IRAM_ATTR for the receive fast path.
+#include "esp_attr.h"
+
+// build_profile.h: HOT_FN (IRAM in the release profile).
+#include "build_profile.h"
+
+// Frame types.
+enum {
+    FT_DATA,
+    FT_ACK,
+    FT_DISC,
+    FT_UA
+};
+
+// ============================================================
+// COBS
+// ============================================================
+
+// Encodes n bytes into out (at least n + n / 254 + 1 bytes).
+// Returns the encoded length, without the delimiter.
+static size_t HOT_FN cobs_encode(const uint8_t *in, size_t n, uint8_t *out) {
+    size_t code_at = 0;
+    size_t o = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < n; i++) {
+        if (in[i] == 0) {
+            out[code_at] = code;
+            code_at = o++;
+            code = 1;
+            continue;
+        }
+        out[o++] = in[i];
+        if (++code == 0xFF) {
+            out[code_at] = code;
+            code_at = o++;
+            code = 1;
+        }
+    }
+    out[code_at] = code;
+    return o;
+}
+
+// Decodes in place (the output is never longer than the input).
+// Returns the decoded length, or -1 for a malformed block.
+// IRAM, like frame_link_rx(); the CRC after it runs from ROM.
+static int IRAM_ATTR cobs_decode(uint8_t *buf, size_t n) {
+    size_t i = 0;
+    size_t o = 0;
+    while (i < n) {
+        uint8_t code = buf[i++];
+        if (code == 0 || i + code - 1 > n) {
+            return -1;
+        }
+        for (int k = 1; k < code; k++) {
+            buf[o++] = buf[i++];
+        }
+        if (code < 0xFF && i < n) {
+            buf[o++] = 0;
+        }
+    }
+    return (int)o;
+}
+
+static uint32_t frame_crc(const uint8_t *data, size_t len) {
+#if FRAME_CRC32
+    return esp_rom_crc32_le(0, data, (uint32_t)len);
+#else
+    return esp_rom_crc16_le(0, data, (uint32_t)len);
+#endif
+}
+
+// ============================================================
+// Output
+// ============================================================
+
+// xorshift32: cheap and repeatable, for bit-error injection.
+static uint32_t next_rand(frame_link_t *fl) {
+    uint32_t x = fl->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    fl->rng = x;
+    return x;
+}
+
+static void inject_errors(frame_link_t *fl, uint8_t *data, size_t len) {
+    uint64_t threshold = (uint64_t)fl->ber_ppm << 32;
+    for (size_t i = 0; i < len; i++) {
+        for (int bit = 0; bit < 8; bit++) {
+            if ((uint64_t)next_rand(fl) * 1000000 < threshold) {
+                data[i] ^= (uint8_t)(1u << bit);
+                fl->stats.bit_errors++;
+            }
+        }
+    }
+}
+
+// Bit n of the sack field: ack + 1 + n is held, out of order.
+static uint8_t sack_bits(const frame_link_t *fl) {
+    uint8_t bits = 0;
+    for (int n = 0; n < 8 && n < FRAME_WINDOW - 1; n++) {
+        if (fl->rx[(uint8_t)(fl->rx_next + 1 + n) % FRAME_WINDOW].used) {
+            bits |= (uint8_t)(1u << n);
+        }
+    }
+    return bits;
+}
+
+// Builds, encodes and writes one frame. Every frame carries the
+// current ack / sack, so an ACK is no longer due afterwards.
+static void send_frame(frame_link_t *fl, uint8_t type, uint8_t seq, const uint8_t *payload,
+                       size_t len) {
+    uint8_t raw[FRAME_RAW_MAX];
+    raw[0] = type;
+    raw[1] = seq;
+    raw[2] = fl->rx_next;
+    raw[3] = sack_bits(fl);
+    if (len > 0) {
+        memcpy(raw + FRAME_HEADER_BYTES, payload, len);
+    }
+    size_t n = FRAME_HEADER_BYTES + len;
+    uint32_t crc = frame_crc(raw, n);
+    for (int i = 0; i < FRAME_CRC_BYTES; i++) {
+        raw[n++] = (uint8_t)(crc >> (8 * i));
+    }
+
+    size_t w = cobs_encode(raw, n, fl->out);
+    fl->out[w++] = 0;
+    if (fl->ber_ppm > 0) {
+        inject_errors(fl, fl->out, w);
+    }
+    fl->write(fl->out, w, fl->user);
+    fl->ack_due = false;
+    fl->stats.frames_tx++;
+    fl->stats.wire_tx += (uint32_t)w;
+}
+
+static void resend(frame_link_t *fl, frame_tx_slot_t *slot, int64_t now_us) {
+    slot->sent_us = now_us;
+    slot->sent_order = ++fl->tx_count;
+    send_frame(fl, FT_DATA, slot->seq, slot->data, slot->len);
+}
+
+// ============================================================
+// Input
+// ============================================================
+
+// Cumulative ack frees the window up to ack; sack marks frames
+// the peer holds. A frame still missing that went out before
+// the newest acknowledged one was lost: resend it now rather
+// than at its timeout. Its new sent_order keeps later acks for
+// the same frames from resending it again.
+static void handle_ack(frame_link_t *fl, uint8_t ack, uint8_t sack, int64_t now_us) {
+    uint8_t in_flight = (uint8_t)(fl->tx_next - fl->tx_base);
+    uint8_t acked = (uint8_t)(ack - fl->tx_base);
+    if (acked > in_flight) {
+        return;  // Stale or bogus.
+    }
+    uint32_t newest = 0;
+    for (uint8_t seq = fl->tx_base; seq != ack; seq++) {
+        uint32_t order = fl->tx[seq % FRAME_WINDOW].sent_order;
+        newest = order > newest ? order : newest;
+    }
+    fl->tx_base = ack;
+    in_flight -= acked;
+
+    for (int n = 0; n < 8 && n + 1 < in_flight; n++) {
+        frame_tx_slot_t *slot = &fl->tx[(uint8_t)(ack + 1 + n) % FRAME_WINDOW];
+        if (sack & (1u << n)) {
+            slot->sacked = true;
+        }
+        if (slot->sacked && slot->sent_order > newest) {
+            newest = slot->sent_order;
+        }
+    }
+    for (uint8_t d = 0; d < in_flight; d++) {
+        frame_tx_slot_t *slot = &fl->tx[(uint8_t)(ack + d) % FRAME_WINDOW];
+        if (!slot->sacked && slot->sent_order < newest) {
+            fl->stats.sack_resends++;
+            resend(fl, slot, now_us);
+        }
+    }
+}
+
+// Hands in-order frames to the deliver callback until one is
+// missing or refused.
+static void deliver_ready(frame_link_t *fl) {
+    for (;;) {
+        frame_rx_slot_t *slot = &fl->rx[fl->rx_next % FRAME_WINDOW];
+        if (!slot->used || !fl->deliver(slot->data, slot->len, fl->user)) {
+            return;
+        }
+        fl->stats.payload_rx += slot->len;
+        slot->used = false;
+        fl->rx_next++;
+        fl->ack_due = true;
+    }
+}
+
+static void handle_data(frame_link_t *fl, uint8_t seq, const uint8_t *payload, size_t len) {
+    uint8_t d = (uint8_t)(seq - fl->rx_next);
+    fl->ack_due = true;  // Even a duplicate: our last ACK may be what got lost.
+    if (d >= FRAME_WINDOW) {
+        fl->stats.duplicates++;
+        return;
+    }
+    frame_rx_slot_t *slot = &fl->rx[seq % FRAME_WINDOW];
+    if (slot->used) {
+        fl->stats.duplicates++;
+        return;
+    }
+    memcpy(slot->data, payload, len);
+    slot->len = (uint16_t)len;
+    slot->used = true;
+    if (d > 0) {
+        fl->stats.out_of_order++;
+    }
+    deliver_ready(fl);
+}
+
+// One frame between delimiters: decode, check, dispatch.
+static void handle_frame(frame_link_t *fl, int64_t now_us) {
+    int n = cobs_decode(fl->in, fl->in_len);
+    if (n < FRAME_HEADER_BYTES + FRAME_CRC_BYTES) {
+        fl->stats.crc_errors++;
+        return;
+    }
+    size_t body = (size_t)n - FRAME_CRC_BYTES;
+    uint32_t rx_crc = 0;
+    for (int i = 0; i < FRAME_CRC_BYTES; i++) {
+        rx_crc |= (uint32_t)fl->in[body + i] << (8 * i);
+    }
+    if (rx_crc != frame_crc(fl->in, body)) {
+        fl->stats.crc_errors++;
+        return;
+    }
+    fl->stats.frames_rx++;
+    fl->silent = 0;
+
+    const uint8_t *h = fl->in;
+    size_t len = body - FRAME_HEADER_BYTES;
+    handle_ack(fl, h[2], h[3], now_us);
+    switch (h[0]) {
+        case FT_DATA:
+            if (len > 0 && len <= FRAME_PAYLOAD_MAX) {
+                handle_data(fl, h[1], h + FRAME_HEADER_BYTES, len);
+            }
+            break;
+        case FT_DISC:
+            fl->peer_closed = true;
+            send_frame(fl, FT_UA, 0, NULL, 0);
+            break;
+        case FT_UA:
+            fl->closed = true;
+            break;
+        default:
+            break;  // FT_ACK: header only.
+    }
+}
+
+// ============================================================
+// Public functions
+// ============================================================
+void frame_link_init(frame_link_t *fl, frame_write_fn write, frame_deliver_fn deliver,
+                     void *user) {
+    memset(fl, 0, sizeof(*fl));
+    fl->write = write;
+    fl->deliver = deliver;
+    fl->user = user;
+}
+
+bool frame_link_can_send(const frame_link_t *fl) {
+    return !fl->failed && (uint8_t)(fl->tx_next - fl->tx_base) < FRAME_WINDOW;
+}
+
+bool frame_link_idle(const frame_link_t *fl) {
+    return fl->tx_next == fl->tx_base;
+}
+
+int frame_link_send(frame_link_t *fl, const uint8_t *data, size_t len, int64_t now_us) {
+    if (fl->failed || len == 0 || len > FRAME_PAYLOAD_MAX) {
+        return -1;
+    }
+    if (!frame_link_can_send(fl)) {
+        return 0;
+    }
+    frame_tx_slot_t *slot = &fl->tx[fl->tx_next % FRAME_WINDOW];
+    memcpy(slot->data, data, len);
+    slot->len = (uint16_t)len;
+    slot->seq = fl->tx_next++;
+    slot->sacked = false;
+    fl->stats.payload_tx += (uint32_t)len;
+    resend(fl, slot, now_us);
+    return (int)len;
+}
+
+// The per-byte delimiter scan is the receive fast path: IRAM, so
+// draining the backlog a flash operation leaves in the UART ring
+// does not stall on instruction fetches.
+void IRAM_ATTR frame_link_rx(frame_link_t *fl, const uint8_t *data, size_t len, int64_t now_us) {
+    fl->stats.wire_rx += (uint32_t)len;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = data[i];
+        if (c == 0) {
+            if (fl->in_overflow) {
+                fl->stats.overflows++;
+            } else if (fl->in_len > 0) {
+                handle_frame(fl, now_us);
+            }
+            fl->in_len = 0;
+            fl->in_overflow = false;
+        } else if (fl->in_len == sizeof(fl->in)) {
+            fl->in_overflow = true;  // Dropped at the next delimiter.
+        } else {
+            fl->in[fl->in_len++] = c;
+        }
+    }
+    if (fl->ack_due) {
+        send_frame(fl, FT_ACK, 0, NULL, 0);
+    }
+}
+
+void frame_link_tick(frame_link_t *fl, int64_t now_us) {
+    if (fl->failed) {
+        return;
+    }
+
+    // --- Held deliveries ---
+    deliver_ready(fl);
+
+    // --- Retransmission timers ---
+    // Each frame has its own; the oldest one's measures silence.
+    for (uint8_t seq = fl->tx_base; seq != fl->tx_next; seq++) {
+        frame_tx_slot_t *slot = &fl->tx[seq % FRAME_WINDOW];
+        if (slot->sacked || now_us - slot->sent_us < (int64_t)FRAME_RTO_MS * 1000) {
+            continue;
+        }
+        if (seq == fl->tx_base && ++fl->silent > FRAME_RETRIES_MAX) {
+            fl->failed = true;
+            return;
+        }
+        fl->stats.timeout_resends++;
+        resend(fl, slot, now_us);
+    }
+
+    if (fl->ack_due) {
+        send_frame(fl, FT_ACK, 0, NULL, 0);
+    }
+}
+
+void frame_link_disconnect(frame_link_t *fl) {
+    send_frame(fl, FT_DISC, 0, NULL, 0);
+}
+
+void frame_link_set_bit_errors(frame_link_t *fl, uint32_t per_million, uint32_t seed) {
+    fl->ber_ppm = per_million;
+    fl->rng = seed ? seed : 1;
+}
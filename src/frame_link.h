@@ -0,0 +1,172 @@
+#pragma once
+
+// ============================================================
+// frame_link.h
+//
+// Framed, CRC-protected link protocol for a byte pipe (UART).
+// Both ends run the same engine: the host over the modem UART
+// (modem_frame.c) and the fake modem on UART2.
+//
+// Wire format, one frame:
+//   COBS(header, payload, CRC) 0x00
+// COBS removes every 0x00 from the frame, so 0x00 only ever
+// delimits: a receiver that lost sync (noise, a flipped bit)
+// is back in step at the next zero. Overhead is 1 byte per 254
+// plus the delimiter.
+//
+// Header (4 bytes):
+//   type   DATA, ACK, DISC, UA
+//   seq    DATA sequence number (mod 256)
+//   ack    next seq the sender of this frame expects
+//   sack   bit n: seq ack+1+n already received out of order.
+//          Eight bits cover a window of up to 9; with a larger
+//          FRAME_WINDOW, frames held beyond ack+8 are reported
+//          only once the cumulative ack reaches them, so the
+//          sender may resend them on timeout.
+// Every frame carries ack / sack, so acknowledgements ride on
+// data going the other way; a bare ACK only goes out when there
+// is none.
+//
+// CRC-32 (or CRC-16/CCITT with FRAME_CRC32 0) over header and
+// payload, little-endian, from the ROM tables.
+//
+// Selective repeat: up to FRAME_WINDOW DATA frames in flight.
+// The receiver keeps out-of-order frames within its window and
+// delivers them in order once the gap is filled; the sender
+// resends only what is missing:
+//   - a hole is resent as soon as a frame sent after it is
+//     acknowledged (cumulatively or in sack): it was lost, and
+//     so was an earlier resend if that is what it was,
+//   - a frame not acknowledged after FRAME_RTO_MS is resent on
+//     its own; FRAME_RETRIES_MAX timeouts in a row with nothing
+//     heard from the peer fail the link.
+// A receiver that cannot take a frame yet (the deliver callback
+// returns false) keeps it and leaves it unacknowledged: the
+// sender's window is the flow control.
+//
+// The engine does no I/O and keeps no time of its own: bytes
+// come in through frame_link_rx(), go out through the write
+// callback, and the caller passes the clock.
+// ============================================================
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "app_config.h"
+
+#define FRAME_HEADER_BYTES 4
+#define FRAME_CRC_BYTES (FRAME_CRC32 ? 4 : 2)
+
+// Largest decoded frame, and its worst-case COBS encoding with
+// the delimiter.
+#define FRAME_RAW_MAX (FRAME_HEADER_BYTES + FRAME_PAYLOAD_MAX + FRAME_CRC_BYTES)
+#define FRAME_WIRE_MAX (FRAME_RAW_MAX + FRAME_RAW_MAX / 254 + 2)
+
+// Writes encoded bytes to the wire.
+typedef void (*frame_write_fn)(const uint8_t *data, size_t len, void *user);
+
+// Hands over one received payload, in order. Returning false
+// keeps it in the link for a later try (frame_link_tick()).
+typedef bool (*frame_deliver_fn)(const uint8_t *data, size_t len, void *user);
+
+// --- Counters ---
+typedef struct {
+    uint32_t frames_tx;       // Including retransmissions and ACKs.
+    uint32_t frames_rx;       // Passed the CRC.
+    uint32_t wire_tx;         // Encoded bytes written.
+    uint32_t wire_rx;
+    uint32_t payload_tx;      // Bytes accepted by frame_link_send().
+    uint32_t payload_rx;      // Bytes delivered.
+    uint32_t crc_errors;      // Bad CRC, bad COBS or too short.
+    uint32_t overflows;       // Longer than FRAME_WIRE_MAX.
+    uint32_t duplicates;      // DATA already received.
+    uint32_t out_of_order;    // DATA held for an earlier gap.
+    uint32_t sack_resends;    // Selective retransmissions.
+    uint32_t timeout_resends; // Retransmissions after FRAME_RTO_MS.
+    uint32_t bit_errors;      // Injected on this end's output.
+} frame_link_stats_t;
+
+typedef struct {
+    bool sacked;              // Peer has it (sack), awaiting the cumulative ack.
+    uint8_t seq;
+    uint16_t len;
+    int64_t sent_us;
+    uint32_t sent_order;      // tx_count when last (re)sent.
+    uint8_t data[FRAME_PAYLOAD_MAX];
+} frame_tx_slot_t;
+
+typedef struct {
+    bool used;
+    uint16_t len;
+    uint8_t data[FRAME_PAYLOAD_MAX];
+} frame_rx_slot_t;
+
+typedef struct {
+    frame_write_fn write;
+    frame_deliver_fn deliver;
+    void *user;
+
+    // Sender: seqs tx_base .. tx_next-1 in flight, in
+    // tx[seq % FRAME_WINDOW].
+    uint8_t tx_base;
+    uint8_t tx_next;
+    uint32_t tx_count;        // DATA transmissions, for sent_order.
+    frame_tx_slot_t tx[FRAME_WINDOW];
+
+    // Receiver: rx_next is the next seq to deliver; frames within
+    // the window wait in rx[seq % FRAME_WINDOW].
+    uint8_t rx_next;
+    bool ack_due;
+    frame_rx_slot_t rx[FRAME_WINDOW];
+
+    // COBS receive buffer (encoded bytes up to the delimiter).
+    size_t in_len;
+    bool in_overflow;
+    uint8_t in[FRAME_WIRE_MAX];
+
+    // Encode scratch for the write callback.
+    uint8_t out[FRAME_WIRE_MAX];
+
+    uint8_t silent;           // Oldest-frame timeouts since the peer was last heard.
+    bool failed;              // More than FRAME_RETRIES_MAX of them.
+    bool peer_closed;         // DISC received (answered with UA).
+    bool closed;              // UA received for our DISC.
+
+    // Bit errors injected on output, per million bits (test only).
+    uint32_t ber_ppm;
+    uint32_t rng;
+
+    frame_link_stats_t stats;
+} frame_link_t;
+
+// --- Public functions ---------------------------------------
+
+void frame_link_init(frame_link_t *fl, frame_write_fn write, frame_deliver_fn deliver,
+                     void *user);
+
+// Sends len (<= FRAME_PAYLOAD_MAX) bytes as one DATA frame.
+// Returns len, 0 when the window is full, -1 when len is too
+// large or the link has failed.
+int frame_link_send(frame_link_t *fl, const uint8_t *data, size_t len, int64_t now_us);
+
+// True when frame_link_send() would take a frame.
+bool frame_link_can_send(const frame_link_t *fl);
+
+// True when every frame sent has been acknowledged.
+bool frame_link_idle(const frame_link_t *fl);
+
+// Feeds received wire bytes. Delivers payloads and sends the
+// acknowledgement for them.
+void frame_link_rx(frame_link_t *fl, const uint8_t *data, size_t len, int64_t now_us);
+
+// Retransmits timed-out frames and retries held deliveries.
+// Call every few milliseconds, or whenever the wire is idle.
+void frame_link_tick(frame_link_t *fl, int64_t now_us);
+
+// Sends DISC. The peer answers UA (fl->closed).
+void frame_link_disconnect(frame_link_t *fl);
+
+// Flips output bits at per_million / 1e6 per bit, from a
+// deterministic sequence seeded by seed. 0 turns it off.
+void frame_link_set_bit_errors(frame_link_t *fl, uint32_t per_million, uint32_t seed);
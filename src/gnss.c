@@ -0,0 +1,164 @@
+// ============================================================
+// gnss.c
+//
+// NMEA from the modem's AT channel into the fix / sky state.
+// See gnss.h.
+// ============================================================
+
+#include "gnss.h"
+
+#if FEATURE_GNSS
+
+// stdio.h: printf() for console logging to UART0.
+#include <stdio.h>
+
+// string.h: fix / sky copies.
+#include <string.h>
+
+// FreeRTOS: spinlock around the published state.
+#include "freertos/FreeRTOS.h"
+
+// esp_timer.h: fix age.
+#include "esp_timer.h"
+
+// AT commands, line observer.
+#include "modem.h"
+
+static const char *TAG = "gnss";
+
+static nmea_parser_t s_parser;
+static bool s_running;
+
+// Published state. Written by the parser callback (on whichever
+// task read the line), read by anyone.
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static gnss_fix_t s_fix;
+static gnss_sat_t s_sky[GNSS_SATS_MAX];
+static int s_sky_count;
+
+// ============================================================
+// on_sentence()
+//
+// GGA and RMC update their half of the fix. GSV message 1 of a
+// series drops that system's satellites; each message appends
+// its own.
+// ============================================================
+static void on_sentence(const nmea_sentence_t *s, void *user) {
+    (void)user;
+    portENTER_CRITICAL(&s_mux);
+    if (s->type == NMEA_GGA) {
+        s_fix.time = s->gga.time;
+        s_fix.quality = s->gga.quality;
+        s_fix.satellites = s->gga.satellites;
+        s_fix.hdop_x100 = s->gga.hdop_x100;
+        if (s->gga.quality > 0) {
+            s_fix.lat_e7 = s->gga.lat_e7;
+            s_fix.lon_e7 = s->gga.lon_e7;
+            s_fix.alt_mm = s->gga.alt_mm;
+        }
+    } else if (s->type == NMEA_RMC) {
+        s_fix.time = s->rmc.time;
+        s_fix.date = s->rmc.date;
+        s_fix.speed_mmps = s->rmc.speed_mmps;
+        s_fix.course_cdeg = s->rmc.course_cdeg;
+        if (s->rmc.active) {
+            s_fix.lat_e7 = s->rmc.lat_e7;
+            s_fix.lon_e7 = s->rmc.lon_e7;
+        }
+        s_fix.valid = s->rmc.active;
+    } else {
+        char sys = s->talker[1];
+        if (s->gsv.msg_num == 1) {
+            int kept = 0;
+            for (int i = 0; i < s_sky_count; i++) {
+                if (s_sky[i].system != sys) {
+                    s_sky[kept++] = s_sky[i];
+                }
+            }
+            s_sky_count = kept;
+        }
+        for (int i = 0; i < s->gsv.count && s_sky_count < GNSS_SATS_MAX; i++) {
+            s_sky[s_sky_count++] = (gnss_sat_t){.system = sys, .sat = s->gsv.sats[i]};
+        }
+    }
+    s_fix.valid = s_fix.valid && s_fix.quality > 0;
+    s_fix.updated_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&s_mux);
+}
+
+// NMEA lines reach the observer without their "\r\n"; the parser
+// gets them back so it sees the stream as the receiver sent it.
+static void on_line(const char *line, void *user) {
+    (void)user;
+    if (line[0] != '$') {
+        return;
+    }
+    nmea_feed(&s_parser, (const uint8_t *)line, strlen(line));
+    nmea_feed(&s_parser, (const uint8_t *)"\r\n", 2);
+}
+
+static bool at_ok(const char *cmd) {
+    char resp[64];
+    return modem_send_at(cmd, resp, sizeof(resp), MODEM_CMD_TIMEOUT_MS) >= 0 &&
+           strstr(resp, "OK") != NULL;
+}
+
+// ============================================================
+// gnss_start()
+//
+// Steps:
+//   1. Parser and observer first: the first sentence may come
+//      right behind the OK.
+//   2. Receiver power, then NMEA output on the AT channel.
+// ============================================================
+esp_err_t gnss_start(void) {
+    if (s_running) {
+        return ESP_OK;
+    }
+
+    // --- Step 1: Parser ---
+    nmea_init(&s_parser, on_sentence, NULL);
+    if (modem_add_line_observer(on_line, NULL) != ESP_OK) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // --- Step 2: Receiver ---
+    if (!at_ok("AT+CGNSSPWR=1\r\n") || !at_ok("AT+CGNSSTST=1\r\n")) {
+        printf("[%s] receiver did not start\n", TAG);
+        modem_remove_line_observer(on_line, NULL);
+        return ESP_FAIL;
+    }
+    s_running = true;
+    return ESP_OK;
+}
+
+void gnss_stop(void) {
+    if (!s_running) {
+        return;
+    }
+    at_ok("AT+CGNSSTST=0\r\n");
+    at_ok("AT+CGNSSPWR=0\r\n");
+    modem_remove_line_observer(on_line, NULL);
+    s_running = false;
+}
+
+bool gnss_get_fix(gnss_fix_t *out) {
+    portENTER_CRITICAL(&s_mux);
+    *out = s_fix;
+    portEXIT_CRITICAL(&s_mux);
+    return out->valid;
+}
+
+int gnss_get_sky(gnss_sat_t *out, int max) {
+    portENTER_CRITICAL(&s_mux);
+    int n = s_sky_count < max ? s_sky_count : max;
+    memcpy(out, s_sky, (size_t)n * sizeof(*out));
+    portEXIT_CRITICAL(&s_mux);
+    return n;
+}
+
+nmea_stats_t gnss_stats(void) {
+    return s_parser.stats;
+}
+
+#endif  // FEATURE_GNSS
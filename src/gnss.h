@@ -0,0 +1,67 @@
+#pragma once
+
+// ============================================================
+// gnss.h
+//
+// GNSS position from the modem's built-in receiver.
+//
+// The modem streams NMEA on its AT channel once asked to
+// (AT+CGNSSPWR=1, AT+CGNSSTST=1): the sentences arrive as
+// unsolicited "$..." lines between command responses. gnss.c
+// picks them off the line observer and feeds them byte by byte
+// into the incremental parser (nmea.c), which keeps the latest
+// fix and sky view up to date. There is no third UART on the
+// ESP32-S3 for a separate NMEA port (UART0 console, UART1 modem,
+// UART2 fake modem); the parser does not care where bytes come
+// from.
+// ============================================================
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "app_config.h"
+
+// nmea_time_t / nmea_date_t / nmea_sat_t, parser counters.
+#include "nmea.h"
+
+// Latest fix, merged from GGA (altitude, quality, HDOP) and RMC
+// (date, speed, course, validity).
+typedef struct {
+    bool valid;               // RMC status 'A' and GGA quality > 0.
+    nmea_time_t time;
+    nmea_date_t date;
+    int32_t lat_e7;
+    int32_t lon_e7;
+    int32_t alt_mm;
+    uint32_t speed_mmps;
+    uint16_t course_cdeg;
+    uint16_t hdop_x100;
+    uint8_t quality;
+    uint8_t satellites;       // Used in the fix.
+    int64_t updated_us;       // esp_timer time of the last sentence (0 = none yet).
+} gnss_fix_t;
+
+typedef struct {
+    char system;              // Talker second letter: 'P' GPS, 'L' GLONASS, 'A' Galileo, 'B' BeiDou.
+    nmea_sat_t sat;
+} gnss_sat_t;
+
+// --- Public functions ---------------------------------------
+
+// Powers the receiver, routes NMEA to the AT channel and starts
+// parsing it.
+esp_err_t gnss_start(void);
+
+// Stops the NMEA output and the parser.
+void gnss_stop(void);
+
+// Copies the latest fix. Returns out->valid.
+bool gnss_get_fix(gnss_fix_t *out);
+
+// Copies up to max satellites in view (latest GSV series per
+// system). Returns the number copied.
+int gnss_get_sky(gnss_sat_t *out, int max);
+
+nmea_stats_t gnss_stats(void);
@@ -0,0 +1,252 @@
+// ============================================================
+// i2c_bus.c
+//
+// Bus task + transaction queue over the ESP-IDF I2C master
+// driver. See i2c_bus.h.
+// ============================================================
+
+#include "i2c_bus.h"
+
+#if FEATURE_I2C_BUS
+
+// stdio.h: printf() for console logging to UART0.
+#include <stdio.h>
+
+// string.h: memcpy()/memset() for op buffers and stats.
+#include <string.h>
+
+// FreeRTOS: bus task and the transaction queue.
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+// ESP-IDF I2C master driver (bus + per-device handles).
+#include "driver/i2c_master.h"
+
+// esp_timer.h: queueing / execution timestamps.
+#include "esp_timer.h"
+
+// mem_plan_value(): queue depth.
+#include "mem_plan.h"
+
+static const char *TAG = "i2c_bus";
+
+static i2c_master_bus_handle_t s_bus;
+static QueueHandle_t s_q;            // i2c_txn_t * in submit order.
+static i2c_bus_stats_t s_stats;
+
+// Device handles are created on first use and kept; the bus
+// task is the only user, so no locking.
+static struct {
+    uint8_t addr;
+    i2c_master_dev_handle_t dev;
+} s_devs[I2C_MAX_DEVICES];
+static int s_dev_count;
+
+// ============================================================
+// get_device()
+//
+// Returns the driver handle for a 7-bit address, adding the
+// device to the bus the first time it is seen.
+// ============================================================
+static i2c_master_dev_handle_t get_device(uint8_t addr) {
+    for (int i = 0; i < s_dev_count; i++) {
+        if (s_devs[i].addr == addr) {
+            return s_devs[i].dev;
+        }
+    }
+    if (s_dev_count >= I2C_MAX_DEVICES) {
+        return NULL;
+    }
+    i2c_device_config_t cfg = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = addr,
+        .scl_speed_hz = I2C_FREQ_HZ,
+    };
+    i2c_master_dev_handle_t dev;
+    if (i2c_master_bus_add_device(s_bus, &cfg, &dev) != ESP_OK) {
+        return NULL;
+    }
+    s_devs[s_dev_count].addr = addr;
+    s_devs[s_dev_count].dev = dev;
+    s_dev_count++;
+    return dev;
+}
+
+static esp_err_t run_op(const i2c_op_t *op) {
+    i2c_master_dev_handle_t dev = get_device(op->addr);
+    if (!dev) {
+        return ESP_ERR_NO_MEM;
+    }
+    switch (op->kind) {
+        case I2C_OP_WRITE:
+            return i2c_master_transmit(dev, op->wbuf, op->wlen, I2C_TIMEOUT_MS);
+        case I2C_OP_READ:
+            return i2c_master_receive(dev, op->rbuf, op->rlen, I2C_TIMEOUT_MS);
+        case I2C_OP_WRITE_READ:
+            return i2c_master_transmit_receive(dev, op->wbuf, op->wlen, op->rbuf,
+                                               op->rlen, I2C_TIMEOUT_MS);
+        default:
+            return ESP_ERR_INVALID_ARG;
+    }
+}
+
+// ============================================================
+// i2c_bus_task()
+//
+// Steps (per transaction):
+//   1. Take the next transaction pointer off the queue.
+//   2. Run its ops back-to-back; stop at the first failure.
+//   3. Record timing and call its done callback, then go
+//      straight to the next queued transaction.
+// ============================================================
+static void i2c_bus_task(void *arg) {
+    i2c_txn_t *txn;
+    while (1) {
+        // --- Step 1: Next transaction ---
+        if (xQueueReceive(s_q, &txn, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        txn->t_start_us = esp_timer_get_time();
+
+        // --- Step 2: Execute ---
+        txn->result = ESP_OK;
+        txn->failed_op = txn->n_ops;
+        for (uint8_t i = 0; i < txn->n_ops; i++) {
+            esp_err_t err = run_op(&txn->ops[i]);
+            s_stats.ops++;
+            if (err != ESP_OK) {
+                txn->result = err;
+                txn->failed_op = i;
+                break;
+            }
+        }
+        txn->t_done_us = esp_timer_get_time();
+
+        // --- Step 3: Account + complete ---
+        uint32_t queued_us = (uint32_t)(txn->t_start_us - txn->t_submit_us);
+        if (queued_us > s_stats.max_queue_us) {
+            s_stats.max_queue_us = queued_us;
+        }
+        s_stats.busy_us += (uint64_t)(txn->t_done_us - txn->t_start_us);
+        s_stats.txns++;
+        if (txn->result != ESP_OK) {
+            s_stats.errors++;
+        }
+        if (txn->done) {
+            txn->done(txn, txn->user);
+        }
+    }
+}
+
+// ============================================================
+// Transaction builders
+// ============================================================
+void i2c_txn_init(i2c_txn_t *txn, i2c_done_fn done, void *user) {
+    memset(txn, 0, sizeof(*txn));
+    txn->done = done;
+    txn->user = user;
+}
+
+static i2c_op_t *add_op(i2c_txn_t *txn, uint8_t addr, i2c_op_kind_t kind) {
+    if (txn->n_ops >= I2C_TXN_MAX_OPS) {
+        return NULL;
+    }
+    i2c_op_t *op = &txn->ops[txn->n_ops++];
+    memset(op, 0, sizeof(*op));
+    op->addr = addr;
+    op->kind = (uint8_t)kind;
+    return op;
+}
+
+bool i2c_txn_write(i2c_txn_t *txn, uint8_t addr, const uint8_t *data, size_t len) {
+    if (len > I2C_OP_WRITE_MAX) {
+        return false;
+    }
+    i2c_op_t *op = add_op(txn, addr, I2C_OP_WRITE);
+    if (!op) {
+        return false;
+    }
+    memcpy(op->wbuf, data, len);
+    op->wlen = (uint8_t)len;
+    return true;
+}
+
+bool i2c_txn_write_reg(i2c_txn_t *txn, uint8_t addr, uint8_t reg, uint8_t value) {
+    uint8_t buf[2] = {reg, value};
+    return i2c_txn_write(txn, addr, buf, sizeof(buf));
+}
+
+bool i2c_txn_read(i2c_txn_t *txn, uint8_t addr, uint8_t *buf, size_t len) {
+    i2c_op_t *op = add_op(txn, addr, I2C_OP_READ);
+    if (!op) {
+        return false;
+    }
+    op->rbuf = buf;
+    op->rlen = (uint16_t)len;
+    return true;
+}
+
+bool i2c_txn_read_reg(i2c_txn_t *txn, uint8_t addr, uint8_t reg, uint8_t *buf,
+                      size_t len) {
+    i2c_op_t *op = add_op(txn, addr, I2C_OP_WRITE_READ);
+    if (!op) {
+        return false;
+    }
+    op->wbuf[0] = reg;
+    op->wlen = 1;
+    op->rbuf = buf;
+    op->rlen = (uint16_t)len;
+    return true;
+}
+
+// ============================================================
+// Public API
+// ============================================================
+esp_err_t i2c_bus_submit(i2c_txn_t *txn) {
+    txn->t_submit_us = esp_timer_get_time();
+    if (xQueueSend(s_q, &txn, 0) != pdTRUE) {
+        s_stats.rejected++;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_init(void) {
+    i2c_master_bus_config_t cfg = {
+        .i2c_port = I2C_NUM_0,
+        .sda_io_num = PIN_I2C_SDA,
+        .scl_io_num = PIN_I2C_SCL,
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .glitch_ignore_cnt = 7,
+        .flags.enable_internal_pullup = true,
+    };
+    esp_err_t err = i2c_new_master_bus(&cfg, &s_bus);
+    if (err != ESP_OK) {
+        printf("[%s] i2c_new_master_bus failed: %s\n", TAG, esp_err_to_name(err));
+        return err;
+    }
+
+    uint32_t depth = mem_plan_value(MEM_I2C_QUEUE);
+    s_q = xQueueCreate(depth, sizeof(i2c_txn_t *));
+    if (!s_q) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(i2c_bus_task, "i2c_bus", I2C_TASK_STACK_BYTES, NULL,
+                    I2C_TASK_PRIO, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    printf("[%s] SDA %d SCL %d @ %d Hz, queue %lu\n", TAG, PIN_I2C_SDA, PIN_I2C_SCL,
+           I2C_FREQ_HZ, (unsigned long)depth);
+    return ESP_OK;
+}
+
+const i2c_bus_stats_t *i2c_bus_stats(void) {
+    return &s_stats;
+}
+
+void i2c_bus_reset_stats(void) {
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+
+#endif  // FEATURE_I2C_BUS
@@ -0,0 +1,103 @@
+#pragma once
+
+// ============================================================
+// i2c_bus.h
+//
+// Asynchronous I2C bus manager (FEATURE_I2C_BUS).
+//
+// One task owns the bus (PIN_I2C_SDA/SCL at I2C_FREQ_HZ). Other
+// tasks never touch the driver and never block on the bus:
+//   1. Build an i2c_txn_t: a list of operations, possibly for
+//      several devices (e.g. "read 14 bytes from reg 0x3B of
+//      0x68, then 8 bytes from reg 0xF7 of 0x76").
+//   2. i2c_bus_submit() queues a pointer to it and returns.
+//   3. The bus task runs the operations back-to-back and calls
+//      the transaction's done callback.
+//
+// Ownership:
+//   The transaction and its read buffers belong to the caller
+//   but must stay untouched from submit until the callback (the
+//   queue holds pointers, nothing is copied).
+//
+// Callbacks run on the bus task; keep them short (copy out /
+// notify a task). Submitting from a callback is allowed.
+//
+// Errors:
+//   The first failing operation (NACK, timeout) aborts the rest
+//   of its transaction; result and failed_op say which. Other
+//   queued transactions are unaffected.
+// ============================================================
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "app_config.h"
+
+typedef enum {
+    I2C_OP_WRITE,     // Write wbuf (register address + data).
+    I2C_OP_READ,      // Read rlen bytes.
+    I2C_OP_WRITE_READ // Write wbuf, repeated start, read rlen bytes.
+} i2c_op_kind_t;
+
+typedef struct {
+    uint8_t addr;     // 7-bit device address.
+    uint8_t kind;     // i2c_op_kind_t
+    uint8_t wlen;
+    uint8_t wbuf[I2C_OP_WRITE_MAX];
+    uint8_t *rbuf;
+    uint16_t rlen;
+} i2c_op_t;
+
+typedef struct i2c_txn i2c_txn_t;
+
+// Called on the bus task when the transaction finishes.
+typedef void (*i2c_done_fn)(i2c_txn_t *txn, void *user);
+
+struct i2c_txn {
+    i2c_op_t ops[I2C_TXN_MAX_OPS];
+    uint8_t n_ops;
+
+    i2c_done_fn done;
+    void *user;
+
+    // Filled in by the bus task before done() is called.
+    esp_err_t result;
+    uint8_t failed_op;        // Index of the failing op (n_ops if none).
+    int64_t t_submit_us;
+    int64_t t_start_us;
+    int64_t t_done_us;
+};
+
+// --- Counters -----------------------------------------------
+typedef struct {
+    uint32_t txns;
+    uint32_t ops;
+    uint32_t errors;          // Transactions with result != ESP_OK.
+    uint32_t rejected;        // Submits refused (queue full).
+    uint32_t max_queue_us;    // Longest submit -> start wait.
+    uint64_t busy_us;         // Time spent executing transactions.
+} i2c_bus_stats_t;
+
+// --- Public functions ---------------------------------------
+
+// Creates the master bus on I2C_NUM_0 and starts the bus task.
+esp_err_t i2c_bus_init(void);
+
+// Transaction builders. Return false when the op list is full or
+// the write is longer than I2C_OP_WRITE_MAX.
+void i2c_txn_init(i2c_txn_t *txn, i2c_done_fn done, void *user);
+bool i2c_txn_write(i2c_txn_t *txn, uint8_t addr, const uint8_t *data, size_t len);
+bool i2c_txn_write_reg(i2c_txn_t *txn, uint8_t addr, uint8_t reg, uint8_t value);
+bool i2c_txn_read(i2c_txn_t *txn, uint8_t addr, uint8_t *buf, size_t len);
+bool i2c_txn_read_reg(i2c_txn_t *txn, uint8_t addr, uint8_t reg, uint8_t *buf,
+                      size_t len);
+
+// Queues txn without blocking. ESP_ERR_NO_MEM if the queue is
+// full (the callback is not called in that case).
+esp_err_t i2c_bus_submit(i2c_txn_t *txn);
+
+const i2c_bus_stats_t *i2c_bus_stats(void);
+void i2c_bus_reset_stats(void);
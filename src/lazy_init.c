@@ -0,0 +1,130 @@
+// ============================================================
+// lazy_init.c
+//
+// Run-once subsystem start-up on the init task or at first use.
+// See lazy_init.h.
+// ============================================================
+
+#include "lazy_init.h"
+
+// stdbool.h: eager flag.
+#include <stdbool.h>
+
+// FreeRTOS: init task, state lock, done bits.
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+
+// esp_timer.h: init spans for the boot timeline.
+#include "esp_timer.h"
+
+// boot_prof_span().
+#include "boot_prof.h"
+
+// The subsystems' init functions.
+#include "camera_pipeline.h"
+#include "display.h"
+#include "sd_logger.h"
+#include "audio_capture.h"
+#include "i2c_bus.h"
+
+typedef struct {
+    const char *name;
+    esp_err_t (*init)(void);  // NULL: feature off.
+    bool eager;               // Started by the init task at boot.
+} subsys_cfg_t;
+
+// Slowest first on the init task. The I2C bus and the audio
+// capture come up in milliseconds and only for their own test:
+// first use is soon enough.
+static const subsys_cfg_t s_cfg[LAZY_COUNT] = {
+#if FEATURE_CAMERA
+    [LAZY_CAMERA] = {"camera", cam_pipeline_init, true},
+#endif
+#if FEATURE_DISPLAY
+    [LAZY_DISPLAY] = {"display", display_init, true},
+#endif
+#if FEATURE_SD_LOGGING
+    [LAZY_SD_LOG] = {"sd_log", sd_log_init, true},
+#endif
+#if FEATURE_AUDIO
+    [LAZY_AUDIO] = {"audio", audio_capture_init, false},
+#endif
+#if FEATURE_I2C_BUS
+    [LAZY_I2C_BUS] = {"i2c_bus", i2c_bus_init, false},
+#endif
+};
+
+_Static_assert(LAZY_COUNT <= 24, "one event group bit per subsystem");
+
+enum {
+    ST_IDLE,
+    ST_RUNNING,
+    ST_DONE
+};
+
+static uint8_t s_state[LAZY_COUNT];
+static esp_err_t s_result[LAZY_COUNT];
+static SemaphoreHandle_t s_lock;
+static EventGroupHandle_t s_done;    // Bit id: s_result[id] is final.
+
+// The first caller takes an idle subsystem; everyone else waits
+// for its done bit.
+static bool claim(lazy_subsys_t id) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool mine = s_state[id] == ST_IDLE;
+    if (mine) {
+        s_state[id] = ST_RUNNING;
+    }
+    xSemaphoreGive(s_lock);
+    return mine;
+}
+
+static void run(lazy_subsys_t id, const char *where) {
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = s_cfg[id].init();
+    boot_prof_span(s_cfg[id].name, where, t0, esp_timer_get_time(), err);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_result[id] = err;
+    s_state[id] = ST_DONE;
+    xSemaphoreGive(s_lock);
+    xEventGroupSetBits(s_done, 1u << id);
+}
+
+// A deep-sleep duty cycle wakes only to send one reading over the
+// modem: no eager pass, so a timer wake does not bring up the
+// camera, panel and SD card just to sleep again.
+#define LAZY_EAGER (BOOT_INIT_EAGER && !FEATURE_DEEP_SLEEP)
+
+#if LAZY_EAGER
+static void init_task(void *arg) {
+    for (int id = 0; id < LAZY_COUNT; id++) {
+        if (s_cfg[id].init != NULL && s_cfg[id].eager && claim((lazy_subsys_t)id)) {
+            run((lazy_subsys_t)id, "init task");
+        }
+    }
+    vTaskDelete(NULL);
+}
+#endif
+
+void lazy_init_start(void) {
+    s_lock = xSemaphoreCreateMutex();
+    s_done = xEventGroupCreate();
+#if LAZY_EAGER
+    xTaskCreate(init_task, "lazy_init", BOOT_INIT_TASK_STACK, NULL, BOOT_INIT_TASK_PRIO, NULL);
+#endif
+}
+
+esp_err_t lazy_init_require(lazy_subsys_t id) {
+    if (id >= LAZY_COUNT || s_cfg[id].init == NULL) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (claim(id)) {
+        run(id, "first use");
+    } else {
+        xEventGroupWaitBits(s_done, 1u << id, pdFALSE, pdTRUE, portMAX_DELAY);
+    }
+    return s_result[id];
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+// ============================================================
+// lazy_init.h
+//
+// Start-up of the FEATURE_* subsystems, off app_main()'s serial
+// path.
+//
+// Each subsystem's init runs exactly once, whichever comes first:
+//   - lazy_init_start() at boot hands the ones marked eager (slow
+//     hardware bring-up: SD mount, panel reset, sensor probe) to
+//     a background task, which starts them one after the other
+//     while app_main() carries on with the modem.
+//   - lazy_init_require() at first use starts it on the caller's
+//     task, or waits for the init task if it is already on it.
+// So two different inits can run at once, one on the init task
+// and one at first use. Shared setup under them has to take
+// that: the SD logger and the display both register with the
+// SPI arbiter, whose spi_arb_init() / spi_arb_add_device() are
+// serialized for this.
+// Later calls return the first result at once. Disabled features
+// return ESP_ERR_NOT_SUPPORTED.
+//
+// With FEATURE_DEEP_SLEEP there is no eager pass: each wake only
+// sends a reading over the modem, and anything else starts at
+// first use.
+//
+// Not here: power_init() (FEATURE_POWER_MGMT) stays on
+// app_main()'s path, ahead of the modem. Every UART exchange
+// holds its PM lock, and a lock created in the middle of one
+// would be released without having been taken.
+//
+// Every init is recorded on the boot timeline (boot_prof.h) with
+// the task it ran on.
+// ============================================================
+
+#include "esp_err.h"
+
+#include "app_config.h"
+
+typedef enum {
+    LAZY_CAMERA,              // cam_pipeline_init() (FEATURE_CAMERA)
+    LAZY_DISPLAY,             // display_init()      (FEATURE_DISPLAY)
+    LAZY_SD_LOG,              // sd_log_init()       (FEATURE_SD_LOGGING)
+    LAZY_AUDIO,               // audio_capture_init() (FEATURE_AUDIO)
+    LAZY_I2C_BUS,             // i2c_bus_init()      (FEATURE_I2C_BUS)
+    LAZY_COUNT
+} lazy_subsys_t;
+
+// --- Public functions ---------------------------------------
+
+// Starts the eager subsystems on the init task (BOOT_INIT_EAGER,
+// not with FEATURE_DEEP_SLEEP). Call once from app_main(), after
+// mem_plan_init().
+void lazy_init_start(void);
+
+// Brings the subsystem up if nobody has yet and returns its init
+// result; blocks while the init task is on it.
+esp_err_t lazy_init_require(lazy_subsys_t id);
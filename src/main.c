@@ -12,9 +12,73 @@
 //   UART2 RTS (GPIO12) ---wire---> UART1 CTS (GPIO15)
 //
 // Flow:
-//   1. app_main() initializes UART1 with hardware flow control.
+//   1. app_main() initializes UART1 via modem_uart_init(); the
+//      FEATURE_* peripherals start on a background task or at
+//      first use (lazy_init.h).
 //   2. app_main() calls fake_modem_start() to launch the UART2 task.
-//   3. app_main() loops: send an AT command on UART1 TX,
+//      With FEATURE_DEEP_SLEEP it then runs the wake -> send ->
+//      deep sleep duty cycle instead of the steps below. Otherwise
+//      the registration state machine brings the modem up to
+//      PDP_ACTIVE from its URCs, and the boot timeline is printed.
+//   3. If FEATURE_MQTT is on, runs the MQTT session test against
+//      the fake modem's stand-in broker.
+//   4. If FEATURE_COAP is on, runs the CoAP uplink test against
+//      the stand-in CoAP server and compares it with HTTP. With
+//      COAP_USE_DTLS it runs over a DTLS session, then moves the
+//      socket to another port and checks that the session
+//      carries on by connection ID.
+//   5. If FEATURE_AGGREGATION is on, runs a synthetic sensor stream
+//      through the aggregator and reports the uplink reduction.
+//   6. If FEATURE_SD_LOGGING is on, measures the SD logger's hot
+//      path and background write throughput.
+//   7. If FEATURE_AUDIO is on, benchmarks the DSP kernels, then
+//      captures I2S audio into two consumers and reports
+//      overruns, underruns and latency.
+//   8. If FEATURE_CAMERA is on, streams JPEG frames through a
+//      link throttled to MODEM_BAUD and reports drops, latency
+//      and memory use.
+//   9. If FEATURE_DISPLAY is on, animates a sprite on the SPI
+//      display with full-screen vs dirty-rectangle redraws and
+//      reports FPS and CPU load.
+//  10. If FEATURE_I2C_BUS is on, queues a burst of multi-device
+//      sensor reads on the I2C bus manager and reports submit
+//      cost, completion latency and bus occupancy.
+//  11. If the SPI arbiter is in use (SD logging / display),
+//      runs SD logging and display redraws at the same time and
+//      reports bus utilization and per-device queueing latency.
+//  12. If FEATURE_POWER_MGMT is on, runs spaced AT transactions
+//      with DFS / light sleep and again pinned at full power,
+//      and reports latency and estimated energy per transaction.
+//  13. Drops coverage on the fake modem and times the recovery
+//      back to PDP_ACTIVE, which reruns only the stages it lost.
+//  14. Opens a socket on every modem link, echoes traffic on all
+//      of them at once through the fake modem's loopback peers
+//      and checks a peer hang-up.
+//  15. If FEATURE_SMS is on, reads the fake modem's stored SMS
+//      and round-trips messages through its stand-in SMSC in PDU
+//      mode, one batched listing per poll.
+//  16. If FEATURE_GNSS is on, benchmarks the NMEA parser, then
+//      follows the fix from the fake modem's receiver, whose
+//      sentences arrive on the AT channel.
+//  17. If FEATURE_FRAME_LINK is on, switches the modem UART to
+//      the framed, CRC-checked transport and measures echo
+//      goodput under injected bit errors.
+//  18. Sends a burst into the fake modem while it stops reading,
+//      under RTS/CTS, XON/XOFF and no flow control, and reports
+//      the bytes lost to RX overflow in each mode.
+//  19. Damages modem answers (line noise, an RX overflow while
+//      the reader is held off) and checks that only the command
+//      hit fails or is retried, quickly, and the next one gets a
+//      clean answer.
+//  20. Streams the loopback at MODEM_STRESS_BAUD without flow
+//      control while another task erases flash sector after
+//      sector, and reports the bytes dropped (none, with the
+//      UART ISRs in IRAM) and the longest erase against the RX
+//      ring's headroom.
+//  21. Times a fixed workload (AT round trip, framed link, DSP
+//      filters) and prints it against the other build profile's
+//      last run (debug vs release), with the image size.
+//  22. app_main() loops: send an AT command on UART1 TX,
 //      read the response on UART1 RX, print it, wait, repeat.
 // ============================================================
 
@@ -24,50 +88,108 @@
 // string.h: strlen() for measuring command strings before sending.
 #include <string.h>
 
+// errno.h: socket test error codes (EINPROGRESS).
+#include <errno.h>
+
 // FreeRTOS headers for vTaskDelay() (blocking delay in the main loop).
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
-// ESP-IDF UART driver API.
-#include "driver/uart.h"
+// esp_timer.h: microsecond timestamps for the protocol test timing.
+#include "esp_timer.h"
 
-// Our fake modem module — provides fake_modem_start().
-#include "fake_modem.h"
+// esp_partition.h: scratch partition for the flash stress test.
+#include "esp_partition.h"
 
-// ============================================================
-// UART1 pin and config definitions (modem driver side)
-//
-// These match the board_feather_esp32s3.h modem UART mapping:
-//   TX=GPIO17, RX=GPIO18, RTS=GPIO16, CTS=GPIO15
-// ============================================================
+// spi_flash_mmap.h: SPI_FLASH_SEC_SIZE (erase unit).
+#include "spi_flash_mmap.h"
+
+// Feature toggles and protocol settings.
+#include "app_config.h"
+
+// Board descriptor resolution — board_init().
+#include "board.h"
+
+// Boot-time buffer sizing from the real heap.
+#include "mem_plan.h"
+
+// UART1 modem driver — modem_uart_init(), modem_send_at(), data mode.
+#include "modem.h"
+
+// MQTT client used by the session test.
+#include "mqtt_client.h"
+
+// CoAP client used by the uplink test.
+#include "coap_client.h"
+
+// DTLS + connection ID session under it (COAP_USE_DTLS).
+#include "coap_dtls.h"
+
+// Streaming aggregation used by the downsampling test.
+#include "aggregator.h"
+
+// Append-only SD logger used by the logging test.
+#include "sd_logger.h"
+
+// I2S capture with zero-copy frame handoff.
+#include "audio_capture.h"
+
+// Fixed-point DSP kernels (PIE SIMD on the ESP32-S3).
+#include "dsp.h"
+
+// ADPCM encoder stage for the audio uplink.
+#include "audio_encoder.h"
+
+// Camera frame ring + chunked JPEG uplink.
+#include "camera_pipeline.h"
+
+// Band-buffered SPI display with dirty rectangles.
+#include "display.h"
+
+// Asynchronous I2C bus manager.
+#include "i2c_bus.h"
+
+// Shared SPI bus arbiter (SD card + display).
+#include "spi_arbiter.h"
+
+// Deep-sleep duty cycle with RTC-retained modem/session state.
+#include "deep_sleep.h"
+
+// DFS + light sleep with activity-scoped PM locks.
+#include "power_mgmt.h"
+
+// URC-driven registration state machine.
+#include "modem_reg.h"
 
-// Which hardware UART peripheral for the modem driver side:
-#define MODEM_UART_NUM  1
+// BSD-style sockets on the modem's links.
+#include "modem_sock.h"
 
-// GPIO pin for UART1 TX (ESP32 sends data to modem here):
-#define MODEM_TX_PIN    17
+// SMS in PDU mode.
+#include "modem_sms.h"
 
-// GPIO pin for UART1 RX (ESP32 receives data from modem here):
-#define MODEM_RX_PIN    18
+// GNSS fix from the modem's NMEA output.
+#include "gnss.h"
 
-// GPIO pin for UART1 RTS (ESP32 tells modem "I can receive"):
-#define MODEM_RTS_PIN   16
+// Framed binary transport on the modem UART.
+#include "modem_frame.h"
 
-// GPIO pin for UART1 CTS (modem tells ESP32 "I can receive"):
-#define MODEM_CTS_PIN   15
+// Our fake modem module — provides fake_modem_start().
+#include "fake_modem.h"
 
-// Baud rate for UART1. Must match FAKE_MODEM_BAUD in fake_modem.h:
-#define MODEM_BAUD      115200
+// Debug / release profile benchmark.
+#include "build_profile.h"
 
-// RX ring buffer size for the UART1 driver.
-// 256 bytes is enough to hold modem responses like "+CSQ: 20,99\r\nOK\r\n":
-#define MODEM_RX_BUF    256
+// Boot timeline, reset to first AT command.
+#include "boot_prof.h"
+
+// Run-once peripheral start-up (init task / first use).
+#include "lazy_init.h"
 
 // ============================================================
 // send_at_command()
 //
-// Sends one AT command string on UART1 TX and reads back the
-// response on UART1 RX.
+// Sends one AT command string on UART1 TX and prints the
+// response collected by modem_send_at().
 //
 // Inputs:
 //   cmd — null-terminated AT command (e.g. "AT\r\n").
@@ -78,116 +200,1862 @@
 //   so you can see what the fake modem sent back.
 // ============================================================
 static void send_at_command(const char *cmd) {
-    // --- Send the command on UART1 TX ---
-    // strlen(cmd) gives byte count. uart_write_bytes() pushes them
-    // into the UART1 TX FIFO. If CTS is deasserted (modem says "wait"),
-    // the hardware pauses transmission automatically.
     printf("[main] sending: \"%.*s\"\n", (int)(strlen(cmd) - 2), cmd);
-    uart_write_bytes(MODEM_UART_NUM, cmd, strlen(cmd));
 
-    // --- Wait briefly for the fake modem to process and respond ---
-    // 200ms is generous; real modems can take longer for some commands.
-    vTaskDelay(pdMS_TO_TICKS(200));
-
-    // --- Read response from UART1 RX ---
     // Temporary buffer to hold the response bytes.
-    uint8_t rx_buf[128];
+    char rx_buf[128];
 
-    // Try to read up to 127 bytes with a 300ms timeout.
-    // Returns the number of bytes actually read (0 if nothing arrived).
-    int len = uart_read_bytes(MODEM_UART_NUM, rx_buf, sizeof(rx_buf) - 1,
-                              pdMS_TO_TICKS(300));
+    // Waits for the final result code instead of a fixed delay.
+    int len = modem_send_at(cmd, rx_buf, sizeof(rx_buf), 500);
 
     if (len > 0) {
-        // Null-terminate so we can print it as a C string.
-        rx_buf[len] = '\0';
-
         // Print the raw response. \r\n from the modem will show as
         // line breaks in the console output.
-        printf("[main] response (%d bytes): %s\n", len, (char *)rx_buf);
+        printf("[main] response (%d bytes): %s\n", len, rx_buf);
     } else {
-        // No bytes received within the timeout.
+        // No final result code within the timeout.
         // Could mean: wiring issue, fake modem not running,
         // or flow control is blocking transmission.
         printf("[main] no response received\n");
     }
 }
 
+#if FEATURE_MQTT
+// ============================================================
+// MQTT session test
+//
+// Exercises the MQTT client against the stand-in broker behind
+// the fake modem:
+//   - first connection: new session, subscribe, publish burst
+//   - second connection: session resumed, subscribe skipped
+// Each connection must get every publish acknowledged and the
+// command it publishes to itself echoed back; the reconnect must
+// find its session. Misses print FAILED.
+// The publish burst is pipelined, so the elapsed time shows the
+// benefit over waiting for each PUBACK.
+// ============================================================
+
+// Transport adapter: MQTT bytes over the modem transparent link.
+static int mqtt_modem_write(void *ctx, const uint8_t *data, size_t len) {
+    (void)ctx;
+    return modem_data_write(data, len);
+}
+
+static int mqtt_modem_read(void *ctx, uint8_t *buf, size_t len,
+                           uint32_t timeout_ms) {
+    (void)ctx;
+    return modem_data_read(buf, len, timeout_ms);
+}
+
+// Set when the command published to ourselves comes back.
+static volatile bool s_mqtt_cmd_seen;
+
+static void mqtt_on_message(void *user, const char *topic, size_t topic_len,
+                            const uint8_t *payload, size_t payload_len) {
+    (void)user;
+    printf("[main] mqtt rx \"%.*s\": %.*s\n", (int)topic_len, topic,
+           (int)payload_len, (const char *)payload);
+    if (topic_len == strlen("feather-s3/cmd/led") &&
+        memcmp(topic, "feather-s3/cmd/led", topic_len) == 0) {
+        s_mqtt_cmd_seen = true;
+    }
+}
+
+// Persistent client: the in-flight window must outlive one connection.
+static mqtt_client_t s_mqtt;
+
+// ============================================================
+// run_mqtt_session()
+//
+// One connect / (subscribe) / publish burst / disconnect cycle.
+//
+// Inputs:
+//   burst          — number of QoS1 telemetry publishes to pipeline.
+//   expect_session — the broker must report session present.
+//
+// Returns true if the session met every expectation: connected,
+// session present when expected, every publish acknowledged and
+// the command echoed back through the subscription. Each miss is
+// printed as FAILED.
+// ============================================================
+static bool run_mqtt_session(int burst, bool expect_session) {
+    if (!modem_open_transparent(MQTT_BROKER_HOST, MQTT_BROKER_PORT)) {
+        printf("[main] mqtt: FAILED to open the link\n");
+        return false;
+    }
+    if (mqtt_connect(&s_mqtt, MQTT_ACK_TIMEOUT_MS) != ESP_OK) {
+        printf("[main] mqtt: FAILED to connect\n");
+        return false;
+    }
+    bool ok = true;
+
+    // Persistent session: only subscribe when the broker forgot us.
+    if (!mqtt_session_present(&s_mqtt)) {
+        if (expect_session) {
+            printf("[main] mqtt: FAILED, no session present on reconnect\n");
+            ok = false;
+        }
+        mqtt_subscribe(&s_mqtt, "feather-s3/cmd/#", 1, MQTT_ACK_TIMEOUT_MS);
+    } else {
+        printf("[main] session resumed, subscription kept\n");
+    }
+
+    // A command to ourselves, delivered back through the subscription.
+    const char *cmd = "{\"led\":1}";
+    uint32_t acked_before = s_mqtt.stats.acked;
+    s_mqtt_cmd_seen = false;
+    mqtt_publish(&s_mqtt, "feather-s3/cmd/led", (const uint8_t *)cmd,
+                 strlen(cmd), 1, false, MQTT_ACK_TIMEOUT_MS);
+
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < burst; i++) {
+        char payload[48];
+        int len = snprintf(payload, sizeof(payload), "{\"seq\":%d,\"rssi\":-73}", i);
+        mqtt_publish(&s_mqtt, "feather-s3/telemetry", (const uint8_t *)payload,
+                     (size_t)len, 1, false, MQTT_ACK_TIMEOUT_MS);
+    }
+    esp_err_t err = mqtt_wait_idle(&s_mqtt, MQTT_ACK_TIMEOUT_MS);
+    int64_t elapsed = esp_timer_get_time() - start;
+
+    const mqtt_stats_t *st = &s_mqtt.stats;
+    uint32_t acked = st->acked - acked_before;
+    printf("[main] mqtt burst of %d: %s in %lld ms, %lu batches, "
+           "window full %lu times, avg ack %lld us, max %lld us\n",
+           burst, err == ESP_OK ? "all acked" : "incomplete",
+           (long long)(elapsed / 1000), (unsigned long)st->batches,
+           (unsigned long)st->window_full,
+           st->acked ? (long long)(st->ack_latency_us / st->acked) : 0LL,
+           (long long)st->ack_latency_max_us);
+    if (err != ESP_OK || acked < (uint32_t)burst + 1) {
+        printf("[main] mqtt: FAILED, %lu of %d publishes acked\n", (unsigned long)acked,
+               burst + 1);
+        ok = false;
+    }
+
+    // The echo may still be on its way behind the last PUBACK.
+    int64_t deadline = esp_timer_get_time() + (int64_t)MQTT_ACK_TIMEOUT_MS * 1000;
+    while (!s_mqtt_cmd_seen && s_mqtt.connected && esp_timer_get_time() < deadline) {
+        mqtt_poll(&s_mqtt, 20);
+    }
+    if (!s_mqtt_cmd_seen) {
+        printf("[main] mqtt: FAILED, command not echoed back\n");
+        ok = false;
+    }
+
+    mqtt_disconnect(&s_mqtt);
+    // Let the fake modem report CLOSED before AT traffic resumes.
+    vTaskDelay(pdMS_TO_TICKS(200));
+    return ok;
+}
+
+static void mqtt_session_test(void) {
+    mqtt_config_t cfg = {
+        .client_id = "feather-s3",
+        .protocol_level = MQTT_PROTOCOL_LEVEL,
+        .keepalive_s = MQTT_KEEPALIVE_S,
+        .clean_session = false,
+        .session_expiry_s = MQTT_SESSION_EXPIRY_S,
+        .on_message = mqtt_on_message,
+        .user = NULL,
+    };
+    mqtt_transport_t tp = {
+        .write = mqtt_modem_write,
+        .read = mqtt_modem_read,
+        .ctx = NULL,
+    };
+    mqtt_client_init(&s_mqtt, &cfg, &tp);
+
+    printf("[main] mqtt session test: first connect\n");
+    bool ok = run_mqtt_session(20, false);
+
+    // Same client id, clean_session = 0: the broker must report
+    // session present and the subscribe step is skipped.
+    printf("[main] mqtt session test: reconnect\n");
+    ok &= run_mqtt_session(20, true);
+    printf("[main] mqtt session test: %s\n", ok ? "passed" : "FAILED");
+}
+#endif
+
+#if FEATURE_COAP
+// ============================================================
+// CoAP uplink test
+//
+// Sends the same small reading the way the firmware would
+// (CON and NON), then a block-wise upload and download, and
+// prints bytes and round trips per reading next to what the
+// equivalent HTTP/1.1 POST costs.
+//
+// With COAP_USE_DTLS all of it goes through a DTLS session
+// with the stand-in server, and the test ends with a NAT
+// rebinding: the socket reopens on COAP_REBIND_PORT and one
+// more reading must get through on the same session.
+// ============================================================
+
+// Transport adapter: CoAP datagrams over the modem UDP socket.
+static int coap_modem_send(void *ctx, const uint8_t *data, size_t len) {
+    (void)ctx;
+    return modem_udp_send(COAP_UDP_LINK_ID, COAP_SERVER_HOST, COAP_SERVER_PORT,
+                          data, len, COAP_ACK_TIMEOUT_MS);
+}
+
+static int coap_modem_recv(void *ctx, uint8_t *buf, size_t len,
+                           uint32_t timeout_ms) {
+    (void)ctx;
+    return modem_udp_recv(COAP_UDP_LINK_ID, buf, len, timeout_ms);
+}
+
+// --- Header overhead used for the HTTP comparison -----------
+// IPv4 (20) + UDP (8) per datagram.
+#define UDP_IP_OVERHEAD 28
+// IPv4 (20) + TCP (20, no options) per segment.
+#define TCP_IP_OVERHEAD 40
+// Pure ACK segments around one request/response on an open connection.
+#define TCP_ACK_SEGMENTS 2
+// SYN, SYN-ACK, ACK, FIN, ACK, FIN, ACK for a connection per reading.
+#define TCP_SETUP_TEARDOWN_SEGMENTS 7
+
+#if COAP_USE_DTLS
+// Plus one DTLS 1.2 record: header (13), explicit nonce (8),
+// CCM_8 tag (8); with a CID, the CID and the inner content type.
+#define DATAGRAM_OVERHEAD \
+    (UDP_IP_OVERHEAD + 29 + (COAP_DTLS_CID_LEN > 0 ? COAP_DTLS_CID_LEN + 1 : 0))
+#else
+#define DATAGRAM_OVERHEAD UDP_IP_OVERHEAD
+#endif
+
+static coap_client_t s_coap;
+
+#if COAP_USE_DTLS
+static coap_dtls_t s_dtls;
+
+// Runs the handshake over the plain UDP transport and points tp
+// at the session. A saved session (NULL for none) is offered for
+// an abbreviated handshake; if it does not load, the handshake
+// is a full one.
+static bool coap_dtls_up(coap_transport_t *tp, const uint8_t *session, size_t session_len) {
+    const coap_transport_t udp = {
+        .send = coap_modem_send,
+        .recv = coap_modem_recv,
+        .ctx = NULL,
+    };
+    if (coap_dtls_init(&s_dtls, &udp, (const uint8_t *)COAP_DTLS_PSK,
+                       strlen(COAP_DTLS_PSK), COAP_DTLS_PSK_IDENTITY) != ESP_OK) {
+        coap_dtls_free(&s_dtls);
+        return false;
+    }
+    if (session && coap_dtls_resume_session(&s_dtls, session, session_len) != ESP_OK) {
+        printf("[main] saved dtls session did not load, full handshake\n");
+    }
+    if (coap_dtls_handshake(&s_dtls, COAP_ACK_TIMEOUT_MS * 16) != ESP_OK) {
+        coap_dtls_free(&s_dtls);
+        return false;
+    }
+    coap_dtls_transport(&s_dtls, tp);
+    return true;
+}
+
+// NAT rebinding stand-in: the stand-in server now sees our
+// records from another port. It only takes them if they carry
+// its CID; without one the reading times out.
+static void coap_dtls_rebind_test(const char *reading, size_t reading_len) {
+    modem_udp_close(COAP_UDP_LINK_ID);
+    if (!modem_udp_open(COAP_UDP_LINK_ID, COAP_REBIND_PORT)) {
+        return;
+    }
+    uint32_t handshakes = s_dtls.handshakes;
+    uint8_t code = 0;
+    esp_err_t err = coap_post(&s_coap, "t/env", COAP_FORMAT_JSON, (const uint8_t *)reading,
+                              reading_len, true, &code);
+    bool kept = err == ESP_OK && code == COAP_CHANGED && s_dtls.handshakes == handshakes;
+    printf("[main] coap dtls: port %u -> %u, CID %s: %s\n", COAP_LOCAL_PORT,
+           COAP_REBIND_PORT, coap_dtls_cid_active(&s_dtls) ? "active" : "off",
+           kept ? "reading accepted on the same session, no handshake"
+                : "session lost, a new handshake would be needed");
+}
+#endif
+
+static void coap_uplink_test(void) {
+    if (!modem_udp_open(COAP_UDP_LINK_ID, COAP_LOCAL_PORT)) {
+        return;
+    }
+    coap_transport_t tp = {
+        .send = coap_modem_send,
+        .recv = coap_modem_recv,
+        .ctx = NULL,
+    };
+#if COAP_USE_DTLS
+    if (!coap_dtls_up(&tp, NULL, 0)) {
+        printf("[main] coap dtls session not up, skipping test\n");
+        modem_udp_close(COAP_UDP_LINK_ID);
+        return;
+    }
+#endif
+    coap_client_init(&s_coap, &tp, (uint32_t)esp_timer_get_time());
+
+    const char *reading = "{\"t\":21.5,\"rh\":48}";
+    const size_t reading_len = strlen(reading);
+    const int count = 5;
+    uint8_t code = 0;
+
+    // --- Confirmable readings ---
+    coap_stats_t before = s_coap.stats;
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < count; i++) {
+        coap_post(&s_coap, "t/env", COAP_FORMAT_JSON, (const uint8_t *)reading,
+                  reading_len, true, &code);
+    }
+    int64_t con_us = (esp_timer_get_time() - start) / count;
+    uint32_t con_bytes = (s_coap.stats.tx_bytes + s_coap.stats.rx_bytes -
+                          before.tx_bytes - before.rx_bytes) / count;
+    uint32_t con_dgrams = (s_coap.stats.tx_datagrams + s_coap.stats.rx_datagrams -
+                           before.tx_datagrams - before.rx_datagrams) / count;
+
+    // --- Non-confirmable readings ---
+    before = s_coap.stats;
+    for (int i = 0; i < count; i++) {
+        coap_post(&s_coap, "t/env", COAP_FORMAT_JSON, (const uint8_t *)reading,
+                  reading_len, false, NULL);
+    }
+    uint32_t non_bytes = (s_coap.stats.tx_bytes - before.tx_bytes) / count;
+
+    // --- Block-wise upload and download ---
+    static uint8_t blob[600];
+    for (size_t i = 0; i < sizeof(blob); i++) {
+        blob[i] = (uint8_t)i;
+    }
+    esp_err_t err = coap_post(&s_coap, "t/trace", COAP_FORMAT_OCTETS, blob,
+                              sizeof(blob), true, &code);
+    printf("[main] coap block1 upload %u bytes: %s, code %u.%02u\n",
+           (unsigned)sizeof(blob), err == ESP_OK ? "ok" : "failed", code >> 5,
+           code & 0x1F);
+
+    static uint8_t doc[1024];
+    size_t doc_len = 0;
+    err = coap_get(&s_coap, "config", doc, sizeof(doc), &doc_len, &code);
+    printf("[main] coap block2 get config: %s, %u bytes, code %u.%02u\n",
+           err == ESP_OK ? "ok" : "failed", (unsigned)doc_len, code >> 5,
+           code & 0x1F);
+
+    // --- HTTP/1.1 equivalent of one reading ---
+    char http_req[256];
+    int req_len = snprintf(http_req, sizeof(http_req),
+                           "POST /t/env HTTP/1.1\r\nHost: %s\r\n"
+                           "Content-Type: application/json\r\n"
+                           "Content-Length: %u\r\n\r\n%s",
+                           COAP_SERVER_HOST, (unsigned)reading_len, reading);
+    const char *http_resp = "HTTP/1.1 204 No Content\r\n\r\n";
+    uint32_t http_app = (uint32_t)req_len + (uint32_t)strlen(http_resp);
+    uint32_t http_keepalive = http_app + (2 + TCP_ACK_SEGMENTS) * TCP_IP_OVERHEAD;
+    uint32_t http_fresh = http_keepalive + TCP_SETUP_TEARDOWN_SEGMENTS * TCP_IP_OVERHEAD;
+
+    printf("[main] per-reading cost (payload %u bytes):\n", (unsigned)reading_len);
+    printf("[main]   coap CON          : %4lu app bytes, %4lu on wire, 1 RTT, %lld ms measured\n",
+           (unsigned long)con_bytes,
+           (unsigned long)(con_bytes + con_dgrams * DATAGRAM_OVERHEAD), (long long)(con_us / 1000));
+    printf("[main]   coap NON          : %4lu app bytes, %4lu on wire, 0 RTT\n",
+           (unsigned long)non_bytes, (unsigned long)(non_bytes + DATAGRAM_OVERHEAD));
+    printf("[main]   http keep-alive   : %4lu app bytes, %4lu on wire, 1 RTT\n",
+           (unsigned long)http_app, (unsigned long)http_keepalive);
+    printf("[main]   http new conn     : %4lu app bytes, %4lu on wire, 2 RTT"
+           " (+2 RTT and ~kB for a TLS 1.2 handshake)\n",
+           (unsigned long)http_app, (unsigned long)http_fresh);
+    printf("[main]   coap retransmits %lu, timeouts %lu\n",
+           (unsigned long)s_coap.stats.retransmits, (unsigned long)s_coap.stats.timeouts);
+
+#if COAP_USE_DTLS
+    coap_dtls_rebind_test(reading, reading_len);
+    coap_dtls_free(&s_dtls);
+#endif
+    modem_udp_close(COAP_UDP_LINK_ID);
+}
+#endif
+
+#if FEATURE_AGGREGATION
+// ============================================================
+// Aggregation test
+//
+// Feeds one minute of a synthetic 100 Hz temperature signal
+// (slow drift + noise + one spike) through the aggregator and
+// compares the JSON bytes that would go uplink against sending
+// every raw sample.
+// ============================================================
+static aggregator_t s_agg;
+static uint32_t s_agg_bytes;
+
+static void agg_on_summary(void *user, const agg_summary_t *sum) {
+    (void)user;
+    char json[192];
+    size_t n = agg_format_summary(&s_agg, sum, json, sizeof(json));
+    s_agg_bytes += (uint32_t)n;
+    printf("[main] agg %s\n", json);
+}
+
+static void agg_on_raw(void *user, const agg_sample_t *samples, size_t n) {
+    (void)user;
+    char json[48];
+    for (size_t i = 0; i < n; i++) {
+        s_agg_bytes += (uint32_t)snprintf(json, sizeof(json),
+                                          "{\"ch\":\"temp\",\"t\":%lu,\"v\":%.2f}",
+                                          (unsigned long)samples[i].t_ms,
+                                          (double)samples[i].value);
+    }
+}
+
+static void aggregation_test(void) {
+    agg_sink_t sink = {
+        .on_summary = agg_on_summary,
+        .on_raw = agg_on_raw,
+        .user = NULL,
+    };
+    agg_init(&s_agg, &sink);
+
+    agg_channel_config_t temp = {
+        .name = "temp",
+        .rollup_ms = 10000,
+        .n_pct = 2,
+        .pct = {0.5f, 0.95f},
+        .low = -20.0f,
+        .high = 60.0f,
+        .sigma_k = 6.0f,
+        .post_trigger = 5,
+    };
+    agg_channel_setup(&s_agg, 0, &temp);
+
+    uint32_t raw_bytes = 0;
+    uint32_t lcg = 12345;
+    char json[48];
+    s_agg_bytes = 0;
+
+    int64_t start = esp_timer_get_time();
+    for (uint32_t t = 0; t < 60000; t += 10) {
+        lcg = lcg * 1664525u + 1013904223u;
+        float noise = (float)(lcg >> 16) / 65536.0f - 0.5f;
+        float v = 21.0f + (float)t / 60000.0f + 0.2f * noise;
+        if (t == 33000) {
+            v += 8.0f;  // Spike that must survive as raw data.
+        }
+        raw_bytes += (uint32_t)snprintf(json, sizeof(json),
+                                        "{\"ch\":\"temp\",\"t\":%lu,\"v\":%.2f}",
+                                        (unsigned long)t, (double)v);
+        agg_add(&s_agg, 0, t, v);
+    }
+    agg_flush(&s_agg);
+    int64_t elapsed = esp_timer_get_time() - start;
+
+    const agg_stats_t *st = &s_agg.stats;
+    printf("[main] aggregation: %lu samples -> %lu summaries + %lu raw, "
+           "%lu triggers\n",
+           (unsigned long)st->samples_in, (unsigned long)st->summaries_out,
+           (unsigned long)st->raw_out, (unsigned long)st->triggers);
+    printf("[main] uplink bytes: raw %lu, aggregated %lu (%.1f%% of raw), "
+           "%lld us/sample incl. JSON\n",
+           (unsigned long)raw_bytes, (unsigned long)s_agg_bytes,
+           100.0 * s_agg_bytes / (raw_bytes ? raw_bytes : 1),
+           (long long)(elapsed / (st->samples_in ? st->samples_in : 1)));
+}
+#endif
+
+#if FEATURE_SD_LOGGING
+// ============================================================
+// SD logging test
+//
+// Logs a burst of fixed-size records as fast as possible and
+// reports the caller-side cost per record (memcpy only) against
+// the background block write time, plus any drops.
+// ============================================================
+static bool s_sd_ok;
+
+static void sd_logging_test(void) {
+    if (lazy_init_require(LAZY_SD_LOG) != ESP_OK) {
+        printf("[main] SD logger unavailable, skipping test\n");
+        return;
+    }
+    s_sd_ok = true;
+
+    uint8_t payload[32];
+    memset(payload, 0xA5, sizeof(payload));
+
+    const uint32_t count = 5000;
+    int64_t start = esp_timer_get_time();
+    for (uint32_t i = 0; i < count; i++) {
+        memcpy(payload, &i, sizeof(i));
+        sd_log_write(1, (uint32_t)(esp_timer_get_time() / 1000), payload,
+                     sizeof(payload));
+    }
+    int64_t hot_us = esp_timer_get_time() - start;
+    esp_err_t err = sd_log_flush(5000);
+    int64_t total_us = esp_timer_get_time() - start;
+
+    const sd_log_stats_t *st = sd_log_stats();
+    printf("[main] sd log: %lu records (%lu dropped), %.2f us/record in caller\n",
+           (unsigned long)st->records, (unsigned long)st->dropped,
+           (double)hot_us / count);
+    printf("[main] sd log: %lu blocks + %lu index sectors, avg write %lu us, "
+           "max %lu us, %lu KB/s, flush %s in %lld ms\n",
+           (unsigned long)st->blocks_written, (unsigned long)st->index_written,
+           (unsigned long)(st->blocks_written ? st->total_write_us / st->blocks_written : 0),
+           (unsigned long)st->max_write_us,
+           (unsigned long)(st->total_write_us
+                               ? (uint64_t)st->blocks_written * SD_LOG_BUF_BYTES * 1000000 /
+                                     st->total_write_us / 1024
+                               : 0),
+           esp_err_to_name(err), (long long)(total_us / 1000));
+}
+#endif
+
+#if FEATURE_AUDIO
+// ============================================================
+// Audio capture test
+//
+// Two consumers read the same DMA frames without copies:
+//   - level meter: converts to 16-bit and prints RMS once a second.
+//   - encoder: ADPCM stage on its own core; encoded bytes go to
+//     a counter standing in for the modem TX queue.
+// Runs for a few seconds and prints the pipeline counters.
+// ============================================================
+static volatile bool s_audio_run;
+
+static void audio_meter_task(void *arg) {
+    int id = (int)(intptr_t)arg;
+    static DSP_ALIGNED int16_t pcm[AUDIO_FRAME_SAMPLES];
+    audio_frame_t f;
+    uint32_t frames = 0;
+    while (s_audio_run) {
+        if (!audio_frame_acquire(id, &f, 100)) {
+            continue;
+        }
+        dsp_s32_to_s16(f.samples, pcm, f.n_samples);
+        bool intact = audio_frame_intact(&f);
+        audio_frame_release(id, &f);
+
+        if (++frames % (1000000 / AUDIO_FRAME_US) == 0) {
+            printf("[main] level: rms %u%s\n", dsp_rms_s16(pcm, f.n_samples),
+                   intact ? "" : " (torn)");
+        }
+    }
+    vTaskDelete(NULL);
+}
+
+// Stands in for the modem TX queue: counts encoded bytes.
+static void audio_uplink_sink(void *user, const uint8_t *data, size_t len,
+                              uint32_t seq) {
+    *(uint32_t *)user += (uint32_t)len;
+}
+
+static void audio_capture_test(void) {
+    // Kernel benchmark + SIMD/reference equivalence, then the
+    // offline encoder benchmark (no microphone needed).
+    dsp_selftest();
+    audio_encoder_bench();
+
+    if (lazy_init_require(LAZY_AUDIO) != ESP_OK) {
+        printf("[main] audio capture unavailable, skipping test\n");
+        return;
+    }
+    int meter = audio_subscribe("meter", AUDIO_DMA_BUF_COUNT - 1);
+    static uint32_t uplink_bytes;
+    audio_encoder_start(audio_uplink_sink, &uplink_bytes);
+    int encoder = audio_encoder_consumer();
+
+    s_audio_run = true;
+    xTaskCreate(audio_meter_task, "audio_meter", 3072, (void *)(intptr_t)meter, 5, NULL);
+    audio_capture_start();
+
+    vTaskDelay(pdMS_TO_TICKS(3000));
+
+    audio_capture_stop();
+    s_audio_run = false;
+    audio_encoder_stop();
+    vTaskDelay(pdMS_TO_TICKS(200));
+
+    const audio_stats_t *st = audio_capture_stats();
+    printf("[main] audio: %lu frames, %lu overruns, %lu gaps\n",
+           (unsigned long)st->frames, (unsigned long)st->overruns,
+           (unsigned long)st->gaps);
+    int ids[] = {meter, encoder};
+    for (int i = 0; i < 2; i++) {
+        const audio_consumer_stats_t *c = audio_consumer_stats(ids[i]);
+        printf("[main] audio %-5s: %lu frames, %lu drops, %lu underruns, "
+               "latency avg %lu us max %lu us\n",
+               c->name, (unsigned long)c->received, (unsigned long)c->drops,
+               (unsigned long)c->underruns,
+               (unsigned long)(c->received ? c->total_latency_us / c->received : 0),
+               (unsigned long)c->max_latency_us);
+    }
+
+    const audio_enc_stats_t *enc = audio_encoder_stats();
+    printf("[main] encoder: %lu frames -> %lu bytes uplink, encode avg %lu us "
+           "max %lu us, %lu torn\n",
+           (unsigned long)enc->frames, (unsigned long)uplink_bytes,
+           (unsigned long)(enc->frames ? enc->total_encode_us / enc->frames : 0),
+           (unsigned long)enc->max_encode_us, (unsigned long)enc->torn);
+}
+#endif
+
+#if FEATURE_CAMERA
+// ============================================================
+// Camera pipeline test
+//
+// The uplink is a stand-in that only accepts bytes at the modem
+// UART rate (10 bits per byte at MODEM_BAUD), so capture
+// outruns it and the drop policy is exercised.
+// ============================================================
+static int cam_throttled_write(void *ctx, const uint8_t *data, size_t len) {
+    uint32_t *debt_us = (uint32_t *)ctx;
+    *debt_us += (uint32_t)((uint64_t)len * 10 * 1000000 / MODEM_BAUD);
+    if (*debt_us >= 1000 * portTICK_PERIOD_MS) {
+        vTaskDelay(pdMS_TO_TICKS(*debt_us / 1000));
+        *debt_us %= 1000 * portTICK_PERIOD_MS;
+    }
+    return (int)len;
+}
+
+static void camera_pipeline_test(void) {
+    if (lazy_init_require(LAZY_CAMERA) != ESP_OK) {
+        printf("[main] camera unavailable, skipping test\n");
+        return;
+    }
+    static uint32_t debt_us;
+    cam_pipeline_start(cam_throttled_write, &debt_us);
+    vTaskDelay(pdMS_TO_TICKS(10000));
+    cam_pipeline_stop();
+    vTaskDelay(pdMS_TO_TICKS(500));
+
+    const cam_stats_t *st = cam_pipeline_stats();
+    printf("[main] camera (%s): %lu captured, %lu sent, %lu dropped, %lu oversize, "
+           "max JPEG %lu bytes\n",
+           BOARD_NAME, (unsigned long)st->captured, (unsigned long)st->sent,
+           (unsigned long)st->dropped, (unsigned long)st->oversize,
+           (unsigned long)st->max_jpeg_bytes);
+    printf("[main] camera latency avg %lu ms max %lu ms, %llu bytes uplink, "
+           "memory PSRAM %lu + internal %lu bytes\n",
+           (unsigned long)(st->sent ? st->total_latency_ms / st->sent : 0),
+           (unsigned long)st->max_latency_ms, (unsigned long long)st->bytes_sent,
+           (unsigned long)st->psram_used, (unsigned long)st->internal_used);
+}
+#endif
+
+#if FEATURE_DISPLAY
+// ============================================================
+// Display benchmark
+//
+// A 40x40 sprite bounces over a gradient background. Each pass
+// runs for DISPLAY_BENCH_MS:
+//   full  — every frame invalidates the whole screen.
+//   dirty — every frame invalidates only the sprite's old and
+//           new positions.
+// CPU load is render time / wall time; "DMA wait" is time the
+// renderer spent blocked because both band buffers were still
+// on the bus (render fully hidden behind DMA when it is high).
+// ============================================================
+#define DISPLAY_BENCH_MS 3000
+#define SPRITE_SIZE 40
+
+typedef struct {
+    int x;
+    int y;
+} sprite_t;
+
+static void render_scene(void *user, const display_rect_t *area, uint16_t *pixels) {
+    const sprite_t *sp = (const sprite_t *)user;
+    for (int y = area->y; y < area->y + area->h; y++) {
+        uint16_t bg = DISPLAY_RGB565(0, 0, (y * 255) / DISPLAY_HEIGHT);
+        bool row_hit = y >= sp->y && y < sp->y + SPRITE_SIZE;
+        for (int x = area->x; x < area->x + area->w; x++) {
+            bool hit = row_hit && x >= sp->x && x < sp->x + SPRITE_SIZE;
+            *pixels++ = hit ? DISPLAY_RGB565(255, 64, 0) : bg;
+        }
+    }
+}
+
+static void display_bench_pass(const char *name, bool dirty_only) {
+    sprite_t sp = {0, 0};
+    int dx = 3;
+    int dy = 2;
+    display_invalidate_all();
+    display_flush(render_scene, &sp);
+    display_wait_idle();
+    display_reset_stats();
+
+    int64_t start = esp_timer_get_time();
+    while (esp_timer_get_time() - start < DISPLAY_BENCH_MS * 1000LL) {
+        sprite_t old = sp;
+        sp.x += dx;
+        sp.y += dy;
+        if (sp.x < 0 || sp.x + SPRITE_SIZE > DISPLAY_WIDTH) {
+            dx = -dx;
+            sp.x += 2 * dx;
+        }
+        if (sp.y < 0 || sp.y + SPRITE_SIZE > DISPLAY_HEIGHT) {
+            dy = -dy;
+            sp.y += 2 * dy;
+        }
+        if (dirty_only) {
+            display_invalidate(old.x, old.y, SPRITE_SIZE, SPRITE_SIZE);
+            display_invalidate(sp.x, sp.y, SPRITE_SIZE, SPRITE_SIZE);
+        } else {
+            display_invalidate_all();
+        }
+        display_flush(render_scene, &sp);
+    }
+    display_wait_idle();
+    int64_t elapsed_us = esp_timer_get_time() - start;
+
+    const display_stats_t *st = display_stats();
+    printf("[main] display %-5s: %.1f fps, %lu px/frame, CPU %.1f%%, DMA wait %.1f%%\n",
+           name, st->frames * 1e6 / (double)elapsed_us,
+           (unsigned long)(st->frames ? st->pixels / st->frames : 0),
+           100.0 * (double)st->render_us / (double)elapsed_us,
+           100.0 * (double)st->wait_us / (double)elapsed_us);
+}
+
+static bool s_display_ok;
+
+static void display_test(void) {
+    if (lazy_init_require(LAZY_DISPLAY) != ESP_OK) {
+        printf("[main] display unavailable, skipping test\n");
+        return;
+    }
+    s_display_ok = true;
+    display_bench_pass("full", false);
+    display_bench_pass("dirty", true);
+}
+#endif
+
+#if FEATURE_I2C_BUS
+// ============================================================
+// I2C bus manager test
+//
+// Queues I2C_TEST_TXNS transactions at once, each reading an
+// IMU block (0x68, reg 0x3B, 14 bytes) and a pressure sensor
+// block (0x76, reg 0xF7, 8 bytes). The submitting task only
+// pays for the queue push; completions arrive as task
+// notifications from the callbacks. Without sensors attached
+// every transaction fails with a NACK, which still exercises
+// the queue and error path.
+// ============================================================
+#define I2C_TEST_TXNS 8
+
+static void i2c_test_done(i2c_txn_t *txn, void *user) {
+    xTaskNotifyGive((TaskHandle_t)user);
+}
+
+static void i2c_bus_test(void) {
+    if (lazy_init_require(LAZY_I2C_BUS) != ESP_OK) {
+        printf("[main] I2C bus unavailable, skipping test\n");
+        return;
+    }
+    static i2c_txn_t txns[I2C_TEST_TXNS];
+    static uint8_t imu[I2C_TEST_TXNS][14];
+    static uint8_t baro[I2C_TEST_TXNS][8];
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+    i2c_bus_reset_stats();
+    int64_t start = esp_timer_get_time();
+    int submitted = 0;
+    for (int i = 0; i < I2C_TEST_TXNS; i++) {
+        i2c_txn_init(&txns[i], i2c_test_done, self);
+        i2c_txn_read_reg(&txns[i], 0x68, 0x3B, imu[i], sizeof(imu[i]));
+        i2c_txn_read_reg(&txns[i], 0x76, 0xF7, baro[i], sizeof(baro[i]));
+        if (i2c_bus_submit(&txns[i]) == ESP_OK) {
+            submitted++;
+        }
+    }
+    int64_t submit_us = esp_timer_get_time() - start;
+
+    for (int i = 0; i < submitted; i++) {
+        ulTaskNotifyTake(pdFALSE, pdMS_TO_TICKS(I2C_TIMEOUT_MS * I2C_TXN_MAX_OPS));
+    }
+    int64_t elapsed_us = esp_timer_get_time() - start;
+
+    int64_t total_latency_us = 0;
+    int64_t max_latency_us = 0;
+    int ok = 0;
+    for (int i = 0; i < submitted; i++) {
+        int64_t latency_us = txns[i].t_done_us - txns[i].t_submit_us;
+        total_latency_us += latency_us;
+        if (latency_us > max_latency_us) {
+            max_latency_us = latency_us;
+        }
+        if (txns[i].result == ESP_OK) {
+            ok++;
+        }
+    }
+
+    const i2c_bus_stats_t *st = i2c_bus_stats();
+    printf("[main] i2c: %d txns submitted in %lld us (caller never blocked), %d ok, "
+           "%lu failed\n",
+           submitted, (long long)submit_us, ok, (unsigned long)st->errors);
+    printf("[main] i2c: latency avg %lld us max %lld us, bus busy %.1f%% of %lld us\n",
+           (long long)(submitted ? total_latency_us / submitted : 0),
+           (long long)max_latency_us,
+           elapsed_us > 0 ? 100.0 * (double)st->busy_us / (double)elapsed_us : 0.0,
+           (long long)elapsed_us);
+}
+#endif
+
+#if SPI_ARB_ENABLED
+// ============================================================
+// SPI bus sharing test
+//
+// With both SD logging and the display up, a background task
+// logs a 32-byte record every millisecond while the display
+// benchmark redraws dirty rectangles. Both go through the SPI
+// arbiter; its report shows how busy the bus was and how long
+// each device queued behind the other.
+// ============================================================
+#if FEATURE_SD_LOGGING && FEATURE_DISPLAY
+static volatile bool s_spi_load_run;
+
+static void spi_sd_load_task(void *arg) {
+    uint8_t payload[32];
+    memset(payload, 0x5A, sizeof(payload));
+    while (s_spi_load_run) {
+        sd_log_write(2, (uint32_t)(esp_timer_get_time() / 1000), payload, sizeof(payload));
+        vTaskDelay(1);
+    }
+    vTaskDelete(NULL);
+}
+#endif
+
+static void spi_bus_test(void) {
+#if FEATURE_SD_LOGGING && FEATURE_DISPLAY
+    if (s_sd_ok && s_display_ok) {
+        spi_arb_reset_stats();
+        s_spi_load_run = true;
+        xTaskCreate(spi_sd_load_task, "spi_sd_load", 3072, NULL, 4, NULL);
+        display_bench_pass("+sd", true);
+        s_spi_load_run = false;
+        sd_log_flush(5000);
+    }
+#endif
+    spi_arb_print_stats();
+}
+#endif
+
+#if FEATURE_DEEP_SLEEP
+// ============================================================
+// Deep-sleep duty cycle
+//
+// Wake (or cold start) -> modem up -> one NON CoAP reading ->
+// deep sleep. The uplink sequence and the CoAP message id /
+// token continue from RTC memory, so the server never sees a
+// repeated message id from a woken device.
+//
+// With COAP_USE_DTLS the reading goes over a DTLS session. The
+// session is saved to RTC memory right after the handshake (it
+// carries the server's newest ticket) and offered on the next
+// timer wake; the report then shows wake-to-first-byte for
+// resumed and full handshakes side by side.
+// ============================================================
+
+// Wraps the uplink transport to stamp the first byte of the
+// reading. Under DTLS that is after the handshake, so the
+// figure includes it.
+static int coap_sleep_send(void *ctx, const uint8_t *data, size_t len) {
+    const coap_transport_t *link = (const coap_transport_t *)ctx;
+    deep_sleep_mark_first_byte();
+    return link->send(link->ctx, data, len);
+}
+
+static int coap_sleep_recv(void *ctx, uint8_t *buf, size_t len, uint32_t timeout_ms) {
+    const coap_transport_t *link = (const coap_transport_t *)ctx;
+    return link->recv(link->ctx, buf, len, timeout_ms);
+}
+
+#if COAP_USE_DTLS
+// Session handshake for the cycle; saves the session for the
+// next wake.
+static bool deep_sleep_dtls_up(coap_transport_t *link) {
+    static uint8_t saved[DEEP_SLEEP_TLS_SESSION_MAX];
+    size_t saved_len = 0;
+    const uint8_t *retained = deep_sleep_tls_session(&saved_len);
+    if (!coap_dtls_up(link, retained, saved_len)) {
+        return false;
+    }
+    deep_sleep_note_session(coap_dtls_resumed(&s_dtls));
+    saved_len = coap_dtls_save_session(&s_dtls, saved, sizeof(saved));
+    deep_sleep_save_tls_session(saved, saved_len);
+    return true;
+}
+#endif
+
+// One NON reading over link, cursors carried over from RTC memory.
+static void deep_sleep_post(coap_transport_t *link) {
+    coap_transport_t tp = {
+        .send = coap_sleep_send,
+        .recv = coap_sleep_recv,
+        .ctx = link,
+    };
+    coap_client_init(&s_coap, &tp, (uint32_t)esp_timer_get_time());
+    if (deep_sleep_is_wake()) {
+        s_coap.next_mid = (uint16_t)deep_sleep_cursor(DS_CURSOR_COAP_MID);
+        s_coap.next_token = deep_sleep_cursor(DS_CURSOR_COAP_TOKEN);
+    }
+
+    uint32_t seq = deep_sleep_cursor(DS_CURSOR_UPLINK_SEQ);
+    char reading[48];
+    int n = snprintf(reading, sizeof(reading), "{\"seq\":%lu,\"t\":21.5}",
+                     (unsigned long)seq);
+    if (coap_post(&s_coap, "t/env", COAP_FORMAT_JSON, (const uint8_t *)reading,
+                  (size_t)n, false, NULL) == ESP_OK) {
+        deep_sleep_set_cursor(DS_CURSOR_UPLINK_SEQ, seq + 1);
+    }
+    deep_sleep_set_cursor(DS_CURSOR_COAP_MID, s_coap.next_mid);
+    deep_sleep_set_cursor(DS_CURSOR_COAP_TOKEN, s_coap.next_token);
+}
+
+static void deep_sleep_cycle(void) {
+    if (deep_sleep_modem_up() == ESP_OK &&
+        modem_udp_open(COAP_UDP_LINK_ID, COAP_LOCAL_PORT)) {
+        coap_transport_t link = {
+            .send = coap_modem_send,
+            .recv = coap_modem_recv,
+            .ctx = NULL,
+        };
+#if COAP_USE_DTLS
+        if (deep_sleep_dtls_up(&link)) {
+            deep_sleep_post(&link);
+            coap_dtls_free(&s_dtls);
+        } else {
+            printf("[main] dtls session not up, no reading this cycle\n");
+        }
+#else
+        deep_sleep_post(&link);
+#endif
+        modem_udp_close(COAP_UDP_LINK_ID);
+    }
+    deep_sleep_report();
+    boot_prof_print();
+    deep_sleep_enter(DEEP_SLEEP_INTERVAL_S);
+}
+#endif
+
+#if FEATURE_POWER_MGMT
+// ============================================================
+// Power management benchmark
+//
+// POWER_BENCH_TXNS AT+CSQ transactions, POWER_BENCH_GAP_MS
+// apart, parsed under POWER_PARSE like a real reply would be.
+// Pass 1 runs as the firmware does (DFS + light sleep, locks
+// only around the exchange and parse); pass 2 pins the chip at
+// max clock and awake, the same as power management off.
+//
+// Energy comes from power_estimate_uj(): lock hold times times
+// the POWER_UA_* current model, gap included. It ranks the two
+// configurations; a current probe gives the real numbers.
+// ============================================================
+static void power_bench_pass(const char *name, bool performance) {
+    if (performance) {
+        power_set_performance(true);
+    }
+    power_domain_stats_t uart0 = power_domain_stats(POWER_UART);
+    power_domain_stats_t parse0 = power_domain_stats(POWER_PARSE);
+    power_domain_stats_t crypto0 = power_domain_stats(POWER_CRYPTO);
+
+    int64_t total_latency_us = 0;
+    int64_t max_latency_us = 0;
+    int ok = 0;
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < POWER_BENCH_TXNS; i++) {
+        char resp[64];
+        int64_t t0 = esp_timer_get_time();
+        int n = modem_send_at("AT+CSQ\r\n", resp, sizeof(resp), MODEM_CMD_TIMEOUT_MS);
+        int64_t latency_us = esp_timer_get_time() - t0;
+        total_latency_us += latency_us;
+        if (latency_us > max_latency_us) {
+            max_latency_us = latency_us;
+        }
+
+        power_lock(POWER_PARSE);
+        int rssi = 99;
+        int ber = 99;
+        const char *p = n >= 0 ? strstr(resp, "+CSQ:") : NULL;
+        if (p && sscanf(p, "+CSQ: %d,%d", &rssi, &ber) == 2) {
+            ok++;
+        }
+        power_unlock(POWER_PARSE);
+
+        vTaskDelay(pdMS_TO_TICKS(POWER_BENCH_GAP_MS));
+    }
+    uint64_t total_us = (uint64_t)(esp_timer_get_time() - start);
+
+    if (performance) {
+        power_set_performance(false);
+    }
+
+    uint64_t uart_us = power_domain_stats(POWER_UART).held_us - uart0.held_us;
+    uint64_t cpu_max_us = (power_domain_stats(POWER_PARSE).held_us - parse0.held_us) +
+                          (power_domain_stats(POWER_CRYPTO).held_us - crypto0.held_us);
+    uint64_t awake_us = uart_us + cpu_max_us;
+    if (performance) {
+        cpu_max_us = total_us;
+        awake_us = total_us;
+    }
+    uint32_t uj = power_estimate_uj(total_us, cpu_max_us, awake_us);
+
+    printf("[main] power %-5s: %d/%d ok, latency avg %lld us max %lld us\n", name, ok,
+           POWER_BENCH_TXNS, (long long)(total_latency_us / POWER_BENCH_TXNS),
+           (long long)max_latency_us);
+    printf("[main] power %-5s: awake %llu ms, max clock %llu ms of %llu ms -> "
+           "~%lu uJ/txn, ~%lu uA avg (model)\n",
+           name, (unsigned long long)(awake_us / 1000),
+           (unsigned long long)(cpu_max_us / 1000), (unsigned long long)(total_us / 1000),
+           (unsigned long)(uj / POWER_BENCH_TXNS),
+           (unsigned long)(total_us ? (uint64_t)uj * 1000000000ULL / POWER_SUPPLY_MV / total_us
+                                    : 0));
+}
+
+static void power_test(void) {
+    power_bench_pass("dfs", false);
+    power_bench_pass("max", true);
+}
+#endif
+
+// ============================================================
+// Registration recovery test
+//
+// The fake modem drops coverage for MODEM_REG_TEST_OUTAGE_MS.
+// The state machine should fall back to SIM_READY and rerun only
+// registration and PDP activation: the SIM_READY stage (boot
+// handshake + SIM) must show no restart.
+// ============================================================
+static void modem_reg_test(void) {
+    if (modem_reg_state() < MODEM_REG_PDP_ACTIVE) {
+        printf("[main] reg: network not up (%s), skipping recovery test\n",
+               modem_reg_state_name(modem_reg_state()));
+        return;
+    }
+    modem_reg_stats_t before[MODEM_REG_STATE_COUNT];
+    for (int s = 0; s < MODEM_REG_STATE_COUNT; s++) {
+        before[s] = modem_reg_stats((modem_reg_state_t)s);
+    }
+
+    int64_t t0 = esp_timer_get_time();
+    fake_modem_drop_coverage(MODEM_REG_TEST_OUTAGE_MS);
+    if (modem_reg_wait_lost(MODEM_REG_POLL_MS * 2) != ESP_OK) {
+        printf("[main] reg: coverage loss not reported\n");
+        return;
+    }
+    int64_t t_lost = esp_timer_get_time();
+    printf("[main] reg: lost after %lld ms, state %s\n", (long long)((t_lost - t0) / 1000),
+           modem_reg_state_name(modem_reg_state()));
+
+    uint32_t budget_ms = MODEM_REG_TEST_OUTAGE_MS + MODEM_PDP_TIMEOUT_MS;
+    if (modem_reg_wait(MODEM_REG_PDP_ACTIVE, budget_ms) != ESP_OK) {
+        printf("[main] reg: not recovered within %lu ms\n", (unsigned long)budget_ms);
+    } else {
+        printf("[main] reg: PDP_ACTIVE again %lld ms after the loss (outage %d ms)\n",
+               (long long)((esp_timer_get_time() - t_lost) / 1000),
+               MODEM_REG_TEST_OUTAGE_MS);
+    }
+    for (int s = MODEM_REG_SIM_READY; s <= MODEM_REG_PDP_ACTIVE; s++) {
+        modem_reg_stats_t st = modem_reg_stats((modem_reg_state_t)s);
+        printf("[main] reg: stage to %-10s reruns %lu\n",
+               modem_reg_state_name((modem_reg_state_t)s),
+               (unsigned long)(st.restarts - before[s].restarts));
+    }
+    modem_reg_print();
+}
+
+// ============================================================
+// Modem socket test
+//
+// Every modem link at once: TCP sockets plus one UDP socket,
+// each against the fake modem's loopback echo peer. Connects
+// complete by URC, echoes arrive as "+CIPRXGET: 1" and are
+// pulled on recv(); one peer then hangs up (POLLHUP, recv 0).
+// ============================================================
+static void modem_sock_test(void) {
+    if (modem_sock_init() != ESP_OK) {
+        printf("[main] sock: init failed\n");
+        return;
+    }
+    int count = modem_sock_count();
+    modem_sock_pollfd_t fds[MODEM_SOCK_MAX];
+    int open = 0;
+
+    // --- Open and connect (last one UDP) ---
+    for (int i = 0; i < count; i++) {
+        modem_sock_type_t type = i == count - 1 ? MODEM_SOCK_UDP : MODEM_SOCK_TCP;
+        int sock = modem_sock_open(type);
+        if (sock < 0) {
+            break;
+        }
+        if (modem_sock_connect(sock, "echo.test", 7) < 0 && errno != EINPROGRESS) {
+            printf("[main] sock: connect %d failed (errno %d)\n", sock, errno);
+            modem_sock_close(sock);
+            continue;
+        }
+        fds[open++] = (modem_sock_pollfd_t){.sock = sock, .events = MODEM_SOCK_POLLOUT};
+    }
+
+    int64_t t0 = esp_timer_get_time();
+    int ready = 0;
+    while (ready < open && modem_sock_poll(fds, open, MODEM_CMD_TIMEOUT_MS) > 0) {
+        ready = 0;
+        for (int i = 0; i < open; i++) {
+            ready += (fds[i].revents & MODEM_SOCK_POLLOUT) != 0;
+        }
+    }
+    printf("[main] sock: %d/%d sockets connected in %lld ms\n", ready, open,
+           (long long)((esp_timer_get_time() - t0) / 1000));
+
+    // --- Echo rounds, all sockets in flight together ---
+    int ok = 0;
+    int bad = 0;
+    t0 = esp_timer_get_time();
+    for (int r = 0; r < MODEM_SOCK_TEST_ROUNDS; r++) {
+        char tx[MODEM_SOCK_MAX][48];
+        size_t got[MODEM_SOCK_MAX] = {0};
+        char rx[MODEM_SOCK_MAX][48];
+        for (int i = 0; i < open; i++) {
+            snprintf(tx[i], sizeof(tx[i]), "socket %d round %d payload", fds[i].sock, r);
+            modem_sock_send(fds[i].sock, tx[i], strlen(tx[i]));
+            fds[i].events = MODEM_SOCK_POLLIN;
+        }
+
+        int done = 0;
+        while (done < open && modem_sock_poll(fds, open, MODEM_CMD_TIMEOUT_MS) > 0) {
+            for (int i = 0; i < open; i++) {
+                if (!(fds[i].revents & MODEM_SOCK_POLLIN) || got[i] == strlen(tx[i])) {
+                    continue;
+                }
+                int n = modem_sock_recv(fds[i].sock, rx[i] + got[i],
+                                        sizeof(rx[i]) - got[i]);
+                if (n > 0) {
+                    got[i] += (size_t)n;
+                    if (got[i] == strlen(tx[i])) {
+                        fds[i].events = 0;
+                        done++;
+                    }
+                }
+            }
+        }
+        for (int i = 0; i < open; i++) {
+            bool match = got[i] == strlen(tx[i]) && memcmp(rx[i], tx[i], got[i]) == 0;
+            ok += match;
+            bad += !match;
+        }
+    }
+    int64_t dt_ms = (esp_timer_get_time() - t0) / 1000;
+    printf("[main] sock: %d echoes ok, %d missing/corrupt over %d rounds (%lld ms)\n", ok,
+           bad, MODEM_SOCK_TEST_ROUNDS, (long long)dt_ms);
+
+    // --- Peer hang-up on the first TCP socket ---
+    if (open > 1) {
+        fake_modem_close_peer(fds[0].sock, 0);
+        fds[0].events = MODEM_SOCK_POLLIN;
+        modem_sock_poll(fds, 1, MODEM_CMD_TIMEOUT_MS);
+        char tmp[8];
+        int n = modem_sock_recv(fds[0].sock, tmp, sizeof(tmp));
+        printf("[main] sock: peer close -> %s, recv %d\n",
+               (fds[0].revents & MODEM_SOCK_POLLHUP) ? "POLLHUP" : "no hang-up", n);
+    }
+
+    for (int i = 0; i < open; i++) {
+        modem_sock_close(fds[i].sock);
+    }
+    modem_sock_stats_t st = modem_sock_stats();
+    printf("[main] sock: connects %lu (failed %lu), tx %lu B, rx %lu B, "
+           "%lu rx URCs, %lu pulls, %lu peer closes\n",
+           (unsigned long)st.connects, (unsigned long)st.connect_failures,
+           (unsigned long)st.tx_bytes, (unsigned long)st.rx_bytes,
+           (unsigned long)st.rx_urcs, (unsigned long)st.pulls,
+           (unsigned long)st.peer_closes);
+    modem_sock_deinit();
+}
+
+#if FEATURE_SMS
+// ============================================================
+// SMS test
+//
+// The fake modem's store holds messages from before boot; each
+// message sent comes back from its stand-in SMSC. However many
+// "+CMTI" arrive, each modem_sms_poll() reads them with one
+// AT+CMGL.
+// ============================================================
+static void sms_print(const modem_sms_t *msg, void *user) {
+    static const char *const alphabets[] = {"GSM7", "8-bit", "UCS2"};
+    (*(int *)user)++;
+    printf("[main] sms: #%d from %s at %02u/%02u/%02u %02u:%02u:%02u (%s%s): %s\n",
+           msg->index, msg->number, msg->time.year, msg->time.month, msg->time.day,
+           msg->time.hour, msg->time.minute, msg->time.second, alphabets[msg->alphabet],
+           msg->truncated ? ", truncated" : "", msg->text);
+}
+
+static void sms_test(void) {
+    int received = 0;
+    if (modem_sms_init(sms_print, &received) != ESP_OK) {
+        printf("[main] sms: init failed\n");
+        return;
+    }
+
+    // --- Stored while nobody listened ---
+    int n = modem_sms_poll(0);
+    printf("[main] sms: %d stored messages in one listing\n", n);
+
+    // --- Round trip: GSM 7-bit, extension characters, UCS2 ---
+    static const char *const texts[] = {
+        "status?",
+        "set interval=60 {ack} [ok] 5€",
+        "Temp 23\xC2\xB0" "C",
+    };
+    const int count = (int)(sizeof(texts) / sizeof(texts[0]));
+    modem_sms_stats_t before = modem_sms_stats();
+    int64_t t0 = esp_timer_get_time();
+    for (int i = 0; i < count; i++) {
+        esp_err_t err = modem_sms_send(MODEM_SMS_TEST_NUMBER, texts[i]);
+        if (err != ESP_OK) {
+            printf("[main] sms: send %d failed (%s)\n", i, esp_err_to_name(err));
+        }
+    }
+    int64_t t_sent = esp_timer_get_time();
+
+    // Let every echo announce itself, then read them together.
+    while (modem_sms_stats().cmti_urcs - before.cmti_urcs < (uint32_t)count &&
+           esp_timer_get_time() - t_sent < (int64_t)MODEM_CMD_TIMEOUT_MS * 1000) {
+        vTaskDelay(pdMS_TO_TICKS(50));
+    }
+    received = 0;
+    modem_sms_poll(MODEM_CMD_TIMEOUT_MS);
+
+    modem_sms_stats_t st = modem_sms_stats();
+    printf("[main] sms: sent %d in %lld ms; %d back from %lu +CMTI with %lu AT+CMGL\n",
+           count, (long long)((t_sent - t0) / 1000), received,
+           (unsigned long)(st.cmti_urcs - before.cmti_urcs),
+           (unsigned long)(st.list_cmds - before.list_cmds));
+    printf("[main] sms: totals sent %lu (failed %lu), received %lu, %lu listings, "
+           "%lu deletes, %lu decode errors\n",
+           (unsigned long)st.sent, (unsigned long)st.send_failures,
+           (unsigned long)st.received, (unsigned long)st.list_cmds,
+           (unsigned long)st.delete_cmds, (unsigned long)st.decode_errors);
+}
+#endif
+
+#if FEATURE_GNSS
+// ============================================================
+// GNSS test
+//
+// Parser throughput first: a canned epoch (GGA, RMC, three GSV)
+// fed in 64-byte chunks, the way it comes off the UART ring,
+// for GNSS_BENCH_MS. A corrupted sentence must be dropped
+// without losing the next one. Then the live fix from the fake
+// modem's receiver.
+// ============================================================
+static const char s_nmea_epoch[] =
+    "$GPGGA,123519.00,4807.0380,N,01131.0000,E,1,06,0.9,545.4,M,46.9,M,,*67\r\n"
+    "$GPRMC,123519.00,A,4807.0380,N,01131.0000,E,018.0,000.0,171026,,,A*5B\r\n"
+    "$GPGSV,2,1,05,03,45,120,42,07,62,045,45,11,20,300,33,19,38,210,38*71\r\n"
+    "$GPGSV,2,2,05,28,12,080,*4D\r\n"
+    "$GLGSV,1,1,02,65,55,160,40,72,30,020,36*66\r\n";
+
+static void nmea_count(const nmea_sentence_t *s, void *user) {
+    (void)s;
+    (*(uint32_t *)user)++;
+}
+
+static void gnss_test(void) {
+    // --- Parser benchmark ---
+    static nmea_parser_t p;
+    uint32_t delivered = 0;
+    nmea_init(&p, nmea_count, &delivered);
+    const size_t len = sizeof(s_nmea_epoch) - 1;
+    int64_t t0 = esp_timer_get_time();
+    int64_t t_end = t0 + (int64_t)GNSS_BENCH_MS * 1000;
+    int64_t now = t0;
+    while (now < t_end) {
+        for (size_t off = 0; off < len; off += 64) {
+            size_t n = len - off < 64 ? len - off : 64;
+            nmea_feed(&p, (const uint8_t *)s_nmea_epoch + off, n);
+        }
+        now = esp_timer_get_time();
+    }
+    int64_t us = now - t0;
+    printf("[main] gnss: %lu sentences (%lu bytes) in %lld ms: %llu sentences/s, "
+           "%llu KB/s, %lu errors\n",
+           (unsigned long)delivered, (unsigned long)p.stats.bytes, (long long)(us / 1000),
+           (unsigned long long)((uint64_t)delivered * 1000000 / (uint64_t)us),
+           (unsigned long long)((uint64_t)p.stats.bytes * 1000000 / 1024 / (uint64_t)us),
+           (unsigned long)(p.stats.checksum_errors + p.stats.overflows +
+                           p.stats.decode_errors + p.stats.unsupported));
+
+    // --- Corrupted sentence: dropped, next one still decoded ---
+    char bad[sizeof(s_nmea_epoch)];
+    memcpy(bad, s_nmea_epoch, sizeof(bad));
+    bad[20] ^= 0x01;  // A latitude digit of the GGA.
+    nmea_init(&p, nmea_count, &delivered);
+    delivered = 0;
+    nmea_feed(&p, (const uint8_t *)bad, len);
+    printf("[main] gnss: corrupted epoch: %lu of 5 decoded, %lu checksum errors\n",
+           (unsigned long)delivered, (unsigned long)p.stats.checksum_errors);
+
+    // --- Live fix from the modem ---
+    if (gnss_start() != ESP_OK) {
+        printf("[main] gnss: start failed\n");
+        return;
+    }
+    gnss_fix_t fix;
+    t0 = esp_timer_get_time();
+    while (!gnss_get_fix(&fix) &&
+           esp_timer_get_time() - t0 < (int64_t)GNSS_TEST_WAIT_MS * 1000) {
+        vTaskDelay(pdMS_TO_TICKS(50));
+    }
+    if (!fix.valid) {
+        printf("[main] gnss: no fix after %d ms\n", GNSS_TEST_WAIT_MS);
+    } else {
+        // Two epochs apart, the fix has moved.
+        vTaskDelay(pdMS_TO_TICKS(2000));
+        gnss_fix_t later;
+        gnss_get_fix(&later);
+        printf("[main] gnss: fix after %lld ms: %02u:%02u:%02u %04u-%02u-%02u, "
+               "lat %ld lon %ld (1e-7 deg), alt %ld mm, %u sats, hdop %u.%02u\n",
+               (long long)((fix.updated_us - t0) / 1000), fix.time.hour, fix.time.minute,
+               fix.time.second, fix.date.year, fix.date.month, fix.date.day,
+               (long)fix.lat_e7, (long)fix.lon_e7, (long)fix.alt_mm, fix.satellites,
+               fix.hdop_x100 / 100, fix.hdop_x100 % 100);
+        printf("[main] gnss: 2 s later: lat %+ld (1e-7 deg), %lu mm/s, course %u.%02u deg\n",
+               (long)(later.lat_e7 - fix.lat_e7), (unsigned long)later.speed_mmps,
+               later.course_cdeg / 100, later.course_cdeg % 100);
+    }
+    gnss_sat_t sky[GNSS_SATS_MAX];
+    int in_view = gnss_get_sky(sky, GNSS_SATS_MAX);
+    int tracked = 0;
+    for (int i = 0; i < in_view; i++) {
+        tracked += sky[i].sat.snr >= 0;
+    }
+    nmea_stats_t st = gnss_stats();
+    printf("[main] gnss: %d satellites in view (%d tracked); %lu sentences, "
+           "%lu checksum errors, %lu overflows\n",
+           in_view, tracked, (unsigned long)st.sentences,
+           (unsigned long)st.checksum_errors, (unsigned long)st.overflows);
+    gnss_stop();
+}
+#endif
+
+#if FEATURE_FRAME_LINK
+// ============================================================
+// Framed link test
+//
+// Echoes FRAME_BENCH_BYTES through the fake modem's framed peer
+// at several injected bit-error rates (both directions) and
+// reports goodput: verified bytes back per second, next to the
+// raw line rate. Every byte is checked, so a corrupted frame
+// that got through would show as a mismatch.
+// ============================================================
+static void frame_test(void) {
+    static const uint32_t ber_ppm[] = {0, 10, 50, 200};
+    static uint8_t tx[FRAME_PAYLOAD_MAX];
+    static uint8_t rx[FRAME_PAYLOAD_MAX];
+    const uint32_t line_rate = MODEM_BAUD / 10;  // Bytes/s, 8N1.
+
+    for (size_t level = 0; level < sizeof(ber_ppm) / sizeof(ber_ppm[0]); level++) {
+        fake_modem_set_bit_errors(ber_ppm[level]);
+        if (modem_frame_open() != ESP_OK) {
+            printf("[main] frame: open failed\n");
+            fake_modem_set_bit_errors(0);
+            return;
+        }
+        modem_frame_set_bit_errors(ber_ppm[level]);
+
+        // --- Send while the window allows, collect the echoes ---
+        uint32_t sent = 0;
+        uint32_t received = 0;
+        uint32_t mismatches = 0;
+        bool failed = false;
+        int64_t t0 = esp_timer_get_time();
+        while (received < FRAME_BENCH_BYTES && !failed) {
+            int s = 0;
+            if (sent < FRAME_BENCH_BYTES) {
+                size_t n = FRAME_BENCH_BYTES - sent < FRAME_PAYLOAD_MAX
+                               ? FRAME_BENCH_BYTES - sent
+                               : FRAME_PAYLOAD_MAX;
+                for (size_t i = 0; i < n; i++) {
+                    tx[i] = (uint8_t)((sent + i) * 7 + (sent + i) / 251);
+                }
+                s = modem_frame_send(tx, n, 0);
+                sent += s > 0 ? (uint32_t)s : 0;
+                failed = s < 0;
+            }
+            int r = modem_frame_recv(rx, sizeof(rx), s > 0 ? 0 : 20);
+            for (int i = 0; i < r; i++) {
+                uint32_t pos = received + (uint32_t)i;
+                mismatches += rx[i] != (uint8_t)(pos * 7 + pos / 251);
+            }
+            received += r > 0 ? (uint32_t)r : 0;
+            failed = failed || r < 0;
+        }
+        int64_t us = esp_timer_get_time() - t0;
+
+        // Clean wire for the disconnect.
+        modem_frame_set_bit_errors(0);
+        fake_modem_set_bit_errors(0);
+        modem_frame_flush(FRAME_RTO_MS * 2);
+        frame_link_stats_t st = modem_frame_stats();
+        modem_frame_close();
+
+        uint32_t goodput = (uint32_t)((uint64_t)received * 1000000 / (uint64_t)us);
+        printf("[main] frame: %lu ppm: %lu B echoed in %lld ms, goodput %lu B/s "
+               "(%lu%% of line rate), %lu mismatches%s\n",
+               (unsigned long)ber_ppm[level], (unsigned long)received, (long long)(us / 1000),
+               (unsigned long)goodput, (unsigned long)(goodput * 100 / line_rate),
+               (unsigned long)mismatches, failed ? ", LINK FAILED" : "");
+        printf("[main] frame:   %lu frames out (%lu selective, %lu timeout resends), "
+               "%lu in, %lu CRC errors, %lu out of order, %lu duplicates\n",
+               (unsigned long)st.frames_tx, (unsigned long)st.sack_resends,
+               (unsigned long)st.timeout_resends, (unsigned long)st.frames_rx,
+               (unsigned long)st.crc_errors, (unsigned long)st.out_of_order,
+               (unsigned long)st.duplicates);
+    }
+}
+#endif
+
+// ============================================================
+// Flow-control test
+//
+// The fake modem stops reading for MODEM_FLOW_TEST_STALL_MS
+// while MODEM_FLOW_TEST_BYTES arrive: far more than its
+// FAKE_MODEM_RX_BUF ring and the FIFO hold. Run under each mode
+// on both ends; with flow control nothing may be lost, and the
+// time shows what holding the sender back costs. XON/XOFF also
+// reports the wire bytes its escaping added.
+// ============================================================
+static void flow_test(void) {
+    static const flow_mode_t modes[] = {FLOW_HW, FLOW_SW, FLOW_NONE};
+    static uint8_t burst[MODEM_FLOW_TEST_BYTES];
+    char cmd[40];
+    char resp[48];
+    size_t escapes = 0;
+
+    for (size_t i = 0; i < sizeof(burst); i++) {
+        burst[i] = FLOW_TEST_BYTE(i);
+        escapes += burst[i] == FLOW_XON || burst[i] == FLOW_XOFF || burst[i] == FLOW_ESC;
+    }
+    snprintf(cmd, sizeof(cmd), "AT+FCTEST=%u,%u\r", (unsigned)sizeof(burst),
+             (unsigned)MODEM_FLOW_TEST_STALL_MS);
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        // RTS/CTS only where the board wires it.
+        if (modes[m] == FLOW_HW && flow_default() != FLOW_HW) {
+            continue;
+        }
+        modem_set_flow_control(modes[m]);
+        fake_modem_set_flow_control(modes[m]);
+
+        int64_t t0 = esp_timer_get_time();
+        int n = modem_send_prompt(cmd, burst, sizeof(burst), resp, sizeof(resp),
+                                  MODEM_CMD_TIMEOUT_MS);
+        int64_t us = esp_timer_get_time() - t0;
+        unsigned got = 0, bad = 0;
+        if (n < 0 || sscanf(resp, "+FCTEST: %u,%u", &got, &bad) != 2) {
+            printf("[main] flow: %s: no result\n", flow_name(modes[m]));
+            continue;
+        }
+        printf("[main] flow: %-8s %u of %u B received, %u lost, %u out of place, "
+               "%lld ms (stall %d ms)",
+               flow_name(modes[m]), got, (unsigned)sizeof(burst),
+               (unsigned)sizeof(burst) - got, bad, (long long)(us / 1000),
+               MODEM_FLOW_TEST_STALL_MS);
+        if (modes[m] == FLOW_SW) {
+            printf(", +%u B escapes", (unsigned)escapes);
+        }
+        printf("\n");
+    }
+
+    modem_set_flow_control(flow_default());
+    fake_modem_set_flow_control(flow_default());
+}
+
+// ============================================================
+// UART error test
+//
+//   1. Line noise in the answer to a query: counted, dropped,
+//      and the query is sent again.
+//   2. An overflow: without flow control, the fake modem floods
+//      more than the RX ring holds ahead of the answer while a
+//      higher-priority task keeps the reader off the CPU. The
+//      command fails as soon as the reader is back, not at its
+//      timeout.
+//   3. The next command must get its own answer, with nothing
+//      of the flood or the failed one's answer glued on.
+// ============================================================
+
+// Busy-waits on the reader's core for (uintptr_t)arg ms, after
+// giving the command a moment to go out.
+static void reader_hog_task(void *arg) {
+    vTaskDelay(pdMS_TO_TICKS(20));
+    int64_t end = esp_timer_get_time() + (int64_t)(uintptr_t)arg * 1000;
+    while (esp_timer_get_time() < end) {
+    }
+    vTaskDelete(NULL);
+}
+
+static void uart_error_test(void) {
+    char cmd[40];
+    char resp[96];
+
+    // --- Step 1: Noise, query retried ---
+    modem_uart_stats_t before = modem_uart_stats();
+    modem_send_at("AT+UARTERR=1\r\n", NULL, 0, MODEM_CMD_TIMEOUT_MS);
+    int64_t t0 = esp_timer_get_time();
+    int n = modem_send_at("AT+CEREG?\r\n", resp, sizeof(resp), MODEM_CMD_TIMEOUT_MS);
+    modem_uart_stats_t st = modem_uart_stats();
+    printf("[main] uart: noise: AT+CEREG? %s in %lld ms, %lu framing errors, %lu breaks, "
+           "%lu retried\n",
+           n >= 0 && strstr(resp, "+CEREG:") != NULL ? "answered" : "FAILED",
+           (long long)((esp_timer_get_time() - t0) / 1000),
+           (unsigned long)(st.frame_err - before.frame_err),
+           (unsigned long)(st.breaks - before.breaks),
+           (unsigned long)(st.retries - before.retries));
+
+    // --- Step 2: Overflow, command failed ---
+    uint32_t flood = mem_plan_value(MEM_RX_RING) + 2048;
+    uint32_t hog_ms = flood * 10 * 1000 / MODEM_BAUD + 100;  // 8N1: 10 bits a byte.
+    before = st;
+    modem_set_flow_control(FLOW_NONE);
+    fake_modem_set_flow_control(FLOW_NONE);
+    snprintf(cmd, sizeof(cmd), "AT+UARTERR=2,%lu\r\n", (unsigned long)flood);
+    modem_send_at(cmd, NULL, 0, MODEM_CMD_TIMEOUT_MS);
+    xTaskCreatePinnedToCore(reader_hog_task, "reader_hog", 2048, (void *)(uintptr_t)hog_ms,
+                            MODEM_REG_TASK_PRIO + 1, NULL, xPortGetCoreID());
+    t0 = esp_timer_get_time();
+    n = modem_send_at("AT+CSQ\r\n", resp, sizeof(resp), MODEM_CMD_TIMEOUT_MS);
+    int64_t fail_ms = (esp_timer_get_time() - t0) / 1000;
+    modem_set_flow_control(flow_default());
+    fake_modem_set_flow_control(flow_default());
+    st = modem_uart_stats();
+    printf("[main] uart: overflow: AT+CSQ %s after %lld ms (reader held %lu ms, timeout %d ms), "
+           "%lu FIFO overflows, %lu ring full, %lu resyncs\n",
+           n < 0 ? "failed" : "answered", (long long)fail_ms, (unsigned long)hog_ms,
+           MODEM_CMD_TIMEOUT_MS, (unsigned long)(st.fifo_ovf - before.fifo_ovf),
+           (unsigned long)(st.buffer_full - before.buffer_full),
+           (unsigned long)(st.resyncs - before.resyncs));
+
+    // --- Step 3: Next command clean ---
+    n = modem_send_at("AT+CSQ\r\n", resp, sizeof(resp), MODEM_CMD_TIMEOUT_MS);
+    bool clean = n >= 0 && strstr(resp, "+CSQ: 20,99") != NULL && strstr(resp, "FILL") == NULL;
+    printf("[main] uart: next command %s\n", clean ? "clean" : "GOT A DAMAGED ANSWER");
+}
+
+// ============================================================
+// Flash stress test
+//
+// A task on the other core erases the scratch partition one
+// sector at a time, nonstop; each erase disables the flash cache
+// and with it every ISR not in IRAM, and holds every task on
+// both cores. Meanwhile the fake modem streams
+// MODEM_STRESS_BYTES at MODEM_STRESS_BAUD, no flow control,
+// through a TX ring that holds a whole erase's worth at line
+// rate, so its IRAM ISR keeps the line busy throughout. Every
+// byte must arrive, in place, with no FIFO overflow: the host's
+// IRAM ISR keeps moving them into its RX ring, which has to hold
+// all of them until the reader runs again.
+//
+// The rings are sized for MODEM_STRESS_ERASE_MS; the report
+// puts the longest erase actually seen next to the host ring's
+// headroom. A planned RX ring too small for the budget skips the
+// test rather than run one that cannot pass.
+// ============================================================
+
+// Longer than any sector erase: a silence this long ends the
+// stream.
+#define STRESS_IDLE_MS 1000
+
+static volatile bool s_erase_run;
+static volatile uint32_t s_erases;
+static volatile uint32_t s_erase_max_us;
+
+static void flash_erase_task(void *arg) {
+    const esp_partition_t *part = arg;
+    for (uint32_t off = 0; s_erase_run; off = (off + SPI_FLASH_SEC_SIZE) % part->size) {
+        int64_t t0 = esp_timer_get_time();
+        esp_partition_erase_range(part, off, SPI_FLASH_SEC_SIZE);
+        uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+        s_erase_max_us = us > s_erase_max_us ? us : s_erase_max_us;
+        s_erases++;
+        vTaskDelay(1);  // The idle task's watchdog.
+    }
+    vTaskDelete(NULL);
+}
+
+static void flash_stress_test(void) {
+    const esp_partition_t *part = esp_partition_find_first(
+        ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, MODEM_STRESS_PARTITION);
+    if (part == NULL) {
+        printf("[main] stress: no \"%s\" partition, skipped\n", MODEM_STRESS_PARTITION);
+        return;
+    }
+    uint32_t ring = mem_plan_value(MEM_RX_RING);
+    if (ring < MODEM_STRESS_BURST_BYTES) {
+        printf("[main] stress: RX ring %lu B, %d B arrive in a %d ms erase, skipped\n",
+               (unsigned long)ring, MODEM_STRESS_BURST_BYTES, MODEM_STRESS_ERASE_MS);
+        return;
+    }
+
+    // --- Step 1: Top baud rate, no flow control ---
+    modem_set_flow_control(FLOW_NONE);
+    fake_modem_set_flow_control(FLOW_NONE);
+    modem_set_baud_rate(MODEM_STRESS_BAUD);
+    fake_modem_set_baud_rate(MODEM_STRESS_BAUD);
+
+    // --- Step 2: Erases on the other core ---
+    s_erases = 0;
+    s_erase_max_us = 0;
+    s_erase_run = true;
+    xTaskCreatePinnedToCore(flash_erase_task, "flash_erase", 3072, (void *)part, 1, NULL,
+                            1 - xPortGetCoreID());
+
+    // --- Step 3: Stream ---
+    modem_uart_stats_t before = modem_uart_stats();
+    char cmd[32];
+    char resp[48];
+    static uint8_t buf[1024];
+    size_t got = 0;
+    size_t bad = 0;
+    snprintf(cmd, sizeof(cmd), "AT+STREAM=%lu\r\n", (unsigned long)MODEM_STRESS_BYTES);
+    int64_t t0 = esp_timer_get_time();
+    if (modem_send_at(cmd, resp, sizeof(resp), MODEM_CMD_TIMEOUT_MS) >= 0 &&
+        strstr(resp, "CONNECT") != NULL) {
+        t0 = esp_timer_get_time();
+        while (got < MODEM_STRESS_BYTES) {
+            int n = modem_data_read(buf, sizeof(buf), STRESS_IDLE_MS);
+            if (n <= 0) {
+                break;
+            }
+            for (int i = 0; i < n; i++) {
+                bad += buf[i] != FLOW_TEST_BYTE(got + i);
+            }
+            got += (size_t)n;
+        }
+    }
+    int64_t us = esp_timer_get_time() - t0;
+
+    // --- Step 4: Back to normal ---
+    s_erase_run = false;
+    modem_set_baud_rate(MODEM_BAUD);
+    fake_modem_set_baud_rate(FAKE_MODEM_BAUD);
+    modem_set_flow_control(flow_default());
+    fake_modem_set_flow_control(flow_default());
+
+    modem_uart_stats_t st = modem_uart_stats();
+    uint32_t rate = us > 0 ? (uint32_t)((int64_t)got * 1000000 / us) : 0;
+    printf("[main] stress: %u of %lu B at %d baud, %u lost, %u out of place, "
+           "%lu FIFO overflows, %lu ring full\n",
+           (unsigned)got, (unsigned long)MODEM_STRESS_BYTES, MODEM_STRESS_BAUD,
+           (unsigned)(MODEM_STRESS_BYTES - got), (unsigned)bad,
+           (unsigned long)(st.fifo_ovf - before.fifo_ovf),
+           (unsigned long)(st.buffer_full - before.buffer_full));
+    printf("[main] stress: %lu sector erases meanwhile, %lu B/s of %d\n",
+           (unsigned long)s_erases, (unsigned long)rate, MODEM_STRESS_BAUD / 10);
+
+    // Bytes the line delivered during the longest erase.
+    int64_t erase_bytes = (int64_t)(MODEM_STRESS_BAUD / 10) * s_erase_max_us / 1000000;
+    printf("[main] stress: longest erase %lu.%lu ms = %lld B at line rate; RX ring %lu B "
+           "(%lld B headroom), sized for %d ms\n",
+           (unsigned long)(s_erase_max_us / 1000), (unsigned long)(s_erase_max_us % 1000 / 100),
+           (long long)erase_bytes, (unsigned long)ring, (long long)(ring - erase_bytes),
+           MODEM_STRESS_ERASE_MS);
+    if (s_erase_max_us > MODEM_STRESS_ERASE_MS * 1000) {
+        printf("[main] stress: an erase outlasted MODEM_STRESS_ERASE_MS; raise it (and the "
+               "rings with it) for this flash chip\n");
+    }
+}
+
 // ============================================================
 // app_main()
 //
 // Entry point called by ESP-IDF after boot.
 //
 // Steps:
-//   1. Configure UART1 (baud, word format, flow control).
-//   2. Assign GPIO pins to UART1 signals.
-//   3. Install UART1 driver with RX buffer.
-//   4. Start the fake modem on UART2 (background task).
-//   5. Loop forever: send AT commands, read responses, delay.
+//   1. Resolve the board (board_init()) and plan buffer sizes
+//      (mem_plan_init()), configure and install UART1
+//      (modem_uart_init()); check the deep-sleep wake state
+//      (FEATURE_DEEP_SLEEP) and set up DFS / light sleep
+//      (FEATURE_POWER_MGMT). The slow peripherals (SD, display,
+//      camera) start on the init task meanwhile; the rest at
+//      their first use. Each phase is marked on the boot
+//      timeline.
+//   2. Start the fake modem on UART2 (background task).
+//      With FEATURE_DEEP_SLEEP the firmware is a duty cycle:
+//      bring the modem up (full path on cold start, fast resume
+//      on a timer wake), send one CoAP reading, report
+//      wake-to-first-byte time and the boot timeline, and deep
+//      sleep. Steps 3-22 do not run. Otherwise start the
+//      registration state machine, wait (bounded) for
+//      PDP_ACTIVE and print the boot timeline.
+//   3. Run the MQTT session test (FEATURE_MQTT).
+//   4. Run the CoAP uplink test (FEATURE_COAP).
+//   5. Run the aggregation test (FEATURE_AGGREGATION).
+//   6. Run the SD logging test (FEATURE_SD_LOGGING).
+//   7. Run the audio capture test (FEATURE_AUDIO).
+//   8. Run the camera pipeline test (FEATURE_CAMERA).
+//   9. Run the display benchmark (FEATURE_DISPLAY).
+//  10. Run the I2C bus manager test (FEATURE_I2C_BUS).
+//  11. Report SPI bus sharing (SD logging / display).
+//  12. Run the power management benchmark (FEATURE_POWER_MGMT).
+//  13. Run the registration recovery test.
+//  14. Run the modem socket test.
+//  15. Run the SMS test (FEATURE_SMS).
+//  16. Run the GNSS test (FEATURE_GNSS).
+//  17. Run the framed link benchmark (FEATURE_FRAME_LINK).
+//  18. Run the flow-control overflow benchmark.
+//  19. Run the UART error recovery test.
+//  20. Run the flash-erase UART stress test.
+//  21. Run the build profile benchmark.
+//  22. Loop forever: send AT commands, read responses, delay.
 // ============================================================
 void app_main(void) {
+    boot_prof_start();
     printf("[main] UART loopback test starting\n");
 
-    // --- Step 1: UART1 configuration struct ---
-    // Same structure as fake_modem.c but for UART1.
-    uart_config_t uart_cfg = {
-        // Baud rate: 115200 (must match fake modem).
-        .baud_rate = MODEM_BAUD,
+    // Board first: with BOARD_AUTODETECT every PIN_* below comes
+    // from the descriptor it resolves.
+    board_init();
+    boot_prof_mark("board");
 
-        // 8 data bits, no parity, 1 stop bit (8N1).
-        .data_bits = UART_DATA_8_BITS,
-        .parity = UART_PARITY_DISABLE,
-        .stop_bits = UART_STOP_BITS_1,
+    // Buffer sizes and queue depths from the heap this board has,
+    // before any driver allocates.
+    mem_plan_init();
+    mem_plan_print();
+    boot_prof_mark("mem_plan");
 
-        // Enable hardware flow control on UART1.
-        // UART1 will assert RTS when its RX FIFO has room.
-        // UART1 will check CTS before sending each byte.
-        .flow_ctrl = UART_HW_FLOWCTRL_CTS_RTS,
+    // SD mount, panel and sensor bring-up run on the init task
+    // from here, alongside the modem; the tests below wait for
+    // whichever they need. A deep-sleep build skips that pass:
+    // its wakes only need the modem.
+    lazy_init_start();
 
-        // Deassert RTS when RX FIFO exceeds 122 bytes.
-        .rx_flow_ctrl_thresh = 122,
+#if FEATURE_DEEP_SLEEP
+    // Wake cause + RTC-retained state, before anything talks to
+    // the modem.
+    deep_sleep_boot();
+    boot_prof_mark("deep_sleep");
+#endif
 
-        // Use default reference clock for baud rate generation.
-        .source_clk = UART_SCLK_DEFAULT,
-    };
+#if FEATURE_POWER_MGMT
+    // DFS + light sleep; the lock calls below are no-ops until
+    // this has run. Serial, ahead of the modem: see lazy_init.h.
+    power_init();
+    boot_prof_mark("power");
+#endif
+
+    // --- Step 1: UART1 driver ---
+    // Baud, 8N1, flow control and pins from the board profile.
+    modem_uart_init();
+    boot_prof_mark("modem_uart");
 
-    // --- Step 2: Apply config to UART1 hardware ---
-    // Programs UART1's baud divisor, frame format, and flow control.
-    uart_param_config(MODEM_UART_NUM, &uart_cfg);
-
-    // --- Step 3: Assign GPIO pins to UART1 signals ---
-    // Order: TX, RX, RTS, CTS.
-    uart_set_pin(MODEM_UART_NUM,
-                 MODEM_TX_PIN,   // UART1 TX  -> GPIO17
-                 MODEM_RX_PIN,   // UART1 RX  -> GPIO18
-                 MODEM_RTS_PIN,  // UART1 RTS -> GPIO16
-                 MODEM_CTS_PIN); // UART1 CTS -> GPIO15
-
-    // --- Step 4: Install UART1 driver ---
-    // RX ring buffer = MODEM_RX_BUF bytes.
-    // TX buffer = 0 (blocking writes directly to FIFO).
-    // No event queue.
-    uart_driver_install(MODEM_UART_NUM,
-                        MODEM_RX_BUF,  // RX buffer size
-                        0,             // TX buffer size
-                        0,             // Event queue size
-                        NULL,          // Event queue handle
-                        0);            // Interrupt flags
-
-    printf("[main] UART1 configured on TX=%d RX=%d RTS=%d CTS=%d\n",
-           MODEM_TX_PIN, MODEM_RX_PIN, MODEM_RTS_PIN, MODEM_CTS_PIN);
-
-    // --- Step 5: Start fake modem on UART2 ---
+    // --- Step 2: Start fake modem on UART2 ---
     // This configures UART2 and launches a background task.
-    // After this call, the fake modem is listening on UART2 RX.
+    // UART2's driver and RX ring are installed before the task
+    // starts, so a command sent before it first reads waits in
+    // the ring: no settle delay needed.
     fake_modem_start();
+    boot_prof_mark("fake_modem");
+
+#if FEATURE_DEEP_SLEEP
+    // Duty cycle: send one reading and sleep (does not return).
+    deep_sleep_cycle();
+#endif
+
+    // Registration runs in the background from here; the tests
+    // below need the PDP context, so wait for it (bounded: each
+    // test reports its own failure if the network never came up).
+    modem_reg_start();
+    if (modem_reg_wait(MODEM_REG_PDP_ACTIVE,
+                       MODEM_SIM_TIMEOUT_MS + MODEM_REG_TIMEOUT_MS) != ESP_OK) {
+        printf("[main] network not up (%s), continuing\n",
+               modem_reg_state_name(modem_reg_state()));
+    }
+    boot_prof_mark("network");
+    modem_reg_print();
+    boot_prof_print();
+
+#if FEATURE_MQTT
+    // --- Step 3: MQTT over the transparent link ---
+    mqtt_session_test();
+#endif
+
+#if FEATURE_COAP
+    // --- Step 4: CoAP over modem UDP ---
+    coap_uplink_test();
+#endif
+
+#if FEATURE_AGGREGATION
+    // --- Step 5: Downsampling before uplink ---
+    aggregation_test();
+#endif
+
+#if FEATURE_SD_LOGGING
+    // --- Step 6: Buffered SD logging ---
+    sd_logging_test();
+#endif
+
+#if FEATURE_AUDIO
+    // --- Step 7: I2S capture pipeline ---
+    audio_capture_test();
+#endif
+
+#if FEATURE_CAMERA
+    // --- Step 8: Camera to uplink ---
+    camera_pipeline_test();
+#endif
+
+#if FEATURE_DISPLAY
+    // --- Step 9: SPI display, full vs partial redraw ---
+    display_test();
+#endif
+
+#if FEATURE_I2C_BUS
+    // --- Step 10: Queued I2C transactions ---
+    i2c_bus_test();
+#endif
+
+#if SPI_ARB_ENABLED
+    // --- Step 11: Shared SPI bus ---
+    spi_bus_test();
+#endif
+
+#if FEATURE_POWER_MGMT
+    // --- Step 12: DFS / light sleep vs full power ---
+    power_test();
+#endif
+
+    // --- Step 13: Coverage loss and recovery ---
+    modem_reg_test();
+
+    // --- Step 14: Concurrent sockets on the modem's links ---
+    modem_sock_test();
+
+#if FEATURE_SMS
+    // --- Step 15: SMS in PDU mode ---
+    sms_test();
+#endif
+
+#if FEATURE_GNSS
+    // --- Step 16: NMEA parser and GNSS fix ---
+    gnss_test();
+#endif
+
+#if FEATURE_FRAME_LINK
+    // --- Step 17: Framed transport under bit errors ---
+    frame_test();
+#endif
+
+    // --- Step 18: RX overflow with and without flow control ---
+    flow_test();
+
+    // --- Step 19: Damaged answers and resync ---
+    uart_error_test();
+
+    // --- Step 20: Full-rate reception through flash erases ---
+    flash_stress_test();
 
-    // Give the fake modem task time to initialize.
-    vTaskDelay(pdMS_TO_TICKS(100));
+    // --- Step 21: Debug vs release profile ---
+    build_profile_bench();
 
     printf("[main] sending AT commands...\n\n");
 
-    // --- Step 6: Main loop — send commands, read responses ---
+    // --- Step 22: Main loop — send commands, read responses ---
     while (1) {
         // Send basic "AT" command (modem alive check).
         // The \r\n at the end is the standard AT command terminator.
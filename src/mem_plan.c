@@ -0,0 +1,199 @@
+// ============================================================
+// mem_plan.c
+//
+// Weighted fill of per-pool heap budgets. See mem_plan.h.
+// ============================================================
+
+#include "mem_plan.h"
+
+// stdio.h: printf() for console logging to UART0.
+#include <stdio.h>
+
+// esp_heap_caps.h: free / total size per capability.
+#include "esp_heap_caps.h"
+
+// Floors, maxima, weights and budget shares.
+#include "app_config.h"
+
+// board_info(): PSRAM the board has, for the report.
+#include "board.h"
+
+static const char *TAG = "mem_plan";
+
+typedef enum {
+    POOL_INTERNAL,
+    POOL_PSRAM,
+    POOL_COUNT
+} pool_t;
+
+typedef struct {
+    const char *name;
+    uint32_t min;             // Floor (always granted).
+    uint32_t max;
+    uint32_t weight;          // 0 = floor only (feature off).
+    uint32_t unit_bytes;      // Heap cost of one unit of value.
+    uint32_t align;           // Value rounded down to a multiple.
+    pool_t pool;              // Preferred pool.
+} item_cfg_t;
+
+static const item_cfg_t s_items[MEM_ITEM_COUNT] = {
+    [MEM_RX_RING] = {"rx_ring", RX_RING_BYTES, RX_RING_BYTES_MAX, RX_RING_WEIGHT,
+                     1, 256, POOL_INTERNAL},
+    [MEM_TX_RING] = {"tx_ring", TX_RING_BYTES, TX_RING_BYTES_MAX, TX_RING_WEIGHT,
+                     1, 256, POOL_INTERNAL},
+    [MEM_I2C_QUEUE] = {"i2c_queue", I2C_QUEUE_DEPTH, I2C_QUEUE_DEPTH_MAX,
+                       FEATURE_I2C_BUS ? I2C_QUEUE_WEIGHT : 0,
+                       sizeof(void *), 1, POOL_INTERNAL},
+};
+
+_Static_assert(RX_RING_BYTES <= RX_RING_BYTES_MAX && TX_RING_BYTES <= TX_RING_BYTES_MAX &&
+               I2C_QUEUE_DEPTH <= I2C_QUEUE_DEPTH_MAX,
+               "memory planner floor above its _MAX");
+
+typedef struct {
+    size_t free_bytes;
+    size_t total_bytes;
+    uint32_t budget;
+    uint32_t planned;         // Bytes handed out (floors included).
+    bool over_budget;
+} pool_state_t;
+
+static bool s_planned;
+static uint32_t s_value[MEM_ITEM_COUNT];
+static pool_t s_pool[MEM_ITEM_COUNT];
+static pool_state_t s_pools[POOL_COUNT];
+
+// ============================================================
+// plan_pool()
+//
+// Steps:
+//   1. Grant every item in the pool its floor.
+//   2. Split what is left by weight among items below their max;
+//      items that hit max return their excess, so repeat until
+//      nothing more is granted.
+//   3. Round down to each item's alignment (never below floor).
+// ============================================================
+static void plan_pool(pool_t pool) {
+    pool_state_t *ps = &s_pools[pool];
+
+    // --- Step 1: Floors ---
+    uint64_t used = 0;
+    for (int i = 0; i < MEM_ITEM_COUNT; i++) {
+        if (s_pool[i] == pool) {
+            s_value[i] = s_items[i].min;
+            used += (uint64_t)s_items[i].min * s_items[i].unit_bytes;
+        }
+    }
+    if (used > ps->budget) {
+        ps->over_budget = true;
+        ps->planned = (uint32_t)used;
+        return;
+    }
+
+    // --- Step 2: Weighted fill ---
+    uint64_t remaining = ps->budget - used;
+    for (int round = 0; round < MEM_ITEM_COUNT && remaining > 0; round++) {
+        uint64_t weights = 0;
+        for (int i = 0; i < MEM_ITEM_COUNT; i++) {
+            if (s_pool[i] == pool && s_value[i] < s_items[i].max) {
+                weights += s_items[i].weight;
+            }
+        }
+        if (weights == 0) {
+            break;
+        }
+        uint64_t granted = 0;
+        for (int i = 0; i < MEM_ITEM_COUNT; i++) {
+            const item_cfg_t *it = &s_items[i];
+            if (s_pool[i] != pool || s_value[i] >= it->max || it->weight == 0) {
+                continue;
+            }
+            uint64_t units = remaining * it->weight / weights / it->unit_bytes;
+            if (units > it->max - s_value[i]) {
+                units = it->max - s_value[i];
+            }
+            s_value[i] += (uint32_t)units;
+            granted += units * it->unit_bytes;
+        }
+        if (granted == 0) {
+            break;
+        }
+        remaining -= granted;
+    }
+
+    // --- Step 3: Alignment ---
+    ps->planned = 0;
+    for (int i = 0; i < MEM_ITEM_COUNT; i++) {
+        if (s_pool[i] != pool) {
+            continue;
+        }
+        uint32_t v = s_value[i] - s_value[i] % s_items[i].align;
+        s_value[i] = v < s_items[i].min ? s_items[i].min : v;
+        ps->planned += s_value[i] * s_items[i].unit_bytes;
+    }
+}
+
+// ============================================================
+// mem_plan_init()
+// ============================================================
+esp_err_t mem_plan_init(void) {
+    s_pools[POOL_INTERNAL].free_bytes = heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    s_pools[POOL_INTERNAL].total_bytes = heap_caps_get_total_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    s_pools[POOL_PSRAM].free_bytes = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    s_pools[POOL_PSRAM].total_bytes = heap_caps_get_total_size(MALLOC_CAP_SPIRAM);
+    s_pools[POOL_INTERNAL].budget =
+        (uint32_t)((uint64_t)s_pools[POOL_INTERNAL].free_bytes * MEM_PLAN_INTERNAL_PCT / 100);
+    s_pools[POOL_PSRAM].budget =
+        (uint32_t)((uint64_t)s_pools[POOL_PSRAM].free_bytes * MEM_PLAN_PSRAM_PCT / 100);
+
+    // PSRAM-capable items live in internal RAM when PSRAM is not
+    // in the heap.
+    bool have_psram = s_pools[POOL_PSRAM].free_bytes > 0;
+    for (int i = 0; i < MEM_ITEM_COUNT; i++) {
+        s_pool[i] = (s_items[i].pool == POOL_PSRAM && have_psram) ? POOL_PSRAM
+                                                                  : POOL_INTERNAL;
+    }
+    plan_pool(POOL_INTERNAL);
+    plan_pool(POOL_PSRAM);
+    s_planned = true;
+
+    bool over = s_pools[POOL_INTERNAL].over_budget || s_pools[POOL_PSRAM].over_budget;
+    return over ? ESP_ERR_NO_MEM : ESP_OK;
+}
+
+uint32_t mem_plan_value(mem_item_t item) {
+    if (!s_planned) {
+        mem_plan_init();  // First use before app_main() planned.
+    }
+    return s_value[item];
+}
+
+uint32_t mem_plan_caps(mem_item_t item) {
+    if (!s_planned) {
+        mem_plan_init();
+    }
+    return s_pool[item] == POOL_PSRAM ? MALLOC_CAP_SPIRAM
+                                      : (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+}
+
+void mem_plan_print(void) {
+    static const char *const pool_names[POOL_COUNT] = {"internal", "psram"};
+    for (int p = 0; p < POOL_COUNT; p++) {
+        const pool_state_t *ps = &s_pools[p];
+        printf("[%s] %-8s free %u of %u KB, budget %lu KB, planned %lu KB%s\n", TAG,
+               pool_names[p], (unsigned)(ps->free_bytes / 1024),
+               (unsigned)(ps->total_bytes / 1024), (unsigned long)(ps->budget / 1024),
+               (unsigned long)(ps->planned / 1024),
+               ps->over_budget ? " (OVER BUDGET: floors only)" : "");
+    }
+    if (s_pools[POOL_PSRAM].total_bytes == 0 && board_info()->desc->psram_mb > 0) {
+        printf("[%s] board has %u MB PSRAM but it is not in the heap (CONFIG_SPIRAM)\n",
+               TAG, board_info()->desc->psram_mb);
+    }
+    for (int i = 0; i < MEM_ITEM_COUNT; i++) {
+        const item_cfg_t *it = &s_items[i];
+        printf("[%s]   %-10s %6lu  (%lu..%lu, %s)\n", TAG, it->name,
+               (unsigned long)s_value[i], (unsigned long)it->min, (unsigned long)it->max,
+               pool_names[s_pool[i]]);
+    }
+}
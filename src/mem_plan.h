@@ -0,0 +1,56 @@
+#pragma once
+
+// ============================================================
+// mem_plan.h
+//
+// Boot-time memory planner.
+//
+// Buffer sizes and queue depths are not picked per board at
+// compile time; they are planned once at boot from what the heap
+// actually has:
+//
+//   budget (internal) = free internal heap * MEM_PLAN_INTERNAL_PCT
+//   budget (PSRAM)    = free PSRAM         * MEM_PLAN_PSRAM_PCT
+//
+// Each item declares a floor (the plain app_config.h name, e.g.
+// RX_RING_BYTES), a _MAX and a _WEIGHT. Every item first gets its
+// floor; the rest of its pool's budget is split by weight, capped
+// at _MAX, and rounded down to the item's alignment. PSRAM-capable
+// items fall back to the internal pool on boards whose PSRAM is
+// not in the heap (no PSRAM, or CONFIG_SPIRAM off).
+//
+// If even the floors do not fit, every item keeps its floor and
+// the plan is flagged as over budget: floors are the sizes the
+// firmware has always been safe with.
+//
+// Only init code calls mem_plan_value(); the plan never changes
+// after boot.
+// ============================================================
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef enum {
+    MEM_RX_RING,              // Modem UART RX ring (bytes).
+    MEM_TX_RING,              // Modem UART TX ring (bytes).
+    MEM_I2C_QUEUE,            // I2C bus queue depth (entries).
+    MEM_ITEM_COUNT
+} mem_item_t;
+
+// --- Public functions ---------------------------------------
+
+// Reads the heap sizes and plans every item. Call once in
+// app_main() after board_init() and before any driver that sizes
+// a buffer from the plan.
+esp_err_t mem_plan_init(void);
+
+// Planned value of one item (bytes or entries).
+uint32_t mem_plan_value(mem_item_t item);
+
+// heap_caps flags the item should be allocated with.
+uint32_t mem_plan_caps(mem_item_t item);
+
+// Prints heap sizes, budgets and the planned values.
+void mem_plan_print(void);
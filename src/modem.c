@@ -0,0 +1,1170 @@
+// ============================================================
+// modem.c
+//
+// Driver side of the modem link on UART1.
+// See modem.h for the public API.
+//
+// Behavior:
+//   - modem_uart_init() brings up UART1 using the pins from the
+//     board profile, with RTS/CTS flow control where it wires
+//     them and XON/XOFF otherwise (flow_ctl.h). Under XON/XOFF
+//     every binary payload is escaped on the way out and
+//     unescaped on the way in; AT text goes as it is.
+//   - modem_send_at() writes one command and accumulates the
+//     response until a final result code is seen, instead of
+//     sleeping a fixed time and hoping the reply is complete.
+//   - modem_data_*() pass raw bytes through once the modem is
+//     in transparent (data) mode.
+//   - modem_udp_*() handle the '>' send prompt and the "+IPD"
+//     receive framing of non-transparent sockets; modem_link_*()
+//     the same prompt and the "+CIPRXGET: 2" framing of links in
+//     manual receive mode (modem_sock.c). modem_send_prompt() is
+//     the same prompt for other commands (AT+CMGS), and
+//     modem_send_at_lines() streams long listings (AT+CMGL) line
+//     by line (modem_sms.c).
+//   - Every exchange holds the POWER_UART lock so the chip does
+//     not enter light sleep mid-response. The UART is clocked
+//     from XTAL, so DFS never changes the baud rate. While any
+//     line observer is registered a URC may come at any time,
+//     and a UART wake-up would lose its first characters, so
+//     POWER_UART stays held from the first observer added to
+//     the last one removed.
+//   - Every line seen in AT mode (responses and URCs) goes to the
+//     line observers. Exchanges hold a recursive mutex so
+//     modem_poll() on another task never reads into the middle of
+//     a response; the wait for unsolicited bytes blocks on the
+//     UART event queue, not on the mutex.
+//   - Every read path also takes the UART error events (FIFO
+//     overflow, framing, parity, break; a full ring is only
+//     counted, it loses nothing). An error drops the line in
+//     progress and resynchronizes on a line boundary
+//     (resync()); the exchange it hit fails at once instead of
+//     running into its timeout, and a query is sent once more.
+//     Nothing of its answer is left to be read by the next one.
+//   - The driver's ISR and its ring-buffer push run from IRAM
+//     (CONFIG_UART_ISR_IN_IRAM, ESP_INTR_FLAG_IRAM), with the
+//     ring and event queue in internal RAM: reception goes on
+//     while a flash write / erase has the cache disabled.
+// ============================================================
+
+#include "modem.h"
+
+// stdio.h: printf() for console logging to UART0.
+#include <stdio.h>
+
+// string.h: strlen(), strstr() for command sizing and result matching.
+#include <string.h>
+
+// stdlib.h: atoi() for "+IPD<len>" parsing.
+#include <stdlib.h>
+
+// FreeRTOS headers for ticks and delays.
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+// ESP-IDF UART driver API.
+#include "driver/uart.h"
+
+// esp_intr_alloc.h: ESP_INTR_FLAG_IRAM for the UART interrupt.
+#include "esp_intr_alloc.h"
+
+// esp_timer.h: microsecond deadlines for the UDP helpers.
+#include "esp_timer.h"
+
+// Board pins (PIN_MODEM_*), MODEM_BAUD and timeouts.
+#include "app_config.h"
+
+// power_lock(): no light sleep while an exchange is in flight.
+#include "power_mgmt.h"
+
+// mem_plan_value(): RX / TX ring sizes.
+#include "mem_plan.h"
+
+// flow_apply(), flow_write(), flow_unescape(): RTS/CTS or XON/XOFF.
+#include "flow_ctl.h"
+
+// First AT command stamp for the boot timeline.
+#include "boot_prof.h"
+
+static const char *TAG = "modem";
+
+// Timeout for the AT commands used while opening a data connection.
+// NETOPEN / CIPOPEN can take several seconds on a real network.
+#define MODEM_OPEN_TIMEOUT_MS 10000
+
+// UART events: data (one per RX burst) wakes modem_poll();
+// errors are taken by whichever read comes next. Exchanges
+// empty the queue as they read, so it only fills while nobody
+// reads. A burst is at most the driver's 120-byte FIFO
+// threshold, so a full ring's worth of data events still leaves
+// room for the BUFFER_FULL / FIFO_OVF behind them: an overflow
+// is never missed for want of a queue slot.
+#define MODEM_EVENT_QUEUE_LEN(ring) ((ring) / 100 + 8)
+
+// Budget for the rest of a URC line once its first byte is in.
+#define MODEM_URC_LINE_MS 100
+
+static SemaphoreHandle_t s_lock;     // Recursive: open sequences nest modem_send_at().
+static QueueHandle_t s_events;
+static struct {
+    modem_line_fn fn;
+    void *user;
+} s_observers[MODEM_LINE_OBSERVERS_MAX];
+static int s_observer_count;         // > 0: POWER_UART held for URCs.
+static bool s_data_mode;             // Transparent link up (CONNECT seen).
+static uint32_t s_udp_links;         // Bit per open UDP link id.
+static flow_mode_t s_flow;
+static bool s_rx_esc;                // XON/XOFF: FLOW_ESC seen, its byte not yet.
+static modem_uart_stats_t s_uart_stats;
+static bool s_damaged;               // A UART error hit the exchange in progress.
+
+// read_line() result for a line cut by a UART error.
+#define READ_LINE_DAMAGED (-2)
+
+static int read_line(char *buf, size_t len, int64_t deadline_us);
+
+static void modem_lock(void) {
+    if (s_lock) {
+        xSemaphoreTakeRecursive(s_lock, portMAX_DELAY);
+    }
+}
+
+static void modem_unlock(void) {
+    if (s_lock) {
+        xSemaphoreGiveRecursive(s_lock);
+    }
+}
+
+static void notify(const char *line) {
+    if (line[0] == '\0') {
+        return;
+    }
+    for (int i = 0; i < MODEM_LINE_OBSERVERS_MAX; i++) {
+        if (s_observers[i].fn) {
+            s_observers[i].fn(line, s_observers[i].user);
+        }
+    }
+}
+
+// Takes every complete NMEA sentence ("$..." line: GNSS output
+// the modem interleaves on the AT channel) out of a response
+// being collected and hands it to the observers only, so
+// sentences never take up the caller's response buffer. An
+// unfinished sentence stays until its '\n' is in.
+// Returns the new length of buf.
+static size_t route_nmea(char *buf, size_t pos) {
+    size_t i = 0;
+    while (i < pos) {
+        char *line = buf + i;
+        char *nl = memchr(line, '\n', pos - i);
+        if (nl == NULL) {
+            break;
+        }
+        size_t n = (size_t)(nl - line) + 1;
+        if (line[0] != '$') {
+            i += n;
+            continue;
+        }
+        *nl = '\0';
+        if (nl > line && nl[-1] == '\r') {
+            nl[-1] = '\0';
+        }
+        notify(line);
+        memmove(line, nl + 1, pos - i - n + 1);  // With the terminator.
+        pos -= n;
+    }
+    return pos;
+}
+
+// Hands every complete line of a collected response to the
+// observer. Modifies buf.
+static void notify_lines(char *buf) {
+    char *save = NULL;
+    for (char *line = strtok_r(buf, "\r\n", &save); line != NULL;
+         line = strtok_r(NULL, "\r\n", &save)) {
+        notify(line);
+    }
+}
+
+// ============================================================
+// UART errors
+// ============================================================
+
+// Counts one event. Returns true for the types that lose or
+// corrupt bytes. A full ring is counted but is not one: the
+// driver leaves the bytes in the FIFO (and flow control holds
+// the modem) until a read makes room, so a stall under RTS/CTS
+// or XON/XOFF does not damage the exchange. Bytes are only lost
+// if the FIFO then overruns too, which is a FIFO_OVF.
+static bool count_event(const uart_event_t *ev) {
+    switch (ev->type) {
+        case UART_FIFO_OVF:
+            s_uart_stats.fifo_ovf++;
+            return true;
+        case UART_BUFFER_FULL:
+            s_uart_stats.buffer_full++;
+            return false;
+        case UART_FRAME_ERR:
+            s_uart_stats.frame_err++;
+            return true;
+        case UART_PARITY_ERR:
+            s_uart_stats.parity_err++;
+            return true;
+        case UART_BREAK:
+            s_uart_stats.breaks++;
+            return true;
+        default:
+            return false;  // UART_DATA: a wake-up, the reader is already here.
+    }
+}
+
+// Takes every event queued so far. Returns true if any was an
+// error: the bytes received since the last look are suspect.
+// Counts only; the read paths mark the exchange (s_damaged).
+static bool rx_errors(void) {
+    uart_event_t ev;
+    bool err = false;
+    while (s_events != NULL && xQueueReceive(s_events, &ev, 0) == pdTRUE) {
+        err |= count_event(&ev);
+    }
+    return err;
+}
+
+// ============================================================
+// resync()
+//
+// After an error the line being received is damaged; after an
+// overflow, so is everything buffered around the gap.
+//
+// Behavior:
+//   - Drops the buffered bytes, then the rest of the damaged
+//     line up to its '\n' (again after each further error).
+//   - Reads whole lines (intact again, so they go to the
+//     observers) until a final result code, or until the modem
+//     has been quiet for MODEM_RESYNC_QUIET_MS: either way the
+//     answer in progress is over, and none of it is left to be
+//     read as the next command's.
+// Returns true if a final result code was seen.
+// ============================================================
+static bool resync(int64_t deadline_us) {
+    char line[MODEM_URC_MAX];
+    bool partial = true;  // Next bytes continue a line cut short.
+    s_uart_stats.resyncs++;
+    uart_flush_input(UART_MODEM_NUM);
+    s_rx_esc = false;
+    rx_errors();
+
+    for (;;) {
+        int64_t quiet = esp_timer_get_time() + MODEM_RESYNC_QUIET_MS * 1000;
+        int n = read_line(line, sizeof(line), quiet < deadline_us ? quiet : deadline_us);
+        if (n == READ_LINE_DAMAGED) {
+            uart_flush_input(UART_MODEM_NUM);
+            partial = true;
+            continue;
+        }
+        if (n < 0) {
+            s_damaged = false;
+            return false;
+        }
+        if (partial) {
+            partial = false;
+            continue;
+        }
+        notify(line);
+        if (strcmp(line, "OK") == 0 || strstr(line, "ERROR") != NULL ||
+            strncmp(line, "CONNECT", 7) == 0) {
+            s_damaged = false;
+            return true;
+        }
+    }
+}
+
+// Ends an exchange: after a UART error, resyncs so nothing of
+// the damaged answer is left for the next one, and fails it.
+static int check_damage(int result, int64_t deadline_us) {
+    if (!s_damaged) {
+        return result;
+    }
+    printf("[%s] UART error during the exchange, failed\n", TAG);
+    resync(deadline_us);
+    s_uart_stats.failed++;
+    return -1;
+}
+
+// ============================================================
+// drain_pending()
+//
+// Empties the RX buffer before a command is written. Lines that
+// arrived since the last exchange (URCs) go to the observer
+// instead of being flushed; what is left of a transparent-mode
+// stream is dropped, and the end of that data session reported
+// as "CLOSED".
+// ============================================================
+static void drain_pending(void) {
+    if (s_data_mode) {
+        uart_flush_input(UART_MODEM_NUM);
+        s_data_mode = false;
+        s_rx_esc = false;
+        rx_errors();
+        s_damaged = false;
+        notify("CLOSED");
+        return;
+    }
+    char line[MODEM_URC_MAX];
+    size_t buffered = 0;
+    while (uart_get_buffered_data_len(UART_MODEM_NUM, &buffered) == ESP_OK &&
+           buffered > 0) {
+        int64_t deadline = esp_timer_get_time() + MODEM_URC_LINE_MS * 1000;
+        if (read_line(line, sizeof(line), deadline) < 0) {
+            break;  // Damaged lines are not passed on.
+        }
+        notify(line);
+    }
+    uart_flush_input(UART_MODEM_NUM);
+
+    // Errors so far belong to lines before this command.
+    rx_errors();
+    s_damaged = false;
+}
+
+// ============================================================
+// has_final_result()
+//
+// Checks whether an accumulated response contains a final
+// result code, i.e. the modem is done answering.
+//
+// Inputs:
+//   buf — null-terminated response text collected so far.
+//
+// Returns:
+//   true if "OK", "ERROR" or "CONNECT" terminated by \r\n is present.
+// ============================================================
+static bool has_final_result(const char *buf) {
+    if (strstr(buf, "\r\nOK\r\n") != NULL || strncmp(buf, "OK\r\n", 4) == 0) {
+        return true;
+    }
+    if (strstr(buf, "ERROR\r\n") != NULL) {
+        // Covers plain "ERROR" and "+CME ERROR: <n>".
+        return true;
+    }
+    const char *connect = strstr(buf, "CONNECT");
+    if (connect != NULL && strstr(connect, "\r\n") != NULL) {
+        // "CONNECT" or "CONNECT 115200" — link switched to data mode.
+        return true;
+    }
+    return false;
+}
+
+// ============================================================
+// modem_uart_init()
+//
+// Steps:
+//   1. Fill a uart_config_t (baud, 8N1, RTS/CTS flow control
+//      if the board wires it).
+//   2. Apply it to UART1.
+//   3. Assign the board's modem GPIOs to UART1 signals.
+//   4. Install the UART1 driver with an RX ring buffer.
+//   5. XON/XOFF instead, on boards without RTS/CTS.
+// ============================================================
+void modem_uart_init(void) {
+    s_flow = flow_default();
+
+    // --- Step 1: UART1 configuration struct ---
+    // Same structure as fake_modem.c but for UART1.
+    uart_config_t uart_cfg = {
+        // Baud rate from the board profile (must match fake modem).
+        .baud_rate = MODEM_BAUD,
+
+        // 8 data bits, no parity, 1 stop bit (8N1).
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+
+        // Hardware flow control on UART1, where the board has it.
+        // UART1 will assert RTS when its RX FIFO has room.
+        // UART1 will check CTS before sending each byte.
+        .flow_ctrl = s_flow == FLOW_HW ? UART_HW_FLOWCTRL_CTS_RTS : UART_HW_FLOWCTRL_DISABLE,
+
+        // Deassert RTS when RX FIFO exceeds 122 bytes.
+        .rx_flow_ctrl_thresh = 122,
+
+        // XTAL (40 MHz) rather than APB: APB follows the CPU under
+        // DFS, XTAL does not, so the baud rate holds at any
+        // CPU frequency.
+        .source_clk = UART_SCLK_XTAL,
+    };
+
+    // --- Step 2: Apply config to UART1 hardware ---
+    uart_param_config(UART_MODEM_NUM, &uart_cfg);
+
+    // --- Step 3: Assign GPIO pins to UART1 signals ---
+    // Order: TX, RX, RTS, CTS.
+    uart_set_pin(UART_MODEM_NUM,
+                 PIN_MODEM_TX,
+                 PIN_MODEM_RX,
+                 PIN_MODEM_RTS,
+                 PIN_MODEM_CTS);
+
+    // --- Step 4: Install UART1 driver ---
+    // RX ring buffer sized by the memory planner (at least
+    // RX_RING_BYTES; more on boards with heap to spare, so bursts
+    // of URCs / datagrams survive a busy reader).
+    // TX ring sized by the planner too: writes return once the
+    // bytes are queued, not once all but the last FIFO's worth
+    // has gone out.
+    // Event queue: lets modem_poll() sleep until bytes arrive,
+    // and carries the UART errors.
+    // IRAM interrupt: a flash write / erase (tens of ms per
+    // sector) holds off every other ISR, while the 128-byte FIFO
+    // overflows after 11 ms at 115200 baud and 0.5 ms at 2.5
+    // Mbaud. With CONFIG_UART_ISR_IN_IRAM the driver allocates
+    // the ring and the queue in internal RAM for it.
+    uart_driver_install(UART_MODEM_NUM,
+                        (int)mem_plan_value(MEM_RX_RING),  // RX buffer size
+                        (int)mem_plan_value(MEM_TX_RING),  // TX buffer size
+                        MODEM_EVENT_QUEUE_LEN((int)mem_plan_value(MEM_RX_RING)),  // Event queue size
+                        &s_events,     // Event queue handle
+                        ESP_INTR_FLAG_IRAM);  // Interrupt flags
+    s_lock = xSemaphoreCreateRecursiveMutex();
+
+    // --- Step 5: Software flow control ---
+    // The peripheral sends XOFF / XON at the FIFO thresholds;
+    // the FIFO only fills once the RX ring above is full.
+    flow_apply(UART_MODEM_NUM, s_flow);
+
+    printf("[%s] UART%d configured on TX=%d RX=%d RTS=%d CTS=%d, flow control %s\n", TAG,
+           UART_MODEM_NUM, PIN_MODEM_TX, PIN_MODEM_RX, PIN_MODEM_RTS,
+           PIN_MODEM_CTS, flow_name(s_flow));
+}
+
+// ============================================================
+// modem_set_flow_control()
+//
+// Waits for the TX FIFO to empty so no byte goes out half under
+// the old mode. An escape split across the switch is dropped.
+// ============================================================
+void modem_set_flow_control(flow_mode_t mode) {
+    modem_lock();
+    uart_wait_tx_done(UART_MODEM_NUM, pdMS_TO_TICKS(MODEM_CMD_TIMEOUT_MS));
+    flow_apply(UART_MODEM_NUM, mode);
+    s_flow = mode;
+    s_rx_esc = false;
+    modem_unlock();
+}
+
+flow_mode_t modem_flow_control(void) {
+    return s_flow;
+}
+
+// ============================================================
+// modem_set_baud_rate()
+//
+// Same hand-over as the flow-control switch. The modem's side
+// must follow before the next exchange.
+// ============================================================
+void modem_set_baud_rate(uint32_t baud) {
+    modem_lock();
+    uart_wait_tx_done(UART_MODEM_NUM, pdMS_TO_TICKS(MODEM_CMD_TIMEOUT_MS));
+    uart_set_baudrate(UART_MODEM_NUM, baud);
+    modem_unlock();
+}
+
+// ============================================================
+// send_at_once()
+//
+// One attempt of modem_send_at().
+//
+// Loop behavior:
+//   1. Empty the RX buffer: late URCs go to the observer,
+//      leftovers from a closed data connection are dropped.
+//   2. Write the command.
+//   3. Read in small chunks until has_final_result(), a UART
+//      error (s_damaged) or the deadline. NMEA sentences go to
+//      the observers as they complete (route_nmea()) and are
+//      not part of the response.
+//
+// Returns:
+//   Response length (buf is null-terminated), or -1 without a
+//   final result code.
+// ============================================================
+static int send_at_once(const char *cmd, char *buf, size_t len, uint32_t timeout_ms) {
+    size_t pos = 0;
+
+    // --- Step 1: Pending URCs ---
+    drain_pending();
+
+    // --- Step 2: Command ---
+    boot_prof_first_at();
+    uart_write_bytes(UART_MODEM_NUM, cmd, strlen(cmd));
+
+    // --- Step 3: Response ---
+    TickType_t start = xTaskGetTickCount();
+    TickType_t deadline = pdMS_TO_TICKS(timeout_ms);
+    bool done = false;
+
+    while (!done && (xTaskGetTickCount() - start) < deadline) {
+        int n = uart_read_bytes(UART_MODEM_NUM, (uint8_t *)buf + pos,
+                                len - 1 - pos, pdMS_TO_TICKS(20));
+        if (n <= 0) {
+            continue;
+        }
+        pos += (size_t)n;
+        buf[pos] = '\0';
+        pos = route_nmea(buf, pos);
+        done = has_final_result(buf);
+        if (rx_errors()) {
+            s_damaged = true;
+            break;
+        }
+
+        // Response longer than the line limit: keep the tail only,
+        // the final result code is always at the end.
+        if (!done && pos >= len - 1) {
+            size_t keep = len / 2;
+            memmove(buf, buf + pos - keep, keep);
+            pos = keep;
+        }
+    }
+    buf[pos] = '\0';
+    return done ? (int)pos : -1;
+}
+
+// ============================================================
+// modem_send_at()
+//
+// Steps:
+//   1. One attempt (send_at_once()).
+//   2. If a UART error hit the answer: resync, then send a
+//      query ("?") again, up to MODEM_UART_RETRIES times; any
+//      other command may have acted already and just fails.
+//      Either way the caller learns at once, not at the
+//      deadline, and the next command starts on a clean line.
+//   3. Copy the response out and pass its lines to the
+//      observer.
+// ============================================================
+int modem_send_at(const char *cmd, char *resp, size_t resp_len,
+                  uint32_t timeout_ms) {
+    // Local accumulator so callers can pass resp == NULL.
+    char buf[MODEM_LINE_MAX];
+    int n;
+
+    modem_lock();
+    power_lock(POWER_UART);
+    for (int attempt = 0;; attempt++) {
+        // --- Step 1: Exchange ---
+        n = send_at_once(cmd, buf, sizeof(buf), timeout_ms);
+        if (!s_damaged) {
+            break;
+        }
+
+        // --- Step 2: Damaged answer ---
+        resync(esp_timer_get_time() + (int64_t)timeout_ms * 1000);
+        buf[0] = '\0';
+        n = -1;
+        if (attempt >= MODEM_UART_RETRIES || strchr(cmd, '?') == NULL) {
+            printf("[%s] %.*s: answer damaged (UART error), failed\n", TAG,
+                   (int)strcspn(cmd, "\r"), cmd);
+            s_uart_stats.failed++;
+            break;
+        }
+        s_uart_stats.retries++;
+    }
+
+    // --- Step 3: Response ---
+    if (resp != NULL && resp_len > 0) {
+        size_t copy = strlen(buf);
+        copy = copy < resp_len - 1 ? copy : resp_len - 1;
+        memcpy(resp, buf, copy);
+        resp[copy] = '\0';
+    }
+    if (n >= 0 && strstr(buf, "CONNECT") != NULL) {
+        s_data_mode = true;
+    }
+    notify_lines(buf);
+    power_unlock(POWER_UART);
+    modem_unlock();
+    return n;
+}
+
+// ============================================================
+// modem_open_transparent()
+//
+// Runs the SIMCom-style transparent TCP open sequence.
+// Any step failing aborts the sequence.
+// ============================================================
+static bool open_transparent(const char *host, uint16_t port) {
+    char resp[96];
+    char cmd[128];
+
+    if (modem_send_at("AT+CIPMODE=1\r\n", resp, sizeof(resp),
+                      MODEM_OPEN_TIMEOUT_MS) < 0 ||
+        strstr(resp, "OK") == NULL) {
+        printf("[%s] CIPMODE failed\n", TAG);
+        return false;
+    }
+    if (modem_send_at("AT+NETOPEN\r\n", resp, sizeof(resp),
+                      MODEM_OPEN_TIMEOUT_MS) < 0 ||
+        strstr(resp, "OK") == NULL) {
+        printf("[%s] NETOPEN failed\n", TAG);
+        return false;
+    }
+
+    snprintf(cmd, sizeof(cmd), "AT+CIPOPEN=0,\"TCP\",\"%s\",%u\r\n", host,
+             (unsigned)port);
+    if (modem_send_at(cmd, resp, sizeof(resp), MODEM_OPEN_TIMEOUT_MS) < 0 ||
+        strstr(resp, "CONNECT") == NULL) {
+        printf("[%s] CIPOPEN %s:%u failed\n", TAG, host, (unsigned)port);
+        return false;
+    }
+
+    printf("[%s] transparent link open to %s:%u\n", TAG, host, (unsigned)port);
+    return true;
+}
+
+bool modem_open_transparent(const char *host, uint16_t port) {
+    modem_lock();
+    bool ok = open_transparent(host, port);
+    modem_unlock();
+    return ok;
+}
+
+// ============================================================
+// modem_data_write() / modem_data_read()
+//
+// Thin pass-through to the UART driver while in data mode,
+// escaping for XON/XOFF. A read that only found an escape byte
+// returns 0, like a timeout.
+// ============================================================
+int modem_data_write(const uint8_t *data, size_t len) {
+    power_lock(POWER_UART);
+    int n = flow_write(UART_MODEM_NUM, data, len, s_flow);
+    // The TX ring may still be draining: no light sleep before
+    // the last byte is out.
+    uart_wait_tx_done(UART_MODEM_NUM, pdMS_TO_TICKS(MODEM_CMD_TIMEOUT_MS));
+    power_unlock(POWER_UART);
+    return n;
+}
+
+int modem_data_read(uint8_t *buf, size_t len, uint32_t timeout_ms) {
+    power_lock(POWER_UART);
+    int n = uart_read_bytes(UART_MODEM_NUM, buf, len,
+                            pdMS_TO_TICKS(timeout_ms));
+    power_unlock(POWER_UART);
+
+    // Counted only: a binary stream has no line to resync on; the
+    // protocol above (frame_link's CRC, TCP's peer) catches it.
+    rx_errors();
+    if (n > 0 && s_flow == FLOW_SW) {
+        n = (int)flow_unescape(buf, (size_t)n, &s_rx_esc);
+    }
+    return n;
+}
+
+// ============================================================
+// read_line()
+//
+// Reads one line byte by byte so nothing after the line
+// terminator is consumed (a datagram may follow immediately).
+//
+// Inputs:
+//   buf, len    — destination; the line is null-terminated and
+//                 stripped of "\r\n".
+//   deadline_us — esp_timer time after which to give up.
+//
+// Returns:
+//   Line length (0 for an empty line), -1 on timeout, or
+//   READ_LINE_DAMAGED when a UART error hit the line (buf holds
+//   what arrived; the caller resyncs).
+// ============================================================
+static int read_line(char *buf, size_t len, int64_t deadline_us) {
+    size_t pos = 0;
+    while (esp_timer_get_time() < deadline_us) {
+        uint8_t b;
+        if (uart_read_bytes(UART_MODEM_NUM, &b, 1, pdMS_TO_TICKS(10)) <= 0) {
+            continue;
+        }
+        if (b == '\n') {
+            buf[pos] = '\0';
+            if (rx_errors()) {
+                s_damaged = true;
+                return READ_LINE_DAMAGED;
+            }
+            return (int)pos;
+        }
+        if (b != '\r' && pos < len - 1) {
+            buf[pos++] = (char)b;
+        }
+    }
+    buf[pos] = '\0';
+    return -1;
+}
+
+// ============================================================
+// modem_udp_open()
+// ============================================================
+static bool udp_open(uint8_t link_id, uint16_t local_port) {
+    char resp[96];
+    char cmd[64];
+
+    if (modem_send_at("AT+CIPMODE=0\r\n", resp, sizeof(resp),
+                      MODEM_OPEN_TIMEOUT_MS) < 0 ||
+        strstr(resp, "OK") == NULL) {
+        printf("[%s] CIPMODE=0 failed\n", TAG);
+        return false;
+    }
+    if (modem_send_at("AT+NETOPEN\r\n", resp, sizeof(resp),
+                      MODEM_OPEN_TIMEOUT_MS) < 0 ||
+        strstr(resp, "OK") == NULL) {
+        printf("[%s] NETOPEN failed\n", TAG);
+        return false;
+    }
+
+    snprintf(cmd, sizeof(cmd), "AT+CIPOPEN=%u,\"UDP\",,,%u\r\n",
+             (unsigned)link_id, (unsigned)local_port);
+    if (modem_send_at(cmd, resp, sizeof(resp), MODEM_OPEN_TIMEOUT_MS) < 0 ||
+        strstr(resp, "OK") == NULL) {
+        printf("[%s] UDP open on link %u failed\n", TAG, (unsigned)link_id);
+        return false;
+    }
+    printf("[%s] UDP link %u open, local port %u\n", TAG, (unsigned)link_id,
+           (unsigned)local_port);
+    return true;
+}
+
+bool modem_udp_open(uint8_t link_id, uint16_t local_port) {
+    modem_lock();
+    bool ok = udp_open(link_id, local_port);
+    if (ok) {
+        s_udp_links |= 1u << link_id;
+    }
+    modem_unlock();
+    return ok;
+}
+
+// ============================================================
+// wait_prompt()
+//
+// Waits for the CIPSEND '>' prompt. Lines that arrive before it
+// (URCs) go to the observers rather than being skipped. A UART
+// error gives up: the prompt may be what was lost.
+// ============================================================
+static bool wait_prompt(int64_t deadline_us) {
+    char line[MODEM_URC_MAX];
+    size_t pos = 0;
+    while (esp_timer_get_time() < deadline_us) {
+        uint8_t b;
+        if (uart_read_bytes(UART_MODEM_NUM, &b, 1, pdMS_TO_TICKS(10)) <= 0) {
+            continue;
+        }
+        if (b == '>' && pos == 0) {
+            return true;
+        }
+        if (b == '\n') {
+            line[pos] = '\0';
+            if (rx_errors()) {
+                s_damaged = true;
+                return false;
+            }
+            notify(line);
+            pos = 0;
+        } else if (b != '\r' && pos < sizeof(line) - 1) {
+            line[pos++] = (char)b;
+        }
+    }
+    return false;
+}
+
+// ============================================================
+// read_payload()
+//
+// Reads exactly n raw bytes following a length header, storing
+// up to len of them (the excess is read and dropped). n counts
+// payload bytes: XON/XOFF escapes come on top.
+// Returns bytes stored, or -1 if the deadline cut the payload or
+// a UART error hit it (bytes lost: the count ran into whatever
+// followed).
+// ============================================================
+static int read_payload(uint8_t *buf, size_t len, size_t n, int64_t deadline_us) {
+    size_t stored = 0;
+    size_t got = 0;
+    bool esc = false;
+    while (got < n && esp_timer_get_time() < deadline_us) {
+        uint8_t b;
+        if (uart_read_bytes(UART_MODEM_NUM, &b, 1, pdMS_TO_TICKS(10)) <= 0) {
+            continue;
+        }
+        if (s_flow == FLOW_SW && !flow_unescape_byte(&b, &esc)) {
+            continue;
+        }
+        if (stored < len) {
+            buf[stored++] = b;
+        }
+        got++;
+    }
+    if (got < n) {
+        printf("[%s] payload of %u truncated at %u bytes\n", TAG, (unsigned)n,
+               (unsigned)got);
+        return -1;
+    }
+    if (rx_errors()) {
+        s_damaged = true;
+        return -1;
+    }
+    return (int)stored;
+}
+
+// ============================================================
+// prompt_exchange()
+//
+// Steps:
+//   1. Write the command.
+//   2. Wait for the '>' prompt (modem ready for raw bytes).
+//   3. Write exactly len payload bytes.
+//   4. Wait for OK, keeping the last "+..." line in resp.
+// The RX buffer is not flushed: a datagram from an earlier
+// exchange must not be thrown away here.
+// ============================================================
+static int prompt_exchange(const char *cmd, const uint8_t *data, size_t len,
+                           char *resp, size_t resp_len, int64_t deadline_us) {
+    // --- Step 1: Command ---
+    uart_write_bytes(UART_MODEM_NUM, cmd, strlen(cmd));
+
+    // --- Step 2: '>' prompt ---
+    if (!wait_prompt(deadline_us)) {
+        printf("[%s] %.*s: no prompt\n", TAG, (int)strcspn(cmd, "="), cmd);
+        return -1;
+    }
+
+    // --- Step 3: payload ---
+    flow_write(UART_MODEM_NUM, data, len, s_flow);
+
+    // --- Step 4: OK / ERROR ---
+    char line[64];
+    while (read_line(line, sizeof(line), deadline_us) >= 0) {
+        notify(line);
+        if (strcmp(line, "OK") == 0) {
+            return (int)len;
+        }
+        if (strstr(line, "ERROR") != NULL) {
+            break;
+        }
+        if (resp != NULL && line[0] == '+') {
+            snprintf(resp, resp_len, "%s", line);
+        }
+    }
+    printf("[%s] %.*s failed\n", TAG, (int)strcspn(cmd, "="), cmd);
+    return -1;
+}
+
+// ============================================================
+// cip_send()
+//
+// AT+CIPSEND with length (and destination for UDP; host == NULL
+// for a connected TCP link), then the payload after the prompt.
+// ============================================================
+static int cip_send(uint8_t link_id, const char *host, uint16_t port,
+                    const uint8_t *data, size_t len, uint32_t timeout_ms) {
+    char cmd[96];
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+
+    if (host != NULL) {
+        snprintf(cmd, sizeof(cmd), "AT+CIPSEND=%u,%u,\"%s\",%u\r\n",
+                 (unsigned)link_id, (unsigned)len, host, (unsigned)port);
+    } else {
+        snprintf(cmd, sizeof(cmd), "AT+CIPSEND=%u,%u\r\n", (unsigned)link_id,
+                 (unsigned)len);
+    }
+    return prompt_exchange(cmd, data, len, NULL, 0, deadline);
+}
+
+// ============================================================
+// modem_udp_send() / modem_link_send()
+// ============================================================
+int modem_udp_send(uint8_t link_id, const char *host, uint16_t port,
+                   const uint8_t *data, size_t len, uint32_t timeout_ms) {
+    modem_lock();
+    power_lock(POWER_UART);
+    int n = cip_send(link_id, host, port, data, len, timeout_ms);
+    n = check_damage(n, esp_timer_get_time() + (int64_t)timeout_ms * 1000);
+    power_unlock(POWER_UART);
+    modem_unlock();
+    return n;
+}
+
+int modem_link_send(uint8_t link_id, const uint8_t *data, size_t len,
+                    uint32_t timeout_ms) {
+    modem_lock();
+    power_lock(POWER_UART);
+    int n = cip_send(link_id, NULL, 0, data, len, timeout_ms);
+    n = check_damage(n, esp_timer_get_time() + (int64_t)timeout_ms * 1000);
+    power_unlock(POWER_UART);
+    modem_unlock();
+    return n;
+}
+
+// ============================================================
+// modem_udp_recv()
+// ============================================================
+static int udp_recv(uint8_t link_id, uint8_t *buf, size_t len,
+                    uint32_t timeout_ms) {
+    (void)link_id;
+    char line[64];
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+
+    while (read_line(line, sizeof(line), deadline) >= 0) {
+        if (strncmp(line, "+IPD", 4) != 0) {
+            notify(line);  // "+CIPSEND: ...", "RECV FROM: ...", URCs.
+            continue;
+        }
+        return read_payload(buf, len, (size_t)atoi(line + 4), deadline);
+    }
+    return 0;
+}
+
+int modem_udp_recv(uint8_t link_id, uint8_t *buf, size_t len,
+                   uint32_t timeout_ms) {
+    modem_lock();
+    power_lock(POWER_UART);
+    int n = udp_recv(link_id, buf, len, timeout_ms);
+    n = check_damage(n, esp_timer_get_time() + (int64_t)timeout_ms * 1000);
+    power_unlock(POWER_UART);
+    modem_unlock();
+    return n;
+}
+
+// ============================================================
+// modem_link_read()
+//
+// Steps:
+//   1. Deliver pending URCs, write AT+CIPRXGET=2,<link>,<len>.
+//   2. Skip (and deliver) lines up to "+CIPRXGET: 2,<link>,<n>,<rest>".
+//   3. Read the n payload bytes, then the final OK.
+// ============================================================
+static int link_read(uint8_t link_id, uint8_t *buf, size_t len, size_t *rest,
+                     uint32_t timeout_ms) {
+    char cmd[40];
+    char line[64];
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    *rest = 0;
+
+    // --- Step 1: Command ---
+    drain_pending();
+    snprintf(cmd, sizeof(cmd), "AT+CIPRXGET=2,%u,%u\r\n", (unsigned)link_id,
+             (unsigned)len);
+    uart_write_bytes(UART_MODEM_NUM, cmd, strlen(cmd));
+
+    // --- Step 2: Header ---
+    int stored = -1;
+    while (stored < 0 && read_line(line, sizeof(line), deadline) >= 0) {
+        unsigned link = 0, n = 0, left = 0;
+        if (sscanf(line, "+CIPRXGET: 2,%u,%u,%u", &link, &n, &left) == 3 &&
+            link == link_id) {
+            // --- Step 3: Payload + OK ---
+            stored = read_payload(buf, len, n, deadline);
+            *rest = left;
+            if (stored < 0) {
+                return -1;
+            }
+        } else if (strcmp(line, "OK") == 0) {
+            return 0;  // Nothing buffered.
+        } else if (strstr(line, "ERROR") != NULL) {
+            return -1;
+        } else {
+            notify(line);
+        }
+    }
+    while (stored >= 0 && read_line(line, sizeof(line), deadline) >= 0) {
+        if (strcmp(line, "OK") == 0) {
+            break;
+        }
+        notify(line);
+    }
+    return stored;
+}
+
+int modem_link_read(uint8_t link_id, uint8_t *buf, size_t len, size_t *rest,
+                    uint32_t timeout_ms) {
+    modem_lock();
+    power_lock(POWER_UART);
+    int n = link_read(link_id, buf, len, rest, timeout_ms);
+    n = check_damage(n, esp_timer_get_time() + (int64_t)timeout_ms * 1000);
+    power_unlock(POWER_UART);
+    modem_unlock();
+    return n;
+}
+
+// ============================================================
+// modem_send_prompt()
+// ============================================================
+int modem_send_prompt(const char *cmd, const uint8_t *data, size_t len, char *resp,
+                      size_t resp_len, uint32_t timeout_ms) {
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    if (resp != NULL && resp_len > 0) {
+        resp[0] = '\0';
+    }
+    modem_lock();
+    power_lock(POWER_UART);
+    drain_pending();
+    int n = prompt_exchange(cmd, data, len, resp, resp_len, deadline);
+    n = check_damage(n, deadline);
+    power_unlock(POWER_UART);
+    modem_unlock();
+    return n;
+}
+
+// ============================================================
+// modem_send_at_lines()
+//
+// Like modem_send_at(), but hands the response to fn one line
+// at a time as it arrives, in the caller's line buffer, so a
+// long listing never has to fit in one response buffer.
+// ============================================================
+int modem_send_at_lines(const char *cmd, char *line, size_t line_len, modem_line_fn fn,
+                        void *user, uint32_t timeout_ms) {
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    int lines = -1;
+
+    modem_lock();
+    power_lock(POWER_UART);
+    drain_pending();
+    uart_write_bytes(UART_MODEM_NUM, cmd, strlen(cmd));
+
+    int count = 0;
+    while (read_line(line, line_len, deadline) >= 0) {
+        if (line[0] == '\0') {
+            continue;
+        }
+        if (strcmp(line, "OK") == 0) {
+            lines = count;
+            break;
+        }
+        if (strstr(line, "ERROR") != NULL) {
+            break;
+        }
+        notify(line);
+        if (line[0] == '$') {
+            continue;  // NMEA sentence: observers only.
+        }
+        fn(line, user);
+        count++;
+    }
+    lines = check_damage(lines, deadline);
+    power_unlock(POWER_UART);
+    modem_unlock();
+    return lines;
+}
+
+// ============================================================
+// modem_udp_close()
+// ============================================================
+void modem_udp_close(uint8_t link_id) {
+    char cmd[32];
+    snprintf(cmd, sizeof(cmd), "AT+CIPCLOSE=%u\r\n", (unsigned)link_id);
+    modem_lock();
+    s_udp_links &= ~(1u << link_id);
+    modem_send_at(cmd, NULL, 0, MODEM_OPEN_TIMEOUT_MS);
+    modem_unlock();
+}
+
+// ============================================================
+// URC path
+// ============================================================
+esp_err_t modem_add_line_observer(modem_line_fn fn, void *user) {
+    esp_err_t err = ESP_ERR_NO_MEM;
+    modem_lock();
+    for (int i = 0; i < MODEM_LINE_OBSERVERS_MAX; i++) {
+        if (s_observers[i].fn == NULL) {
+            s_observers[i].fn = fn;
+            s_observers[i].user = user;
+            if (s_observer_count++ == 0) {
+                power_lock(POWER_UART);
+            }
+            err = ESP_OK;
+            break;
+        }
+    }
+    modem_unlock();
+    return err;
+}
+
+void modem_remove_line_observer(modem_line_fn fn, void *user) {
+    modem_lock();
+    for (int i = 0; i < MODEM_LINE_OBSERVERS_MAX; i++) {
+        if (s_observers[i].fn == fn && s_observers[i].user == user) {
+            s_observers[i].fn = NULL;
+            if (--s_observer_count == 0) {
+                power_unlock(POWER_UART);
+            }
+        }
+    }
+    modem_unlock();
+}
+
+// ============================================================
+// modem_poll()
+//
+// Steps:
+//   1. While a data session owns the UART, just wait: its own
+//      reads pass any URC lines on.
+//   2. Sleep on the UART event queue (no mutex; POWER_UART is
+//      already held by the observer registration),
+//      unless bytes are already buffered: exchanges take the
+//      events of what they leave behind. Peek only: an error
+//      event must stay queued for the exchange that may be
+//      reading right now.
+//   3. Under the mutex, take the events and read whatever
+//      complete lines are buffered, passing them to the
+//      observer. An exchange that ran in between may already
+//      have consumed them. A UART error drops the damaged line
+//      and resyncs.
+// ============================================================
+int modem_poll(uint32_t timeout_ms) {
+    // --- Step 1: Data session open ---
+    if (s_data_mode || s_udp_links != 0 || s_events == NULL) {
+        vTaskDelay(pdMS_TO_TICKS(timeout_ms));
+        return 0;
+    }
+
+    // --- Step 2: Wait for RX activity ---
+    uart_event_t ev;
+    size_t buffered = 0;
+    if ((uart_get_buffered_data_len(UART_MODEM_NUM, &buffered) != ESP_OK || buffered == 0) &&
+        xQueuePeek(s_events, &ev, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+        return 0;
+    }
+
+    // --- Step 3: Read complete lines ---
+    int lines = 0;
+    char line[MODEM_URC_MAX];
+    modem_lock();
+    power_lock(POWER_UART);
+    if (rx_errors()) {
+        resync(esp_timer_get_time() + MODEM_URC_LINE_MS * 1000);
+    }
+    while (!s_data_mode && s_udp_links == 0 &&
+           uart_get_buffered_data_len(UART_MODEM_NUM, &buffered) == ESP_OK &&
+           buffered > 0) {
+        int64_t deadline = esp_timer_get_time() + MODEM_URC_LINE_MS * 1000;
+        int n = read_line(line, sizeof(line), deadline);
+        if (n == READ_LINE_DAMAGED) {
+            resync(deadline);
+            continue;
+        }
+        if (n < 0) {
+            break;
+        }
+        if (line[0] != '\0') {
+            notify(line);
+            lines++;
+        }
+    }
+    power_unlock(POWER_UART);
+    modem_unlock();
+    return lines;
+}
+
+modem_uart_stats_t modem_uart_stats(void) {
+    return s_uart_stats;
+}
@@ -0,0 +1,242 @@
+#pragma once
+
+// ============================================================
+// modem.h
+//
+// Driver side of the modem link on UART1.
+//
+// Owns the UART1 peripheral and gives the rest of the firmware
+// three ways to talk to the modem:
+//   - AT command mode: send one command line, collect the
+//     response up to its final result code (OK / ERROR / ...).
+//   - Transparent data mode: after a successful
+//     modem_open_transparent(), raw bytes written here go straight
+//     to the remote TCP peer and bytes from the peer come back
+//     through modem_data_read(). Protocol clients (MQTT, ...)
+//     sit on top of this byte stream.
+//   - UDP datagram mode: modem_udp_*() wrap AT+CIPOPEN/CIPSEND
+//     in non-transparent mode; incoming datagrams arrive as
+//     "+IPD<len>" followed by the raw bytes.
+//
+// Unsolicited result codes (URCs): every line the driver reads
+// in AT mode — command responses, and URCs that arrive during or
+// between exchanges — is passed to the line observers
+// (modem_reg.c, modem_sock.c, modem_sms.c). Between exchanges, modem_poll() waits for them.
+// NMEA sentences ("$..." lines) the modem interleaves with a
+// response go to the observers only (gnss.c), never into the
+// caller's response buffer or line callback.
+// While a data session is open (transparent link, or a UDP
+// socket) modem_poll() stays off the UART and URCs reach the
+// observer through that session's own reads.
+//
+// UART errors (FIFO overflow, framing, parity, break) are
+// counted by type; so is a full RX ring, which only stalls. The line they hit is dropped and the reader resyncs on
+// the next line boundary; the exchange in progress fails at once
+// (-1) and only that one: a query is retried, MODEM_UART_RETRIES
+// times, and the next caller's command starts clean.
+//
+// Pins, baud rate and flow control come from the active board
+// profile (PIN_MODEM_*, MODEM_BAUD, MODEM_USE_HWFC in
+// config/board_*.h): RTS/CTS where it is wired, XON/XOFF
+// otherwise.
+// ============================================================
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+// flow_mode_t.
+#include "flow_ctl.h"
+
+// Longest URC line kept (longer ones are truncated).
+#define MODEM_URC_MAX 128
+
+// Registration state machine, socket layer, SMS, GNSS, one spare.
+#define MODEM_LINE_OBSERVERS_MAX 5
+
+// Line observer: one line without "\r\n", never empty. Runs on
+// whichever task did the read, with the modem mutex held: it must
+// not call modem_* functions.
+typedef void (*modem_line_fn)(const char *line, void *user);
+
+// --- Counters ---
+typedef struct {
+    uint32_t fifo_ovf;       // Hardware RX FIFO overran: bytes lost.
+    uint32_t buffer_full;    // RX ring full: reads stalled, bytes held in the FIFO.
+    uint32_t frame_err;      // Bad stop bit (noise, baud mismatch).
+    uint32_t parity_err;     // Only with parity enabled.
+    uint32_t breaks;         // Line held low.
+    uint32_t resyncs;        // Damaged lines dropped up to a line boundary.
+    uint32_t retries;        // Queries sent again after a damaged answer.
+    uint32_t failed;         // Exchanges failed by an error, not a timeout.
+} modem_uart_stats_t;
+
+// --- Public functions ---------------------------------------
+
+// modem_uart_init()
+//
+// Configures UART1 (baud, 8N1, flow_default() flow control),
+// assigns the board's modem pins and installs the UART1 driver.
+// Call once from app_main() before any other modem_* function.
+void modem_uart_init(void);
+
+// modem_set_flow_control()
+//
+// Switches UART1 to another flow-control mode (overflow
+// benchmark). The modem must be switched to the same mode; call
+// between exchanges.
+void modem_set_flow_control(flow_mode_t mode);
+
+flow_mode_t modem_flow_control(void);
+
+// modem_set_baud_rate()
+//
+// Changes UART1's baud rate (flash stress test; MODEM_BAUD at
+// boot). The modem must be switched to the same rate; call
+// between exchanges.
+void modem_set_baud_rate(uint32_t baud);
+
+// modem_send_at()
+//
+// Sends one AT command and collects the response until a final
+// result code ("OK", "ERROR", "+CME ERROR", "CONNECT") arrives or
+// timeout_ms expires.
+//
+// Inputs:
+//   cmd        — null-terminated command including trailing "\r\n".
+//   resp       — buffer for the raw response (may be NULL).
+//   resp_len   — size of resp in bytes.
+//   timeout_ms — overall deadline for the final result code.
+//
+// Returns:
+//   Number of response bytes stored (resp is null-terminated),
+//   or -1 if no final result code arrived before the deadline.
+int modem_send_at(const char *cmd, char *resp, size_t resp_len,
+                  uint32_t timeout_ms);
+
+// modem_open_transparent()
+//
+// Opens a TCP connection in transparent mode:
+//   AT+CIPMODE=1, AT+NETOPEN, AT+CIPOPEN=0,"TCP","<host>",<port>
+// and waits for "CONNECT". After this returns true, the link is
+// a raw byte pipe until the peer closes it.
+//
+// Returns true when the modem reported CONNECT.
+bool modem_open_transparent(const char *host, uint16_t port);
+
+// modem_data_write()
+//
+// Writes raw bytes in transparent mode.
+// Returns the number of bytes queued, or -1 on error.
+int modem_data_write(const uint8_t *data, size_t len);
+
+// modem_data_read()
+//
+// Reads up to len raw bytes in transparent mode, waiting at most
+// timeout_ms for the first byte.
+// Returns bytes read (0 on timeout), or -1 on error.
+int modem_data_read(uint8_t *buf, size_t len, uint32_t timeout_ms);
+
+// modem_udp_open()
+//
+// Switches to non-transparent mode and opens a UDP socket:
+//   AT+CIPMODE=0, AT+NETOPEN, AT+CIPOPEN=<link>,"UDP",,,<local_port>
+//
+// Returns true when the modem accepted the socket.
+bool modem_udp_open(uint8_t link_id, uint16_t local_port);
+
+// modem_udp_send()
+//
+// Sends one datagram: AT+CIPSEND=<link>,<len>,"<host>",<port>,
+// waits for the '>' prompt, writes the payload, waits for OK.
+//
+// Returns len on success, -1 on error or timeout.
+int modem_udp_send(uint8_t link_id, const char *host, uint16_t port,
+                   const uint8_t *data, size_t len, uint32_t timeout_ms);
+
+// modem_udp_recv()
+//
+// Waits up to timeout_ms for a "+IPD<n>" notification and reads
+// the n payload bytes that follow. Datagrams longer than len are
+// truncated (the excess is read and dropped).
+//
+// Note: lines other than +IPD seen while waiting go to the line
+// observer, so only one UDP socket should be receiving at a time.
+//
+// Returns bytes stored (0 on timeout), or -1 on error.
+int modem_udp_recv(uint8_t link_id, uint8_t *buf, size_t len,
+                   uint32_t timeout_ms);
+
+// modem_udp_close()
+//
+// AT+CIPCLOSE=<link>.
+void modem_udp_close(uint8_t link_id);
+
+// modem_add_line_observer() / modem_remove_line_observer()
+//
+// Registers an observer for AT-mode lines. Every observer sees
+// every line. ESP_ERR_NO_MEM when all MODEM_LINE_OBSERVERS_MAX
+// slots are taken.
+//
+// While at least one observer is registered the chip stays out
+// of light sleep (POWER_UART): a URC waking it through the UART
+// would lose its first characters. Remove observers that are
+// no longer needed.
+esp_err_t modem_add_line_observer(modem_line_fn fn, void *user);
+void modem_remove_line_observer(modem_line_fn fn, void *user);
+
+// modem_link_send()
+//
+// Sends on a connected link in non-transparent mode:
+// AT+CIPSEND=<link>,<len>, '>' prompt, payload, OK.
+//
+// Returns len on success, -1 on error or timeout.
+int modem_link_send(uint8_t link_id, const uint8_t *data, size_t len,
+                    uint32_t timeout_ms);
+
+// modem_link_read()
+//
+// Pulls up to len bytes a link holds in manual receive mode
+// (AT+CIPRXGET=1): AT+CIPRXGET=2,<link>,<len>. *rest is what the
+// modem still holds for the link afterwards.
+//
+// Returns bytes stored (0 when the link had nothing), or -1.
+int modem_link_read(uint8_t link_id, uint8_t *buf, size_t len, size_t *rest,
+                    uint32_t timeout_ms);
+
+// modem_send_prompt()
+//
+// Sends a command that answers with a '>' prompt (AT+CMGS, ...),
+// writes len raw bytes after the prompt and waits for OK. The
+// last "+..." line of the answer (e.g. "+CMGS: <mr>") is copied to
+// resp (may be NULL).
+//
+// Returns len on success, -1 on error or timeout.
+int modem_send_prompt(const char *cmd, const uint8_t *data, size_t len, char *resp,
+                      size_t resp_len, uint32_t timeout_ms);
+
+// modem_send_at_lines()
+//
+// Sends one AT command and hands every response line (without
+// "\r\n", never empty, final result code excluded) to fn as it
+// is read, in the caller's buffer line / line_len. fn runs with
+// the modem mutex held, like an observer.
+//
+// Returns the number of lines delivered, or -1 on ERROR or
+// timeout.
+int modem_send_at_lines(const char *cmd, char *line, size_t line_len, modem_line_fn fn,
+                        void *user, uint32_t timeout_ms);
+
+// modem_poll()
+//
+// Waits up to timeout_ms for unsolicited lines and passes them to
+// the observer. Sleeps on the UART event queue, so an idle modem
+// costs no CPU wake-ups. Returns immediately after timeout_ms
+// (without reading) while a data session owns the UART.
+//
+// Returns the number of lines delivered.
+int modem_poll(uint32_t timeout_ms);
+
+modem_uart_stats_t modem_uart_stats(void);
@@ -0,0 +1,204 @@
+// ============================================================
+// modem_frame.c
+//
+// frame_link over the modem UART. See modem_frame.h.
+// ============================================================
+
+#include "modem_frame.h"
+
+#if FEATURE_FRAME_LINK
+
+// stdio.h: printf() for console logging to UART0.
+#include <stdio.h>
+
+// string.h: strstr() on the CONNECT answer, memcpy().
+#include <string.h>
+
+// esp_timer.h: link clock and deadlines.
+#include "esp_timer.h"
+
+// esp_heap_caps.h: link state (window buffers) while open, in
+// internal RAM next to the UART ring the fast path reads from.
+#include "esp_heap_caps.h"
+
+// AT exchange to switch over, raw reads / writes afterwards.
+#include "modem.h"
+
+static const char *TAG = "modem_frame";
+
+// Longest single UART read while pumping: short enough for the
+// retransmission timers to stay accurate.
+#define PUMP_MS 5
+
+static frame_link_t *s_link;
+static frame_link_stats_t s_last_stats;
+
+// Receive target of the modem_frame_recv() in progress.
+static uint8_t *s_dst;
+static size_t s_dst_len;
+static int s_got;
+
+static void link_write(const uint8_t *data, size_t len, void *user) {
+    (void)user;
+    modem_data_write(data, len);
+}
+
+// Takes one message, and only while a receive is waiting for it;
+// anything else stays in the link's window.
+static bool link_deliver(const uint8_t *data, size_t len, void *user) {
+    (void)user;
+    if (s_dst == NULL || s_got >= 0) {
+        return false;
+    }
+    size_t n = len < s_dst_len ? len : s_dst_len;
+    memcpy(s_dst, data, n);
+    s_got = (int)n;
+    return true;
+}
+
+// One read from the UART (up to wait_ms), fed to the link, then
+// its timers.
+static void pump(uint32_t wait_ms) {
+    uint8_t buf[128];
+    int n = modem_data_read(buf, sizeof(buf), wait_ms);
+    int64_t now = esp_timer_get_time();
+    if (n > 0) {
+        frame_link_rx(s_link, buf, (size_t)n, now);
+    }
+    frame_link_tick(s_link, now);
+}
+
+static uint32_t remaining_ms(int64_t deadline) {
+    int64_t left = deadline - esp_timer_get_time();
+    if (left <= 0) {
+        return 0;
+    }
+    return left < PUMP_MS * 1000 ? (uint32_t)(left / 1000) : PUMP_MS;
+}
+
+// ============================================================
+// modem_frame_open()
+//
+// Steps:
+//   1. Link state first: the modem's first frame may follow
+//      CONNECT directly.
+//   2. AT+FRAME=1; CONNECT puts the AT layer in data mode.
+// ============================================================
+esp_err_t modem_frame_open(void) {
+    if (s_link != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // --- Step 1: Link state ---
+    s_link = heap_caps_malloc(sizeof(*s_link), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (s_link == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    frame_link_init(s_link, link_write, link_deliver, NULL);
+
+    // --- Step 2: Switch the UART over ---
+    char resp[64];
+    if (modem_send_at("AT+FRAME=1\r\n", resp, sizeof(resp), MODEM_CMD_TIMEOUT_MS) < 0 ||
+        strstr(resp, "CONNECT") == NULL) {
+        printf("[%s] modem refused framed mode\n", TAG);
+        heap_caps_free(s_link);
+        s_link = NULL;
+        return ESP_FAIL;
+    }
+    printf("[%s] framed link up: %d B frames, window %d, CRC-%d\n", TAG, FRAME_PAYLOAD_MAX,
+           FRAME_WINDOW, FRAME_CRC32 ? 32 : 16);
+    return ESP_OK;
+}
+
+int modem_frame_send(const uint8_t *data, size_t len, uint32_t timeout_ms) {
+    if (s_link == NULL) {
+        return -1;
+    }
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    while (!frame_link_can_send(s_link)) {
+        if (s_link->failed) {
+            return -1;
+        }
+        if (esp_timer_get_time() >= deadline) {
+            return 0;
+        }
+        pump(remaining_ms(deadline));
+    }
+    return frame_link_send(s_link, data, len, esp_timer_get_time());
+}
+
+int modem_frame_recv(uint8_t *buf, size_t len, uint32_t timeout_ms) {
+    if (s_link == NULL) {
+        return -1;
+    }
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    s_dst = buf;
+    s_dst_len = len;
+    s_got = -1;
+
+    // A message may already be waiting in the window.
+    frame_link_tick(s_link, esp_timer_get_time());
+    while (s_got < 0 && !s_link->failed && !s_link->peer_closed) {
+        pump(remaining_ms(deadline));
+        if (esp_timer_get_time() >= deadline) {
+            break;
+        }
+    }
+    s_dst = NULL;
+    if (s_got >= 0) {
+        return s_got;
+    }
+    return s_link->failed || s_link->peer_closed ? -1 : 0;
+}
+
+bool modem_frame_flush(uint32_t timeout_ms) {
+    if (s_link == NULL) {
+        return false;
+    }
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    while (!frame_link_idle(s_link)) {
+        if (s_link->failed || esp_timer_get_time() >= deadline) {
+            return false;
+        }
+        pump(remaining_ms(deadline));
+    }
+    return true;
+}
+
+// ============================================================
+// modem_frame_close()
+//
+// DISC until UA (at most FRAME_RETRIES_MAX tries, one per
+// FRAME_RTO_MS). The modem leaves framed mode on DISC; the next
+// AT exchange drops whatever is still buffered.
+// ============================================================
+void modem_frame_close(void) {
+    if (s_link == NULL) {
+        return;
+    }
+    for (int i = 0; i <= FRAME_RETRIES_MAX && !s_link->closed && !s_link->peer_closed; i++) {
+        frame_link_disconnect(s_link);
+        int64_t deadline = esp_timer_get_time() + (int64_t)FRAME_RTO_MS * 1000;
+        while (!s_link->closed && esp_timer_get_time() < deadline) {
+            pump(remaining_ms(deadline));
+        }
+    }
+    if (!s_link->closed && !s_link->peer_closed) {
+        printf("[%s] no UA from the modem\n", TAG);
+    }
+    s_last_stats = s_link->stats;
+    heap_caps_free(s_link);
+    s_link = NULL;
+}
+
+void modem_frame_set_bit_errors(uint32_t per_million) {
+    if (s_link != NULL) {
+        frame_link_set_bit_errors(s_link, per_million, 0x5EED);
+    }
+}
+
+frame_link_stats_t modem_frame_stats(void) {
+    return s_link != NULL ? s_link->stats : s_last_stats;
+}
+
+#endif  // FEATURE_FRAME_LINK
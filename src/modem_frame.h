@@ -0,0 +1,67 @@
+#pragma once
+
+// ============================================================
+// modem_frame.h
+//
+// Framed binary transport on the modem UART, an alternative to
+// the AT text exchanges for device-to-device traffic.
+//
+// AT+FRAME=1 switches the link: the modem answers CONNECT and
+// from then on both sides speak frame_link (COBS frames with a
+// CRC, sequence numbers, a sliding window and selective
+// retransmit; see frame_link.h) instead of lines. Like the
+// transparent data session, it owns the UART until
+// modem_frame_close(); the next AT exchange finds the modem back
+// in command mode.
+//
+// Messages keep their boundaries: one modem_frame_send() of up
+// to FRAME_PAYLOAD_MAX bytes is one modem_frame_recv() on the
+// other side, in order, exactly once, or the link reports
+// failure.
+//
+// Single user: calls come from one task at a time.
+// ============================================================
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "app_config.h"
+
+// frame_link_stats_t.
+#include "frame_link.h"
+
+// --- Public functions ---------------------------------------
+
+// AT+FRAME=1 and the link state. ESP_FAIL when the modem did not
+// answer CONNECT.
+esp_err_t modem_frame_open(void);
+
+// Sends one message (1..FRAME_PAYLOAD_MAX bytes), waiting up to
+// timeout_ms for room in the window.
+// Returns len, 0 on timeout, -1 when len is invalid or the link
+// has failed.
+int modem_frame_send(const uint8_t *data, size_t len, uint32_t timeout_ms);
+
+// Receives one message into buf (truncated to len), waiting up
+// to timeout_ms. Also runs the link's retransmissions, so a
+// sender that only sends should still call it with 0.
+// Returns the message length, 0 on timeout, -1 once the link has
+// failed or the peer closed it.
+int modem_frame_recv(uint8_t *buf, size_t len, uint32_t timeout_ms);
+
+// Waits until every message sent is acknowledged. Returns false
+// on timeout or failure.
+bool modem_frame_flush(uint32_t timeout_ms);
+
+// Disconnects (DISC / UA) and hands the UART back to AT
+// commands.
+void modem_frame_close(void);
+
+// Flips bits on this side's output (test only; see
+// frame_link_set_bit_errors()).
+void modem_frame_set_bit_errors(uint32_t per_million);
+
+frame_link_stats_t modem_frame_stats(void);
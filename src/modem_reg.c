@@ -0,0 +1,433 @@
+// ============================================================
+// modem_reg.c
+//
+// URC-driven modem registration state machine.
+// See modem_reg.h.
+// ============================================================
+
+#include "modem_reg.h"
+
+// stdio.h: printf() for console logging to UART0.
+#include <stdio.h>
+
+// string.h / stdlib.h: URC matching and field parsing.
+#include <string.h>
+#include <stdlib.h>
+
+// FreeRTOS: state machine task, state mutex, waiters.
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+
+// esp_timer.h: stage deadlines and durations.
+#include "esp_timer.h"
+
+// Timeouts, APN, task sizing.
+#include "app_config.h"
+
+// modem_send_at(), modem_poll(), line observer.
+#include "modem.h"
+
+static const char *TAG = "modem_reg";
+
+// What the modem has reported. The state is derived from these,
+// so a URC only has to update the fact it is about.
+#define FACT_CONFIGURED (1u << 0)  // Answered AT, URCs enabled.
+#define FACT_SIM (1u << 1)
+#define FACT_REG (1u << 2)
+#define FACT_PDP (1u << 3)
+#define FACT_SESSION (1u << 4)
+#define FACT_ALL 0x1Fu
+
+// Event group: bit s is set while state >= s; LOST_BIT on a drop.
+#define STATE_BITS ((1u << MODEM_REG_STATE_COUNT) - 1)
+#define LOST_BIT (1u << MODEM_REG_STATE_COUNT)
+
+static SemaphoreHandle_t s_lock;
+static EventGroupHandle_t s_events;
+static bool s_started;
+static uint32_t s_facts;
+static uint32_t s_links;              // Bit per open data link (0 = transparent).
+static volatile modem_reg_state_t s_state = MODEM_REG_OFF;
+static int64_t s_stage_start_us;
+static modem_reg_stats_t s_stats[MODEM_REG_STATE_COUNT];
+
+static const char *const s_names[MODEM_REG_STATE_COUNT] = {
+    [MODEM_REG_OFF] = "OFF",
+    [MODEM_REG_BOOTING] = "BOOTING",
+    [MODEM_REG_SIM_READY] = "SIM_READY",
+    [MODEM_REG_REGISTERED] = "REGISTERED",
+    [MODEM_REG_PDP_ACTIVE] = "PDP_ACTIVE",
+    [MODEM_REG_DATA] = "DATA",
+};
+
+static modem_reg_state_t derive(uint32_t f) {
+    if (!s_started) {
+        return MODEM_REG_OFF;
+    }
+    if (!(f & FACT_CONFIGURED) || !(f & FACT_SIM)) {
+        return MODEM_REG_BOOTING;
+    }
+    if (!(f & FACT_REG)) {
+        return MODEM_REG_SIM_READY;
+    }
+    if (!(f & FACT_PDP)) {
+        return MODEM_REG_REGISTERED;
+    }
+    return (f & FACT_SESSION) ? MODEM_REG_DATA : MODEM_REG_PDP_ACTIVE;
+}
+
+// ============================================================
+// update_facts()
+//
+// Steps:
+//   1. Apply the change and derive the new state.
+//   2. Stage accounting: going up completes stages, going down
+//      means the stage above the new state runs again.
+//   3. Publish the state to waiters.
+// ============================================================
+static void update_facts(uint32_t set, uint32_t clear) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+
+    // --- Step 1: New state ---
+    s_facts = (s_facts | set) & ~clear;
+    if (clear & FACT_SESSION) {
+        s_links = 0;  // Sockets do not survive the bearer.
+    }
+    modem_reg_state_t old = s_state;
+    modem_reg_state_t now = derive(s_facts);
+    s_state = now;
+    if (now == old) {
+        xSemaphoreGive(s_lock);
+        return;
+    }
+
+    // --- Step 2: Stage accounting ---
+    int64_t t = esp_timer_get_time();
+    if (now > old) {
+        for (int s = (int)old + 1; s <= (int)now; s++) {
+            s_stats[s].reached++;
+            s_stats[s].last_ms = 0;
+        }
+        s_stats[old + 1].last_ms = (uint32_t)((t - s_stage_start_us) / 1000);
+    } else {
+        s_stats[now + 1].restarts++;
+    }
+    s_stage_start_us = t;
+
+    // --- Step 3: Waiters ---
+    EventBits_t reached = (1u << (now + 1)) - 1;
+    xEventGroupClearBits(s_events, STATE_BITS & ~reached);
+    xEventGroupSetBits(s_events, reached | (now < old ? LOST_BIT : 0));
+    printf("[%s] %s -> %s\n", TAG, s_names[old], s_names[now]);
+
+    xSemaphoreGive(s_lock);
+}
+
+// ============================================================
+// URC parsing
+// ============================================================
+
+// "+CEREG: <stat>[,<tac>,...]" (URC) or "+CEREG: <n>,<stat>[,...]"
+// (reply to +CEREG?). The reply has a second plain number; the
+// URC's second field, if any, is a quoted TAC.
+static int cereg_stat(const char *p) {
+    char *end = NULL;
+    long first = strtol(p, &end, 10);
+    if (end[0] == ',' && end[1] >= '0' && end[1] <= '9') {
+        return atoi(end + 1);
+    }
+    return (int)first;
+}
+
+// DATA while any link is open. Only called from on_line(), which
+// the modem driver serializes.
+static void set_link(int link, bool open) {
+    if (link < 0 || link >= 32) {
+        return;
+    }
+    if (open) {
+        s_links |= 1u << link;
+    } else {
+        s_links &= ~(1u << link);
+    }
+    if (s_links != 0) {
+        update_facts(FACT_SESSION, 0);
+    } else {
+        update_facts(0, FACT_SESSION);
+    }
+}
+
+static void on_line(const char *line, void *user) {
+    (void)user;
+    if (strcmp(line, "RDY") == 0) {
+        // Modem reset: everything from the boot handshake on.
+        update_facts(0, FACT_ALL);
+
+    } else if (strncmp(line, "+CPIN:", 6) == 0) {
+        if (strstr(line, "READY") != NULL) {
+            update_facts(FACT_SIM, 0);
+        } else {
+            update_facts(0, FACT_SIM | FACT_REG | FACT_PDP | FACT_SESSION);
+        }
+
+    } else if (strncmp(line, "+CEREG:", 7) == 0) {
+        int stat = cereg_stat(line + 7);
+        if (stat == 1 || stat == 5) {
+            update_facts(FACT_REG, 0);
+        } else {
+            // Searching / denied / unknown. The PDP context may
+            // have survived; the REGISTERED stage asks first.
+            update_facts(0, FACT_REG | FACT_PDP | FACT_SESSION);
+        }
+
+    } else if (strncmp(line, "+CGEV:", 6) == 0) {
+        if (strstr(line, "DETACH") != NULL) {
+            update_facts(0, FACT_REG | FACT_PDP | FACT_SESSION);
+        } else if (strstr(line, "DEACT") != NULL) {
+            update_facts(0, FACT_PDP | FACT_SESSION);
+        } else if (strstr(line, "PDN ACT") != NULL) {
+            update_facts(FACT_PDP, 0);
+        }
+
+    } else if (strncmp(line, "+CGACT:", 7) == 0) {
+        // Reply to +CGACT?: "<cid>,<state>", one line per context.
+        char *end = NULL;
+        long cid = strtol(line + 7, &end, 10);
+        if (cid == MODEM_PDP_CID && end[0] == ',') {
+            update_facts(end[1] == '1' ? FACT_PDP : 0, end[1] == '1' ? 0 : FACT_PDP);
+        }
+
+    } else if (strncmp(line, "CONNECT", 7) == 0) {
+        set_link(0, true);
+
+    } else if (strncmp(line, "+CIPOPEN:", 9) == 0) {
+        // "<link>,<err>"; the "+CIPOPEN: <link>" lines of the
+        // +CIPOPEN? listing have no comma.
+        const char *comma = strchr(line, ',');
+        if (comma && atoi(comma + 1) == 0) {
+            set_link(atoi(line + 9), true);
+        }
+
+    } else if (strcmp(line, "CLOSED") == 0) {
+        set_link(0, false);
+
+    } else if (strncmp(line, "+CIPCLOSE:", 10) == 0) {
+        set_link(atoi(line + 10), false);
+
+    } else if (strncmp(line, "+IPCLOSE:", 9) == 0) {
+        set_link(atoi(line + 9), false);
+    }
+}
+
+// ============================================================
+// Stages
+// ============================================================
+static bool at_ok(const char *cmd, uint32_t timeout_ms) {
+    char resp[64];
+    return modem_send_at(cmd, resp, sizeof(resp), timeout_ms) >= 0 &&
+           strstr(resp, "OK") != NULL;
+}
+
+// Sleeps in modem_poll() until a URC moves the state away from
+// `state` or the deadline passes. Returns true if it moved.
+static bool wait_urc(modem_reg_state_t state, int64_t deadline_us) {
+    while (s_state == state) {
+        int64_t left_ms = (deadline_us - esp_timer_get_time()) / 1000;
+        if (left_ms <= 0) {
+            return false;
+        }
+        modem_poll(left_ms < MODEM_REG_POLL_MS ? (uint32_t)left_ms : MODEM_REG_POLL_MS);
+    }
+    return true;
+}
+
+static void stage_failed(modem_reg_state_t next, const char *what) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_stats[next].timeouts++;
+    xSemaphoreGive(s_lock);
+    printf("[%s] %s: %s, retrying\n", TAG, s_names[s_state], what);
+    vTaskDelay(pdMS_TO_TICKS(MODEM_REG_RETRY_MS));
+}
+
+// ============================================================
+// stage_boot()
+//
+// BOOTING -> SIM_READY.
+//
+// Steps:
+//   1. Until configured: wait for the modem to answer AT, then
+//      enable the URCs the rest of the machine runs on.
+//   2. Until the SIM is ready: ask once, then wait for
+//      "+CPIN: READY" (PIN entry, slow SIM init).
+// ============================================================
+static void stage_boot(void) {
+    // --- Step 1: Handshake + URC setup ---
+    if (!(s_facts & FACT_CONFIGURED)) {
+        int64_t deadline = esp_timer_get_time() + (int64_t)MODEM_BOOT_GRACE_MS * 1000;
+        bool up = false;
+        while (!up && esp_timer_get_time() < deadline) {
+            up = at_ok("AT\r\n", 1000);
+        }
+        char cgdcont[64];
+        snprintf(cgdcont, sizeof(cgdcont), "AT+CGDCONT=%d,\"IP\",\"%s\"\r\n",
+                 MODEM_PDP_CID, MODEM_APN);
+        if (!up || !at_ok("ATE0\r\n", MODEM_CMD_TIMEOUT_MS) ||
+            !at_ok("AT+CMEE=2\r\n", MODEM_CMD_TIMEOUT_MS) ||
+            !at_ok("AT+CEREG=2\r\n", MODEM_CMD_TIMEOUT_MS) ||
+            !at_ok("AT+CGEREP=2,1\r\n", MODEM_CMD_TIMEOUT_MS) ||
+            !at_ok(cgdcont, MODEM_CMD_TIMEOUT_MS)) {
+            stage_failed(MODEM_REG_SIM_READY, up ? "setup rejected" : "no answer to AT");
+            return;
+        }
+        update_facts(FACT_CONFIGURED, 0);
+    }
+
+    // --- Step 2: SIM ---
+    // "+CPIN: READY" from boot has usually been seen already.
+    if (!(s_facts & FACT_SIM)) {
+        modem_send_at("AT+CPIN?\r\n", NULL, 0, MODEM_CMD_TIMEOUT_MS);
+        int64_t deadline = esp_timer_get_time() + (int64_t)MODEM_SIM_TIMEOUT_MS * 1000;
+        if (!wait_urc(MODEM_REG_BOOTING, deadline)) {
+            stage_failed(MODEM_REG_SIM_READY, "SIM not ready");
+        }
+    }
+}
+
+// SIM_READY -> REGISTERED. One +CEREG? covers "registered before
+// URCs were enabled"; after that the network tells us.
+static void stage_register(void) {
+    modem_send_at("AT+CEREG?\r\n", NULL, 0, MODEM_CMD_TIMEOUT_MS);
+    int64_t deadline = esp_timer_get_time() + (int64_t)MODEM_REG_TIMEOUT_MS * 1000;
+    if (!wait_urc(MODEM_REG_SIM_READY, deadline)) {
+        stage_failed(MODEM_REG_REGISTERED, "not registered");
+    }
+}
+
+// REGISTERED -> PDP_ACTIVE. After a short outage the context is
+// often still up, so ask before activating.
+static void stage_pdp(void) {
+    modem_send_at("AT+CGACT?\r\n", NULL, 0, MODEM_CMD_TIMEOUT_MS);
+    if (s_state != MODEM_REG_REGISTERED) {
+        return;
+    }
+
+    char cmd[32];
+    snprintf(cmd, sizeof(cmd), "AT+CGACT=1,%d\r\n", MODEM_PDP_CID);
+    int64_t deadline = esp_timer_get_time() + (int64_t)MODEM_PDP_TIMEOUT_MS * 1000;
+    if (at_ok(cmd, MODEM_PDP_TIMEOUT_MS) && wait_urc(MODEM_REG_REGISTERED, deadline)) {
+        return;
+    }
+    if (s_state == MODEM_REG_REGISTERED) {
+        stage_failed(MODEM_REG_PDP_ACTIVE, "PDP activation failed");
+    }
+}
+
+// ============================================================
+// reg_task()
+//
+// Runs the stage for the current state; in PDP_ACTIVE / DATA
+// there is nothing to do but listen.
+// ============================================================
+static void reg_task(void *arg) {
+    (void)arg;
+    while (1) {
+        switch (s_state) {
+            case MODEM_REG_BOOTING:
+                stage_boot();
+                break;
+            case MODEM_REG_SIM_READY:
+                stage_register();
+                break;
+            case MODEM_REG_REGISTERED:
+                stage_pdp();
+                break;
+            default:
+                modem_poll(MODEM_REG_POLL_MS);
+                break;
+        }
+    }
+}
+
+// ============================================================
+// Public API
+// ============================================================
+esp_err_t modem_reg_start(void) {
+    if (s_started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_lock = xSemaphoreCreateMutex();
+    s_events = xEventGroupCreate();
+    if (s_lock == NULL || s_events == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_stage_start_us = esp_timer_get_time();
+    s_started = true;
+    update_facts(0, 0);  // OFF -> BOOTING
+    modem_add_line_observer(on_line, NULL);
+
+    if (xTaskCreate(reg_task, "modem_reg", MODEM_TASK_STACK_BYTES, NULL,
+                    MODEM_REG_TASK_PRIO, NULL) != pdPASS) {
+        modem_remove_line_observer(on_line, NULL);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+modem_reg_state_t modem_reg_state(void) {
+    return s_state;
+}
+
+const char *modem_reg_state_name(modem_reg_state_t state) {
+    return state < MODEM_REG_STATE_COUNT ? s_names[state] : "?";
+}
+
+esp_err_t modem_reg_wait_until(modem_reg_state_t at_least, int64_t deadline_us) {
+    if (s_events == NULL || at_least >= MODEM_REG_STATE_COUNT) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    int64_t left_us = deadline_us - esp_timer_get_time();
+    TickType_t ticks = left_us > 0 ? pdMS_TO_TICKS((left_us + 999) / 1000) : 0;
+    EventBits_t bit = 1u << at_least;
+    EventBits_t bits = xEventGroupWaitBits(s_events, bit, pdFALSE, pdTRUE, ticks);
+    return (bits & bit) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+esp_err_t modem_reg_wait(modem_reg_state_t at_least, uint32_t timeout_ms) {
+    return modem_reg_wait_until(at_least,
+                                esp_timer_get_time() + (int64_t)timeout_ms * 1000);
+}
+
+esp_err_t modem_reg_wait_lost(uint32_t timeout_ms) {
+    if (s_events == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xEventGroupClearBits(s_events, LOST_BIT);
+    EventBits_t bits = xEventGroupWaitBits(s_events, LOST_BIT, pdTRUE, pdTRUE,
+                                           pdMS_TO_TICKS(timeout_ms));
+    return (bits & LOST_BIT) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+modem_reg_stats_t modem_reg_stats(modem_reg_state_t state) {
+    modem_reg_stats_t st = {0};
+    if (s_lock != NULL && state < MODEM_REG_STATE_COUNT) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        st = s_stats[state];
+        xSemaphoreGive(s_lock);
+    }
+    return st;
+}
+
+void modem_reg_print(void) {
+    printf("[%s] state %s\n", TAG, s_names[s_state]);
+    printf("[%s]   %-10s %7s %8s %8s %7s\n", TAG, "stage to", "reached", "restarts",
+           "timeouts", "last ms");
+    for (int s = MODEM_REG_SIM_READY; s <= MODEM_REG_PDP_ACTIVE; s++) {
+        modem_reg_stats_t st = modem_reg_stats((modem_reg_state_t)s);
+        printf("[%s]   %-10s %7lu %8lu %8lu %7lu\n", TAG, s_names[s],
+               (unsigned long)st.reached, (unsigned long)st.restarts,
+               (unsigned long)st.timeouts, (unsigned long)st.last_ms);
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+// ============================================================
+// modem_reg.h
+//
+// Modem registration state machine.
+//
+//   OFF -> BOOTING -> SIM_READY -> REGISTERED -> PDP_ACTIVE -> DATA
+//
+// The state is derived from what the modem has reported, not from
+// polling queries:
+//   - "RDY"                      modem (re)booted
+//   - "+CPIN: READY" / other     SIM usable / not
+//   - "+CEREG: <stat>"           registered when stat is 1 or 5
+//   - "+CGEV: ... PDN ACT/DEACT" PDP context up / down
+//   - "CONNECT", "+CIPOPEN: n,0" data link open
+//   - "CLOSED", "+CIPCLOSE: n,x", "+IPCLOSE: n,x"
+//                                data link closed (DATA while
+//                                any link is open)
+// Responses to our own queries (+CPIN?, +CEREG?, +CGACT?) use
+// the same formats and go through the same parser.
+//
+// A background task does the one thing each stage needs (boot
+// handshake + URC setup, PDP activation) and otherwise sleeps in
+// modem_poll() until a URC moves the state.
+//
+// Recovery restarts only the stage that failed: coverage loss
+// ("+CEREG: 2/3/4") drops to SIM_READY, so only registration and
+// PDP activation run again; the boot handshake and SIM check are
+// not repeated unless the modem itself reports "RDY" (reset) or
+// loses the SIM.
+//
+// DATA is entered and left by whoever opens sockets (MQTT, CoAP);
+// the state machine only brings the link up to PDP_ACTIVE.
+// ============================================================
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef enum {
+    MODEM_REG_OFF,
+    MODEM_REG_BOOTING,
+    MODEM_REG_SIM_READY,
+    MODEM_REG_REGISTERED,
+    MODEM_REG_PDP_ACTIVE,
+    MODEM_REG_DATA,
+    MODEM_REG_STATE_COUNT
+} modem_reg_state_t;
+
+// --- Counters ---
+// Per state, for the stage that leads into it.
+typedef struct {
+    uint32_t reached;         // Times the state was entered from below.
+    uint32_t restarts;        // Times the stage had to run again after a drop.
+    uint32_t timeouts;        // Stage attempts that hit their deadline.
+    uint32_t last_ms;         // Duration of the last completed stage.
+} modem_reg_stats_t;
+
+// --- Public functions ---------------------------------------
+
+// Installs the URC observer on the modem driver and starts the
+// state machine task. Call after modem_uart_init().
+esp_err_t modem_reg_start(void);
+
+modem_reg_state_t modem_reg_state(void);
+
+const char *modem_reg_state_name(modem_reg_state_t state);
+
+// Blocks until the state is at least at_least (ESP_OK) or
+// timeout_ms passes (ESP_ERR_TIMEOUT).
+esp_err_t modem_reg_wait(modem_reg_state_t at_least, uint32_t timeout_ms);
+
+// Same, with an absolute esp_timer deadline, so one budget can
+// cover several waits.
+esp_err_t modem_reg_wait_until(modem_reg_state_t at_least, int64_t deadline_us);
+
+// Blocks until the next drop to a lower state (coverage loss,
+// PDP deactivation, modem reset) or timeout_ms.
+esp_err_t modem_reg_wait_lost(uint32_t timeout_ms);
+
+modem_reg_stats_t modem_reg_stats(modem_reg_state_t state);
+
+// Prints state and per-stage counters.
+void modem_reg_print(void);
@@ -0,0 +1,698 @@
+// ============================================================
+// modem_sms.c
+//
+// SMS in PDU mode: SMS-SUBMIT encoding, batched storage reads,
+// SMS-DELIVER decoding straight from the hex listing.
+// See modem_sms.h.
+// ============================================================
+
+#include "modem_sms.h"
+
+#if FEATURE_SMS
+
+// stdio.h: printf() for console logging to UART0.
+#include <stdio.h>
+
+// stddef.h: offsetof() to clear a message up to its text.
+#include <stddef.h>
+
+// string.h: command building, "+CMTI" / "+CMGL" matching.
+#include <string.h>
+
+// FreeRTOS: "+CMTI" wake-up for modem_sms_poll().
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+// AT exchanges, prompt send, streamed listing, line observer.
+#include "modem.h"
+
+static const char *TAG = "modem_sms";
+
+// Longest listing line: a PDU with a full 12-octet SMSC address
+// and a 176-octet TPDU, as hex.
+#define SMS_LINE_MAX (2 * (12 + 176) + 8)
+
+// Longest SMS-SUBMIT we build: SCA, first octet, MR, address
+// (20 digits), PID, DCS, UDL, 140 octets of user data.
+#define SMS_SUBMIT_MAX (1 + 1 + 1 + 12 + 1 + 1 + 1 + 140)
+
+// "+CMTI" seen since the last listing.
+#define EVT_NEW (1u << 0)
+
+static EventGroupHandle_t s_evt;
+static modem_sms_fn s_on_message;
+static void *s_user;
+static modem_sms_stats_t s_stats;
+
+// Listing buffers. Only touched by modem_send_at_lines() and its
+// callback, both under the modem mutex.
+static char s_line[SMS_LINE_MAX];
+static modem_sms_t s_msg;
+
+// ============================================================
+// GSM 03.38 default alphabet
+// ============================================================
+static const uint16_t s_gsm7[128] = {
+    0x0040, 0x00A3, 0x0024, 0x00A5, 0x00E8, 0x00E9, 0x00F9, 0x00EC,
+    0x00F2, 0x00C7, 0x000A, 0x00D8, 0x00F8, 0x000D, 0x00C5, 0x00E5,
+    0x0394, 0x005F, 0x03A6, 0x0393, 0x039B, 0x03A9, 0x03A0, 0x03A8,
+    0x03A3, 0x0398, 0x039E, 0x00A0, 0x00C6, 0x00E6, 0x00DF, 0x00C9,
+    0x0020, 0x0021, 0x0022, 0x0023, 0x00A4, 0x0025, 0x0026, 0x0027,
+    0x0028, 0x0029, 0x002A, 0x002B, 0x002C, 0x002D, 0x002E, 0x002F,
+    0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037,
+    0x0038, 0x0039, 0x003A, 0x003B, 0x003C, 0x003D, 0x003E, 0x003F,
+    0x00A1, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047,
+    0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F,
+    0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057,
+    0x0058, 0x0059, 0x005A, 0x00C4, 0x00D6, 0x00D1, 0x00DC, 0x00A7,
+    0x00BF, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067,
+    0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F,
+    0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077,
+    0x0078, 0x0079, 0x007A, 0x00E4, 0x00F6, 0x00F1, 0x00FC, 0x00E0,
+};
+
+// Escape (0x1B) + code.
+#define GSM7_ESC 0x1B
+
+static const struct {
+    uint8_t code;
+    uint16_t cp;
+} s_gsm7_ext[] = {
+    {0x0A, 0x000C}, {0x14, '^'}, {0x28, '{'}, {0x29, '}'}, {0x2F, '\\'},
+    {0x3C, '['},    {0x3D, '~'}, {0x3E, ']'}, {0x40, '|'}, {0x65, 0x20AC},
+};
+
+#define GSM7_EXT_COUNT (sizeof(s_gsm7_ext) / sizeof(s_gsm7_ext[0]))
+
+// Code for a code point: 0-127, GSM7_ESC << 8 | ext code for the
+// extension table, or -1 when the alphabet does not have it.
+static int gsm7_code(uint32_t cp) {
+    if ((cp >= 'A' && cp <= 'Z') || (cp >= 'a' && cp <= 'z') ||
+        (cp >= '0' && cp <= '9') || cp == ' ') {
+        return (int)cp;  // Same position as ASCII.
+    }
+    for (int i = 0; i < 128; i++) {
+        if (s_gsm7[i] == cp && i != GSM7_ESC) {
+            return i;
+        }
+    }
+    for (size_t i = 0; i < GSM7_EXT_COUNT; i++) {
+        if (s_gsm7_ext[i].cp == cp) {
+            return GSM7_ESC << 8 | s_gsm7_ext[i].code;
+        }
+    }
+    return -1;
+}
+
+// ============================================================
+// UTF-8
+// ============================================================
+
+// Next code point of a UTF-8 string; malformed bytes read as
+// U+FFFD (which then forces UCS2, and is sent as such).
+static uint32_t utf8_next(const char **s) {
+    const uint8_t *p = (const uint8_t *)*s;
+    uint32_t cp = 0xFFFD;
+    int extra = 0;
+    if (p[0] < 0x80) {
+        cp = p[0];
+    } else if ((p[0] & 0xE0) == 0xC0) {
+        cp = p[0] & 0x1F;
+        extra = 1;
+    } else if ((p[0] & 0xF0) == 0xE0) {
+        cp = p[0] & 0x0F;
+        extra = 2;
+    } else if ((p[0] & 0xF8) == 0xF0) {
+        cp = p[0] & 0x07;
+        extra = 3;
+    }
+    int i = 1;
+    for (; i <= extra; i++) {
+        if ((p[i] & 0xC0) != 0x80) {
+            cp = 0xFFFD;
+            break;
+        }
+        cp = cp << 6 | (p[i] & 0x3F);
+    }
+    *s += i;
+    return cp;
+}
+
+typedef struct {
+    char *buf;
+    size_t cap;               // Bytes, without the terminator.
+    size_t len;
+    bool truncated;
+} utf8_wr_t;
+
+static void utf8_put(utf8_wr_t *w, uint32_t cp) {
+    char tmp[4];
+    size_t n;
+    if (cp < 0x80) {
+        tmp[0] = (char)cp;
+        n = 1;
+    } else if (cp < 0x800) {
+        tmp[0] = (char)(0xC0 | cp >> 6);
+        tmp[1] = (char)(0x80 | (cp & 0x3F));
+        n = 2;
+    } else if (cp < 0x10000) {
+        tmp[0] = (char)(0xE0 | cp >> 12);
+        tmp[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        tmp[2] = (char)(0x80 | (cp & 0x3F));
+        n = 3;
+    } else {
+        tmp[0] = (char)(0xF0 | cp >> 18);
+        tmp[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+        tmp[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        tmp[3] = (char)(0x80 | (cp & 0x3F));
+        n = 4;
+    }
+    if (w->len + n > w->cap) {
+        w->truncated = true;  // Never split a character.
+        return;
+    }
+    memcpy(w->buf + w->len, tmp, n);
+    w->len += n;
+    w->buf[w->len] = '\0';
+}
+
+// ============================================================
+// Hex reader
+//
+// Walks the PDU in place, in the listing's line buffer.
+// ============================================================
+typedef struct {
+    const char *p;
+    const char *end;
+    bool bad;                 // Ran past the end or hit a non-hex digit.
+} hex_rd_t;
+
+static int hex_nibble(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+static uint8_t rd_byte(hex_rd_t *r) {
+    if (r->end - r->p < 2) {
+        r->bad = true;
+        return 0;
+    }
+    int hi = hex_nibble(r->p[0]);
+    int lo = hex_nibble(r->p[1]);
+    if (hi < 0 || lo < 0) {
+        r->bad = true;
+        return 0;
+    }
+    r->p += 2;
+    return (uint8_t)(hi << 4 | lo);
+}
+
+static void rd_skip(hex_rd_t *r, size_t octets) {
+    if ((size_t)(r->end - r->p) < 2 * octets) {
+        r->bad = true;
+        r->p = r->end;
+        return;
+    }
+    r->p += 2 * octets;
+}
+
+// Swapped-nibble BCD octet (time stamps).
+static uint8_t rd_bcd(hex_rd_t *r) {
+    uint8_t b = rd_byte(r);
+    return (uint8_t)((b & 0x0F) * 10 + (b >> 4));
+}
+
+// ============================================================
+// unpack_gsm7()
+//
+// Decodes septets from packed octets as they are read, after
+// fill_bits of padding (user data header alignment).
+// ============================================================
+static void unpack_gsm7(hex_rd_t *r, size_t septets, unsigned fill_bits, utf8_wr_t *w) {
+    uint32_t acc = 0;
+    unsigned bits = 0;
+    bool esc = false;
+
+    if (fill_bits > 0 && septets > 0) {
+        acc = rd_byte(r) >> fill_bits;
+        bits = 8 - fill_bits;
+    }
+    for (size_t i = 0; i < septets && !r->bad; i++) {
+        if (bits < 7) {
+            acc |= (uint32_t)rd_byte(r) << bits;
+            bits += 8;
+        }
+        uint8_t c = acc & 0x7F;
+        acc >>= 7;
+        bits -= 7;
+
+        if (esc) {
+            esc = false;
+            uint32_t cp = s_gsm7[c];  // Unknown extension: base character.
+            for (size_t k = 0; k < GSM7_EXT_COUNT; k++) {
+                if (s_gsm7_ext[k].code == c) {
+                    cp = s_gsm7_ext[k].cp;
+                }
+            }
+            utf8_put(w, cp);
+        } else if (c == GSM7_ESC) {
+            esc = true;
+        } else {
+            utf8_put(w, s_gsm7[c]);
+        }
+    }
+}
+
+// TP-DCS to alphabet (3GPP TS 23.038, section 4).
+static modem_sms_alphabet_t dcs_alphabet(uint8_t dcs) {
+    switch (dcs >> 4) {
+        case 0x0: case 0x1: case 0x2: case 0x3:   // General data coding
+        case 0x4: case 0x5: case 0x6: case 0x7:   // (auto-deletion group)
+            return (dcs & 0x0C) == 0x08 ? MODEM_SMS_UCS2
+                 : (dcs & 0x0C) == 0x04 ? MODEM_SMS_8BIT
+                                         : MODEM_SMS_GSM7;
+        case 0xE:                                  // Message waiting, UCS2
+            return MODEM_SMS_UCS2;
+        case 0xF:                                  // Data coding / class
+            return (dcs & 0x04) ? MODEM_SMS_8BIT : MODEM_SMS_GSM7;
+        default:                                   // Message waiting, GSM7
+            return MODEM_SMS_GSM7;
+    }
+}
+
+// ============================================================
+// read_address()
+//
+// TP-OA / TP-DA: digit count, type of address, digits. Numbers
+// come out as "+<digits>" (international) or "<digits>";
+// alphanumeric senders are packed GSM 7-bit text.
+// ============================================================
+static void read_address(hex_rd_t *r, char *out, size_t out_len) {
+    uint8_t digits = rd_byte(r);
+    uint8_t toa = rd_byte(r);
+    size_t octets = (digits + 1u) / 2;
+    utf8_wr_t w = {.buf = out, .cap = out_len - 1};
+    out[0] = '\0';
+
+    if ((toa & 0x70) == 0x50) {
+        hex_rd_t sub = {.p = r->p, .end = r->p + 2 * octets};
+        if (sub.end > r->end) {
+            r->bad = true;
+            return;
+        }
+        unpack_gsm7(&sub, digits * 4u / 7, 0, &w);
+        rd_skip(r, octets);
+        return;
+    }
+
+    if ((toa & 0x70) == 0x10) {
+        utf8_put(&w, '+');
+    }
+    for (size_t i = 0; i < octets && !r->bad; i++) {
+        uint8_t b = rd_byte(r);
+        uint8_t d[2] = {(uint8_t)(b & 0x0F), (uint8_t)(b >> 4)};
+        for (int k = 0; k < 2; k++) {
+            if (d[k] <= 9) {
+                utf8_put(&w, '0' + d[k]);
+            } else if (d[k] != 0x0F) {
+                utf8_put(&w, "*#abc"[d[k] - 10]);
+            }
+        }
+    }
+}
+
+// ============================================================
+// decode_pdu()
+//
+// Steps:
+//   1. Skip the SMSC address.
+//   2. Header: SMS-DELIVER (received) or SMS-SUBMIT (stored
+//      outgoing), up to TP-DCS; time stamp or validity period.
+//   3. User data header, if flagged: skipped, with the septet
+//      fill bits it implies.
+//   4. User data straight into m->text.
+// ============================================================
+static bool decode_pdu(const char *hex, size_t len, modem_sms_t *m) {
+    hex_rd_t r = {.p = hex, .end = hex + len};
+
+    // --- Step 1: SMSC ---
+    rd_skip(&r, rd_byte(&r));
+
+    // --- Step 2: Header ---
+    uint8_t fo = rd_byte(&r);
+    uint8_t mti = fo & 0x03;
+    if (mti == 0x00) {
+        read_address(&r, m->number, sizeof(m->number));
+        rd_byte(&r);  // TP-PID
+        m->alphabet = dcs_alphabet(rd_byte(&r));
+        m->time.year = rd_bcd(&r);
+        m->time.month = rd_bcd(&r);
+        m->time.day = rd_bcd(&r);
+        m->time.hour = rd_bcd(&r);
+        m->time.minute = rd_bcd(&r);
+        m->time.second = rd_bcd(&r);
+        uint8_t tz = rd_byte(&r);
+        int q = (tz & 0x07) * 10 + (tz >> 4);
+        m->time.tz_quarters = (int8_t)((tz & 0x08) ? -q : q);
+    } else if (mti == 0x01) {
+        rd_byte(&r);  // TP-MR
+        read_address(&r, m->number, sizeof(m->number));
+        rd_byte(&r);  // TP-PID
+        m->alphabet = dcs_alphabet(rd_byte(&r));
+        uint8_t vpf = (fo >> 3) & 0x03;
+        rd_skip(&r, vpf == 2 ? 1 : vpf ? 7 : 0);
+    } else {
+        return false;  // Status report / command: not a message.
+    }
+    if (r.bad) {
+        return false;
+    }
+
+    // --- Step 3: User data header ---
+    size_t udl = rd_byte(&r);
+    size_t udh = 0;
+    if (fo & 0x40) {
+        udh = rd_byte(&r) + 1u;
+        rd_skip(&r, udh - 1);
+    }
+
+    // --- Step 4: User data ---
+    utf8_wr_t w = {.buf = m->text, .cap = MODEM_SMS_TEXT_MAX};
+    m->text[0] = '\0';
+    if (m->alphabet == MODEM_SMS_GSM7) {
+        size_t udh_septets = (udh * 8 + 6) / 7;
+        if (udh_septets > udl) {
+            return false;
+        }
+        unpack_gsm7(&r, udl - udh_septets, (unsigned)(udh_septets * 7 - udh * 8), &w);
+    } else if (udh > udl) {
+        return false;
+    } else if (m->alphabet == MODEM_SMS_UCS2) {
+        for (size_t i = 0; i + 1 < udl - udh && !r.bad; i += 2) {
+            uint32_t u = (uint32_t)rd_byte(&r) << 8;
+            u |= rd_byte(&r);
+            if (u >= 0xD800 && u < 0xDC00 && i + 3 < udl - udh) {
+                uint32_t lo = (uint32_t)rd_byte(&r) << 8;
+                lo |= rd_byte(&r);
+                i += 2;
+                u = 0x10000 + ((u - 0xD800) << 10) + (lo - 0xDC00);
+            }
+            utf8_put(&w, u);
+        }
+    } else {
+        for (size_t i = 0; i < udl - udh && !r.bad; i++) {
+            uint8_t b = rd_byte(&r);
+            if (w.len < w.cap) {
+                w.buf[w.len++] = (char)b;
+                w.buf[w.len] = '\0';
+            } else {
+                w.truncated = true;
+            }
+        }
+    }
+    m->text_len = (uint16_t)w.len;
+    m->truncated = w.truncated;
+    return !r.bad;
+}
+
+// ============================================================
+// Hex writer (SMS-SUBMIT)
+// ============================================================
+typedef struct {
+    char *p;
+    char *end;
+} hex_wr_t;
+
+static void wr_byte(hex_wr_t *w, uint8_t b) {
+    static const char digits[] = "0123456789ABCDEF";
+    if (w->end - w->p >= 2) {
+        *w->p++ = digits[b >> 4];
+        *w->p++ = digits[b & 0x0F];
+    }
+}
+
+// ============================================================
+// encode_submit()
+//
+// Steps:
+//   1. Pick the alphabet: GSM 7-bit if every character has a
+//      code (extension characters take two), else UCS2; check
+//      the length against one message.
+//   2. Header: default SMSC, SMS-SUBMIT, destination address,
+//      PID 0, DCS.
+//   3. User data: packed septets, or UTF-16BE.
+// Returns the TPDU length in octets (for AT+CMGS), or -1 with
+// *err set.
+// ============================================================
+static int encode_submit(const char *number, const char *text, char *hex, size_t hex_len,
+                         esp_err_t *err) {
+    // --- Step 1: Alphabet and length ---
+    size_t septets = 0;
+    size_t units = 0;
+    bool gsm7 = true;
+    for (const char *s = text; *s;) {
+        uint32_t cp = utf8_next(&s);
+        int code = gsm7_code(cp);
+        gsm7 = gsm7 && code >= 0;
+        septets += code > 0x7F ? 2 : 1;
+        units += cp > 0xFFFF ? 2 : 1;
+    }
+    if (gsm7 ? septets > 160 : units > 70) {
+        *err = ESP_ERR_INVALID_SIZE;
+        return -1;
+    }
+
+    const char *digits = number[0] == '+' ? number + 1 : number;
+    size_t ndigits = strlen(digits);
+    if (ndigits == 0 || ndigits > 20 || strspn(digits, "0123456789") != ndigits) {
+        *err = ESP_ERR_INVALID_ARG;
+        return -1;
+    }
+
+    // --- Step 2: Header ---
+    hex_wr_t w = {.p = hex, .end = hex + hex_len - 1};
+    wr_byte(&w, 0x00);  // SMSC: the one stored in the SIM.
+    wr_byte(&w, 0x01);  // SMS-SUBMIT, no validity period.
+    wr_byte(&w, 0x00);  // TP-MR: assigned by the modem.
+    wr_byte(&w, (uint8_t)ndigits);
+    wr_byte(&w, number[0] == '+' ? 0x91 : 0x81);
+    for (size_t i = 0; i < ndigits; i += 2) {
+        uint8_t hi = i + 1 < ndigits ? (uint8_t)(digits[i + 1] - '0') : 0x0F;
+        wr_byte(&w, (uint8_t)(hi << 4 | (digits[i] - '0')));
+    }
+    wr_byte(&w, 0x00);  // TP-PID
+    wr_byte(&w, gsm7 ? 0x00 : 0x08);
+
+    // --- Step 3: User data ---
+    if (gsm7) {
+        wr_byte(&w, (uint8_t)septets);
+        uint32_t acc = 0;
+        unsigned bits = 0;
+        for (const char *s = text; *s;) {
+            int code = gsm7_code(utf8_next(&s));
+            int n = code > 0x7F ? 2 : 1;
+            uint32_t pair = code > 0x7F ? (uint32_t)(GSM7_ESC | (code & 0x7F) << 7)
+                                        : (uint32_t)code;
+            acc |= pair << bits;
+            bits += 7 * (unsigned)n;
+            while (bits >= 8) {
+                wr_byte(&w, acc & 0xFF);
+                acc >>= 8;
+                bits -= 8;
+            }
+        }
+        if (bits > 0) {
+            wr_byte(&w, acc & 0xFF);
+        }
+    } else {
+        wr_byte(&w, (uint8_t)(units * 2));
+        for (const char *s = text; *s;) {
+            uint32_t cp = utf8_next(&s);
+            if (cp > 0xFFFF) {
+                cp -= 0x10000;
+                uint16_t hi = (uint16_t)(0xD800 + (cp >> 10));
+                wr_byte(&w, hi >> 8);
+                wr_byte(&w, hi & 0xFF);
+                cp = 0xDC00 + (cp & 0x3FF);
+            }
+            wr_byte(&w, (uint8_t)(cp >> 8));
+            wr_byte(&w, cp & 0xFF);
+        }
+    }
+    *w.p = '\0';
+    return (int)((size_t)(w.p - hex) / 2 - 1);  // Without the SMSC octet.
+}
+
+// ============================================================
+// URC observer
+// ============================================================
+static void on_line(const char *line, void *user) {
+    (void)user;
+    if (strncmp(line, "+CMTI:", 6) == 0) {
+        s_stats.cmti_urcs++;
+        xEventGroupSetBits(s_evt, EVT_NEW);
+    }
+}
+
+static bool at_ok(const char *cmd) {
+    char resp[64];
+    return modem_send_at(cmd, resp, sizeof(resp), MODEM_CMD_TIMEOUT_MS) >= 0 &&
+           strstr(resp, "OK") != NULL;
+}
+
+// ============================================================
+// modem_sms_init()
+// ============================================================
+esp_err_t modem_sms_init(modem_sms_fn on_message, void *user) {
+    if (s_evt == NULL) {
+        s_evt = xEventGroupCreate();
+        if (s_evt == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        if (modem_add_line_observer(on_line, NULL) != ESP_OK) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    s_on_message = on_message;
+    s_user = user;
+
+    // PDU mode; new messages stored in the SIM and announced with
+    // "+CMTI: "SM",<index>".
+    if (!at_ok("AT+CMGF=0\r\n") || !at_ok("AT+CNMI=2,1,0,0,0\r\n")) {
+        printf("[%s] modem refused PDU mode / new message URCs\n", TAG);
+        return ESP_FAIL;
+    }
+
+    // Whatever arrived while nobody listened: first poll lists it.
+    xEventGroupSetBits(s_evt, EVT_NEW);
+    return ESP_OK;
+}
+
+// ============================================================
+// modem_sms_send()
+// ============================================================
+esp_err_t modem_sms_send(const char *number, const char *text) {
+    // Hex PDU + Ctrl-Z.
+    char pdu[2 * SMS_SUBMIT_MAX + 2];
+    esp_err_t err = ESP_OK;
+    int tpdu = encode_submit(number, text, pdu, sizeof(pdu) - 1, &err);
+    if (tpdu < 0) {
+        s_stats.send_failures++;
+        return err;
+    }
+    size_t len = strlen(pdu);
+    pdu[len++] = 0x1A;
+
+    // AT+CMGS is terminated by <CR> alone; the PDU follows the
+    // prompt.
+    char cmd[24];
+    char resp[32];
+    snprintf(cmd, sizeof(cmd), "AT+CMGS=%d\r", tpdu);
+    if (modem_send_prompt(cmd, (const uint8_t *)pdu, len, resp, sizeof(resp),
+                          MODEM_SMS_SEND_TIMEOUT_MS) < 0) {
+        s_stats.send_failures++;
+        return ESP_FAIL;
+    }
+    s_stats.sent++;
+    return ESP_OK;
+}
+
+// ============================================================
+// modem_sms_list()
+//
+// "+CMGL: <index>,<stat>,[<alpha>],<length>" header lines, each
+// followed by its PDU line. The PDU is decoded in the line
+// buffer it was read into.
+// ============================================================
+typedef struct {
+    modem_sms_fn fn;
+    void *user;
+    int index;
+    int stat;
+    bool expect_pdu;
+    int delivered;
+} list_ctx_t;
+
+static void list_line(const char *line, void *user) {
+    list_ctx_t *c = user;
+    int index = 0;
+    int stat = 0;
+    if (sscanf(line, "+CMGL: %d,%d", &index, &stat) == 2) {
+        c->index = index;
+        c->stat = stat;
+        c->expect_pdu = true;
+        return;
+    }
+    if (!c->expect_pdu) {
+        return;  // URC inside the listing: the observers have it.
+    }
+    c->expect_pdu = false;
+
+    memset(&s_msg, 0, offsetof(modem_sms_t, text));
+    s_msg.index = c->index;
+    s_msg.stat = (uint8_t)c->stat;
+    if (!decode_pdu(line, strlen(line), &s_msg)) {
+        printf("[%s] index %d: undecodable PDU\n", TAG, c->index);
+        s_stats.decode_errors++;
+        return;
+    }
+    s_stats.received++;
+    c->delivered++;
+    if (c->fn) {
+        c->fn(&s_msg, c->user);
+    }
+}
+
+int modem_sms_list(modem_sms_stat_t stat, modem_sms_fn fn, void *user) {
+    char cmd[20];
+    list_ctx_t ctx = {.fn = fn, .user = user};
+    snprintf(cmd, sizeof(cmd), "AT+CMGL=%d\r\n", (int)stat);
+    s_stats.list_cmds++;
+    if (modem_send_at_lines(cmd, s_line, sizeof(s_line), list_line, &ctx,
+                            MODEM_CMD_TIMEOUT_MS) < 0) {
+        return -1;
+    }
+    return ctx.delivered;
+}
+
+// ============================================================
+// modem_sms_poll()
+//
+// Clears the "+CMTI" bit before listing: a message that lands
+// during the listing sets it again, and the next poll picks it
+// up (an extra, possibly empty, listing rather than a lost one).
+// ============================================================
+int modem_sms_poll(uint32_t timeout_ms) {
+    if (s_evt == NULL) {
+        return 0;
+    }
+    EventBits_t bits = xEventGroupWaitBits(s_evt, EVT_NEW, pdTRUE, pdFALSE,
+                                           pdMS_TO_TICKS(timeout_ms));
+    if (!(bits & EVT_NEW)) {
+        return 0;
+    }
+    int n = modem_sms_list(MODEM_SMS_REC_UNREAD, s_on_message, s_user);
+    if (n > 0 && MODEM_SMS_DELETE_READ) {
+        modem_sms_delete_read();
+    }
+    return n < 0 ? 0 : n;
+}
+
+esp_err_t modem_sms_delete_read(void) {
+    s_stats.delete_cmds++;
+    return at_ok("AT+CMGD=0,1\r\n") ? ESP_OK : ESP_FAIL;
+}
+
+modem_sms_stats_t modem_sms_stats(void) {
+    return s_stats;
+}
+
+#endif  // FEATURE_SMS
@@ -0,0 +1,112 @@
+#pragma once
+
+// ============================================================
+// modem_sms.h
+//
+// SMS over the modem in PDU mode (AT+CMGF=0), for out-of-band
+// control when there is no data bearer.
+//
+//   - Send: modem_sms_send() encodes an SMS-SUBMIT PDU (GSM
+//     7-bit default alphabet when the text allows it, UCS2
+//     otherwise) and sends it with AT+CMGS.
+//   - Receive: the modem stores new messages and reports each
+//     with "+CMTI: <mem>,<index>" (AT+CNMI=2,1). The URC only
+//     marks that something arrived; modem_sms_poll() then reads
+//     every unread message with ONE AT+CMGL, however many URCs
+//     came in, and deletes what it read with one AT+CMGD=0,1 — not
+//     an AT+CMGR / AT+CMGD pair per index.
+//   - Decoding: the listing is read line by line into one fixed
+//     line buffer, and each PDU is decoded straight from its hex
+//     text into one fixed modem_sms_t (text as UTF-8). No binary
+//     copy of the PDU, no heap.
+//
+// Single-part messages: up to 160 GSM 7-bit characters or 70
+// UCS2 characters per send. Received parts of a concatenated
+// message are delivered one by one (user data header skipped).
+// ============================================================
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "app_config.h"
+
+// AT+CMGL / +CMGL <stat> values.
+typedef enum {
+    MODEM_SMS_REC_UNREAD,
+    MODEM_SMS_REC_READ,
+    MODEM_SMS_STO_UNSENT,
+    MODEM_SMS_STO_SENT,
+    MODEM_SMS_ALL
+} modem_sms_stat_t;
+
+typedef enum {
+    MODEM_SMS_GSM7,
+    MODEM_SMS_8BIT,
+    MODEM_SMS_UCS2
+} modem_sms_alphabet_t;
+
+// Service centre time stamp (local time of the network).
+typedef struct {
+    uint8_t year;             // 0-99
+    uint8_t month;
+    uint8_t day;
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+    int8_t tz_quarters;       // Offset from UTC in quarter hours.
+} modem_sms_time_t;
+
+typedef struct {
+    int index;                // Storage index.
+    uint8_t stat;             // modem_sms_stat_t
+    uint8_t alphabet;         // modem_sms_alphabet_t
+    bool truncated;           // Text did not fit MODEM_SMS_TEXT_MAX.
+    char number[MODEM_SMS_NUMBER_MAX];  // Sender ("+491...", or a name).
+    modem_sms_time_t time;    // Received messages only.
+    uint16_t text_len;
+    char text[MODEM_SMS_TEXT_MAX + 1];  // UTF-8 (8-bit data: raw bytes).
+} modem_sms_t;
+
+// Message callback. msg is only valid during the call, which runs
+// with the modem mutex held: it must not call modem_* functions.
+typedef void (*modem_sms_fn)(const modem_sms_t *msg, void *user);
+
+// --- Counters ---
+typedef struct {
+    uint32_t sent;
+    uint32_t send_failures;
+    uint32_t received;        // Messages decoded and delivered.
+    uint32_t cmti_urcs;       // "+CMTI" notifications.
+    uint32_t list_cmds;       // AT+CMGL exchanges.
+    uint32_t delete_cmds;     // AT+CMGD exchanges.
+    uint32_t decode_errors;
+} modem_sms_stats_t;
+
+// --- Public functions ---------------------------------------
+
+// Selects PDU mode and new-message URCs, and installs the +CMTI
+// observer. Messages already stored are picked up by the first
+// modem_sms_poll(). on_message receives what modem_sms_poll()
+// reads.
+esp_err_t modem_sms_init(modem_sms_fn on_message, void *user);
+
+// Sends one message. ESP_ERR_INVALID_ARG: number not a phone
+// number; ESP_ERR_INVALID_SIZE: text over one message;
+// ESP_FAIL: the modem or network refused it.
+esp_err_t modem_sms_send(const char *number, const char *text);
+
+// Lists stored messages with one AT+CMGL=<stat>, decoding each
+// into fn. Returns the number delivered, or -1.
+int modem_sms_list(modem_sms_stat_t stat, modem_sms_fn fn, void *user);
+
+// Waits up to timeout_ms for "+CMTI", then reads every unread
+// message in one listing (and, with MODEM_SMS_DELETE_READ, deletes
+// read messages in one command). Returns messages delivered.
+int modem_sms_poll(uint32_t timeout_ms);
+
+// AT+CMGD=0,1: deletes every read message.
+esp_err_t modem_sms_delete_read(void);
+
+modem_sms_stats_t modem_sms_stats(void);
@@ -0,0 +1,495 @@
+// ============================================================
+// modem_sock.c
+//
+// Non-blocking sockets over modem AT links. See modem_sock.h.
+// ============================================================
+
+#include "modem_sock.h"
+
+// stdio.h: printf() for console logging to UART0.
+#include <stdio.h>
+
+// string.h / stdlib.h: URC matching, buffer copies.
+#include <string.h>
+#include <stdlib.h>
+
+// errno.h: BSD-style error reporting.
+#include <errno.h>
+
+// FreeRTOS: socket table lock, poll wake-ups.
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+
+// esp_timer.h: poll deadline.
+#include "esp_timer.h"
+
+// esp_heap_caps.h: RX slice pool.
+#include "esp_heap_caps.h"
+
+// MODEM_SOCK_*, timeouts.
+#include "app_config.h"
+
+// AT exchanges, link send / pull, line observer.
+#include "modem.h"
+
+// mem_plan_value(): RX budget.
+#include "mem_plan.h"
+
+static const char *TAG = "modem_sock";
+
+typedef enum {
+    SOCK_FREE,
+    SOCK_OPEN,                // No link yet (before connect).
+    SOCK_CONNECTING,          // CIPOPEN accepted, waiting for "+CIPOPEN: n,0".
+    SOCK_CONNECTED,
+    SOCK_PEER_CLOSED,         // "+IPCLOSE": reads drain, then 0.
+    SOCK_FAILED               // Connect failure or bearer lost; error set.
+} sock_state_t;
+
+typedef struct {
+    uint8_t state;            // sock_state_t
+    uint8_t type;             // modem_sock_type_t
+    bool rx_pending;          // The modem holds data for this link.
+    int error;                // errno for SOCK_FAILED / modem_sock_error().
+    uint8_t *rx;              // RX slice.
+    size_t rx_off;
+    size_t rx_len;
+    char host[48];            // UDP destination.
+    uint16_t port;
+} sock_t;
+
+// Any socket changed state (for modem_sock_poll()).
+#define EVT_CHANGED (1u << 0)
+
+static sock_t s_socks[MODEM_SOCK_MAX];
+static int s_count;
+static uint8_t *s_pool;
+static size_t s_slice;
+static SemaphoreHandle_t s_lock;
+static EventGroupHandle_t s_evt;
+static modem_sock_stats_t s_stats;
+
+// Socket index = modem link id.
+static sock_t *get(int sock) {
+    if (sock < 0 || sock >= s_count || s_socks[sock].state == SOCK_FREE) {
+        return NULL;
+    }
+    return &s_socks[sock];
+}
+
+static bool at_ok(const char *cmd, uint32_t timeout_ms) {
+    char resp[64];
+    return modem_send_at(cmd, resp, sizeof(resp), timeout_ms) >= 0 &&
+           strstr(resp, "OK") != NULL;
+}
+
+// ============================================================
+// on_line()
+//
+// URC side of the socket table. Runs with the modem mutex held,
+// so it only updates state and wakes pollers.
+// ============================================================
+static void on_line(const char *line, void *user) {
+    (void)user;
+    int link = -1;
+    int arg = 0;
+    bool changed = false;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (sscanf(line, "+CIPOPEN: %d,%d", &link, &arg) == 2 && link >= 0 && link < s_count) {
+        sock_t *s = &s_socks[link];
+        if (s->state == SOCK_CONNECTING) {
+            s->state = arg == 0 ? SOCK_CONNECTED : SOCK_FAILED;
+            s->error = arg == 0 ? 0 : ECONNREFUSED;
+            s_stats.connect_failures += arg != 0;
+            changed = true;
+        }
+    } else if (sscanf(line, "+CIPRXGET: 1,%d", &link) == 1 && link >= 0 && link < s_count) {
+        if (s_socks[link].state != SOCK_FREE) {
+            s_socks[link].rx_pending = true;
+            s_stats.rx_urcs++;
+            changed = true;
+        }
+    } else if (sscanf(line, "+IPCLOSE: %d,%d", &link, &arg) == 2 && link >= 0 &&
+               link < s_count) {
+        sock_t *s = &s_socks[link];
+        if (s->state == SOCK_CONNECTED || s->state == SOCK_CONNECTING) {
+            s->state = SOCK_PEER_CLOSED;
+            s_stats.peer_closes++;
+            changed = true;
+        }
+    } else if (strncmp(line, "+CIPEVENT:", 10) == 0 ||
+               (strncmp(line, "+CGEV:", 6) == 0 &&
+                (strstr(line, "DEACT") || strstr(line, "DETACH")))) {
+        // Bearer gone: every link with it.
+        for (int i = 0; i < s_count; i++) {
+            sock_t *s = &s_socks[i];
+            if (s->state >= SOCK_CONNECTING && s->state != SOCK_FAILED) {
+                s->state = SOCK_FAILED;
+                s->error = ENETDOWN;
+                changed = true;
+            }
+        }
+    }
+    xSemaphoreGive(s_lock);
+
+    if (changed) {
+        xEventGroupSetBits(s_evt, EVT_CHANGED);
+    }
+}
+
+// ============================================================
+// modem_sock_init()
+//
+// Steps:
+//   1. Non-transparent mode, network open, manual receive.
+//   2. Link count from the +CIPOPEN? listing (one line per link).
+//   3. Split the RX budget into one slice per socket.
+// ============================================================
+esp_err_t modem_sock_init(void) {
+    if (s_count > 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (s_lock == NULL) {
+        s_lock = xSemaphoreCreateMutex();
+        s_evt = xEventGroupCreate();
+        if (s_lock == NULL || s_evt == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    // --- Step 1: Modes ---
+    if (!at_ok("AT+CIPMODE=0\r\n", MODEM_CMD_TIMEOUT_MS) ||
+        !at_ok("AT+NETOPEN\r\n", MODEM_CMD_TIMEOUT_MS) ||
+        !at_ok("AT+CIPRXGET=1\r\n", MODEM_CMD_TIMEOUT_MS)) {
+        printf("[%s] modem refused socket mode\n", TAG);
+        return ESP_FAIL;
+    }
+
+    // --- Step 2: Link count ---
+    char resp[256];
+    int links = 0;
+    if (modem_send_at("AT+CIPOPEN?\r\n", resp, sizeof(resp), MODEM_CMD_TIMEOUT_MS) >= 0) {
+        for (const char *p = strstr(resp, "+CIPOPEN:"); p; p = strstr(p + 1, "+CIPOPEN:")) {
+            links++;
+        }
+    }
+    if (links == 0) {
+        links = 1;  // Listing not supported: assume one.
+    }
+    int count = links < MODEM_SOCK_MAX ? links : MODEM_SOCK_MAX;
+
+    // --- Step 3: RX slices ---
+    size_t budget = mem_plan_value(MEM_RX_RING);
+    s_pool = heap_caps_malloc(budget, mem_plan_caps(MEM_RX_RING));
+    if (s_pool == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_slice = (budget / (size_t)count) & ~(size_t)3;
+    memset(s_socks, 0, sizeof(s_socks));
+    for (int i = 0; i < count; i++) {
+        s_socks[i].rx = s_pool + (size_t)i * s_slice;
+    }
+    s_count = count;
+
+    if (modem_add_line_observer(on_line, NULL) != ESP_OK) {
+        modem_sock_deinit();
+        return ESP_ERR_NO_MEM;
+    }
+    printf("[%s] %d sockets (modem has %d links), %u B RX each\n", TAG, count, links,
+           (unsigned)s_slice);
+    return ESP_OK;
+}
+
+void modem_sock_deinit(void) {
+    if (s_count == 0) {
+        return;
+    }
+    for (int i = 0; i < s_count; i++) {
+        if (s_socks[i].state != SOCK_FREE) {
+            modem_sock_close(i);
+        }
+    }
+    modem_remove_line_observer(on_line, NULL);
+    at_ok("AT+CIPRXGET=0\r\n", MODEM_CMD_TIMEOUT_MS);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_count = 0;
+    xSemaphoreGive(s_lock);
+    heap_caps_free(s_pool);
+    s_pool = NULL;
+}
+
+int modem_sock_count(void) {
+    return s_count;
+}
+
+// ============================================================
+// Socket calls
+// ============================================================
+int modem_sock_open(modem_sock_type_t type) {
+    if (s_lock == NULL) {
+        errno = ENETDOWN;  // modem_sock_init() not run.
+        return -1;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < s_count; i++) {
+        sock_t *s = &s_socks[i];
+        if (s->state == SOCK_FREE) {
+            uint8_t *rx = s->rx;
+            memset(s, 0, sizeof(*s));
+            s->rx = rx;
+            s->state = SOCK_OPEN;
+            s->type = (uint8_t)type;
+            xSemaphoreGive(s_lock);
+            return i;
+        }
+    }
+    xSemaphoreGive(s_lock);
+    errno = EMFILE;
+    return -1;
+}
+
+// ============================================================
+// modem_sock_connect()
+//
+// TCP:  AT+CIPOPEN=<link>,"TCP","<host>",<port> -> OK, then the
+//       result arrives as "+CIPOPEN: <link>,<err>".
+// UDP:  AT+CIPOPEN=<link>,"UDP",,,<local port> answers at once;
+//       host/port become the send destination.
+// ============================================================
+int modem_sock_connect(int sock, const char *host, uint16_t port) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    sock_t *s = get(sock);
+    if (s == NULL || s->state != SOCK_OPEN) {
+        xSemaphoreGive(s_lock);
+        errno = s ? EISCONN : EBADF;
+        return -1;
+    }
+    s->state = SOCK_CONNECTING;
+    bool tcp = s->type == MODEM_SOCK_TCP;
+    if (!tcp) {
+        snprintf(s->host, sizeof(s->host), "%s", host);
+        s->port = port;
+    }
+    xSemaphoreGive(s_lock);
+
+    char cmd[128];
+    if (tcp) {
+        snprintf(cmd, sizeof(cmd), "AT+CIPOPEN=%d,\"TCP\",\"%s\",%u\r\n", sock, host,
+                 (unsigned)port);
+    } else {
+        snprintf(cmd, sizeof(cmd), "AT+CIPOPEN=%d,\"UDP\",,,%u\r\n", sock,
+                 (unsigned)(MODEM_SOCK_LOCAL_PORT_BASE + sock));
+    }
+    s_stats.connects++;
+    bool ok = at_ok(cmd, MODEM_CMD_TIMEOUT_MS);
+
+    // The "+CIPOPEN" result may already have come with the OK.
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int result = 0;
+    if (!ok) {
+        s->state = SOCK_FAILED;
+        s->error = EIO;
+        s_stats.connect_failures++;
+        errno = EIO;
+        result = -1;
+    } else if (s->state == SOCK_CONNECTING) {
+        errno = EINPROGRESS;
+        result = -1;
+    } else if (s->state == SOCK_FAILED) {
+        errno = s->error;
+        result = -1;
+    }
+    xSemaphoreGive(s_lock);
+    return result;
+}
+
+int modem_sock_send(int sock, const void *data, size_t len) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    sock_t *s = get(sock);
+    int err = 0;
+    if (s == NULL) {
+        err = EBADF;
+    } else if (s->state == SOCK_CONNECTING) {
+        err = EAGAIN;
+    } else if (s->state == SOCK_PEER_CLOSED) {
+        err = EPIPE;
+    } else if (s->state == SOCK_FAILED) {
+        err = s->error ? s->error : ECONNRESET;
+    } else if (s->state != SOCK_CONNECTED) {
+        err = ENOTCONN;
+    } else if (s->type == MODEM_SOCK_UDP && len > MODEM_SOCK_TX_MAX) {
+        err = EMSGSIZE;
+    }
+    bool udp = s && s->type == MODEM_SOCK_UDP;
+    xSemaphoreGive(s_lock);
+    if (err) {
+        errno = err;
+        return -1;
+    }
+
+    size_t n = len < MODEM_SOCK_TX_MAX ? len : MODEM_SOCK_TX_MAX;
+    int sent = udp ? modem_udp_send((uint8_t)sock, s->host, s->port, data, n,
+                                    MODEM_CMD_TIMEOUT_MS)
+                   : modem_link_send((uint8_t)sock, data, n, MODEM_CMD_TIMEOUT_MS);
+    if (sent < 0) {
+        errno = EIO;
+        return -1;
+    }
+    s_stats.tx_bytes += (uint32_t)sent;
+    return sent;
+}
+
+// ============================================================
+// modem_sock_recv()
+//
+// Steps:
+//   1. Serve from the RX slice if it holds anything.
+//   2. Otherwise, if the modem announced data, pull one slice
+//      (or one datagram) with AT+CIPRXGET=2.
+//   3. Nothing: EAGAIN, or 0 / error once the link is gone.
+// ============================================================
+int modem_sock_recv(int sock, void *buf, size_t len) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    sock_t *s = get(sock);
+    if (s == NULL) {
+        xSemaphoreGive(s_lock);
+        errno = EBADF;
+        return -1;
+    }
+
+    // --- Step 2: Pull ---
+    if (s->rx_len == 0 && s->rx_pending) {
+        // Cleared before the pull: a "+CIPRXGET: 1" arriving
+        // during it sets the flag again.
+        s->rx_pending = false;
+        xSemaphoreGive(s_lock);
+        size_t rest = 0;
+        int n = modem_link_read((uint8_t)sock, s->rx, s_slice, &rest, MODEM_CMD_TIMEOUT_MS);
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_stats.pulls++;
+        if (n < 0) {
+            s->rx_pending = true;  // Try again on the next call.
+            xSemaphoreGive(s_lock);
+            errno = EIO;
+            return -1;
+        }
+        s->rx_off = 0;
+        s->rx_len = (size_t)n;
+        s->rx_pending |= rest > 0;
+        s_stats.rx_bytes += (uint32_t)n;
+    }
+
+    // --- Step 1: Slice ---
+    if (s->rx_len > 0) {
+        size_t n = s->rx_len < len ? s->rx_len : len;
+        memcpy(buf, s->rx + s->rx_off, n);
+        s->rx_off += n;
+        s->rx_len -= n;
+        if (s->type == MODEM_SOCK_UDP) {
+            s->rx_len = 0;  // Rest of the datagram is dropped.
+        }
+        xSemaphoreGive(s_lock);
+        return (int)n;
+    }
+
+    // --- Step 3: Nothing buffered ---
+    int result = -1;
+    if (s->state == SOCK_PEER_CLOSED) {
+        result = 0;
+    } else if (s->state == SOCK_FAILED) {
+        errno = s->error ? s->error : ECONNRESET;
+    } else {
+        errno = EAGAIN;
+    }
+    xSemaphoreGive(s_lock);
+    return result;
+}
+
+int modem_sock_close(int sock) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    sock_t *s = get(sock);
+    if (s == NULL) {
+        xSemaphoreGive(s_lock);
+        errno = EBADF;
+        return -1;
+    }
+    bool has_link = s->state != SOCK_OPEN;
+    s->state = SOCK_FREE;
+    xSemaphoreGive(s_lock);
+
+    if (has_link) {
+        char cmd[32];
+        snprintf(cmd, sizeof(cmd), "AT+CIPCLOSE=%d\r\n", sock);
+        modem_send_at(cmd, NULL, 0, MODEM_CMD_TIMEOUT_MS);
+    }
+    return 0;
+}
+
+int modem_sock_error(int sock) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    sock_t *s = get(sock);
+    int err = s ? s->error : EBADF;
+    if (s) {
+        s->error = 0;
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+static uint8_t revents(const sock_t *s, uint8_t events) {
+    if (s == NULL) {
+        return MODEM_SOCK_POLLERR;
+    }
+    uint8_t r = 0;
+    if (s->rx_len > 0 || s->rx_pending || s->state == SOCK_PEER_CLOSED) {
+        r |= MODEM_SOCK_POLLIN;
+    }
+    if (s->state == SOCK_CONNECTED) {
+        r |= MODEM_SOCK_POLLOUT;
+    }
+    r &= events;
+    if (s->state == SOCK_FAILED) {
+        r |= MODEM_SOCK_POLLERR | MODEM_SOCK_POLLHUP;
+    } else if (s->state == SOCK_PEER_CLOSED) {
+        r |= MODEM_SOCK_POLLHUP;
+    }
+    return r;
+}
+
+// ============================================================
+// modem_sock_poll()
+//
+// Clear the wake-up bit, check, sleep: a URC that lands between
+// the check and the sleep sets the bit again, so it is never
+// missed.
+// ============================================================
+int modem_sock_poll(modem_sock_pollfd_t *fds, int nfds, uint32_t timeout_ms) {
+    if (s_lock == NULL) {
+        errno = ENETDOWN;
+        return -1;
+    }
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    while (1) {
+        xEventGroupClearBits(s_evt, EVT_CHANGED);
+        int ready = 0;
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        for (int i = 0; i < nfds; i++) {
+            fds[i].revents = revents(get(fds[i].sock), fds[i].events);
+            ready += fds[i].revents != 0;
+        }
+        xSemaphoreGive(s_lock);
+
+        int64_t left_us = deadline - esp_timer_get_time();
+        if (ready > 0 || left_us <= 0) {
+            return ready;
+        }
+        xEventGroupWaitBits(s_evt, EVT_CHANGED, pdTRUE, pdFALSE,
+                            pdMS_TO_TICKS((left_us + 999) / 1000));
+    }
+}
+
+modem_sock_stats_t modem_sock_stats(void) {
+    return s_stats;
+}
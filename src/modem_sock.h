@@ -0,0 +1,108 @@
+#pragma once
+
+// ============================================================
+// modem_sock.h
+//
+// BSD-style non-blocking sockets on the modem's own TCP/IP stack
+// (SIMCom AT+CIPOPEN links, non-transparent mode).
+//
+// One socket = one modem link; up to the number of links the
+// modem reports (+CIPOPEN? listing), capped at MODEM_SOCK_MAX.
+// Calls never wait for the network:
+//   - modem_sock_connect() on TCP returns -1 / EINPROGRESS; the
+//     "+CIPOPEN: <link>,<err>" URC completes it (POLLOUT or
+//     POLLERR).
+//   - The modem holds received data (manual receive mode,
+//     AT+CIPRXGET=1) and says so with "+CIPRXGET: 1,<link>".
+//     modem_sock_recv() pulls it into the socket's RX slice with
+//     AT+CIPRXGET=2; without data it returns -1 / EAGAIN.
+//   - modem_sock_poll() sleeps until a URC changes a socket.
+// Only the UART exchange itself blocks (a few ms per send/pull).
+//
+// RX slices: the planned RX_RING_BYTES budget (mem_plan_value(
+// MEM_RX_RING)) split evenly between sockets. A pull never asks
+// for more than one slice, so a pull in flight always fits the
+// UART ring of the same size.
+//
+// Errors are reported the BSD way: -1 and errno.
+//
+// URCs are read by the modem_reg task (modem_poll()); start it
+// before modem_sock_init(). Manual receive mode is modem-wide:
+// modem_udp_*() (push mode, "+IPD") must not be used between
+// modem_sock_init() and modem_sock_deinit().
+// ============================================================
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef enum {
+    MODEM_SOCK_TCP,
+    MODEM_SOCK_UDP
+} modem_sock_type_t;
+
+// poll() events. ERR and HUP are reported whether asked or not.
+#define MODEM_SOCK_POLLIN 0x01
+#define MODEM_SOCK_POLLOUT 0x04
+#define MODEM_SOCK_POLLERR 0x08
+#define MODEM_SOCK_POLLHUP 0x10
+
+typedef struct {
+    int sock;
+    uint8_t events;
+    uint8_t revents;
+} modem_sock_pollfd_t;
+
+// --- Counters ---
+typedef struct {
+    uint32_t connects;
+    uint32_t connect_failures;
+    uint32_t tx_bytes;
+    uint32_t rx_bytes;
+    uint32_t rx_urcs;         // "+CIPRXGET: 1" notifications.
+    uint32_t pulls;           // AT+CIPRXGET=2 exchanges.
+    uint32_t peer_closes;
+} modem_sock_stats_t;
+
+// --- Public functions ---------------------------------------
+
+// Switches the modem to non-transparent, manual-receive mode,
+// learns its link count and allocates the RX slices.
+esp_err_t modem_sock_init(void);
+
+// Closes every socket, restores push receive mode (for
+// modem_udp_*()) and frees the RX slices.
+void modem_sock_deinit(void);
+
+// Sockets available (modem links, capped at MODEM_SOCK_MAX).
+int modem_sock_count(void);
+
+// Returns a socket, or -1 (EMFILE: all links in use).
+int modem_sock_open(modem_sock_type_t type);
+
+// TCP: -1 / EINPROGRESS, completion by URC. UDP: sets the
+// destination for modem_sock_send() and returns 0.
+int modem_sock_connect(int sock, const char *host, uint16_t port);
+
+// Bytes accepted by the modem (TCP may be partial, at most
+// MODEM_SOCK_TX_MAX), or -1: EAGAIN (connect in progress),
+// ENOTCONN, EPIPE (peer closed), ECONNRESET / ENETDOWN, EIO,
+// EMSGSIZE (UDP datagram over MODEM_SOCK_TX_MAX).
+int modem_sock_send(int sock, const void *data, size_t len);
+
+// Bytes read, 0 once the peer closed and everything was read,
+// or -1: EAGAIN (nothing yet), ECONNRESET / ENETDOWN, EIO.
+// UDP: one datagram per call, truncated to len.
+int modem_sock_recv(int sock, void *buf, size_t len);
+
+int modem_sock_close(int sock);
+
+// Pending connect error (0 if none), like SO_ERROR. Clears it.
+int modem_sock_error(int sock);
+
+// Fills revents; returns the number of ready entries, 0 on
+// timeout.
+int modem_sock_poll(modem_sock_pollfd_t *fds, int nfds, uint32_t timeout_ms);
+
+modem_sock_stats_t modem_sock_stats(void);
@@ -0,0 +1,713 @@
+// ============================================================
+// mqtt_client.c
+//
+// MQTT 3.1.1 / 5.0 client. See mqtt_client.h for the design.
+//
+// Packet flow:
+//   mqtt_publish() --encode--> window slot --copy--> tx_batch
+//   mqtt_flush()   --one write--> transport
+//   mqtt_poll()    <--bytes-- transport --> rx_byte() parser
+//                  --> handle_packet() (CONNACK/PUBACK/SUBACK/...)
+//
+// Only the subset needed for telemetry is implemented:
+// QoS 0/1 publish, QoS 0/1 subscribe, keepalive. QoS 2 and
+// MQTT 5 properties other than Session Expiry are not used.
+// ============================================================
+
+#include "mqtt_client.h"
+
+// stdio.h: printf() for debug logging to UART0 console.
+#include <stdio.h>
+
+// string.h: memcpy(), strlen() for packet encoding.
+#include <string.h>
+
+// esp_timer.h: microsecond timestamps for keepalive and ack latency.
+#include "esp_timer.h"
+
+// power_lock(): full CPU clock while parsing received packets.
+#include "power_mgmt.h"
+
+static const char *TAG = "mqtt";
+
+// --- Packet types (upper nibble of the fixed header) --------
+#define MQTT_CONNECT     0x10
+#define MQTT_CONNACK     0x20
+#define MQTT_PUBLISH     0x30
+#define MQTT_PUBACK      0x40
+#define MQTT_SUBSCRIBE   0x82  // Reserved flag bits must be 0010.
+#define MQTT_SUBACK      0x90
+#define MQTT_PINGREQ     0xC0
+#define MQTT_PINGRESP    0xD0
+#define MQTT_DISCONNECT  0xE0
+
+// Flag bit in a PUBLISH fixed header marking a retransmission.
+#define MQTT_PUBLISH_DUP 0x08
+
+// MQTT 5 property identifier for Session Expiry Interval.
+#define MQTT5_PROP_SESSION_EXPIRY 0x11
+
+// --- RX parser states ---------------------------------------
+enum {
+    RX_HEADER = 0,  // Waiting for fixed header byte.
+    RX_LENGTH,      // Reading remaining-length varint.
+    RX_BODY,        // Reading remaining bytes into rx_buf.
+};
+
+// ============================================================
+// Encoding helpers
+//
+// All helpers write into a caller-provided buffer at *pos and
+// advance it. Bounds are checked once by the caller via
+// the computed packet size, so these never overflow.
+// ============================================================
+static void put_u8(uint8_t *buf, size_t *pos, uint8_t v) {
+    buf[(*pos)++] = v;
+}
+
+static void put_u16(uint8_t *buf, size_t *pos, uint16_t v) {
+    buf[(*pos)++] = (uint8_t)(v >> 8);
+    buf[(*pos)++] = (uint8_t)(v & 0xFF);
+}
+
+static void put_str(uint8_t *buf, size_t *pos, const char *s, size_t len) {
+    put_u16(buf, pos, (uint16_t)len);
+    memcpy(buf + *pos, s, len);
+    *pos += len;
+}
+
+// Remaining-length varint: 7 bits per byte, MSB = continuation.
+static void put_varint(uint8_t *buf, size_t *pos, uint32_t v) {
+    do {
+        uint8_t b = v & 0x7F;
+        v >>= 7;
+        if (v > 0) {
+            b |= 0x80;
+        }
+        buf[(*pos)++] = b;
+    } while (v > 0);
+}
+
+static size_t varint_size(uint32_t v) {
+    size_t n = 1;
+    while (v >= 128) {
+        v >>= 7;
+        n++;
+    }
+    return n;
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+// Decodes a varint inside a packet body (MQTT 5 property length).
+// Returns bytes consumed, 0 if malformed/truncated.
+static size_t get_varint(const uint8_t *p, size_t avail, uint32_t *out) {
+    uint32_t v = 0;
+    for (size_t i = 0; i < 4 && i < avail; i++) {
+        v |= (uint32_t)(p[i] & 0x7F) << (7 * i);
+        if ((p[i] & 0x80) == 0) {
+            *out = v;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+// ============================================================
+// alloc_packet_id()
+//
+// Returns the next non-zero packet id that is not already used
+// by an in-flight slot.
+// ============================================================
+static uint16_t alloc_packet_id(mqtt_client_t *c) {
+    for (;;) {
+        uint16_t id = c->next_packet_id++;
+        if (c->next_packet_id == 0) {
+            c->next_packet_id = 1;
+        }
+        bool used = false;
+        for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+            if (c->window[i].state != MQTT_SLOT_FREE &&
+                c->window[i].packet_id == id) {
+                used = true;
+                break;
+            }
+        }
+        if (id != 0 && !used) {
+            return id;
+        }
+    }
+}
+
+// ============================================================
+// write_raw()
+//
+// Writes a control packet immediately, bypassing the batch.
+// Used for CONNECT/SUBSCRIBE/PINGREQ/PUBACK/DISCONNECT, which
+// are either latency-sensitive or must precede queued data.
+// ============================================================
+static esp_err_t write_raw(mqtt_client_t *c, const uint8_t *data, size_t len) {
+    int n = c->tp.write(c->tp.ctx, data, len);
+    if (n != (int)len) {
+        printf("[%s] transport write failed (%d/%u)\n", TAG, n, (unsigned)len);
+        c->connected = false;
+        return ESP_FAIL;
+    }
+    c->last_tx_us = esp_timer_get_time();
+    return ESP_OK;
+}
+
+// ============================================================
+// batch_append()
+//
+// Copies an encoded packet into the TX batch, flushing first if
+// it would not fit.
+// ============================================================
+static esp_err_t batch_append(mqtt_client_t *c, const uint8_t *data, size_t len) {
+    if (c->tx_len + len > sizeof(c->tx_batch)) {
+        esp_err_t err = mqtt_flush(c);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    memcpy(c->tx_batch + c->tx_len, data, len);
+    c->tx_len += len;
+    return ESP_OK;
+}
+
+// ============================================================
+// handle_puback()
+//
+// Frees the window slot matching packet_id and records latency.
+// ============================================================
+static void handle_puback(mqtt_client_t *c, uint16_t packet_id, uint8_t reason) {
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        mqtt_inflight_t *slot = &c->window[i];
+        if (slot->state == MQTT_SLOT_SENT && slot->packet_id == packet_id) {
+            int64_t lat = esp_timer_get_time() - slot->sent_us;
+            c->stats.ack_latency_us += lat;
+            if (lat > c->stats.ack_latency_max_us) {
+                c->stats.ack_latency_max_us = lat;
+            }
+            if (reason >= 0x80) {
+                c->stats.nacked++;
+            } else {
+                c->stats.acked++;
+            }
+            slot->state = MQTT_SLOT_FREE;
+            c->inflight--;
+            return;
+        }
+    }
+    // PUBACK for an id we no longer track (duplicate after a resend).
+}
+
+// ============================================================
+// handle_publish()
+//
+// Decodes an incoming PUBLISH, acknowledges QoS1, and hands the
+// message to the on_message callback.
+// ============================================================
+static void handle_publish(mqtt_client_t *c, uint8_t header,
+                           const uint8_t *p, size_t len) {
+    uint8_t qos = (header >> 1) & 0x03;
+    if (len < 2) {
+        return;
+    }
+    size_t topic_len = get_u16(p);
+    size_t pos = 2 + topic_len;
+    if (pos > len) {
+        return;
+    }
+    const char *topic = (const char *)p + 2;
+
+    uint16_t packet_id = 0;
+    if (qos > 0) {
+        if (pos + 2 > len) {
+            return;
+        }
+        packet_id = get_u16(p + pos);
+        pos += 2;
+    }
+    if (c->cfg.protocol_level >= 5) {
+        uint32_t prop_len;
+        size_t used = get_varint(p + pos, len - pos, &prop_len);
+        if (used == 0 || pos + used + prop_len > len) {
+            return;
+        }
+        pos += used + prop_len;
+    }
+
+    c->stats.received++;
+    if (c->cfg.on_message != NULL) {
+        c->cfg.on_message(c->cfg.user, topic, topic_len, p + pos, len - pos);
+    }
+
+    if (qos > 0) {
+        uint8_t ack[4] = {MQTT_PUBACK, 2, (uint8_t)(packet_id >> 8),
+                          (uint8_t)(packet_id & 0xFF)};
+        write_raw(c, ack, sizeof(ack));
+    }
+}
+
+// ============================================================
+// handle_packet()
+//
+// Dispatches one complete packet from the RX parser.
+//
+// Inputs:
+//   header — fixed header byte (type + flags).
+//   p, len — packet body after the remaining-length field.
+// ============================================================
+static void handle_packet(mqtt_client_t *c, uint8_t header,
+                          const uint8_t *p, size_t len) {
+    switch (header & 0xF0) {
+    case MQTT_CONNACK:
+        if (len >= 2) {
+            c->session_present = (p[0] & 0x01) != 0;
+            c->connack_code = p[1];
+            c->connected = (p[1] == 0);
+        }
+        break;
+
+    case MQTT_PUBACK:
+        if (len >= 2) {
+            // MQTT 5 may append a reason code; absent means success.
+            uint8_t reason = (len >= 3) ? p[2] : 0;
+            handle_puback(c, get_u16(p), reason);
+        }
+        break;
+
+    case MQTT_SUBACK:
+        if (len >= 3 && get_u16(p) == c->pending_suback_id) {
+            size_t pos = 2;
+            if (c->cfg.protocol_level >= 5) {
+                uint32_t prop_len;
+                size_t used = get_varint(p + pos, len - pos, &prop_len);
+                if (used == 0) {
+                    break;
+                }
+                pos += used + prop_len;
+            }
+            c->suback_code = (pos < len) ? p[pos] : 0x80;
+            c->pending_suback_id = 0;
+        }
+        break;
+
+    case MQTT_PUBLISH:
+        handle_publish(c, header, p, len);
+        break;
+
+    case MQTT_PINGRESP:
+        c->ping_sent_us = 0;
+        break;
+
+    case MQTT_DISCONNECT:
+        // MQTT 5 server-initiated disconnect.
+        printf("[%s] broker sent DISCONNECT\n", TAG);
+        c->connected = false;
+        break;
+
+    default:
+        printf("[%s] ignoring packet type 0x%02x\n", TAG, header);
+        break;
+    }
+}
+
+// ============================================================
+// rx_byte()
+//
+// Feeds one byte into the incremental packet parser.
+// Bodies longer than rx_buf are consumed and discarded.
+// ============================================================
+static void rx_byte(mqtt_client_t *c, uint8_t b) {
+    switch (c->rx_state) {
+    case RX_HEADER:
+        c->rx_header = b;
+        c->rx_remaining = 0;
+        c->rx_len_shift = 0;
+        c->rx_state = RX_LENGTH;
+        break;
+
+    case RX_LENGTH:
+        c->rx_remaining |= (uint32_t)(b & 0x7F) << c->rx_len_shift;
+        c->rx_len_shift += 7;
+        if ((b & 0x80) == 0) {
+            c->rx_pos = 0;
+            if (c->rx_remaining == 0) {
+                handle_packet(c, c->rx_header, c->rx_buf, 0);
+                c->rx_state = RX_HEADER;
+            } else {
+                c->rx_state = RX_BODY;
+            }
+        } else if (c->rx_len_shift > 21) {
+            // More than 4 length bytes: stream is corrupt. Resync on
+            // the next byte; the broker will drop us if it is really lost.
+            printf("[%s] malformed remaining length\n", TAG);
+            c->rx_state = RX_HEADER;
+        }
+        break;
+
+    case RX_BODY:
+        if (c->rx_pos < sizeof(c->rx_buf)) {
+            c->rx_buf[c->rx_pos] = b;
+        }
+        c->rx_pos++;
+        if (c->rx_pos == c->rx_remaining) {
+            if (c->rx_remaining <= sizeof(c->rx_buf)) {
+                handle_packet(c, c->rx_header, c->rx_buf, c->rx_remaining);
+            } else {
+                printf("[%s] dropped %u-byte packet (> MQTT_PACKET_MAX)\n",
+                       TAG, (unsigned)c->rx_remaining);
+            }
+            c->rx_state = RX_HEADER;
+        }
+        break;
+    }
+}
+
+// ============================================================
+// resend_inflight()
+//
+// After a reconnect, every publish that was written but never
+// acknowledged goes out again. With the session resumed it is a
+// retransmission (DUP flag). Without one (session-present 0) the
+// broker kept no state for it, so it is sent as a new publish:
+// DUP cleared, not counted as retransmitted. QUEUED slots were
+// never on the wire and go out as normal first transmissions.
+// ============================================================
+static esp_err_t resend_inflight(mqtt_client_t *c) {
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        mqtt_inflight_t *slot = &c->window[i];
+        if (slot->state == MQTT_SLOT_FREE) {
+            continue;
+        }
+        if (slot->state == MQTT_SLOT_SENT && c->session_present) {
+            slot->pkt[0] |= MQTT_PUBLISH_DUP;
+            c->stats.retransmitted++;
+        } else {
+            slot->pkt[0] &= (uint8_t)~MQTT_PUBLISH_DUP;
+        }
+        esp_err_t err = batch_append(c, slot->pkt, slot->len);
+        if (err != ESP_OK) {
+            return err;
+        }
+        slot->state = MQTT_SLOT_QUEUED;
+    }
+    return mqtt_flush(c);
+}
+
+// ============================================================
+// Public API
+// ============================================================
+void mqtt_client_init(mqtt_client_t *c, const mqtt_config_t *cfg,
+                      const mqtt_transport_t *tp) {
+    memset(c, 0, sizeof(*c));
+    c->cfg = *cfg;
+    c->tp = *tp;
+    c->next_packet_id = 1;
+    if (c->cfg.protocol_level != 5) {
+        c->cfg.protocol_level = 4;
+    }
+}
+
+esp_err_t mqtt_connect(mqtt_client_t *c, uint32_t timeout_ms) {
+    uint8_t pkt[128];
+    size_t id_len = strlen(c->cfg.client_id);
+
+    // Variable header: protocol name (6) + level (1) + flags (1) + keepalive (2).
+    size_t props = 0;
+    if (c->cfg.protocol_level >= 5) {
+        // Property length (1) + Session Expiry Interval (1 + 4).
+        props = 1 + (c->cfg.session_expiry_s > 0 ? 5 : 0);
+    }
+    size_t remaining = 10 + props + 2 + id_len;
+    if (1 + varint_size(remaining) + remaining > sizeof(pkt)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    size_t pos = 0;
+    put_u8(pkt, &pos, MQTT_CONNECT);
+    put_varint(pkt, &pos, (uint32_t)remaining);
+    put_str(pkt, &pos, "MQTT", 4);
+    put_u8(pkt, &pos, c->cfg.protocol_level);
+    put_u8(pkt, &pos, c->cfg.clean_session ? 0x02 : 0x00);
+    put_u16(pkt, &pos, c->cfg.keepalive_s);
+    if (c->cfg.protocol_level >= 5) {
+        if (c->cfg.session_expiry_s > 0) {
+            put_u8(pkt, &pos, 5);
+            put_u8(pkt, &pos, MQTT5_PROP_SESSION_EXPIRY);
+            put_u16(pkt, &pos, (uint16_t)(c->cfg.session_expiry_s >> 16));
+            put_u16(pkt, &pos, (uint16_t)(c->cfg.session_expiry_s & 0xFFFF));
+        } else {
+            put_u8(pkt, &pos, 0);
+        }
+    }
+    put_str(pkt, &pos, c->cfg.client_id, id_len);
+
+    // Fresh parser and connection state for the new stream.
+    c->connected = false;
+    c->session_present = false;
+    c->connack_code = 0xFF;
+    c->rx_state = RX_HEADER;
+    c->tx_len = 0;
+    c->ping_sent_us = 0;
+
+    if (write_raw(c, pkt, pos) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    while (c->connack_code == 0xFF && esp_timer_get_time() < deadline) {
+        mqtt_poll(c, 50);
+    }
+    if (c->connack_code == 0xFF) {
+        printf("[%s] no CONNACK\n", TAG);
+        return ESP_ERR_TIMEOUT;
+    }
+    if (!c->connected) {
+        printf("[%s] connection refused, code %u\n", TAG, c->connack_code);
+        return ESP_FAIL;
+    }
+
+    printf("[%s] connected as \"%s\" (v%u, session %s, %u in flight)\n", TAG,
+           c->cfg.client_id, c->cfg.protocol_level == 5 ? 5 : 3,
+           c->session_present ? "resumed" : "new", c->inflight);
+    return resend_inflight(c);
+}
+
+bool mqtt_session_present(const mqtt_client_t *c) {
+    return c->session_present;
+}
+
+esp_err_t mqtt_subscribe(mqtt_client_t *c, const char *topic, uint8_t qos,
+                         uint32_t timeout_ms) {
+    if (!c->connected) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    uint8_t pkt[MQTT_PACKET_MAX];
+    size_t topic_len = strlen(topic);
+    size_t props = (c->cfg.protocol_level >= 5) ? 1 : 0;
+    size_t remaining = 2 + props + 2 + topic_len + 1;
+    if (1 + varint_size(remaining) + remaining > sizeof(pkt)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint16_t id = alloc_packet_id(c);
+    size_t pos = 0;
+    put_u8(pkt, &pos, MQTT_SUBSCRIBE);
+    put_varint(pkt, &pos, (uint32_t)remaining);
+    put_u16(pkt, &pos, id);
+    if (props) {
+        put_u8(pkt, &pos, 0);
+    }
+    put_str(pkt, &pos, topic, topic_len);
+    put_u8(pkt, &pos, qos & 0x03);
+
+    // Queued publishes go first so ordering matches call order.
+    esp_err_t err = mqtt_flush(c);
+    if (err != ESP_OK) {
+        return err;
+    }
+    c->pending_suback_id = id;
+    if (write_raw(c, pkt, pos) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    while (c->pending_suback_id != 0 && c->connected &&
+           esp_timer_get_time() < deadline) {
+        mqtt_poll(c, 50);
+    }
+    if (c->pending_suback_id != 0) {
+        c->pending_suback_id = 0;
+        return ESP_ERR_TIMEOUT;
+    }
+    if (c->suback_code >= 0x80) {
+        printf("[%s] subscribe \"%s\" rejected (0x%02x)\n", TAG, topic,
+               c->suback_code);
+        return ESP_FAIL;
+    }
+    printf("[%s] subscribed \"%s\" qos %u\n", TAG, topic, c->suback_code);
+    return ESP_OK;
+}
+
+esp_err_t mqtt_publish(mqtt_client_t *c, const char *topic,
+                       const uint8_t *payload, size_t len, uint8_t qos,
+                       bool retain, uint32_t timeout_ms) {
+    if (!c->connected) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (qos > 1) {
+        qos = 1;  // QoS 2 is not implemented; downgrade.
+    }
+
+    size_t topic_len = strlen(topic);
+    size_t props = (c->cfg.protocol_level >= 5) ? 1 : 0;
+    size_t remaining = 2 + topic_len + (qos ? 2 : 0) + props + len;
+    size_t total = 1 + varint_size(remaining) + remaining;
+    if (total > MQTT_PACKET_MAX) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // Make room in the batch before claiming a slot: a flush marks
+    // every QUEUED slot SENT, and this packet is not in it yet.
+    if (c->tx_len + total > sizeof(c->tx_batch)) {
+        esp_err_t err = mqtt_flush(c);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    // Encode into a window slot (QoS1) or a stack buffer (QoS0).
+    uint8_t scratch[MQTT_PACKET_MAX];
+    uint8_t *pkt = scratch;
+    mqtt_inflight_t *slot = NULL;
+
+    if (qos == 1) {
+        // Only block when every slot is waiting for a PUBACK.
+        if (c->inflight >= MQTT_INFLIGHT_MAX) {
+            c->stats.window_full++;
+            int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+            while (c->inflight >= MQTT_INFLIGHT_MAX && c->connected &&
+                   esp_timer_get_time() < deadline) {
+                mqtt_poll(c, 20);
+            }
+            if (c->inflight >= MQTT_INFLIGHT_MAX) {
+                return c->connected ? ESP_ERR_TIMEOUT : ESP_ERR_INVALID_STATE;
+            }
+        }
+        for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+            if (c->window[i].state == MQTT_SLOT_FREE) {
+                slot = &c->window[i];
+                break;
+            }
+        }
+        pkt = slot->pkt;
+    }
+
+    size_t pos = 0;
+    uint16_t id = 0;
+    put_u8(pkt, &pos, (uint8_t)(MQTT_PUBLISH | (qos << 1) | (retain ? 1 : 0)));
+    put_varint(pkt, &pos, (uint32_t)remaining);
+    put_str(pkt, &pos, topic, topic_len);
+    if (qos) {
+        id = alloc_packet_id(c);
+        put_u16(pkt, &pos, id);
+    }
+    if (props) {
+        put_u8(pkt, &pos, 0);
+    }
+    memcpy(pkt + pos, payload, len);
+    pos += len;
+
+    if (slot != NULL) {
+        slot->packet_id = id;
+        slot->len = (uint16_t)pos;
+        slot->state = MQTT_SLOT_QUEUED;
+        c->inflight++;
+    }
+    c->stats.published++;
+    return batch_append(c, pkt, pos);
+}
+
+esp_err_t mqtt_flush(mqtt_client_t *c) {
+    if (c->tx_len == 0) {
+        return ESP_OK;
+    }
+    esp_err_t err = write_raw(c, c->tx_batch, c->tx_len);
+    c->tx_len = 0;
+    if (err != ESP_OK) {
+        // Slots stay QUEUED and are sent again by the next mqtt_connect().
+        return err;
+    }
+    c->stats.batches++;
+
+    // Everything queued is now on the wire.
+    int64_t now = c->last_tx_us;
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        mqtt_inflight_t *slot = &c->window[i];
+        if (slot->state == MQTT_SLOT_QUEUED) {
+            slot->state = MQTT_SLOT_SENT;
+            slot->sent_us = now;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t mqtt_poll(mqtt_client_t *c, uint32_t timeout_ms) {
+    esp_err_t err = mqtt_flush(c);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Keepalive: ping if nothing was sent for keepalive_s, and give
+    // up on a ping left unanswered for 1.5 x keepalive_s (dead
+    // broker, half-open link).
+    if (c->connected && c->cfg.keepalive_s > 0) {
+        int64_t now = esp_timer_get_time();
+        int64_t keepalive_us = (int64_t)c->cfg.keepalive_s * 1000000;
+        if (c->ping_sent_us != 0) {
+            if (now - c->ping_sent_us > keepalive_us * 3 / 2) {
+                printf("[%s] no PINGRESP in %u s, link lost\n", TAG,
+                       (unsigned)(c->cfg.keepalive_s * 3 / 2));
+                c->connected = false;
+                c->ping_sent_us = 0;
+                return ESP_ERR_TIMEOUT;
+            }
+        } else if (now - c->last_tx_us > keepalive_us) {
+            uint8_t ping[2] = {MQTT_PINGREQ, 0};
+            if (write_raw(c, ping, sizeof(ping)) == ESP_OK) {
+                c->ping_sent_us = c->last_tx_us;
+            }
+        }
+    }
+
+    uint8_t chunk[64];
+    int n = c->tp.read(c->tp.ctx, chunk, sizeof(chunk), timeout_ms);
+    if (n < 0) {
+        c->connected = false;
+        return ESP_FAIL;
+    }
+    // Drain everything already buffered without waiting again.
+    // Parsing runs at full clock; the wait above did not.
+    if (n > 0) {
+        power_lock(POWER_PARSE);
+        while (n > 0) {
+            for (int i = 0; i < n; i++) {
+                rx_byte(c, chunk[i]);
+            }
+            n = c->tp.read(c->tp.ctx, chunk, sizeof(chunk), 0);
+        }
+        power_unlock(POWER_PARSE);
+    }
+    return ESP_OK;
+}
+
+esp_err_t mqtt_wait_idle(mqtt_client_t *c, uint32_t timeout_ms) {
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    do {
+        esp_err_t err = mqtt_poll(c, 20);
+        if (err != ESP_OK) {
+            return err;
+        }
+    } while (c->inflight > 0 && c->connected &&
+             esp_timer_get_time() < deadline);
+    return c->inflight == 0 ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+uint8_t mqtt_inflight_count(const mqtt_client_t *c) {
+    return c->inflight;
+}
+
+void mqtt_disconnect(mqtt_client_t *c) {
+    if (!c->connected) {
+        return;
+    }
+    mqtt_flush(c);
+    uint8_t pkt[2] = {MQTT_DISCONNECT, 0};
+    write_raw(c, pkt, sizeof(pkt));
+    c->connected = false;
+}
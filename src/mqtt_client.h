@@ -0,0 +1,172 @@
+#pragma once
+
+// ============================================================
+// mqtt_client.h
+//
+// Minimal MQTT 3.1.1 / 5.0 client for telemetry uplink.
+//
+// Design points:
+//   - Transport-agnostic: the client only sees a byte stream
+//     through mqtt_transport_t (the modem transparent link in
+//     this project, see modem_data_read/write()).
+//   - QoS1 publishes are pipelined: mqtt_publish() encodes the
+//     packet into a free slot of a fixed in-flight window and
+//     returns without waiting for the PUBACK. Encoded packets
+//     are batched into one transport write on mqtt_flush().
+//     The caller only blocks when all MQTT_INFLIGHT_MAX slots
+//     are waiting for acknowledgements.
+//   - Persistent sessions: with clean_session = false and a
+//     stable client_id, the broker keeps subscriptions across
+//     reconnects. mqtt_session_present() tells the caller after
+//     mqtt_connect() whether it can skip re-subscribing (e.g.
+//     after deep sleep). Unacknowledged publishes are resent
+//     on reconnect: with DUP set when the session was resumed,
+//     as new publishes when the broker started a new one.
+//
+// No dynamic allocation: everything lives in mqtt_client_t.
+// ============================================================
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "app_config.h"
+
+// --- Transport ----------------------------------------------
+// Byte stream the client runs over.
+//   write — queue len bytes; returns bytes written or -1.
+//   read  — read up to len bytes, waiting at most timeout_ms;
+//           returns bytes read (0 on timeout) or -1.
+typedef struct {
+    int (*write)(void *ctx, const uint8_t *data, size_t len);
+    int (*read)(void *ctx, uint8_t *buf, size_t len, uint32_t timeout_ms);
+    void *ctx;
+} mqtt_transport_t;
+
+// Called from mqtt_poll() for every PUBLISH received from the broker.
+// topic is not null-terminated; payload is only valid during the call.
+typedef void (*mqtt_message_cb_t)(void *user, const char *topic,
+                                  size_t topic_len, const uint8_t *payload,
+                                  size_t payload_len);
+
+// --- Configuration ------------------------------------------
+typedef struct {
+    const char *client_id;      // Must be stable for persistent sessions.
+    uint8_t protocol_level;     // 4 = MQTT 3.1.1, 5 = MQTT 5.0.
+    uint16_t keepalive_s;       // PINGREQ interval when idle.
+    bool clean_session;         // false = keep session on the broker.
+    uint32_t session_expiry_s;  // MQTT 5 only: how long the broker keeps it.
+    mqtt_message_cb_t on_message;
+    void *user;                 // Passed back to on_message.
+} mqtt_config_t;
+
+// --- In-flight window slot ----------------------------------
+typedef enum {
+    MQTT_SLOT_FREE = 0,  // Unused.
+    MQTT_SLOT_QUEUED,    // Encoded, waiting in the TX batch.
+    MQTT_SLOT_SENT,      // Written to transport, waiting for PUBACK.
+} mqtt_slot_state_t;
+
+typedef struct {
+    uint8_t state;          // mqtt_slot_state_t
+    uint16_t packet_id;
+    uint16_t len;           // Encoded packet length in pkt[].
+    int64_t sent_us;        // esp_timer time of first transmission.
+    uint8_t pkt[MQTT_PACKET_MAX];
+} mqtt_inflight_t;
+
+// --- Counters -----------------------------------------------
+typedef struct {
+    uint32_t published;        // PUBLISH packets accepted by mqtt_publish().
+    uint32_t acked;            // PUBACKs matched to a window slot.
+    uint32_t nacked;           // MQTT 5 PUBACKs with a failure reason code.
+    uint32_t retransmitted;    // DUP resends after reconnect.
+    uint32_t window_full;      // Times mqtt_publish() had to wait for a slot.
+    uint32_t received;         // PUBLISH packets delivered to on_message.
+    uint32_t batches;          // Transport writes issued by mqtt_flush().
+    int64_t ack_latency_us;    // Sum of publish-to-PUBACK latencies.
+    int64_t ack_latency_max_us;
+} mqtt_stats_t;
+
+// --- Client state -------------------------------------------
+// Treat as opaque; fields are public only so it can be
+// statically allocated.
+typedef struct {
+    mqtt_config_t cfg;
+    mqtt_transport_t tp;
+
+    bool connected;
+    bool session_present;
+    uint8_t connack_code;
+
+    uint16_t next_packet_id;
+    uint16_t pending_suback_id;  // SUBSCRIBE awaiting SUBACK (0 = none).
+    uint8_t suback_code;
+
+    mqtt_inflight_t window[MQTT_INFLIGHT_MAX];
+    uint8_t inflight;            // Slots not FREE.
+
+    uint8_t tx_batch[MQTT_TX_BATCH_BYTES];
+    size_t tx_len;
+
+    // Incremental RX parser.
+    uint8_t rx_state;
+    uint8_t rx_header;
+    uint32_t rx_remaining;
+    uint8_t rx_len_shift;
+    uint32_t rx_pos;
+    uint8_t rx_buf[MQTT_PACKET_MAX];
+
+    int64_t last_tx_us;
+    int64_t ping_sent_us;        // Unanswered PINGREQ (0 = none).
+    mqtt_stats_t stats;
+} mqtt_client_t;
+
+// --- Public functions ---------------------------------------
+
+// Prepares a client. Does not touch the transport.
+void mqtt_client_init(mqtt_client_t *c, const mqtt_config_t *cfg,
+                      const mqtt_transport_t *tp);
+
+// Sends CONNECT and waits for CONNACK. On success, resends every
+// publish still in the in-flight window (DUP = 1 only if the
+// session is present).
+// Returns ESP_OK, ESP_ERR_TIMEOUT, or ESP_FAIL if the broker refused.
+esp_err_t mqtt_connect(mqtt_client_t *c, uint32_t timeout_ms);
+
+// True if the broker resumed an existing session on the last connect,
+// i.e. earlier subscriptions are still active.
+bool mqtt_session_present(const mqtt_client_t *c);
+
+// Subscribes to one topic filter and waits for the SUBACK.
+esp_err_t mqtt_subscribe(mqtt_client_t *c, const char *topic, uint8_t qos,
+                         uint32_t timeout_ms);
+
+// Queues a PUBLISH. QoS 0 packets go to the TX batch only; QoS 1
+// packets also take a window slot until their PUBACK arrives.
+// Blocks (polling the transport) only when the window is full.
+// Returns ESP_OK, ESP_ERR_INVALID_SIZE (packet > MQTT_PACKET_MAX),
+// ESP_ERR_TIMEOUT (window stayed full) or ESP_ERR_INVALID_STATE.
+esp_err_t mqtt_publish(mqtt_client_t *c, const char *topic,
+                       const uint8_t *payload, size_t len, uint8_t qos,
+                       bool retain, uint32_t timeout_ms);
+
+// Writes the pending TX batch to the transport in one call.
+esp_err_t mqtt_flush(mqtt_client_t *c);
+
+// Flushes, then processes incoming packets for up to timeout_ms.
+// Sends PINGREQ when the link has been idle for keepalive_s. With
+// no PINGRESP 1.5 x keepalive_s after it, the broker or the link
+// is gone: marks the client disconnected, returns ESP_ERR_TIMEOUT.
+esp_err_t mqtt_poll(mqtt_client_t *c, uint32_t timeout_ms);
+
+// Flushes and polls until every QoS1 publish is acknowledged.
+esp_err_t mqtt_wait_idle(mqtt_client_t *c, uint32_t timeout_ms);
+
+// Number of QoS1 publishes still awaiting PUBACK.
+uint8_t mqtt_inflight_count(const mqtt_client_t *c);
+
+// Sends DISCONNECT. In-flight slots are kept for the next connect.
+void mqtt_disconnect(mqtt_client_t *c);
@@ -0,0 +1,388 @@
+// ============================================================
+// nmea.c
+//
+// Byte-at-a-time NMEA framing, checksum and field decoding.
+// See nmea.h.
+// ============================================================
+
+#include "nmea.h"
+
+// string.h: memcmp() / memset() for sentence types and results.
+#include <string.h>
+
+// Parser states.
+enum {
+    ST_IDLE,                  // Waiting for '$'.
+    ST_BODY,                  // Between '$' and '*'.
+    ST_SUM_HI,                // First checksum digit.
+    ST_SUM_LO,                // Second checksum digit.
+    ST_END                    // Checksum read, waiting for CR / LF.
+};
+
+static int hex_digit(uint8_t c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+// ============================================================
+// Field conversions
+//
+// All take one NUL-terminated field and return false when it is
+// empty or malformed.
+// ============================================================
+
+// Unsigned integer.
+static bool dec_uint(const char *s, uint32_t *out) {
+    if (*s == '\0') {
+        return false;
+    }
+    uint32_t v = 0;
+    for (; *s; s++) {
+        if (*s < '0' || *s > '9') {
+            return false;
+        }
+        v = v * 10 + (uint32_t)(*s - '0');
+    }
+    *out = v;
+    return true;
+}
+
+// Digits dec_fixed() accepts, scaling included: keeps the value
+// and the products the decoders form from it (speed x 1852)
+// well inside int64_t.
+#define DEC_FIXED_DIGITS_MAX 15
+
+// Decimal "[-]123.4567" as an integer scaled by 10^frac; further
+// fractional digits are truncated. More than DEC_FIXED_DIGITS_MAX
+// digits is malformed.
+static bool dec_fixed(const char *s, int frac, int64_t *out) {
+    bool neg = *s == '-';
+    s += neg;
+    if (*s == '\0') {
+        return false;
+    }
+    int64_t v = 0;
+    int digits = frac;
+    for (; *s && *s != '.'; s++) {
+        if (*s < '0' || *s > '9' || ++digits > DEC_FIXED_DIGITS_MAX) {
+            return false;
+        }
+        v = v * 10 + (*s - '0');
+    }
+    if (*s == '.') {
+        s++;
+    }
+    for (int i = 0; i < frac; i++) {
+        int d = 0;
+        if (*s) {
+            if (*s < '0' || *s > '9') {
+                return false;
+            }
+            d = *s++ - '0';
+        }
+        v = v * 10 + d;
+    }
+    *out = neg ? -v : v;
+    return true;
+}
+
+// hhmmss[.sss]
+static bool dec_time(const char *s, nmea_time_t *t) {
+    int64_t v;
+    if (strlen(s) < 6 || !dec_fixed(s, 3, &v) || v < 0) {
+        return false;
+    }
+    t->millis = (uint16_t)(v % 1000);
+    v /= 1000;
+    t->second = (uint8_t)(v % 100);
+    t->minute = (uint8_t)(v / 100 % 100);
+    t->hour = (uint8_t)(v / 10000);
+    return t->hour < 24 && t->minute < 60 && t->second < 61;
+}
+
+// ddmmyy
+static bool dec_date(const char *s, nmea_date_t *d) {
+    uint32_t v;
+    if (strlen(s) != 6 || !dec_uint(s, &v)) {
+        return false;
+    }
+    uint32_t yy = v % 100;
+    d->year = (uint16_t)(yy < 80 ? 2000 + yy : 1900 + yy);
+    d->month = (uint8_t)(v / 100 % 100);
+    d->day = (uint8_t)(v / 10000);
+    return d->month >= 1 && d->month <= 12 && d->day >= 1 && d->day <= 31;
+}
+
+// (d)ddmm.mmmm + hemisphere to degrees x 1e7. Minutes are taken
+// to 1e-7 and divided by 60 with rounding.
+static bool dec_coord(const char *v, const char *hemi, int32_t *out) {
+    int64_t x;
+    if (!dec_fixed(v, 7, &x) || x < 0) {
+        return false;
+    }
+    int64_t deg = x / 1000000000;            // 100 minutes x 1e7.
+    int64_t min_e7 = x % 1000000000;
+    if (min_e7 >= 600000000 || deg > 180) {
+        return false;                         // 60 minutes or more.
+    }
+    int64_t e7 = deg * 10000000 + (min_e7 + 30) / 60;
+    if (hemi[0] == 'S' || hemi[0] == 'W') {
+        e7 = -e7;
+    } else if (hemi[0] != 'N' && hemi[0] != 'E') {
+        return false;
+    }
+    *out = (int32_t)e7;
+    return true;
+}
+
+// ============================================================
+// Sentence decoders
+//
+// f[0] is the address ("GPGGA"); f[1..] the data fields. Empty
+// fields (no fix yet) leave their value at zero; a malformed
+// field rejects the sentence.
+// ============================================================
+static bool decode_gga(const char *const *f, int nf, nmea_gga_t *g) {
+    if (nf < 15) {
+        return false;
+    }
+    uint32_t u;
+    int64_t v;
+    if (f[1][0] && !dec_time(f[1], &g->time)) {
+        return false;
+    }
+    if (f[2][0] && !dec_coord(f[2], f[3], &g->lat_e7)) {
+        return false;
+    }
+    if (f[4][0] && !dec_coord(f[4], f[5], &g->lon_e7)) {
+        return false;
+    }
+    if (dec_uint(f[6], &u)) {
+        g->quality = (uint8_t)u;
+    }
+    if (dec_uint(f[7], &u)) {
+        g->satellites = (uint8_t)u;
+    }
+    if (f[8][0]) {
+        if (!dec_fixed(f[8], 2, &v) || v < 0) {
+            return false;
+        }
+        g->hdop_x100 = (uint16_t)(v > UINT16_MAX ? UINT16_MAX : v);
+    }
+    if (f[9][0]) {
+        if (!dec_fixed(f[9], 3, &v) || v < INT32_MIN || v > INT32_MAX) {
+            return false;
+        }
+        g->alt_mm = (int32_t)v;
+    }
+    if (f[11][0]) {
+        if (!dec_fixed(f[11], 3, &v) || v < INT32_MIN || v > INT32_MAX) {
+            return false;
+        }
+        g->geoid_mm = (int32_t)v;
+    }
+    return true;
+}
+
+static bool decode_rmc(const char *const *f, int nf, nmea_rmc_t *r) {
+    if (nf < 10) {
+        return false;
+    }
+    int64_t v;
+    if (f[1][0] && !dec_time(f[1], &r->time)) {
+        return false;
+    }
+    r->active = f[2][0] == 'A';
+    if (f[3][0] && !dec_coord(f[3], f[4], &r->lat_e7)) {
+        return false;
+    }
+    if (f[5][0] && !dec_coord(f[5], f[6], &r->lon_e7)) {
+        return false;
+    }
+    if (f[7][0]) {
+        if (!dec_fixed(f[7], 3, &v) || v < 0) {
+            return false;
+        }
+        // Knots x 1000 to mm/s: 1 kn = 1852 m/h.
+        v = (v * 1852 + 1800) / 3600;
+        r->speed_mmps = (uint32_t)(v > UINT32_MAX ? UINT32_MAX : v);
+    }
+    if (f[8][0]) {
+        if (!dec_fixed(f[8], 2, &v) || v < 0) {
+            return false;
+        }
+        r->course_cdeg = (uint16_t)(v % 36000);
+    }
+    if (f[9][0] && !dec_date(f[9], &r->date)) {
+        return false;
+    }
+    return true;
+}
+
+static bool decode_gsv(const char *const *f, int nf, nmea_gsv_t *g) {
+    uint32_t count, num, in_view;
+    if (nf < 4 || !dec_uint(f[1], &count) || !dec_uint(f[2], &num) ||
+        !dec_uint(f[3], &in_view) || num == 0 || num > count) {
+        return false;
+    }
+    g->msg_count = (uint8_t)count;
+    g->msg_num = (uint8_t)num;
+    g->in_view = (uint8_t)in_view;
+
+    // Groups of four; NMEA 4.10 appends a lone signal id.
+    for (int i = 4; i + 3 < nf && g->count < NMEA_GSV_SATS; i += 4) {
+        uint32_t prn, u;
+        if (!dec_uint(f[i], &prn)) {
+            continue;
+        }
+        nmea_sat_t *s = &g->sats[g->count++];
+        s->prn = (uint8_t)prn;
+        s->elevation = dec_uint(f[i + 1], &u) ? (int8_t)u : -1;
+        s->azimuth = dec_uint(f[i + 2], &u) ? (int16_t)u : -1;
+        s->snr = dec_uint(f[i + 3], &u) ? (int8_t)u : -1;
+    }
+    return true;
+}
+
+// ============================================================
+// dispatch()
+//
+// Splits the checked body at the commas in place and decodes it.
+// ============================================================
+static void dispatch(nmea_parser_t *p) {
+    const char *f[NMEA_FIELDS_MAX];
+    int nf = 0;
+    char *s = p->buf;
+    f[nf++] = s;
+    for (; *s; s++) {
+        if (*s == ',') {
+            *s = '\0';
+            if (nf == NMEA_FIELDS_MAX) {
+                break;  // Ignore trailing extras.
+            }
+            f[nf++] = s + 1;
+        }
+    }
+
+    // Address: 2-character talker + 3-character type ("GPGGA").
+    // Proprietary sentences ("PMTK...") have no talker.
+    if (strlen(f[0]) != 5 || f[0][0] == 'P') {
+        p->stats.unsupported++;
+        return;
+    }
+
+    nmea_sentence_t out;
+    memset(&out, 0, sizeof(out));
+    out.talker[0] = f[0][0];
+    out.talker[1] = f[0][1];
+    const char *type = f[0] + 2;
+    bool ok;
+    if (memcmp(type, "GGA", 3) == 0) {
+        out.type = NMEA_GGA;
+        ok = decode_gga(f, nf, &out.gga);
+    } else if (memcmp(type, "RMC", 3) == 0) {
+        out.type = NMEA_RMC;
+        ok = decode_rmc(f, nf, &out.rmc);
+    } else if (memcmp(type, "GSV", 3) == 0) {
+        out.type = NMEA_GSV;
+        ok = decode_gsv(f, nf, &out.gsv);
+    } else {
+        p->stats.unsupported++;
+        return;
+    }
+
+    if (!ok) {
+        p->stats.decode_errors++;
+        return;
+    }
+    p->stats.sentences++;
+    if (p->fn) {
+        p->fn(&out, p->user);
+    }
+}
+
+// ============================================================
+// nmea_init() / nmea_feed()
+// ============================================================
+void nmea_init(nmea_parser_t *p, nmea_fn fn, void *user) {
+    memset(p, 0, sizeof(*p));
+    p->fn = fn;
+    p->user = user;
+}
+
+void nmea_feed(nmea_parser_t *p, const uint8_t *data, size_t len) {
+    p->stats.bytes += (uint32_t)len;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = data[i];
+
+        // '$' always starts over: resync after noise or a cut line.
+        if (c == '$') {
+            if (p->state != ST_IDLE) {
+                p->stats.overflows++;
+            }
+            p->state = ST_BODY;
+            p->len = 0;
+            p->sum = 0;
+            continue;
+        }
+
+        switch (p->state) {
+            case ST_IDLE:
+                break;
+
+            case ST_BODY:
+                if (c == '*') {
+                    p->buf[p->len] = '\0';
+                    p->state = ST_SUM_HI;
+                } else if (c == '\r' || c == '\n') {
+                    p->stats.checksum_errors++;  // No checksum.
+                    p->state = ST_IDLE;
+                } else if (p->len == NMEA_SENTENCE_MAX) {
+                    p->stats.overflows++;
+                    p->state = ST_IDLE;
+                } else {
+                    p->buf[p->len++] = (char)c;
+                    p->sum ^= c;
+                }
+                break;
+
+            case ST_SUM_HI:
+            case ST_SUM_LO: {
+                int d = hex_digit(c);
+                if (d < 0) {
+                    p->stats.checksum_errors++;
+                    p->state = ST_IDLE;
+                } else if (p->state == ST_SUM_HI) {
+                    p->rx_sum = (uint8_t)(d << 4);
+                    p->state = ST_SUM_LO;
+                } else {
+                    p->rx_sum |= (uint8_t)d;
+                    p->state = ST_END;
+                }
+                break;
+            }
+
+            case ST_END:
+                if (c == '\r' || c == '\n') {
+                    p->state = ST_IDLE;
+                    if (p->rx_sum != p->sum) {
+                        p->stats.checksum_errors++;
+                    } else {
+                        dispatch(p);
+                    }
+                } else {
+                    p->stats.checksum_errors++;  // Junk after the checksum.
+                    p->state = ST_IDLE;
+                }
+                break;
+        }
+    }
+}
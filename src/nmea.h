@@ -0,0 +1,141 @@
+#pragma once
+
+// ============================================================
+// nmea.h
+//
+// Incremental NMEA 0183 parser.
+//
+// Bytes go in as they come off the UART (any chunking, down to
+// one byte at a time); complete sentences come out through a
+// callback, already decoded into typed structs:
+//   GGA  fix: time, position, quality, satellites, HDOP, altitude
+//   RMC  time, date, position, speed, course, status
+//   GSV  satellites in view (one message of a series)
+// Other sentence types are counted and dropped.
+//
+// The checksum is XORed up as bytes arrive and checked at the
+// '*'; a sentence that fails, overflows NMEA_SENTENCE_MAX or is
+// interrupted by a new '$' is dropped, and the parser resyncs on
+// the next '$'.
+//
+// Decoding splits the fields in place in the parser's sentence
+// buffer and converts them with integer fixed-point arithmetic
+// (no strtod, no float):
+//   latitude / longitude   degrees x 1e7
+//   altitude, geoid        millimetres
+//   speed                  millimetres per second
+//   course                 centidegrees
+//   HDOP                   x 100
+// ============================================================
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Longest sentence body kept, "$" to "*" exclusive. NMEA 0183
+// allows 79; receivers with extra fields go a little beyond.
+#define NMEA_SENTENCE_MAX 96
+
+// Fields split per sentence (GSV: 4 + 4 x 4 + signal id).
+#define NMEA_FIELDS_MAX 24
+
+// Satellites per GSV message.
+#define NMEA_GSV_SATS 4
+
+typedef enum {
+    NMEA_GGA,
+    NMEA_RMC,
+    NMEA_GSV
+} nmea_type_t;
+
+typedef struct {
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+    uint16_t millis;
+} nmea_time_t;
+
+typedef struct {
+    uint8_t day;
+    uint8_t month;
+    uint16_t year;            // Four digits (00-79 -> 20xx).
+} nmea_date_t;
+
+typedef struct {
+    nmea_time_t time;
+    int32_t lat_e7;           // South negative.
+    int32_t lon_e7;           // West negative.
+    uint8_t quality;          // 0 no fix, 1 GPS, 2 DGPS, 4 RTK, 5 float RTK, 6 dead reckoning.
+    uint8_t satellites;       // Used in the fix.
+    uint16_t hdop_x100;
+    int32_t alt_mm;           // Above mean sea level.
+    int32_t geoid_mm;         // Geoid separation.
+} nmea_gga_t;
+
+typedef struct {
+    nmea_time_t time;
+    nmea_date_t date;
+    bool active;              // Status 'A' (valid), not 'V'.
+    int32_t lat_e7;
+    int32_t lon_e7;
+    uint32_t speed_mmps;
+    uint16_t course_cdeg;
+} nmea_rmc_t;
+
+typedef struct {
+    uint8_t prn;
+    int8_t elevation;         // Degrees, -1 if not given.
+    int16_t azimuth;          // Degrees, -1 if not given.
+    int8_t snr;               // dB-Hz, -1 when not tracked.
+} nmea_sat_t;
+
+typedef struct {
+    uint8_t msg_count;        // Messages in the series.
+    uint8_t msg_num;          // This message, 1-based.
+    uint8_t in_view;          // Satellites in view (whole series).
+    uint8_t count;            // Entries in sats[].
+    nmea_sat_t sats[NMEA_GSV_SATS];
+} nmea_gsv_t;
+
+typedef struct {
+    uint8_t type;             // nmea_type_t
+    char talker[3];           // "GP", "GL", "GA", "GB", "GN", ...
+    union {
+        nmea_gga_t gga;
+        nmea_rmc_t rmc;
+        nmea_gsv_t gsv;
+    };
+} nmea_sentence_t;
+
+// Called for every valid, decoded sentence; s is only valid
+// during the call.
+typedef void (*nmea_fn)(const nmea_sentence_t *s, void *user);
+
+// --- Counters ---
+typedef struct {
+    uint32_t bytes;
+    uint32_t sentences;       // Decoded and delivered.
+    uint32_t checksum_errors; // Wrong or missing checksum.
+    uint32_t overflows;       // Longer than NMEA_SENTENCE_MAX, or cut by '$'.
+    uint32_t unsupported;     // Valid but not GGA / RMC / GSV.
+    uint32_t decode_errors;   // Valid checksum, malformed fields.
+} nmea_stats_t;
+
+typedef struct {
+    uint8_t state;
+    uint8_t len;
+    uint8_t sum;              // XOR of the body so far.
+    uint8_t rx_sum;           // Checksum digits received.
+    char buf[NMEA_SENTENCE_MAX + 1];
+    nmea_fn fn;
+    void *user;
+    nmea_stats_t stats;
+} nmea_parser_t;
+
+// --- Public functions ---------------------------------------
+
+void nmea_init(nmea_parser_t *p, nmea_fn fn, void *user);
+
+// Feeds received bytes. Calls fn for each sentence completed by
+// them; partial sentences carry over to the next call.
+void nmea_feed(nmea_parser_t *p, const uint8_t *data, size_t len);
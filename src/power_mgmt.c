@@ -0,0 +1,193 @@
+// ============================================================
+// power_mgmt.c
+//
+// esp_pm configuration and per-domain PM locks.
+// See power_mgmt.h.
+// ============================================================
+
+#include "power_mgmt.h"
+
+#if FEATURE_POWER_MGMT
+
+// stdio.h: printf() for console logging to UART0.
+#include <stdio.h>
+
+// sdkconfig.h: check that power management is compiled in.
+#include "sdkconfig.h"
+
+// FreeRTOS: spinlock for the hold-time bookkeeping.
+#include "freertos/FreeRTOS.h"
+
+// ESP-IDF power management + UART wake-up.
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "driver/uart.h"
+
+// esp_timer.h: hold-time accounting.
+#include "esp_timer.h"
+
+#if !defined(CONFIG_PM_ENABLE)
+#error "FEATURE_POWER_MGMT needs CONFIG_PM_ENABLE in sdkconfig."
+#endif
+#if POWER_LIGHT_SLEEP && !defined(CONFIG_FREERTOS_USE_TICKLESS_IDLE)
+#error "POWER_LIGHT_SLEEP needs CONFIG_FREERTOS_USE_TICKLESS_IDLE in sdkconfig."
+#endif
+
+static const char *TAG = "power";
+
+// UART RX edges (about 3 characters) that wake from light sleep.
+#define UART_WAKE_THRESHOLD 3
+
+static const struct {
+    const char *name;
+    esp_pm_lock_type_t type;
+} s_domain_cfg[POWER_DOMAIN_COUNT] = {
+    [POWER_UART] = {"uart", ESP_PM_NO_LIGHT_SLEEP},
+    [POWER_PARSE] = {"parse", ESP_PM_CPU_FREQ_MAX},
+    [POWER_CRYPTO] = {"crypto", ESP_PM_CPU_FREQ_MAX},
+};
+
+typedef struct {
+    esp_pm_lock_handle_t lock;
+    uint32_t depth;           // Nesting across tasks.
+    int64_t since_us;         // When depth went 0 -> 1.
+    power_domain_stats_t stats;
+} domain_t;
+
+static domain_t s_domains[POWER_DOMAIN_COUNT];
+static esp_pm_lock_handle_t s_perf_cpu;
+static esp_pm_lock_handle_t s_perf_awake;
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// ============================================================
+// power_init()
+//
+// Steps:
+//   1. DFS between POWER_CPU_MIN_MHZ and POWER_CPU_MAX_MHZ, light
+//      sleep when idle (POWER_LIGHT_SLEEP).
+//   2. One esp_pm lock per domain, plus the performance pair.
+//   3. UART1 wake-up so modem traffic outside an exchange (URCs)
+//      brings the chip out of light sleep.
+// ============================================================
+esp_err_t power_init(void) {
+    // --- Step 1: DFS + light sleep ---
+    esp_pm_config_t pm = {
+        .max_freq_mhz = POWER_CPU_MAX_MHZ,
+        .min_freq_mhz = POWER_CPU_MIN_MHZ,
+        .light_sleep_enable = POWER_LIGHT_SLEEP,
+    };
+    esp_err_t err = esp_pm_configure(&pm);
+    if (err != ESP_OK) {
+        printf("[%s] esp_pm_configure failed: %s\n", TAG, esp_err_to_name(err));
+        return err;
+    }
+
+    // --- Step 2: Locks ---
+    for (int i = 0; i < POWER_DOMAIN_COUNT; i++) {
+        err = esp_pm_lock_create(s_domain_cfg[i].type, 0, s_domain_cfg[i].name,
+                                 &s_domains[i].lock);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    err = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "perf_cpu", &s_perf_cpu);
+    if (err == ESP_OK) {
+        err = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "perf_awake", &s_perf_awake);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // --- Step 3: Wake on modem traffic ---
+#if POWER_LIGHT_SLEEP
+    uart_set_wakeup_threshold(UART_MODEM_NUM, UART_WAKE_THRESHOLD);
+    esp_sleep_enable_uart_wakeup(UART_MODEM_NUM);
+#endif
+
+    printf("[%s] DFS %d-%d MHz, light sleep %s\n", TAG, POWER_CPU_MIN_MHZ,
+           POWER_CPU_MAX_MHZ, POWER_LIGHT_SLEEP ? "on" : "off");
+    return ESP_OK;
+}
+
+// ============================================================
+// power_lock() / power_unlock()
+//
+// The esp_pm lock is counting on its own; the depth counter here
+// only exists to time how long each domain was held.
+// ============================================================
+void power_lock(power_domain_t d) {
+    domain_t *dom = &s_domains[d];
+    if (!dom->lock) {
+        return;  // power_init() not run (or failed): nothing to hold.
+    }
+    esp_pm_lock_acquire(dom->lock);
+    portENTER_CRITICAL(&s_mux);
+    if (dom->depth++ == 0) {
+        dom->since_us = esp_timer_get_time();
+    }
+    dom->stats.acquires++;
+    portEXIT_CRITICAL(&s_mux);
+}
+
+void power_unlock(power_domain_t d) {
+    domain_t *dom = &s_domains[d];
+    if (!dom->lock) {
+        return;
+    }
+    portENTER_CRITICAL(&s_mux);
+    if (dom->depth > 0 && --dom->depth == 0) {
+        dom->stats.held_us += (uint64_t)(esp_timer_get_time() - dom->since_us);
+    }
+    portEXIT_CRITICAL(&s_mux);
+    esp_pm_lock_release(dom->lock);
+}
+
+void power_set_performance(bool on) {
+    if (!s_perf_cpu) {
+        return;
+    }
+    if (on) {
+        esp_pm_lock_acquire(s_perf_cpu);
+        esp_pm_lock_acquire(s_perf_awake);
+    } else {
+        esp_pm_lock_release(s_perf_awake);
+        esp_pm_lock_release(s_perf_cpu);
+    }
+}
+
+power_domain_stats_t power_domain_stats(power_domain_t d) {
+    domain_t *dom = &s_domains[d];
+    portENTER_CRITICAL(&s_mux);
+    power_domain_stats_t st = dom->stats;
+    if (dom->depth > 0) {
+        st.held_us += (uint64_t)(esp_timer_get_time() - dom->since_us);
+    }
+    portEXIT_CRITICAL(&s_mux);
+    return st;
+}
+
+// ============================================================
+// power_estimate_uj()
+//
+// Energy = V * sum(I * t) over three states:
+//   cpu_max_us            at POWER_UA_CPU_MAX
+//   awake_us - cpu_max_us at POWER_UA_CPU_MIN (awake, slow clock)
+//   the rest              at POWER_UA_LIGHT_SLEEP
+// A model, not a measurement: use a current probe for real
+// numbers; this is for comparing configurations.
+// ============================================================
+uint32_t power_estimate_uj(uint64_t total_us, uint64_t cpu_max_us, uint64_t awake_us) {
+    if (awake_us < cpu_max_us) {
+        awake_us = cpu_max_us;
+    }
+    if (total_us < awake_us) {
+        total_us = awake_us;
+    }
+    uint64_t ua_us = cpu_max_us * POWER_UA_CPU_MAX +
+                     (awake_us - cpu_max_us) * POWER_UA_CPU_MIN +
+                     (total_us - awake_us) * POWER_UA_LIGHT_SLEEP;
+    // uA * us * mV = 1e-15 J -> uJ: / 1e9.
+    return (uint32_t)(ua_us * POWER_SUPPLY_MV / 1000000000ULL);
+}
+
+#endif  // FEATURE_POWER_MGMT
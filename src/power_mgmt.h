@@ -0,0 +1,87 @@
+#pragma once
+
+// ============================================================
+// power_mgmt.h
+//
+// Dynamic frequency scaling + automatic light sleep with
+// activity-scoped PM locks (FEATURE_POWER_MGMT).
+//
+// Idle, the CPU drops to POWER_CPU_MIN_MHZ and FreeRTOS tickless
+// idle puts the chip into light sleep. Code that must not be
+// slowed down or put to sleep brackets the work with
+// power_lock() / power_unlock() on one of three domains:
+//
+//   POWER_UART   — a modem exchange is in flight (AT command up
+//                  to its final result, datagram send/receive,
+//                  data-mode read/write). No light sleep; the CPU
+//                  may still run slow. UART1/UART2 are clocked
+//                  from XTAL, so the baud rate is unaffected by
+//                  frequency changes.
+//   POWER_PARSE  — protocol parsing (MQTT / CoAP). CPU at max.
+//   POWER_CRYPTO — TLS/DTLS record and handshake work. CPU at max.
+//
+// Locks nest and may be taken from any task (not from ISRs).
+// Waking through the UART loses the first character(s), so
+// exchanges always hold POWER_UART, and so does modem.c while
+// any URC line observer is registered (modem_reg, SMS, GNSS,
+// sockets): a cut URC would confuse their state machines.
+// The trade-off: light sleep only happens while nothing is
+// listening for URCs. A device that keeps modem_reg running
+// saves power through DFS and deep sleep (FEATURE_DEEP_SLEEP),
+// not light sleep.
+//
+// With FEATURE_POWER_MGMT 0 the lock calls compile to nothing.
+// ============================================================
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "app_config.h"
+
+typedef enum {
+    POWER_UART,
+    POWER_PARSE,
+    POWER_CRYPTO,
+    POWER_DOMAIN_COUNT
+} power_domain_t;
+
+// --- Counters -----------------------------------------------
+typedef struct {
+    uint32_t acquires;
+    uint64_t held_us;         // Wall time with the domain held.
+} power_domain_stats_t;
+
+#if FEATURE_POWER_MGMT
+
+// Configures DFS / light sleep (esp_pm_configure) and creates the
+// domain locks. Call once, early in app_main().
+esp_err_t power_init(void);
+
+void power_lock(power_domain_t d);
+void power_unlock(power_domain_t d);
+
+// Holds max CPU frequency and blocks light sleep everywhere —
+// the same as running without power management. For A/B runs.
+void power_set_performance(bool on);
+
+// Snapshot of one domain (held_us includes a hold in progress).
+power_domain_stats_t power_domain_stats(power_domain_t d);
+
+// Estimated charge for an interval, from how long the CPU-max
+// and UART domains were held and the POWER_UA_* current model.
+// Time with no lock held is counted as light sleep.
+uint32_t power_estimate_uj(uint64_t total_us, uint64_t cpu_max_us, uint64_t awake_us);
+
+#else
+
+static inline void power_lock(power_domain_t d) {
+    (void)d;
+}
+
+static inline void power_unlock(power_domain_t d) {
+    (void)d;
+}
+
+#endif  // FEATURE_POWER_MGMT
@@ -0,0 +1,535 @@
+// ============================================================
+// sd_logger.c
+//
+// Append-only, double/triple-buffered SD card logger.
+// See sd_logger.h for the on-card format.
+//
+// Threads:
+//   - Callers of sd_log_write() (any task): copy into the
+//     current buffer under a short mutex, seal it when full.
+//   - sd_log task: writes sealed buffers to the card, fills the
+//     segment index, and seals a partial buffer after
+//     SD_LOG_FLUSH_MS of inactivity so data never sits in RAM
+//     for long.
+//
+// Buffers move between two queues of buffer indices:
+//   free_q -> (current, filled by callers) -> full_q -> sd_log task -> free_q
+// ============================================================
+
+#include "sd_logger.h"
+
+#if FEATURE_SD_LOGGING
+
+// stdio.h: printf() for console logging to UART0.
+#include <stdio.h>
+
+// string.h: memcpy(), memset() for records and headers.
+#include <string.h>
+
+// FreeRTOS: writer task, buffer queues, caller mutex.
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+// ESP-IDF SPI + SD (raw sector access, no FATFS).
+#include "driver/spi_common.h"
+#include "driver/sdspi_host.h"
+#include "sdmmc_cmd.h"
+
+// Shared SPI bus: every card access is an arbiter job.
+#include "spi_arbiter.h"
+
+// esp_heap_caps.h: DMA-capable buffer allocation.
+#include "esp_heap_caps.h"
+
+// esp_rom_crc.h: esp_rom_crc32_le() for header/index CRCs.
+#include "esp_rom_crc.h"
+
+// esp_timer.h: write latency and idle-flush timing.
+#include "esp_timer.h"
+
+static const char *TAG = "sd_log";
+
+// SPI peripheral the card sits on (bus pins come from the board).
+#define SD_LOG_SPI_HOST SPI2_HOST   // Must match the SPI arbiter's bus
+
+#define BLOCK_SECTORS (SD_LOG_BUF_BYTES / SD_LOG_SECTOR_BYTES)
+#define SEGMENT_SECTORS (BLOCK_SECTORS * SD_LOG_BLOCKS_PER_INDEX + 1)
+#define SEQ_NONE 0xFFFFFFFFu
+#define NO_BUF 0xFF
+
+_Static_assert(SD_LOG_BUF_BYTES % SD_LOG_SECTOR_BYTES == 0,
+               "SD_LOG_BUF_BYTES must be a multiple of the sector size");
+_Static_assert(sizeof(sd_log_index_t) <= SD_LOG_SECTOR_BYTES,
+               "SD_LOG_BLOCKS_PER_INDEX too large for one index sector");
+_Static_assert(SD_LOG_BUF_COUNT >= 2 && SD_LOG_BUF_COUNT < NO_BUF,
+               "SD_LOG_BUF_COUNT must be at least 2 (double buffering)");
+
+// --- Per-buffer bookkeeping ---------------------------------
+typedef struct {
+    uint8_t *data;      // DMA-capable, SD_LOG_BUF_BYTES.
+    uint16_t used;      // Bytes after the block header.
+    uint16_t records;
+    uint32_t seq;       // Assigned when sealed.
+    uint32_t first_ms;
+    uint32_t last_ms;
+} log_buf_t;
+
+static sdmmc_card_t s_card;
+static int s_spi_dev = -1;          // Arbiter device id.
+static log_buf_t s_buf[SD_LOG_BUF_COUNT];
+static uint8_t *s_index;            // One DMA-capable sector.
+static QueueHandle_t s_free_q;
+static QueueHandle_t s_full_q;
+static SemaphoreHandle_t s_lock;    // Guards s_cur and s_next_seq.
+
+static uint8_t s_cur = NO_BUF;      // Buffer callers are filling.
+static int64_t s_cur_open_us;       // When its first record arrived.
+static uint32_t s_next_seq;         // Sequence number of the next block.
+static uint32_t s_segments;         // Segments that fit on the card.
+static sd_log_stats_t s_stats;
+
+// ============================================================
+// block_sector()
+//
+// Maps a block sequence number to its first sector.
+// Sequence numbers wrap around the log region.
+// ============================================================
+static uint32_t block_sector(uint32_t seq) {
+    uint32_t seg = (seq / SD_LOG_BLOCKS_PER_INDEX) % s_segments;
+    uint32_t blk = seq % SD_LOG_BLOCKS_PER_INDEX;
+    return SD_LOG_START_SECTOR + seg * SEGMENT_SECTORS + blk * BLOCK_SECTORS;
+}
+
+// ============================================================
+// card_io()
+//
+// Runs one sector read/write on the card as an SPI arbiter job
+// and waits for it (writer task / init only).
+//
+// Outputs:
+//   *exec_us (optional): time on the bus, excluding queueing.
+// ============================================================
+typedef struct {
+    bool write;
+    void *buf;
+    uint32_t sector;
+    uint32_t count;
+} card_io_t;
+
+static esp_err_t card_io_job(void *ctx) {
+    card_io_t *io = (card_io_t *)ctx;
+    if (io->write) {
+        return sdmmc_write_sectors(&s_card, io->buf, io->sector, io->count);
+    }
+    return sdmmc_read_sectors(&s_card, io->buf, io->sector, io->count);
+}
+
+static esp_err_t card_io(bool write, void *buf, uint32_t sector, uint32_t count,
+                         uint32_t *exec_us) {
+    card_io_t io = {write, buf, sector, count};
+    spi_arb_req_t req;
+    spi_arb_req_job(&req, s_spi_dev, card_io_job, &io,
+                    esp_timer_get_time() + (int64_t)SPI_ARB_SD_DEADLINE_MS * 1000);
+    esp_err_t err = spi_arb_run(&req);
+    if (exec_us) {
+        *exec_us = (uint32_t)(req.t_done_us - req.t_start_us);
+    }
+    return err;
+}
+
+// ============================================================
+// read_segment_seq()
+//
+// Reads the header of block 0 in segment seg.
+//
+// Returns:
+//   true and *seq if the header is a valid log block.
+// ============================================================
+static bool read_segment_seq(uint32_t seg, uint8_t *scratch, uint32_t *seq) {
+    uint32_t sector = SD_LOG_START_SECTOR + seg * SEGMENT_SECTORS;
+    if (card_io(false, scratch, sector, 1, NULL) != ESP_OK) {
+        return false;
+    }
+    sd_log_block_hdr_t hdr;
+    memcpy(&hdr, scratch, sizeof(hdr));
+    if (hdr.magic != SD_LOG_BLOCK_MAGIC) {
+        return false;
+    }
+    if (esp_rom_crc32_le(0, scratch, offsetof(sd_log_block_hdr_t, crc)) != hdr.crc) {
+        return false;
+    }
+    *seq = hdr.seq;
+    return true;
+}
+
+// ============================================================
+// find_log_end()
+//
+// Finds where to continue an existing log after a reset.
+//
+// Steps:
+//   1. If segment 0 has no valid header, start a fresh log.
+//   2. Otherwise the newest run of segments starts at 0 and has
+//      seq(i) == seq(0) + i * SD_LOG_BLOCKS_PER_INDEX. That
+//      predicate is true up to the last written segment and
+//      false after it (unwritten or older lap), so binary
+//      search finds the end with O(log n) sector reads.
+//   3. Resume at the start of the next segment. The unused
+//      slots of the last segment are skipped, which keeps the
+//      predicate valid for the next boot.
+// ============================================================
+static uint32_t find_log_end(uint8_t *scratch) {
+    uint32_t seq0;
+    if (!read_segment_seq(0, scratch, &seq0)) {
+        printf("[%s] no existing log, starting fresh\n", TAG);
+        return 0;
+    }
+
+    uint32_t lo = 0;              // Predicate true.
+    uint32_t hi = s_segments;     // Predicate false (virtual).
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        uint32_t seq;
+        if (read_segment_seq(mid, scratch, &seq) &&
+            seq == seq0 + mid * SD_LOG_BLOCKS_PER_INDEX) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    uint32_t next = seq0 + (lo + 1) * SD_LOG_BLOCKS_PER_INDEX;
+    printf("[%s] resuming log after segment %lu, next seq %lu\n", TAG,
+           (unsigned long)lo, (unsigned long)next);
+    return next;
+}
+
+// ============================================================
+// open_next_buffer()
+//
+// Takes a free buffer for callers to fill, without waiting.
+// Caller must hold s_lock.
+//
+// Returns:
+//   true if s_cur now points at an empty buffer.
+// ============================================================
+static bool open_next_buffer(void) {
+    if (xQueueReceive(s_free_q, &s_cur, 0) != pdTRUE) {
+        s_cur = NO_BUF;
+        return false;
+    }
+    s_buf[s_cur].used = 0;
+    s_buf[s_cur].records = 0;
+    return true;
+}
+
+// ============================================================
+// seal_current()
+//
+// Finalizes the block header of the current buffer, queues it
+// for the writer task, and opens the next free buffer (if any).
+// Caller must hold s_lock and s_cur must be valid.
+// ============================================================
+static void seal_current(void) {
+    log_buf_t *b = &s_buf[s_cur];
+    sd_log_block_hdr_t hdr = {
+        .magic = SD_LOG_BLOCK_MAGIC,
+        .seq = s_next_seq++,
+        .used = b->used,
+        .records = b->records,
+    };
+    hdr.crc = esp_rom_crc32_le(0, (const uint8_t *)&hdr,
+                               offsetof(sd_log_block_hdr_t, crc));
+    memcpy(b->data, &hdr, sizeof(hdr));
+
+    // The tail is already zero (see sd_log_task()), so stale bytes
+    // never look like records and sealing costs the same however
+    // full the buffer is.
+    b->seq = hdr.seq;
+
+    // full_q holds SD_LOG_BUF_COUNT entries, so this never fails.
+    xQueueSend(s_full_q, &s_cur, 0);
+    open_next_buffer();
+}
+
+// ============================================================
+// write_index()
+//
+// Records block b in the segment index and writes the index
+// sector once the last block of the segment is on the card.
+// ============================================================
+static void write_index(const log_buf_t *b) {
+    sd_log_index_t *idx = (sd_log_index_t *)s_index;
+    uint32_t blk = b->seq % SD_LOG_BLOCKS_PER_INDEX;
+    uint32_t first_seq = b->seq - blk;
+
+    // New segment (or first block after boot): reset the entries.
+    if (idx->magic != SD_LOG_INDEX_MAGIC || idx->first_seq != first_seq) {
+        memset(s_index, 0, SD_LOG_SECTOR_BYTES);
+        idx->magic = SD_LOG_INDEX_MAGIC;
+        idx->first_seq = first_seq;
+        idx->count = SD_LOG_BLOCKS_PER_INDEX;
+        for (uint32_t i = 0; i < SD_LOG_BLOCKS_PER_INDEX; i++) {
+            idx->entry[i].seq = SEQ_NONE;
+        }
+    }
+    idx->entry[blk].seq = b->seq;
+    idx->entry[blk].first_ms = b->first_ms;
+    idx->entry[blk].last_ms = b->last_ms;
+
+    if (blk != SD_LOG_BLOCKS_PER_INDEX - 1) {
+        return;
+    }
+    idx->crc = esp_rom_crc32_le(0, s_index, offsetof(sd_log_index_t, crc));
+    uint32_t sector = block_sector(first_seq) + BLOCK_SECTORS * SD_LOG_BLOCKS_PER_INDEX;
+    if (card_io(true, s_index, sector, 1, NULL) == ESP_OK) {
+        s_stats.index_written++;
+    } else {
+        s_stats.write_errors++;
+    }
+}
+
+// ============================================================
+// sd_log_task()
+//
+// Background writer. One multi-sector DMA write per block.
+//
+// Steps (forever):
+//   1. Wait up to SD_LOG_FLUSH_MS for a sealed buffer.
+//   2. On timeout, seal the current buffer if its oldest record
+//      is older than SD_LOG_FLUSH_MS.
+//   3. Otherwise write the block, update the index, zero what it
+//      held and return the buffer to the free queue. Buffers go
+//      back all zero, so callers never pay for clearing a tail.
+// ============================================================
+static void sd_log_task(void *arg) {
+    for (;;) {
+        uint8_t i;
+        if (xQueueReceive(s_full_q, &i, pdMS_TO_TICKS(SD_LOG_FLUSH_MS)) != pdTRUE) {
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            if (s_cur != NO_BUF && s_buf[s_cur].records > 0 &&
+                esp_timer_get_time() - s_cur_open_us >= (int64_t)SD_LOG_FLUSH_MS * 1000) {
+                s_stats.partial_flushes++;
+                seal_current();
+            }
+            xSemaphoreGive(s_lock);
+            continue;
+        }
+
+        log_buf_t *b = &s_buf[i];
+        uint32_t us = 0;
+        esp_err_t err = card_io(true, b->data, block_sector(b->seq), BLOCK_SECTORS, &us);
+
+        if (err == ESP_OK) {
+            s_stats.blocks_written++;
+            s_stats.total_write_us += us;
+            if (us > s_stats.max_write_us) {
+                s_stats.max_write_us = us;
+            }
+            write_index(b);
+        } else {
+            s_stats.write_errors++;
+            printf("[%s] block %lu write failed: %s\n", TAG,
+                   (unsigned long)b->seq, esp_err_to_name(err));
+        }
+
+        // Still ours until queued: clear what this block held.
+        memset(b->data, 0, sizeof(sd_log_block_hdr_t) + b->used);
+
+        // A caller may be dropping records for lack of a buffer.
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        if (s_cur == NO_BUF) {
+            s_cur = i;
+            b->used = 0;
+            b->records = 0;
+        } else {
+            xQueueSend(s_free_q, &i, 0);
+        }
+        xSemaphoreGive(s_lock);
+    }
+}
+
+// ============================================================
+// sd_card_mount()
+//
+// Brings up the card in raw sdspi mode on the shared bus. The
+// bus itself belongs to the SPI arbiter; card initialization
+// runs as an arbiter job like every later access.
+// ============================================================
+static esp_err_t card_init_job(void *ctx) {
+    return sdmmc_card_init((const sdmmc_host_t *)ctx, &s_card);
+}
+
+static esp_err_t sd_card_mount(void) {
+    spi_arb_device_config_t arb = {
+        .name = "sd",
+        .cs = -1,                      // sdspi drives its own CS.
+        .clock_hz = SPI_FREQ_HZ,
+        .priority = SPI_ARB_PRIO_SD,
+    };
+    s_spi_dev = spi_arb_add_device(&arb);
+    if (s_spi_dev < 0) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = spi_arb_init();
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    err = sdspi_host_init();
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        return err;
+    }
+
+    sdspi_device_config_t dev = SDSPI_DEVICE_CONFIG_DEFAULT();
+    dev.gpio_cs = PIN_SD_CS;
+    dev.host_id = SD_LOG_SPI_HOST;
+    sdspi_dev_handle_t handle;
+    err = sdspi_host_init_device(&dev, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    sdmmc_host_t host = SDSPI_HOST_DEFAULT();
+    host.slot = handle;
+    host.max_freq_khz = SPI_FREQ_HZ / 1000;
+    spi_arb_req_t req;
+    spi_arb_req_job(&req, s_spi_dev, card_init_job, &host, 0);
+    return spi_arb_run(&req);
+}
+
+// ============================================================
+// Public API
+// ============================================================
+esp_err_t sd_log_init(void) {
+    esp_err_t err = sd_card_mount();
+    if (err != ESP_OK) {
+        printf("[%s] card init failed: %s\n", TAG, esp_err_to_name(err));
+        return err;
+    }
+    if (s_card.csd.sector_size != SD_LOG_SECTOR_BYTES ||
+        (uint32_t)s_card.csd.capacity <= SD_LOG_START_SECTOR + SEGMENT_SECTORS) {
+        printf("[%s] card too small or unsupported sector size\n", TAG);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    s_segments = ((uint32_t)s_card.csd.capacity - SD_LOG_START_SECTOR) / SEGMENT_SECTORS;
+
+    // DMA-capable internal RAM: sdspi would otherwise bounce every
+    // block through its own temporary buffer. Zeroed: every free
+    // buffer is.
+    for (int i = 0; i < SD_LOG_BUF_COUNT; i++) {
+        s_buf[i].data = heap_caps_calloc(1, SD_LOG_BUF_BYTES, MALLOC_CAP_DMA);
+        if (!s_buf[i].data) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    s_index = heap_caps_calloc(1, SD_LOG_SECTOR_BYTES, MALLOC_CAP_DMA);
+    if (!s_index) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_free_q = xQueueCreate(SD_LOG_BUF_COUNT, sizeof(uint8_t));
+    s_full_q = xQueueCreate(SD_LOG_BUF_COUNT, sizeof(uint8_t));
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_free_q || !s_full_q || !s_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // s_index doubles as the scratch sector while scanning.
+    s_next_seq = find_log_end(s_index);
+    memset(s_index, 0, SD_LOG_SECTOR_BYTES);
+
+    for (uint8_t i = 0; i < SD_LOG_BUF_COUNT; i++) {
+        xQueueSend(s_free_q, &i, 0);
+    }
+    open_next_buffer();
+
+    printf("[%s] %s, %lu MB, %lu segments of %d x %d bytes, %d buffers\n",
+           TAG, s_card.cid.name,
+           (unsigned long)((uint64_t)s_card.csd.capacity * SD_LOG_SECTOR_BYTES >> 20),
+           (unsigned long)s_segments, SD_LOG_BLOCKS_PER_INDEX, SD_LOG_BUF_BYTES,
+           SD_LOG_BUF_COUNT);
+
+    xTaskCreate(sd_log_task, "sd_log", SD_LOG_TASK_STACK_BYTES, NULL,
+                SD_LOG_TASK_PRIO, NULL);
+    return ESP_OK;
+}
+
+esp_err_t sd_log_write(uint8_t type, uint32_t t_ms, const void *data, size_t len) {
+    if (len > SD_LOG_RECORD_MAX) {
+        len = SD_LOG_RECORD_MAX;
+    }
+    size_t need = sizeof(sd_log_rec_hdr_t) + len;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+
+    if (s_cur != NO_BUF &&
+        sizeof(sd_log_block_hdr_t) + s_buf[s_cur].used + need > SD_LOG_BUF_BYTES) {
+        seal_current();
+    }
+    if (s_cur == NO_BUF && !open_next_buffer()) {
+        s_stats.dropped++;
+        xSemaphoreGive(s_lock);
+        return ESP_ERR_NO_MEM;
+    }
+
+    log_buf_t *b = &s_buf[s_cur];
+    if (b->records == 0) {
+        b->first_ms = t_ms;
+        s_cur_open_us = esp_timer_get_time();
+    }
+    b->last_ms = t_ms;
+
+    sd_log_rec_hdr_t rec = {
+        .len = (uint16_t)len,
+        .type = type,
+        .t_ms = t_ms,
+    };
+    uint8_t *dst = b->data + sizeof(sd_log_block_hdr_t) + b->used;
+    memcpy(dst, &rec, sizeof(rec));
+    if (len > 0) {
+        memcpy(dst + sizeof(rec), data, len);
+    }
+    b->used += (uint16_t)need;
+    b->records++;
+    s_stats.records++;
+    s_stats.bytes += (uint32_t)len;
+
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+esp_err_t sd_log_flush(uint32_t timeout_ms) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_cur != NO_BUF && s_buf[s_cur].records > 0) {
+        s_stats.partial_flushes++;
+        seal_current();
+    }
+    xSemaphoreGive(s_lock);
+
+    // Idle once every buffer is either free or the (empty) current one.
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    for (;;) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        UBaseType_t idle = uxQueueMessagesWaiting(s_free_q) + (s_cur != NO_BUF ? 1 : 0);
+        xSemaphoreGive(s_lock);
+        if (idle == SD_LOG_BUF_COUNT) {
+            return s_stats.write_errors ? ESP_FAIL : ESP_OK;
+        }
+        if (esp_timer_get_time() >= deadline) {
+            return ESP_ERR_TIMEOUT;
+        }
+        vTaskDelay(pdMS_TO_TICKS(5));
+    }
+}
+
+uint32_t sd_log_position(void) {
+    return s_next_seq;
+}
+
+const sd_log_stats_t *sd_log_stats(void) {
+    return &s_stats;
+}
+
+#endif  // FEATURE_SD_LOGGING
@@ -0,0 +1,123 @@
+#pragma once
+
+// ============================================================
+// sd_logger.h
+//
+// Append-only SD card logger (FEATURE_SD_LOGGING).
+//
+// Why not fopen/fwrite on FATFS:
+//   Every fwrite can block the caller for a whole FAT/cluster
+//   update, and small appends rewrite the same sectors (data,
+//   FAT, directory entry) over and over.
+//
+// What this does instead:
+//   - The card is opened in raw SPI mode (sdspi, DMA-capable
+//     buffers) and the log owns the sectors from
+//     SD_LOG_START_SECTOR to the end of the card.
+//   - SD_LOG_BUF_COUNT block buffers of SD_LOG_BUF_BYTES each
+//     (double or triple buffering). sd_log_write() only copies
+//     the record into the current buffer. When it is full, the
+//     buffer is handed to a background task that writes it with
+//     one multi-sector DMA transfer while callers fill the next.
+//   - If no buffer is free the record is dropped and counted;
+//     the hot path never waits for the card.
+//
+// On-card layout (all sector aligned, never rewritten):
+//
+//   | blk 0 | blk 1 | ... | blk N-1 | index | blk 0 | ...
+//   \_________________ segment ______________/
+//
+//   Data block (SD_LOG_BUF_BYTES):
+//     sd_log_block_hdr_t, then records back to back:
+//     sd_log_rec_hdr_t + payload. Records never span blocks.
+//   Index sector (512 bytes) after every SD_LOG_BLOCKS_PER_INDEX
+//     data blocks: sequence number and time range of each block
+//     in the segment, so a reader can seek by time reading one
+//     sector per segment.
+//
+//   Sequence numbers increase by one per block slot, so after a
+//   reset the end of the log is found by binary search over the
+//   segment headers, and the log wraps to the start of the
+//   region when the card is full.
+// ============================================================
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "app_config.h"
+
+#define SD_LOG_SECTOR_BYTES 512
+#define SD_LOG_BLOCK_MAGIC 0x474C4453u  // "SDLG"
+#define SD_LOG_INDEX_MAGIC 0x58444453u  // "SDDX"
+
+// --- On-card structures -------------------------------------
+typedef struct __attribute__((packed)) {
+    uint32_t magic;      // SD_LOG_BLOCK_MAGIC.
+    uint32_t seq;        // Block slot sequence number.
+    uint16_t used;       // Bytes of records after this header.
+    uint16_t records;    // Number of records in the block.
+    uint32_t crc;        // CRC32 of the fields above.
+} sd_log_block_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t len;        // Payload bytes.
+    uint8_t type;        // Caller-defined record type.
+    uint8_t reserved;
+    uint32_t t_ms;       // Timestamp (ms since boot).
+} sd_log_rec_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t seq;        // 0 if the slot was skipped.
+    uint32_t first_ms;
+    uint32_t last_ms;
+} sd_log_index_entry_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;      // SD_LOG_INDEX_MAGIC.
+    uint32_t first_seq;  // Sequence number of block 0 in the segment.
+    uint32_t count;      // SD_LOG_BLOCKS_PER_INDEX.
+    sd_log_index_entry_t entry[SD_LOG_BLOCKS_PER_INDEX];
+    uint32_t crc;        // CRC32 of everything above.
+} sd_log_index_t;
+
+// Largest payload a single record can carry.
+#define SD_LOG_RECORD_MAX \
+    (SD_LOG_BUF_BYTES - sizeof(sd_log_block_hdr_t) - sizeof(sd_log_rec_hdr_t))
+
+// --- Counters -----------------------------------------------
+typedef struct {
+    uint32_t records;          // Records accepted.
+    uint32_t dropped;          // Records dropped (no free buffer).
+    uint32_t bytes;            // Payload bytes accepted.
+    uint32_t blocks_written;
+    uint32_t index_written;
+    uint32_t write_errors;
+    uint32_t partial_flushes;  // Blocks sealed before they were full.
+    uint32_t max_write_us;     // Slowest block write.
+    uint64_t total_write_us;
+} sd_log_stats_t;
+
+// --- Public functions ---------------------------------------
+
+// Mounts the card in raw SPI mode on the shared PIN_SPI_* bus (SPI arbiter)
+// and PIN_SD_CS, finds the end of an existing log, allocates the
+// DMA buffers and starts the writer task.
+esp_err_t sd_log_init(void);
+
+// Appends one record. Copies at most SD_LOG_RECORD_MAX bytes and
+// never blocks on the card. Returns ESP_ERR_NO_MEM if the record
+// was dropped because every buffer is waiting to be written.
+esp_err_t sd_log_write(uint8_t type, uint32_t t_ms,
+                       const void *data, size_t len);
+
+// Seals the current (partial) block and waits until every queued
+// block is on the card, e.g. before deep sleep.
+esp_err_t sd_log_flush(uint32_t timeout_ms);
+
+// Next block sequence number (log position).
+uint32_t sd_log_position(void);
+
+const sd_log_stats_t *sd_log_stats(void);
@@ -0,0 +1,363 @@
+// ============================================================
+// spi_arbiter.c
+//
+// Priority / deadline ordered request queue for the shared SPI
+// bus. See spi_arbiter.h.
+// ============================================================
+
+#include "spi_arbiter.h"
+
+#if SPI_ARB_ENABLED
+
+// stdio.h: printf() for console logging to UART0.
+#include <stdio.h>
+
+// string.h: memset() for requests and stats.
+#include <string.h>
+
+// FreeRTOS: arbiter task, pending-list mutex, spi_arb_run() wait.
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+// ESP-IDF SPI master driver (bus + raw devices).
+#include "driver/spi_common.h"
+#include "driver/spi_master.h"
+
+// esp_timer.h: queueing / busy time.
+#include "esp_timer.h"
+
+static const char *TAG = "spi_arb";
+
+#define SPI_ARB_HOST SPI2_HOST
+#define NO_DEVICE 0xFF
+
+typedef struct {
+    spi_arb_device_config_t cfg;
+    spi_device_handle_t handle;       // TRANSFER devices only.
+    spi_arb_device_stats_t stats;
+} arb_device_t;
+
+static arb_device_t s_devs[SPI_ARB_MAX_DEVICES];
+static int s_dev_count;
+
+// Bus setup and device registration come from every SPI user's
+// init, which may run on the init task and at first use at once
+// (lazy_init.h): setup_lock() serializes them.
+static portMUX_TYPE s_setup_mux = portMUX_INITIALIZER_UNLOCKED;
+static StaticSemaphore_t s_setup_storage;
+static SemaphoreHandle_t s_setup;
+
+static bool s_started;
+static TaskHandle_t s_task;
+static SemaphoreHandle_t s_lock;      // Guards s_pending and s_seq.
+static spi_arb_req_t *s_pending;      // Unordered; picked by scan.
+static uint32_t s_seq;
+static uint8_t s_last_dev = NO_DEVICE;
+static spi_arb_stats_t s_stats;
+
+// ============================================================
+// runs_before()
+//
+// True if request a should run before request b (see the
+// ordering rules in spi_arbiter.h).
+// ============================================================
+static bool runs_before(const spi_arb_req_t *a, const spi_arb_req_t *b) {
+    uint8_t pa = s_devs[a->dev].cfg.priority;
+    uint8_t pb = s_devs[b->dev].cfg.priority;
+    if (pa != pb) {
+        return pa > pb;
+    }
+    if (a->deadline_us != b->deadline_us) {
+        if (a->deadline_us == 0 || b->deadline_us == 0) {
+            return b->deadline_us == 0;
+        }
+        return a->deadline_us < b->deadline_us;
+    }
+    bool a_same = a->dev == s_last_dev;
+    bool b_same = b->dev == s_last_dev;
+    if (a_same != b_same) {
+        return a_same;
+    }
+    return (int32_t)(a->seq - b->seq) < 0;
+}
+
+// Unlinks and returns the next request to run (NULL if none).
+static spi_arb_req_t *take_next(void) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    spi_arb_req_t **best = NULL;
+    for (spi_arb_req_t **p = &s_pending; *p; p = &(*p)->next) {
+        if (!best || runs_before(*p, *best)) {
+            best = p;
+        }
+    }
+    spi_arb_req_t *req = NULL;
+    if (best) {
+        req = *best;
+        *best = req->next;
+        req->next = NULL;
+    }
+    xSemaphoreGive(s_lock);
+    return req;
+}
+
+static esp_err_t execute(spi_arb_req_t *req) {
+    if (req->kind == SPI_ARB_JOB) {
+        return req->job(req->job_ctx);
+    }
+    spi_device_handle_t handle = s_devs[req->dev].handle;
+    if (!handle) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    spi_transaction_t t = {
+        .length = req->len * 8,
+        .tx_buffer = req->tx,
+        .rx_buffer = req->rx,
+    };
+    return spi_device_transmit(handle, &t);
+}
+
+// ============================================================
+// spi_arb_task()
+//
+// Steps (forever):
+//   1. Sleep until a submit notifies the task.
+//   2. Take the best pending request, run it, account it and
+//      call its done callback. Repeat until nothing is pending,
+//      so the bus never idles while work is queued.
+// ============================================================
+static void spi_arb_task(void *arg) {
+    for (;;) {
+        // --- Step 1: Wait for work ---
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // --- Step 2: Drain in arbitration order ---
+        spi_arb_req_t *req;
+        while ((req = take_next()) != NULL) {
+            arb_device_t *d = &s_devs[req->dev];
+            req->t_start_us = esp_timer_get_time();
+            if (req->dev != s_last_dev) {
+                s_stats.switches++;
+                s_last_dev = req->dev;
+            }
+
+            req->result = execute(req);
+            req->t_done_us = esp_timer_get_time();
+
+            uint32_t queued_us = (uint32_t)(req->t_start_us - req->t_submit_us);
+            uint64_t busy_us = (uint64_t)(req->t_done_us - req->t_start_us);
+            d->stats.requests++;
+            d->stats.total_queue_us += queued_us;
+            if (queued_us > d->stats.max_queue_us) {
+                d->stats.max_queue_us = queued_us;
+            }
+            d->stats.busy_us += busy_us;
+            s_stats.busy_us += busy_us;
+            if (req->deadline_us != 0 && req->t_start_us > req->deadline_us) {
+                d->stats.deadline_misses++;
+            }
+            if (req->result != ESP_OK) {
+                d->stats.errors++;
+            }
+
+            if (req->done) {
+                req->done(req, req->user);
+            }
+        }
+    }
+}
+
+// ============================================================
+// Devices
+// ============================================================
+static void setup_lock(void) {
+    // Created on first use; the spinlock makes that once-only.
+    portENTER_CRITICAL(&s_setup_mux);
+    if (s_setup == NULL) {
+        s_setup = xSemaphoreCreateMutexStatic(&s_setup_storage);
+    }
+    portEXIT_CRITICAL(&s_setup_mux);
+    xSemaphoreTake(s_setup, portMAX_DELAY);
+}
+
+static void setup_unlock(void) {
+    xSemaphoreGive(s_setup);
+}
+
+static esp_err_t attach_device(arb_device_t *d) {
+    if (d->cfg.cs < 0 || d->handle) {
+        return ESP_OK;
+    }
+    spi_device_interface_config_t dev = {
+        .clock_speed_hz = d->cfg.clock_hz,
+        .mode = d->cfg.mode,
+        .spics_io_num = d->cfg.cs,
+        .queue_size = 1,
+    };
+    return spi_bus_add_device(SPI_ARB_HOST, &dev, &d->handle);
+}
+
+int spi_arb_add_device(const spi_arb_device_config_t *cfg) {
+    int id = -1;
+    setup_lock();
+    if (s_dev_count < SPI_ARB_MAX_DEVICES) {
+        arb_device_t *d = &s_devs[s_dev_count];
+        memset(d, 0, sizeof(*d));
+        d->cfg = *cfg;
+        d->stats.name = cfg->name;
+        if (!s_started || attach_device(d) == ESP_OK) {
+            id = s_dev_count++;
+        }
+    }
+    setup_unlock();
+    return id;
+}
+
+// ============================================================
+// spi_arb_init()
+//
+// One bus init for every SPI user, sized for the largest DMA
+// transfer any of them makes (SPI_ARB_MAX_TRANSFER_BYTES).
+// Concurrent callers wait for the first; later ones return at
+// once.
+// ============================================================
+static esp_err_t start(void) {
+    spi_bus_config_t bus = {
+        .mosi_io_num = PIN_SPI_MOSI,
+        .miso_io_num = PIN_SPI_MISO,
+        .sclk_io_num = PIN_SPI_SCK,
+        .quadwp_io_num = -1,
+        .quadhd_io_num = -1,
+        .max_transfer_sz = SPI_ARB_MAX_TRANSFER_BYTES,
+    };
+    esp_err_t err = spi_bus_initialize(SPI_ARB_HOST, &bus, SPI_DMA_CH_AUTO);
+    if (err != ESP_OK) {
+        printf("[%s] spi_bus_initialize failed: %s\n", TAG, esp_err_to_name(err));
+        return err;
+    }
+
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock ||
+        xTaskCreate(spi_arb_task, "spi_arb", SPI_ARB_TASK_STACK_BYTES, NULL,
+                    SPI_ARB_TASK_PRIO, &s_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_started = true;
+    for (int i = 0; i < s_dev_count; i++) {
+        err = attach_device(&s_devs[i]);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    spi_arb_reset_stats();
+    printf("[%s] SCK %d MISO %d MOSI %d, max transfer %d bytes\n", TAG,
+           PIN_SPI_SCK, PIN_SPI_MISO, PIN_SPI_MOSI, SPI_ARB_MAX_TRANSFER_BYTES);
+    return ESP_OK;
+}
+
+esp_err_t spi_arb_init(void) {
+    setup_lock();
+    esp_err_t err = s_started ? ESP_OK : start();
+    setup_unlock();
+    return err;
+}
+
+// ============================================================
+// Requests
+// ============================================================
+void spi_arb_req_transfer(spi_arb_req_t *req, int dev, const void *tx, void *rx,
+                          size_t len, int64_t deadline_us) {
+    memset(req, 0, sizeof(*req));
+    req->dev = (uint8_t)dev;
+    req->kind = SPI_ARB_TRANSFER;
+    req->tx = tx;
+    req->rx = rx;
+    req->len = len;
+    req->deadline_us = deadline_us;
+}
+
+void spi_arb_req_job(spi_arb_req_t *req, int dev, spi_arb_job_fn job, void *ctx,
+                     int64_t deadline_us) {
+    memset(req, 0, sizeof(*req));
+    req->dev = (uint8_t)dev;
+    req->kind = SPI_ARB_JOB;
+    req->job = job;
+    req->job_ctx = ctx;
+    req->deadline_us = deadline_us;
+}
+
+esp_err_t spi_arb_submit(spi_arb_req_t *req, spi_arb_done_fn done, void *user) {
+    if (!s_started || req->dev >= s_dev_count) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    req->done = done;
+    req->user = user;
+    req->t_submit_us = esp_timer_get_time();
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    req->seq = s_seq++;
+    req->next = s_pending;
+    s_pending = req;
+    xSemaphoreGive(s_lock);
+
+    xTaskNotifyGive(s_task);
+    return ESP_OK;
+}
+
+static void run_done(spi_arb_req_t *req, void *user) {
+    xSemaphoreGive((SemaphoreHandle_t)user);
+}
+
+esp_err_t spi_arb_run(spi_arb_req_t *req) {
+    StaticSemaphore_t storage;
+    SemaphoreHandle_t done = xSemaphoreCreateBinaryStatic(&storage);
+    esp_err_t err = spi_arb_submit(req, run_done, done);
+    if (err == ESP_OK) {
+        xSemaphoreTake(done, portMAX_DELAY);
+        err = req->result;
+    }
+    vSemaphoreDelete(done);
+    return err;
+}
+
+// ============================================================
+// Stats
+// ============================================================
+const spi_arb_stats_t *spi_arb_stats(void) {
+    return &s_stats;
+}
+
+const spi_arb_device_stats_t *spi_arb_device_stats(int dev) {
+    return (dev >= 0 && dev < s_dev_count) ? &s_devs[dev].stats : NULL;
+}
+
+int spi_arb_device_count(void) {
+    return s_dev_count;
+}
+
+void spi_arb_reset_stats(void) {
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_stats.since_us = esp_timer_get_time();
+    for (int i = 0; i < s_dev_count; i++) {
+        memset(&s_devs[i].stats, 0, sizeof(s_devs[i].stats));
+        s_devs[i].stats.name = s_devs[i].cfg.name;
+    }
+}
+
+void spi_arb_print_stats(void) {
+    int64_t window_us = esp_timer_get_time() - s_stats.since_us;
+    printf("[%s] utilization %.1f%% over %lld ms, %lu device switches\n", TAG,
+           window_us > 0 ? 100.0 * (double)s_stats.busy_us / (double)window_us : 0.0,
+           (long long)(window_us / 1000), (unsigned long)s_stats.switches);
+    for (int i = 0; i < s_dev_count; i++) {
+        const spi_arb_device_stats_t *d = &s_devs[i].stats;
+        printf("[%s]   %-8s prio %u: %lu req, queue avg %lu us max %lu us, "
+               "busy %llu us, %lu late, %lu errors\n",
+               TAG, d->name, s_devs[i].cfg.priority, (unsigned long)d->requests,
+               (unsigned long)(d->requests ? d->total_queue_us / d->requests : 0),
+               (unsigned long)d->max_queue_us, (unsigned long long)d->busy_us,
+               (unsigned long)d->deadline_misses, (unsigned long)d->errors);
+    }
+}
+
+#endif  // SPI_ARB_ENABLED
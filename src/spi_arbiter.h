@@ -0,0 +1,132 @@
+#pragma once
+
+// ============================================================
+// spi_arbiter.h
+//
+// Shared SPI bus arbiter (SPI2, PIN_SPI_SCK/MISO/MOSI).
+//
+// The SD logger, the display and any raw SPI device (external
+// flash, ...) register here instead of each initializing the
+// bus. Work reaches the bus only through requests:
+//   - SPI_ARB_TRANSFER — a DMA transfer on a device the arbiter
+//     added to the bus (spi_master device per registered CS).
+//   - SPI_ARB_JOB      — a callback run on the arbiter task, for
+//     devices driven by their own IDF stack (sdspi, esp_lcd).
+//
+// Ordering (one request at a time, chosen when the bus frees):
+//   1. Higher device priority first.
+//   2. Then earliest deadline (requests without one go last).
+//   3. Then the device that used the bus last, so the driver
+//      does not reconfigure clock/mode/CS (the IDF only re-applies
+//      device settings when the device changes).
+//   4. Then submit order.
+//
+// Requests are caller-owned and must stay valid until done()
+// (or until spi_arb_run() returns).
+//
+// Accounting: "busy" is time spent executing requests. esp_lcd
+// color DMA keeps running after its job returns; the next
+// request waits for it inside the IDF bus lock, so that time is
+// charged to whichever request runs next.
+// ============================================================
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "app_config.h"
+
+typedef enum {
+    SPI_ARB_TRANSFER,
+    SPI_ARB_JOB
+} spi_arb_kind_t;
+
+typedef struct {
+    const char *name;
+    int cs;              // CS pin for TRANSFER requests; -1 = jobs only.
+    int clock_hz;
+    uint8_t mode;        // SPI mode 0-3.
+    uint8_t priority;    // Higher runs first.
+} spi_arb_device_config_t;
+
+typedef struct spi_arb_req spi_arb_req_t;
+
+typedef esp_err_t (*spi_arb_job_fn)(void *ctx);
+typedef void (*spi_arb_done_fn)(spi_arb_req_t *req, void *user);
+
+struct spi_arb_req {
+    spi_arb_req_t *next;      // Pending list link (arbiter-owned).
+    uint8_t dev;
+    uint8_t kind;             // spi_arb_kind_t
+
+    // SPI_ARB_TRANSFER
+    const void *tx;
+    void *rx;
+    size_t len;
+
+    // SPI_ARB_JOB
+    spi_arb_job_fn job;
+    void *job_ctx;
+
+    int64_t deadline_us;      // Absolute esp_timer time, 0 = none.
+    spi_arb_done_fn done;
+    void *user;
+
+    // Filled in by the arbiter.
+    esp_err_t result;
+    uint32_t seq;
+    int64_t t_submit_us;
+    int64_t t_start_us;
+    int64_t t_done_us;
+};
+
+// --- Counters -----------------------------------------------
+typedef struct {
+    const char *name;
+    uint32_t requests;
+    uint32_t errors;
+    uint32_t deadline_misses;  // Started after their deadline.
+    uint64_t total_queue_us;   // Submit -> start.
+    uint32_t max_queue_us;
+    uint64_t busy_us;
+} spi_arb_device_stats_t;
+
+typedef struct {
+    uint64_t busy_us;
+    uint32_t switches;         // Requests that changed device.
+    int64_t since_us;          // Start of the measurement window.
+} spi_arb_stats_t;
+
+// --- Public functions ---------------------------------------
+
+// Registers a device; returns its id or -1. Call before or after
+// spi_arb_init(); TRANSFER devices are added to the bus then.
+// Safe to call from several tasks at once.
+int spi_arb_add_device(const spi_arb_device_config_t *cfg);
+
+// Initializes the bus and starts the arbiter task. Safe to call
+// from every SPI user, on any task and concurrently; only the
+// first call does the work.
+esp_err_t spi_arb_init(void);
+
+void spi_arb_req_transfer(spi_arb_req_t *req, int dev, const void *tx, void *rx,
+                          size_t len, int64_t deadline_us);
+void spi_arb_req_job(spi_arb_req_t *req, int dev, spi_arb_job_fn job, void *ctx,
+                     int64_t deadline_us);
+
+// Queues req; done(req, user) is called on the arbiter task.
+esp_err_t spi_arb_submit(spi_arb_req_t *req, spi_arb_done_fn done, void *user);
+
+// Queues req and blocks the calling task until it has run.
+// Returns the request result.
+esp_err_t spi_arb_run(spi_arb_req_t *req);
+
+const spi_arb_stats_t *spi_arb_stats(void);
+const spi_arb_device_stats_t *spi_arb_device_stats(int dev);
+int spi_arb_device_count(void);
+void spi_arb_reset_stats(void);
+
+// Prints utilization and per-device queueing latency.
+void spi_arb_print_stats(void);